@@ -0,0 +1,91 @@
+/*
+ * 热路径日志开销：文本日志(LOG_INFO)与二进制日志(LOG_BIN_INFO)的单条调用耗时对比
+ * 用法: binlog_bench [messages] [logdir]
+ * 每种模式由一个线程连续写 messages 条带 int/字符串/double 参数的日志，统计日志语句所在线程的平均耗时
+ * 耗时按线程 CPU 时间(CLOCK_THREAD_CPUTIME_ID)计算，不包括后台线程的格式化和写文件，CPU 核数少时也能反映热路径的开销
+ *   text        LOG_INFO，输出到空函数，只计格式化开销
+ *   text-async  LOG_INFO，输出到 AsyncLogging
+ *   binary      LOG_BIN_INFO，后台线程格式化后输出到空函数
+ *   binary-async LOG_BIN_INFO，后台线程格式化后输出到 AsyncLogging
+ * 两种日志的输出内容相同([文件:函数:行号] 前缀 + 消息)，async 模式的日志文件写在 logdir(默认 /tmp)中
+ */
+
+#include "AsyncLogging.h"
+#include "BinaryLogger.h"
+#include "Logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <time.h>
+
+static double threadCpuSeconds() {
+  struct timespec ts;
+  ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<double>(ts.tv_sec) + ts.tv_nsec / 1e9;
+}
+
+static double runText(int64_t messages) {
+  const char *peer = "127.0.0.1:9981";
+  double start = threadCpuSeconds();
+  for (int64_t i = 0; i < messages; ++i) {
+    LOG_INFO("[%s:%s:%d]\nconnection %ld fd = %d peer = %s rtt = %.3f", __FILE__, __FUNCTION__, __LINE__,
+             static_cast<long>(i), static_cast<int>(i & 1023), peer, 0.125);
+  }
+  return (threadCpuSeconds() - start) * 1e9 / messages;
+}
+
+static double runBinary(int64_t messages) {
+  const char *peer = "127.0.0.1:9981";
+  // 第一条日志创建本线程的缓冲区，不计入耗时
+  LOG_BIN_INFO("binlog_bench start");
+  double start = threadCpuSeconds();
+  for (int64_t i = 0; i < messages; ++i) {
+    LOG_BIN_INFO("connection %ld fd = %d peer = %s rtt = %.3f", static_cast<long>(i),
+                 static_cast<int>(i & 1023), peer, 0.125);
+  }
+  return (threadCpuSeconds() - start) * 1e9 / messages;
+}
+
+int main(int argc, char *argv[]) {
+  int64_t messages = argc > 1 ? atoll(argv[1]) : 1000000;
+  std::string logdir = argc > 2 ? argv[2] : "/tmp";
+  Logger &logger = Logger::instance();
+  // 每条记录约 64 字节，缓冲区足够容纳全部日志，测的是写入开销而不是丢弃
+  size_t ringSize = static_cast<size_t>(messages) * 64;
+
+  fprintf(stderr, "%-13s %10s %10s\n", "mode", "ns/msg", "dropped");
+
+  logger.setOutput([](int, const char *, size_t) {});
+  double ns = runText(messages);
+  fprintf(stderr, "%-13s %10.1f %10d\n", "text", ns, 0);
+
+  BinaryLogger::start(ringSize);
+  ns = runBinary(messages);
+  BinaryLogger::stop();
+  fprintf(stderr, "%-13s %10.1f %10ld\n", "binary", ns, static_cast<long>(BinaryLogger::dropped()));
+
+  {
+    AsyncLogging async(logdir + "/binlog_bench_text", 1024 * 1024 * 1024);
+    async.start();
+    logger.setOutput([&async](int, const char *msg, size_t len) { async.append(msg, len); });
+    ns = runText(messages);
+    async.stop();
+    fprintf(stderr, "%-13s %10.1f %10ld\n", "text-async", ns, static_cast<long>(async.dropped()));
+  }
+
+  {
+    AsyncLogging async(logdir + "/binlog_bench_binary", 1024 * 1024 * 1024);
+    async.start();
+    logger.setOutput([&async](int, const char *msg, size_t len) { async.append(msg, len); });
+    int64_t droppedBefore = BinaryLogger::dropped();
+    BinaryLogger::start(ringSize);
+    ns = runBinary(messages);
+    BinaryLogger::stop();
+    async.stop();
+    fprintf(stderr, "%-13s %10.1f %10ld\n", "binary-async", ns,
+            static_cast<long>(BinaryLogger::dropped() - droppedBefore + async.dropped()));
+  }
+  logger.setOutput([](int, const char *msg, size_t len) { fwrite(msg, 1, len, stdout); });
+  return 0;
+}
@@ -0,0 +1,154 @@
+/*
+ * 协程 echo 服务器与回调 echo 服务器的吞吐对比
+ * 用法: co_echo_bench [callback|coroutine] [threads] [connections] [msgSize] [seconds]
+ * 服务端和 pingpong 客户端运行在同一进程中，客户端使用阻塞 socket，每个连接一个线程
+ */
+
+#include "Coroutine.h"
+#include "EventLoop.h"
+#include "TcpServer.h"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static const uint16_t kPort = 9981;
+
+static CoTask echoSession(CoConnection conn) {
+  while (true) {
+    std::string data = co_await conn.readSome();
+    if (data.empty()) {
+      break;
+    }
+    if (!co_await conn.write(data)) {
+      break;
+    }
+  }
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+  conn->send(buf->retrieveAllAsString());
+}
+
+static bool writeAll(int fd, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = ::write(fd, data, len);
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+static bool readAll(int fd, char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = ::read(fd, data, len);
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+static void clientFunc(size_t msgSize, std::atomic<bool> *stop, std::atomic<int64_t> *messages) {
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr;
+  ::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(kPort);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+    perror("connect");
+    ::close(fd);
+    return;
+  }
+  std::string out(msgSize, 'x');
+  std::string in(msgSize, '\0');
+  int64_t count = 0;
+  while (!*stop) {
+    if (!writeAll(fd, out.data(), out.size()) || !readAll(fd, &in[0], in.size())) {
+      break;
+    }
+    ++count;
+  }
+  *messages += count;
+  ::close(fd);
+}
+
+int main(int argc, char *argv[]) {
+  bool coroutine = argc > 1 && strcmp(argv[1], "coroutine") == 0;
+  int threads = argc > 2 ? atoi(argv[2]) : 1;
+  int connections = argc > 3 ? atoi(argv[3]) : 4;
+  size_t msgSize = argc > 4 ? atoi(argv[4]) : 64;
+  int seconds = argc > 5 ? atoi(argv[5]) : 5;
+
+  EventLoop *serverLoop = nullptr;
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::thread serverThread([&]() {
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "EchoBench");
+    server.setThreadNum(threads);
+    if (coroutine) {
+      server.setConnectionCallback([](const TcpConnectionPtr &conn) {
+        if (conn->connected()) {
+          echoSession(CoConnection(conn));
+        }
+      });
+    } else {
+      server.setConnectionCallback([](const TcpConnectionPtr &) {});
+      server.setMessageCallback(onMessage);
+    }
+    server.start();
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      serverLoop = &loop;
+      cond.notify_one();
+    }
+    loop.loop();
+  });
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (serverLoop == nullptr) {
+      cond.wait(lock);
+    }
+  }
+  // 等待 Acceptor::listen 在 mainLoop 中执行
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  std::atomic<bool> stop(false);
+  std::atomic<int64_t> messages(0);
+  std::vector<std::thread> clients;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < connections; ++i) {
+    clients.emplace_back(clientFunc, msgSize, &stop, &messages);
+  }
+  std::this_thread::sleep_for(std::chrono::seconds(seconds));
+  stop = true;
+  for (std::thread &t : clients) {
+    t.join();
+  }
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  serverLoop->quit();
+  serverThread.join();
+
+  fprintf(stderr, "mode=%s threads=%d connections=%d msgSize=%zu messages/s=%.0f MiB/s=%.2f\n",
+          coroutine ? "coroutine" : "callback", threads, connections, msgSize,
+          messages / elapsed, messages * msgSize / elapsed / 1024 / 1024);
+  return 0;
+}
@@ -0,0 +1,112 @@
+/*
+ * auto-cork 合并写对流水线小消息的效果
+ * 用法: cork_bench [on|off] [pipeline] [bodySize] [seconds]
+ * 客户端每批流水线发送 pipeline 个 16 字节请求，服务端对每个请求分三次 send 头部、消息体和尾部
+ * 输出每秒请求数，以及进程 write 类系统调用(/proc/self/io 的 syscw)的次数
+ */
+
+#include "EventLoop.h"
+#include "TcpServer.h"
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+static const uint16_t kPort = 9983;
+static const size_t kRequestSize = 16;
+
+static int64_t writeSyscalls() {
+  FILE *fp = ::fopen("/proc/self/io", "r");
+  if (fp == nullptr) {
+    return -1;
+  }
+  char line[128];
+  long long value = -1;
+  while (::fgets(line, sizeof(line), fp) != nullptr) {
+    if (::sscanf(line, "syscw: %lld", &value) == 1) {
+      break;
+    }
+  }
+  ::fclose(fp);
+  return value;
+}
+
+int main(int argc, char *argv[]) {
+  bool cork = argc > 1 && strcmp(argv[1], "on") == 0;
+  int pipeline = argc > 2 ? atoi(argv[2]) : 16;
+  size_t bodySize = argc > 3 ? atoi(argv[3]) : 32;
+  int seconds = argc > 4 ? atoi(argv[4]) : 3;
+
+  EventLoop *serverLoop = nullptr;
+  std::thread serverThread([&]() {
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "CorkBench");
+    server.setThreadNum(1);
+    server.setAutoCork(cork);
+    const std::string header(8, 'H');
+    const std::string body(bodySize, 'B');
+    const std::string trailer(8, 'T');
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    server.setMessageCallback([&](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+      while (buf->readableBytes() >= kRequestSize) {
+        buf->retrieve(kRequestSize);
+        conn->send(header);
+        conn->send(body);
+        conn->send(trailer);
+      }
+    });
+    server.start();
+    serverLoop = &loop;
+    loop.loop();
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr;
+  ::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(kPort);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+    perror("connect");
+    return 1;
+  }
+
+  const std::string requests(kRequestSize * pipeline, 'R');
+  const size_t responseBytes = (16 + bodySize) * pipeline;
+  std::string response(responseBytes, '\0');
+  int64_t syscwStart = writeSyscalls();
+  int64_t count = 0;
+  auto start = std::chrono::steady_clock::now();
+  auto deadline = start + std::chrono::seconds(seconds);
+  while (std::chrono::steady_clock::now() < deadline) {
+    if (::write(fd, requests.data(), requests.size()) != static_cast<ssize_t>(requests.size())) {
+      break;
+    }
+    size_t got = 0;
+    while (got < responseBytes) {
+      ssize_t n = ::read(fd, &response[got], responseBytes - got);
+      if (n <= 0) {
+        break;
+      }
+      got += n;
+    }
+    count += pipeline;
+  }
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  int64_t syscw = writeSyscalls() - syscwStart;
+  ::close(fd);
+  serverLoop->quit();
+  serverThread.join();
+
+  fprintf(stderr, "cork=%s pipeline=%d bodySize=%zu requests/s=%.0f write-syscalls/request=%.2f\n",
+          cork ? "on" : "off", pipeline, bodySize, count / elapsed,
+          static_cast<double>(syscw) / count);
+  return 0;
+}
@@ -0,0 +1,227 @@
+/*
+ * HttpServer 的 wrk 风格本地压测：每秒请求数和请求延迟随并发连接数的变化
+ * 用法: http_bench [seconds] [path] [pipeline]
+ *   path      /hello(小响应体，默认)、/file(sendfile 发送 64KB 文件) 或 /chunked(chunked 响应体)
+ *   pipeline  每个连接上同时在途的请求数，默认 1(keep-alive 请求-响应)，大于 1 时测流水线
+ * 服务器运行在单独的线程中，客户端在一个线程中用 epoll 驱动所有 keep-alive 连接，
+ * 依次测并发连接数 1/4/16/64/256，输出 rps 和请求延迟 p50/p99
+ */
+
+#include "EventLoop.h"
+#include "HttpServer.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <errno.h>
+#include <fcntl.h>
+#include <mutex>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static const uint16_t kPort = 9980;
+static const size_t kFileSize = 64 * 1024;
+
+static double nowSeconds() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 一个客户端连接：写出请求，按 Content-Length 或 chunked 结束标记切分响应
+struct Client {
+  int fd;
+  std::string input;
+  size_t toWrite;           // 还没有写出的请求字节数
+  std::vector<double> sent; // 在途请求的发送时间
+  size_t sentHead;
+};
+
+// 返回 input 开头一个完整响应的长度，不完整时返回 0
+static size_t responseLength(const std::string &input) {
+  size_t headerEnd = input.find("\r\n\r\n");
+  if (headerEnd == std::string::npos) {
+    return 0;
+  }
+  headerEnd += 4;
+  const char *cl = ::strcasestr(input.c_str(), "Content-Length:");
+  if (cl != nullptr && static_cast<size_t>(cl - input.c_str()) < headerEnd) {
+    size_t length = headerEnd + ::strtoul(cl + 15, nullptr, 10);
+    return input.size() >= length ? length : 0;
+  }
+  size_t end = input.find("\r\n0\r\n\r\n", headerEnd - 2);
+  return end == std::string::npos ? 0 : end + 7;
+}
+
+static void runLevel(int connections, int pipeline, double seconds, const std::string &request,
+                     double *rps, double *p50, double *p99) {
+  int epfd = ::epoll_create1(EPOLL_CLOEXEC);
+  std::vector<Client> clients(connections);
+  std::string batch;
+  for (int i = 0; i < pipeline; ++i) {
+    batch += request;
+  }
+  for (int i = 0; i < connections; ++i) {
+    Client &c = clients[i];
+    c.fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int on = 1;
+    ::setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::connect(c.fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    c.toWrite = batch.size();
+    c.sentHead = 0;
+    epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.u32 = static_cast<uint32_t>(i);
+    ::epoll_ctl(epfd, EPOLL_CTL_ADD, c.fd, &ev);
+  }
+
+  std::vector<double> latencies;
+  std::vector<epoll_event> events(connections);
+  char buf[64 * 1024];
+  double start = nowSeconds();
+  double deadline = start + seconds;
+  double now = start;
+  while (now < deadline) {
+    int n = ::epoll_wait(epfd, events.data(), connections, 100);
+    now = nowSeconds();
+    for (int e = 0; e < n; ++e) {
+      Client &c = clients[events[e].data.u32];
+      if ((events[e].events & EPOLLOUT) && c.toWrite > 0) {
+        // 一批请求全部写出后才计时，流水线中的请求共享同一个发送时间
+        ssize_t w = ::write(c.fd, batch.data() + batch.size() - c.toWrite, c.toWrite);
+        if (w > 0) {
+          c.toWrite -= w;
+          if (c.toWrite == 0) {
+            c.sent.assign(pipeline, now);
+            c.sentHead = 0;
+            epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.u32 = events[e].data.u32;
+            ::epoll_ctl(epfd, EPOLL_CTL_MOD, c.fd, &ev);
+          }
+        }
+      }
+      if (events[e].events & EPOLLIN) {
+        ssize_t r;
+        while ((r = ::read(c.fd, buf, sizeof(buf))) > 0) {
+          c.input.append(buf, r);
+        }
+        size_t length;
+        while ((length = responseLength(c.input)) > 0) {
+          c.input.erase(0, length);
+          latencies.push_back(now - c.sent[c.sentHead++]);
+        }
+        if (c.sentHead == c.sent.size() && c.toWrite == 0) {
+          c.toWrite = batch.size();
+          epoll_event ev;
+          ev.events = EPOLLIN | EPOLLOUT;
+          ev.data.u32 = events[e].data.u32;
+          ::epoll_ctl(epfd, EPOLL_CTL_MOD, c.fd, &ev);
+        }
+      }
+    }
+  }
+  double elapsed = nowSeconds() - start;
+  for (Client &c : clients) {
+    ::close(c.fd);
+  }
+  ::close(epfd);
+
+  *rps = latencies.size() / elapsed;
+  *p50 = *p99 = 0;
+  if (!latencies.empty()) {
+    std::sort(latencies.begin(), latencies.end());
+    *p50 = latencies[latencies.size() / 2] * 1e6;
+    *p99 = latencies[latencies.size() * 99 / 100] * 1e6;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+  std::string path = argc > 2 ? argv[2] : "/hello";
+  int pipeline = argc > 3 ? std::max(1, atoi(argv[3])) : 1;
+  // 测完一个并发级别时直接关闭客户端连接，服务器可能向已关闭的连接写数据
+  ::signal(SIGPIPE, SIG_IGN);
+  Logger::setLogLevel(ERROR);
+
+  char filePath[] = "/tmp/cmuduo_http_bench.XXXXXX";
+  int fileFd = ::mkstemp(filePath);
+  std::string content(kFileSize, 'x');
+  if (fileFd < 0 || ::write(fileFd, content.data(), content.size()) != static_cast<ssize_t>(content.size())) {
+    perror("mkstemp");
+    return 1;
+  }
+  ::close(fileFd);
+
+  EventLoop *serverLoop = nullptr;
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::thread serverThread([&]() {
+    EventLoop loop;
+    HttpServer server(&loop, InetAddress(kPort, "127.0.0.1"), "HttpBench");
+    server.setHttpCallback([&filePath](const HttpRequest &req, HttpResponse *resp) {
+      if (req.path() == std::string("/hello")) {
+        resp->setContentType("text/plain");
+        resp->send("hello, world\n");
+      } else if (req.path() == std::string("/file")) {
+        int fd = ::open(filePath, O_RDONLY | O_CLOEXEC);
+        resp->setContentType("application/octet-stream");
+        resp->sendFile(fd, 0, kFileSize);
+      } else if (req.path() == std::string("/chunked")) {
+        resp->setContentType("text/plain");
+        resp->beginChunked();
+        resp->writeChunk("hello, ");
+        resp->writeChunk("world\n");
+        resp->endChunked();
+      } else {
+        resp->setStatus(404);
+        resp->send("", 0);
+      }
+    });
+    server.start();
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      serverLoop = &loop;
+      cond.notify_one();
+    }
+    loop.loop();
+  });
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (serverLoop == nullptr) {
+      cond.wait(lock);
+    }
+  }
+  // 等待 Acceptor::listen 在 mainLoop 中执行
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  std::string request = "GET " + path + " HTTP/1.1\r\nHost: 127.0.0.1\r\nUser-Agent: http_bench\r\n\r\n";
+  fprintf(stderr, "path %s, pipeline %d\n", path.c_str(), pipeline);
+  fprintf(stderr, "%8s %12s %10s %10s\n", "conns", "rps", "p50_us", "p99_us");
+  const int levels[] = {1, 4, 16, 64, 256};
+  for (int connections : levels) {
+    double rps = 0;
+    double p50 = 0;
+    double p99 = 0;
+    runLevel(connections, pipeline, seconds, request, &rps, &p50, &p99);
+    fprintf(stderr, "%8d %12.0f %10.1f %10.1f\n", connections, rps, p50, p99);
+  }
+
+  serverLoop->quit();
+  serverThread.join();
+  ::unlink(filePath);
+  return 0;
+}
@@ -0,0 +1,660 @@
+/*
+ * 开环(open-loop)延迟压测：按固定的目标速率发送请求，发送节奏与响应无关，逐级提高速率找出 TcpServer 延迟的拐点
+ * 用法: latency_bench [-R rates] [-d seconds] [-w warmupSeconds] [-c connections] [-t clientThreads]
+ *                     [-l loops] [-m size] [-k] [-o output.json] [-r ip:port]
+ * 闭环压测(收到响应才发下一个请求，比如 pingpong_bench)在服务器停顿时客户端也跟着停下，停顿期间本应发出的请求
+ * 根本没有发出，也就不会出现在延迟统计中(coordinated omission)，测出的延迟远低于真实用户看到的延迟
+ * 这里每个客户端线程(EventLoopThread)按 速率/线程数 的间隔排出每个请求的预定发送时间，由 loop 的定时器
+ * 驱动发送，落后时立即补发，请求在 -c 个连接上轮流发出；服务器回显请求，按连接上的顺序与请求对应
+ * 每个请求记录三个值到 HdrHistogram 风格的直方图(相对误差 < 1%)：
+ *   corrected    收到完整回显的时间 - 预定发送时间，服务器或客户端的停顿计入之后所有请求的延迟，用于找拐点
+ *   uncorrected  收到完整回显的时间 - 实际发送时间，即闭环压测报告的延迟，与 corrected 的差距就是被掩盖的排队延迟
+ *   send_lag     实际发送时间 - 预定发送时间，客户端自己的滞后(定时器精度为 100us)，
+ *                较大时说明瓶颈在压测端，应增加 -t 或在另一台机器上运行并用 -r 压测
+ * 速率按 -R 逐级提高(默认 1k 到 200k 请求/秒)，每级先预热 -w 秒(不统计)，再统计 -d 秒内预定发出的请求，
+ * 之后停止发送并等待在途的响应(最多 max(2, d) 秒)；等不完说明服务器跟不上这个速率，记为 saturated 并停止扫描
+ * (之后的级别只是在测积压)，-k 继续扫描
+ * 拐点(knee_rate)：从最低一级开始，完成率不低于 95% 且 corrected p99 不超过最低一级 p99 十倍的最后一级的速率
+ * 默认在进程内启动 echo 服务器(-l 个 subLoop)，与压测端共享 CPU；-r 压测外部的 echo 服务器
+ * JSON 写到 -o 指定的文件(默认 stdout)，可读的表格写到 stderr
+ */
+
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+#include "SocketOptions.h"
+#include "TcpClient.h"
+#include "TcpServer.h"
+#include "Timestamp.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <errno.h>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static const uint16_t kPort = 9979;
+static const int kMaxBurst = 256;            // 落后时一次最多补发的请求数，之后让 loop 先处理响应
+static const double kKneeSuccessRatio = 0.95;
+static const double kKneeLatencyFactor = 10;
+
+struct Options {
+  Options()
+      : rates("1000,2000,5000,10000,20000,50000,100000,200000")
+      , seconds(3.0)
+      , warmup(1.0)
+      , connections(16)
+      , clientThreads(2)
+      , loops(2)
+      , size(64)
+      , keepGoing(false) {}
+
+  std::string rates;
+  double seconds;
+  double warmup;
+  int connections;
+  int clientThreads;
+  int loops;
+  size_t size;
+  bool keepGoing;
+  std::string output;
+  std::string remote; // ip:port，为空时使用进程内的服务器
+};
+
+static int64_t nowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static std::vector<long> parseList(const std::string &s) {
+  std::vector<long> values;
+  size_t pos = 0;
+  while (pos < s.size()) {
+    size_t comma = s.find(',', pos);
+    if (comma == std::string::npos) {
+      comma = s.size();
+    }
+    if (comma > pos) {
+      values.push_back(atol(s.substr(pos, comma - pos).c_str()));
+    }
+    pos = comma + 1;
+  }
+  return values;
+}
+
+/*
+ * HdrHistogram 风格的对数-线性直方图，值的单位是纳秒
+ * [0, 256) 每个值一个桶，之后每个 2 的幂区间分成 128 个等宽的子桶，相对误差不超过 1/128；
+ * 记录只是一次数组自增，不分配内存，合并是逐桶相加，超过 kMaxValue(约 2.4 小时)的值记在最后一个桶
+ */
+class LatencyHistogram {
+public:
+  LatencyHistogram() : counts_(kBuckets, 0), total_(0), max_(0) {}
+
+  void record(int64_t value) {
+    value = std::max<int64_t>(0, std::min(value, kMaxValue - 1));
+    ++counts_[indexOf(value)];
+    ++total_;
+    max_ = std::max(max_, value);
+  }
+
+  void merge(const LatencyHistogram &other) {
+    for (int i = 0; i < kBuckets; ++i) {
+      counts_[i] += other.counts_[i];
+    }
+    total_ += other.total_;
+    max_ = std::max(max_, other.max_);
+  }
+
+  int64_t count() const { return total_; }
+  int64_t max() const { return max_; }
+
+  // 第 percentile 百分位所在桶的上界(不超过最大值)，没有记录时返回 0
+  int64_t percentile(double percentile) const {
+    if (total_ == 0) {
+      return 0;
+    }
+    int64_t rank = static_cast<int64_t>(percentile / 100 * total_ + 0.5);
+    rank = std::max<int64_t>(1, std::min(rank, total_));
+    int64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+      seen += counts_[i];
+      if (seen >= rank) {
+        return std::min(upperBound(i), max_);
+      }
+    }
+    return max_;
+  }
+
+private:
+  static const int kLinear = 256;
+  static const int kSubBuckets = 128;
+  static const int kMaxShift = 35;
+  static const int kBuckets = kLinear + kMaxShift * kSubBuckets;
+  static const int64_t kMaxValue = static_cast<int64_t>(kSubBuckets * 2) << kMaxShift;
+
+  static int indexOf(int64_t value) {
+    if (value < kLinear) {
+      return static_cast<int>(value);
+    }
+    // value >> shift 落在 [128, 256)
+    int shift = 63 - __builtin_clzll(static_cast<unsigned long long>(value)) - 7;
+    return kLinear + (shift - 1) * kSubBuckets + static_cast<int>((value >> shift) - kSubBuckets);
+  }
+
+  static int64_t upperBound(int index) {
+    if (index < kLinear) {
+      return index;
+    }
+    int shift = (index - kLinear) / kSubBuckets + 1;
+    int64_t sub = (index - kLinear) % kSubBuckets + kSubBuckets;
+    return ((sub + 1) << shift) - 1;
+  }
+
+  std::vector<int64_t> counts_;
+  int64_t total_;
+  int64_t max_;
+};
+
+// 进程内的 echo 服务器
+class EchoServer {
+public:
+  explicit EchoServer(int loops) : loop_(nullptr), server_(nullptr) {
+    thread_ = std::thread([this, loops]() {
+      EventLoop loop;
+      TcpServer server(&loop, InetAddress(kPort), "LatencyBench");
+      SocketOptions options;
+      options.tcpNoDelay = true;
+      server.setSocketOptions(options);
+      server.setThreadNum(loops);
+      server.setConnectionCallback([](const TcpConnectionPtr &) {});
+      server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) { conn->send(buf); });
+      server.start();
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        loop_ = &loop;
+        server_ = &server;
+        cond_.notify_one();
+      }
+      loop.loop();
+    });
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (loop_ == nullptr) {
+      cond_.wait(lock);
+    }
+    // 等待 Acceptor::listen 在 mainLoop 中执行
+    lock.unlock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+
+  ~EchoServer() {
+    EventLoop *loop = loop_;
+    TcpServer *server = server_;
+    loop->runInLoop([server, loop]() { server->stop(0, [loop]() { loop->quit(); }); });
+    thread_.join();
+  }
+
+private:
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  EventLoop *loop_;
+  TcpServer *server_;
+};
+
+// 一级速率的统计，每个客户端线程一份，合并后得到这一级的结果
+struct StepStats {
+  StepStats() : sent(0), completed(0), windowResponses(0), errors(0) {}
+
+  void merge(const StepStats &other) {
+    corrected.merge(other.corrected);
+    uncorrected.merge(other.uncorrected);
+    sendLag.merge(other.sendLag);
+    sent += other.sent;
+    completed += other.completed;
+    windowResponses += other.windowResponses;
+    errors += other.errors;
+  }
+
+  LatencyHistogram corrected;
+  LatencyHistogram uncorrected;
+  LatencyHistogram sendLag;
+  int64_t sent;            // 统计窗口内预定发出的请求数
+  int64_t completed;       // 其中收到响应的请求数
+  int64_t windowResponses; // 统计窗口内收到的响应数(不论请求何时发出)，用于计算吞吐
+  int64_t errors;          // 预定发送时连接不可用而没有发出的请求数
+};
+
+/*
+ * 一个客户端线程：一个 EventLoopThread 和分给它的连接，除 pending_ 外的成员只在 loop 线程中访问
+ * 发送由 pace 驱动：发出所有到了预定时间的请求，再用定时器在下一个预定时间唤醒；
+ * 收到响应时也顺便调用 pace，速率较高时大部分请求在处理响应的同一轮循环中发出，不依赖定时器的精度
+ */
+class Generator {
+public:
+  explicit Generator(const std::string &message)
+      : thread_(new EventLoopThread())
+      , loop_(thread_->startLoop())
+      , message_(message)
+      , step_(0)
+      , interval_(0)
+      , first_(0)
+      , windowStart_(0)
+      , end_(0)
+      , index_(0)
+      , next_(0)
+      , wakeupPending_(false)
+      , connected_(0)
+      , pending_(0) {}
+
+  ~Generator() {
+    // TcpClient 在所属的 loop 中析构，不会与该 loop 中的 removeConnection 竞争
+    std::promise<void> done;
+    loop_->runInLoop([this, &done]() {
+      step_ = 0;
+      clients_.clear();
+      done.set_value();
+    });
+    done.get_future().wait();
+    // 等待析构时 shutdown 的连接关闭
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+
+  void addConnection(const InetAddress &addr) {
+    loop_->runInLoop([this, addr]() {
+      std::unique_ptr<Connection> c(new Connection());
+      Connection *raw = c.get();
+      c->client.reset(new TcpClient(loop_, addr, "LatencyBenchClient"));
+      SocketOptions options;
+      options.tcpNoDelay = true;
+      c->client->setSocketOptions(options);
+      c->client->setConnectionCallback([this, raw](const TcpConnectionPtr &conn) {
+        if (conn->connected()) {
+          raw->conn = conn;
+          connected_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+          raw->conn.reset();
+          connected_.fetch_sub(1, std::memory_order_relaxed);
+        }
+      });
+      c->client->setMessageCallback(
+          [this, raw](const TcpConnectionPtr &, Buffer *buf, Timestamp) { onMessage(raw, buf); });
+      c->client->connect();
+      clients_.push_back(std::move(c));
+    });
+  }
+
+  // 开始一级速率：从 first 开始每隔 interval 纳秒预定一个请求，预定时间在 [windowStart, end) 内的请求计入统计
+  void startStep(int step, double interval, int64_t first, int64_t windowStart, int64_t end) {
+    loop_->runInLoop([=]() {
+      stats_ = StepStats();
+      pending_.store(0, std::memory_order_relaxed);
+      step_ = step;
+      interval_ = interval;
+      first_ = first;
+      windowStart_ = windowStart;
+      end_ = end;
+      index_ = 0;
+      next_ = first;
+      wakeupPending_ = false;
+      schedule();
+    });
+  }
+
+  // 结束当前一级，返回统计；之后才到达的响应不再计入
+  StepStats finishStep() {
+    std::promise<StepStats> result;
+    loop_->runInLoop([this, &result]() {
+      step_ = 0;
+      result.set_value(stats_);
+    });
+    return result.get_future().get();
+  }
+
+  int64_t connected() const { return connected_.load(std::memory_order_relaxed); }
+  // 当前一级已经发出、还没有收到响应的请求数
+  int64_t pending() const { return pending_.load(std::memory_order_relaxed); }
+
+private:
+  // 一个在途请求，按发送顺序排在连接的队列中
+  struct Inflight {
+    int64_t intended; // 预定发送时间
+    int64_t sent;     // 实际发送时间
+    int step;
+  };
+
+  struct Connection {
+    Connection() : partial(0) {}
+    std::unique_ptr<TcpClient> client;
+    TcpConnectionPtr conn;
+    std::deque<Inflight> inflight;
+    size_t partial; // 队首请求的响应已经收到的字节数
+  };
+
+  // 发出所有到了预定时间的请求，然后保证有一次唤醒在下一个预定时间(或者立即，如果还在补发)调用 pace
+  void pace() {
+    if (step_ == 0) {
+      return;
+    }
+    int64_t now = nowNanos();
+    int burst = 0;
+    while (next_ < end_ && next_ <= now && burst < kMaxBurst) {
+      sendOne(next_);
+      ++burst;
+      ++index_;
+      next_ = first_ + static_cast<int64_t>(index_ * interval_);
+    }
+    schedule();
+  }
+
+  void schedule() {
+    if (wakeupPending_ || next_ >= end_) {
+      return;
+    }
+    wakeupPending_ = true;
+    int step = step_;
+    auto wakeup = [this, step]() {
+      // startStep 之后，上一级留下的唤醒直接丢弃
+      if (step == step_) {
+        wakeupPending_ = false;
+        pace();
+      }
+    };
+    int64_t delay = next_ - nowNanos();
+    if (delay <= 0) {
+      loop_->queueInLoop(wakeup);
+    } else {
+      loop_->runAfter(delay / 1e9, wakeup);
+    }
+  }
+
+  void sendOne(int64_t intended) {
+    bool measured = intended >= windowStart_;
+    if (measured) {
+      ++stats_.sent;
+    }
+    if (clients_.empty()) {
+      ++stats_.errors;
+      return;
+    }
+    Connection *c = clients_[index_ % clients_.size()].get();
+    if (!c->conn) {
+      ++stats_.errors;
+      return;
+    }
+    int64_t sent = nowNanos();
+    c->conn->send(message_);
+    c->inflight.push_back(Inflight{intended, sent, step_});
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    if (measured) {
+      stats_.sendLag.record(sent - intended);
+    }
+  }
+
+  void onMessage(Connection *c, Buffer *buf) {
+    int64_t now = nowNanos();
+    c->partial += buf->readableBytes();
+    buf->retrieveAll();
+    while (c->partial >= message_.size() && !c->inflight.empty()) {
+      c->partial -= message_.size();
+      Inflight request = c->inflight.front();
+      c->inflight.pop_front();
+      if (request.step != step_) {
+        continue;
+      }
+      pending_.fetch_sub(1, std::memory_order_relaxed);
+      if (now >= windowStart_ && now < end_) {
+        ++stats_.windowResponses;
+      }
+      if (request.intended >= windowStart_) {
+        ++stats_.completed;
+        stats_.corrected.record(now - request.intended);
+        stats_.uncorrected.record(now - request.sent);
+      }
+    }
+    pace();
+  }
+
+  std::unique_ptr<EventLoopThread> thread_;
+  EventLoop *loop_;
+  const std::string message_;
+  std::vector<std::unique_ptr<Connection>> clients_;
+
+  // 当前一级的发送计划，step_ 为 0 时没有在发送
+  int step_;
+  double interval_;
+  int64_t first_;
+  int64_t windowStart_;
+  int64_t end_;
+  int64_t index_;
+  int64_t next_;       // 下一个请求的预定发送时间
+  bool wakeupPending_; // 已经登记了调用 pace 的定时器或 functor
+  StepStats stats_;
+
+  std::atomic<int64_t> connected_;
+  std::atomic<int64_t> pending_;
+};
+
+// 一级速率的结果
+struct StepResult {
+  StepResult() : rate(0), saturated(false), throughput(0), completedRatio(0) {}
+  long rate;
+  bool saturated;
+  double throughput;
+  double completedRatio;
+  StepStats stats;
+};
+
+static double micros(int64_t nanos) { return nanos / 1e3; }
+
+class Suite {
+public:
+  explicit Suite(const Options &options) : options_(options), kneeRate_(0) {}
+
+  bool run() {
+    std::unique_ptr<EchoServer> server;
+    InetAddress addr(kPort, "127.0.0.1");
+    if (options_.remote.empty()) {
+      server.reset(new EchoServer(options_.loops));
+    } else {
+      size_t colon = options_.remote.rfind(':');
+      uint16_t port = static_cast<uint16_t>(colon == std::string::npos ? kPort : atoi(options_.remote.c_str() + colon + 1));
+      addr = InetAddress(port, options_.remote.substr(0, colon));
+    }
+    bool ok = true;
+    {
+      std::string message(options_.size, 'x');
+      std::vector<std::unique_ptr<Generator>> generators;
+      for (int i = 0; i < options_.clientThreads; ++i) {
+        generators.push_back(std::unique_ptr<Generator>(new Generator(message)));
+      }
+      for (int i = 0; i < options_.connections; ++i) {
+        generators[i % generators.size()]->addConnection(addr);
+      }
+      ok = waitConnected(generators);
+      if (ok) {
+        sweep(generators);
+      } else {
+        fprintf(stderr, "cannot establish %d connections to %s\n", options_.connections, addr.toIpPort().c_str());
+      }
+    }
+    server.reset();
+    findKnee();
+    return ok;
+  }
+
+  void writeJson(FILE *out) const {
+    fprintf(out, "{\n");
+    fprintf(out, "  \"bench\": \"latency\",\n");
+    fprintf(out, "  \"time\": \"%s\",\n", Timestamp::now().toFormattedString(false).c_str());
+    fprintf(out, "  \"host\": {\"cpus\": %u},\n", std::thread::hardware_concurrency());
+    fprintf(out, "  \"config\": {\"seconds\": %.3f, \"warmup\": %.3f, \"connections\": %d, \"client_threads\": %d, "
+                 "\"server_loops\": %d, \"message_size\": %zu, \"server\": \"%s\"},\n",
+            options_.seconds, options_.warmup, options_.connections, options_.clientThreads,
+            options_.remote.empty() ? options_.loops : 0, options_.size,
+            options_.remote.empty() ? "in-process" : options_.remote.c_str());
+    fprintf(out, "  \"knee_rate\": %ld,\n", kneeRate_);
+    fprintf(out, "  \"results\": [\n");
+    for (size_t i = 0; i < results_.size(); ++i) {
+      const StepResult &r = results_[i];
+      const StepStats &s = r.stats;
+      fprintf(out, "    {\"target_rate\": %ld, \"throughput\": %.1f, \"sent\": %lld, \"completed\": %lld, "
+                   "\"errors\": %lld, \"saturated\": %s, "
+                   "\"corrected_us\": {\"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"p99.9\": %.1f, \"max\": %.1f}, "
+                   "\"uncorrected_us\": {\"p50\": %.1f, \"p99\": %.1f, \"p99.9\": %.1f, \"max\": %.1f}, "
+                   "\"send_lag_us\": {\"p50\": %.1f, \"p99\": %.1f, \"max\": %.1f}}%s\n",
+              r.rate, r.throughput, static_cast<long long>(s.sent), static_cast<long long>(s.completed),
+              static_cast<long long>(s.errors), r.saturated ? "true" : "false",
+              micros(s.corrected.percentile(50)), micros(s.corrected.percentile(90)),
+              micros(s.corrected.percentile(99)), micros(s.corrected.percentile(99.9)), micros(s.corrected.max()),
+              micros(s.uncorrected.percentile(50)), micros(s.uncorrected.percentile(99)),
+              micros(s.uncorrected.percentile(99.9)), micros(s.uncorrected.max()),
+              micros(s.sendLag.percentile(50)), micros(s.sendLag.percentile(99)), micros(s.sendLag.max()),
+              i + 1 < results_.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+  }
+
+private:
+  bool waitConnected(const std::vector<std::unique_ptr<Generator>> &generators) {
+    int64_t deadline = nowNanos() + 10 * 1000 * 1000 * 1000LL;
+    while (nowNanos() < deadline) {
+      int64_t connected = 0;
+      for (const std::unique_ptr<Generator> &g : generators) {
+        connected += g->connected();
+      }
+      if (connected == options_.connections) {
+        return true;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+  }
+
+  void sweep(const std::vector<std::unique_ptr<Generator>> &generators) {
+    fprintf(stderr, "%10s %11s %9s %9s %9s %9s %10s | %9s %9s | %9s %s\n", "rate", "throughput", "p50_us", "p90_us",
+            "p99_us", "p99.9_us", "max_us", "raw_p99", "raw_max", "lag_p99", "");
+    int step = 0;
+    for (long rate : parseList(options_.rates)) {
+      if (rate <= 0) {
+        continue;
+      }
+      ++step;
+      int threads = static_cast<int>(generators.size());
+      // 各线程的发送时间错开 1/rate，合起来是均匀的 rate 请求/秒
+      double interval = threads * 1e9 / rate;
+      int64_t base = nowNanos() + 20 * 1000 * 1000;
+      int64_t windowStart = base + static_cast<int64_t>(options_.warmup * 1e9);
+      int64_t end = windowStart + static_cast<int64_t>(options_.seconds * 1e9);
+      for (int i = 0; i < threads; ++i) {
+        generators[i]->startStep(step, interval, base + static_cast<int64_t>(i * 1e9 / rate), windowStart, end);
+      }
+      std::this_thread::sleep_for(std::chrono::nanoseconds(end - nowNanos()));
+
+      // 等待在途的响应
+      int64_t drainDeadline = end + static_cast<int64_t>(std::max(2.0, options_.seconds) * 1e9);
+      bool drained = false;
+      while (!drained && nowNanos() < drainDeadline) {
+        int64_t pending = 0;
+        for (const std::unique_ptr<Generator> &g : generators) {
+          pending += g->pending();
+        }
+        drained = pending == 0;
+        if (!drained) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      }
+
+      StepResult result;
+      result.rate = rate;
+      result.saturated = !drained;
+      for (const std::unique_ptr<Generator> &g : generators) {
+        result.stats.merge(g->finishStep());
+      }
+      const StepStats &s = result.stats;
+      result.throughput = s.windowResponses / options_.seconds;
+      result.completedRatio = s.sent > 0 ? static_cast<double>(s.completed) / s.sent : 0;
+      results_.push_back(result);
+      fprintf(stderr, "%10ld %11.0f %9.1f %9.1f %9.1f %9.1f %10.1f | %9.1f %9.1f | %9.1f %s\n", rate,
+              result.throughput, micros(s.corrected.percentile(50)), micros(s.corrected.percentile(90)),
+              micros(s.corrected.percentile(99)), micros(s.corrected.percentile(99.9)), micros(s.corrected.max()),
+              micros(s.uncorrected.percentile(99)), micros(s.uncorrected.max()), micros(s.sendLag.percentile(99)),
+              result.saturated ? "saturated" : "");
+      if (result.saturated && !options_.keepGoing) {
+        break;
+      }
+    }
+  }
+
+  void findKnee() {
+    if (results_.empty()) {
+      return;
+    }
+    int64_t baseline = results_.front().stats.corrected.percentile(99);
+    for (const StepResult &r : results_) {
+      if (r.saturated || r.completedRatio < kKneeSuccessRatio ||
+          r.stats.corrected.percentile(99) > baseline * kKneeLatencyFactor) {
+        break;
+      }
+      kneeRate_ = r.rate;
+    }
+    fprintf(stderr, "knee: %ld requests/s\n", kneeRate_);
+  }
+
+  const Options options_;
+  std::vector<StepResult> results_;
+  long kneeRate_;
+};
+
+int main(int argc, char *argv[]) {
+  Options options;
+  int opt;
+  while ((opt = ::getopt(argc, argv, "R:d:w:c:t:l:m:ko:r:")) != -1) {
+    switch (opt) {
+      case 'R': options.rates = optarg; break;
+      case 'd': options.seconds = std::max(0.1, atof(optarg)); break;
+      case 'w': options.warmup = std::max(0.0, atof(optarg)); break;
+      case 'c': options.connections = std::max(1, atoi(optarg)); break;
+      case 't': options.clientThreads = std::max(1, atoi(optarg)); break;
+      case 'l': options.loops = std::max(0, atoi(optarg)); break;
+      case 'm': options.size = static_cast<size_t>(std::max(1, atoi(optarg))); break;
+      case 'k': options.keepGoing = true; break;
+      case 'o': options.output = optarg; break;
+      case 'r': options.remote = optarg; break;
+      default:
+        fprintf(stderr, "usage: %s [-R rates] [-d seconds] [-w warmupSeconds] [-c connections] [-t clientThreads] "
+                        "[-l loops] [-m size] [-k] [-o output.json] [-r ip:port]\n", argv[0]);
+        return 1;
+    }
+  }
+  ::signal(SIGPIPE, SIG_IGN);
+  Logger::setLogLevel(ERROR);
+
+  Suite suite(options);
+  if (!suite.run()) {
+    return 1;
+  }
+  FILE *out = options.output.empty() ? stdout : ::fopen(options.output.c_str(), "w");
+  if (out == nullptr) {
+    fprintf(stderr, "cannot open %s: %s\n", options.output.c_str(), strerror(errno));
+    return 1;
+  }
+  suite.writeJson(out);
+  if (out != stdout) {
+    ::fclose(out);
+  }
+  return 0;
+}
@@ -0,0 +1,467 @@
+/*
+ * 核心原语的微基准：单独测量热路径上各个操作的耗时和内存分配次数，修改这些类时用来给出前后对比的数字
+ * 用法: micro_bench [-f filter] [-s samples] [-t sampleMs] [-c cpu] [-o output.json]
+ *   -f  只运行名字包含 filter 的测试
+ *   -s  每个测试的采样次数(默认 9)，报告中位数、最小值和离散度(中位数绝对偏差 / 中位数)
+ *   -t  每次采样的最短时间(毫秒，默认 20)，迭代次数按预热时的耗时自动翻倍到满足这个时间
+ *   -c  主线程绑定的 CPU(默认 0)，loop 线程和生产者线程依次绑定到之后的 CPU(CPU 不够时回绕)；-1 不绑定
+ *   -o  结果另外写成 JSON，用于在版本之间对比
+ * 替换全局 operator new 统计分配次数，报告每次操作的平均分配次数(包括所有采样)
+ * 测试项：
+ *   buffer.*     Buffer::append/retrieve、makeSpace 的搬移和扩容、readFd(含写 socketpair 的 write)
+ *   queue.*      EventLoop::queueInLoop：loop 线程自己投递(不唤醒)、1 个和 4 个跨线程生产者，计到 loop 执行完为止
+ *   channel.*    Channel::handleEvent 的分发，tie 与不 tie(tie_.lock() 的开销)
+ *   poller.*     EPollPoller::updateChannel：EPOLL_CTL_MOD，以及 ADD + DEL
+ *   time.*       Timestamp::now 和 EventLoop::cachedNow
+ *   log.*        被级别过滤掉的 LOG_DEBUG，输出到空函数的 LOG_INFO
+ */
+
+#include "Buffer.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+#include "Timestamp.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <functional>
+#include <future>
+#include <math.h>
+#include <memory>
+#include <new>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static std::atomic<int64_t> g_allocations(0);
+
+void *operator new(size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  void *p = ::malloc(size != 0 ? size : 1);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept { ::free(p); }
+void operator delete(void *p, size_t) noexcept { ::free(p); }
+
+// 阻止编译器把被测操作的结果当作无用代码删掉
+template <typename T>
+static inline void doNotOptimize(const T &value) {
+  asm volatile("" : : "r"(&value) : "memory");
+}
+
+static int64_t nowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static int g_baseCpu = 0;
+
+// 第 k 个线程绑定的 CPU(主线程是 0)，不绑定时返回 -1
+static int cpuFor(int k) {
+  if (g_baseCpu < 0) {
+    return -1;
+  }
+  int n = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+  return (g_baseCpu + k) % n;
+}
+
+static void pinThread(int cpu) {
+  if (cpu < 0) {
+    return;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  int ret = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+  if (ret != 0) {
+    fprintf(stderr, "pthread_setaffinity_np(%d): %s\n", cpu, strerror(ret));
+  }
+}
+
+// 在 loop 线程中执行 f 并等待完成
+static void runSync(EventLoop *loop, const std::function<void()> &f) {
+  std::promise<void> done;
+  loop->runInLoop([&f, &done]() {
+    f();
+    done.set_value();
+  });
+  done.get_future().wait();
+}
+
+struct Options {
+  Options() : samples(9), sampleMs(20), cpu(0) {}
+  std::string filter;
+  int samples;
+  int sampleMs;
+  int cpu;
+  std::string output;
+};
+
+struct Stats {
+  std::string name;
+  int64_t iterations;  // 每次采样的迭代次数
+  double medianNs;
+  double minNs;
+  double spread;       // 中位数绝对偏差 / 中位数
+  double allocsPerOp;
+};
+
+class Harness {
+public:
+  // run(n) 把被测操作执行 n 次
+  using RunFunc = std::function<void(int64_t)>;
+
+  explicit Harness(const Options &options) : options_(options) {}
+
+  void add(const std::string &name, const RunFunc &run) {
+    if (options_.filter.empty() || name.find(options_.filter) != std::string::npos) {
+      benchmarks_.push_back(std::make_pair(name, run));
+    }
+  }
+
+  void runAll() {
+    fprintf(stderr, "%-32s %12s %10s %10s %8s %10s\n", "benchmark", "iterations", "ns/op", "min", "spread",
+            "allocs/op");
+    for (const auto &b : benchmarks_) {
+      Stats s = measure(b.first, b.second);
+      fprintf(stderr, "%-32s %12lld %10.2f %10.2f %7.1f%% %10.3f\n", s.name.c_str(),
+              static_cast<long long>(s.iterations), s.medianNs, s.minNs, s.spread * 100, s.allocsPerOp);
+      results_.push_back(s);
+    }
+  }
+
+  void writeJson(FILE *out) const {
+    fprintf(out, "{\n");
+    fprintf(out, "  \"bench\": \"micro\",\n");
+    fprintf(out, "  \"time\": \"%s\",\n", Timestamp::now().toFormattedString(false).c_str());
+    fprintf(out, "  \"host\": {\"cpus\": %u},\n", std::thread::hardware_concurrency());
+    fprintf(out, "  \"config\": {\"samples\": %d, \"sample_ms\": %d, \"cpu\": %d},\n", options_.samples,
+            options_.sampleMs, options_.cpu);
+    fprintf(out, "  \"results\": [\n");
+    for (size_t i = 0; i < results_.size(); ++i) {
+      const Stats &s = results_[i];
+      fprintf(out, "    {\"name\": \"%s\", \"iterations\": %lld, \"ns_per_op\": %.3f, \"min_ns_per_op\": %.3f, "
+                   "\"spread\": %.4f, \"allocs_per_op\": %.4f}%s\n",
+              s.name.c_str(), static_cast<long long>(s.iterations), s.medianNs, s.minNs, s.spread,
+              s.allocsPerOp, i + 1 < results_.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+  }
+
+private:
+  Stats measure(const std::string &name, const RunFunc &run) {
+    // 预热并确定迭代次数：翻倍直到一次采样不短于 sampleMs
+    const int64_t target = static_cast<int64_t>(options_.sampleMs) * 1000000;
+    int64_t n = 1;
+    run(n);
+    for (;;) {
+      int64_t start = nowNanos();
+      run(n);
+      int64_t elapsed = nowNanos() - start;
+      if (elapsed >= target || n >= (int64_t(1) << 32)) {
+        break;
+      }
+      // 离目标还很远时一次放大更多倍，最多 10 倍
+      int64_t factor = elapsed > 0 ? std::min<int64_t>(10, std::max<int64_t>(2, target / elapsed)) : 10;
+      n *= factor;
+    }
+
+    std::vector<double> perOp;
+    int64_t allocsBefore = g_allocations.load(std::memory_order_relaxed);
+    for (int i = 0; i < options_.samples; ++i) {
+      int64_t start = nowNanos();
+      run(n);
+      perOp.push_back(static_cast<double>(nowNanos() - start) / n);
+    }
+    int64_t allocs = g_allocations.load(std::memory_order_relaxed) - allocsBefore;
+
+    Stats s;
+    s.name = name;
+    s.iterations = n;
+    std::sort(perOp.begin(), perOp.end());
+    s.medianNs = perOp[perOp.size() / 2];
+    s.minNs = perOp.front();
+    std::vector<double> deviations;
+    for (double v : perOp) {
+      deviations.push_back(fabs(v - s.medianNs));
+    }
+    std::sort(deviations.begin(), deviations.end());
+    s.spread = s.medianNs > 0 ? deviations[deviations.size() / 2] / s.medianNs : 0;
+    s.allocsPerOp = static_cast<double>(allocs) / (static_cast<double>(n) * options_.samples);
+    return s;
+  }
+
+  const Options options_;
+  std::vector<std::pair<std::string, RunFunc>> benchmarks_;
+  std::vector<Stats> results_;
+};
+
+static void addBufferBenchmarks(Harness *h) {
+  static const char kData[65536] = {0};
+
+  h->add("buffer.append_retrieve/16", [](int64_t n) {
+    Buffer buf;
+    for (int64_t i = 0; i < n; ++i) {
+      buf.append(kData, 16);
+      buf.retrieve(16);
+    }
+    doNotOptimize(buf.readableBytes());
+  });
+
+  h->add("buffer.append_retrieve/4096", [](int64_t n) {
+    Buffer buf;
+    for (int64_t i = 0; i < n; ++i) {
+      buf.append(kData, 4096);
+      buf.retrieve(4096);
+    }
+    doNotOptimize(buf.readableBytes());
+  });
+
+  // 每次 append 前尾部空间不够、但加上头部已读的空间足够：makeSpace 把 100 字节未读数据搬到头部
+  h->add("buffer.makeSpace/move", [](int64_t n) {
+    Buffer buf;
+    buf.append(kData, 100);
+    for (int64_t i = 0; i < n; ++i) {
+      buf.append(kData, 900);
+      buf.retrieve(900);
+    }
+    doNotOptimize(buf.readableBytes());
+  });
+
+  // 新 Buffer 追加 4KB：makeSpace 扩容(含一次分配和 vector 的初始化)
+  h->add("buffer.makeSpace/grow_4096", [](int64_t n) {
+    for (int64_t i = 0; i < n; ++i) {
+      Buffer buf;
+      buf.append(kData, 4096);
+      doNotOptimize(buf.peek());
+    }
+  });
+
+  // readFd 每次操作包括对端的一次 write；64KB 时超出 Buffer 可写空间的部分先读到栈上的 extrabuf 再 append
+  for (size_t size : {size_t(1024), size_t(65536)}) {
+    h->add("buffer.readFd/" + std::to_string(size), [size](int64_t n) {
+      int fds[2];
+      if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        return;
+      }
+      int sndbuf = 256 * 1024;
+      ::setsockopt(fds[1], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+      Buffer buf;
+      int savedErrno = 0;
+      for (int64_t i = 0; i < n; ++i) {
+        ssize_t written = ::write(fds[1], kData, size);
+        size_t got = 0;
+        while (written > 0 && got < static_cast<size_t>(written)) {
+          ssize_t r = buf.readFd(fds[0], &savedErrno);
+          if (r <= 0) {
+            break;
+          }
+          got += r;
+        }
+        buf.retrieveAll();
+      }
+      ::close(fds[0]);
+      ::close(fds[1]);
+    });
+  }
+}
+
+static void addQueueBenchmarks(Harness *h, EventLoop *loop) {
+  // loop 线程自己投递：在定时器回调中(不在 doPendingFunctors 中)调用，不需要唤醒
+  h->add("queue.queueInLoop/loop_thread", [loop](int64_t n) {
+    std::atomic<int64_t> executed(0);
+    loop->runAfter(0, [loop, n, &executed]() {
+      std::atomic<int64_t> *counter = &executed;
+      for (int64_t i = 0; i < n; ++i) {
+        loop->queueInLoop([counter]() { counter->fetch_add(1, std::memory_order_relaxed); });
+      }
+    });
+    // 等投递的回调都执行完，计时包括执行
+    while (executed.load(std::memory_order_acquire) < n) {
+      std::this_thread::yield();
+    }
+  });
+
+  for (int producers : {1, 4}) {
+    h->add("queue.queueInLoop/producers_" + std::to_string(producers), [loop, producers](int64_t n) {
+      std::atomic<int64_t> executed(0);
+      std::atomic<int64_t> *counter = &executed;
+      std::vector<std::thread> threads;
+      int64_t per = n / producers;
+      for (int p = 0; p < producers; ++p) {
+        int64_t count = p == producers - 1 ? n - per * (producers - 1) : per;
+        threads.emplace_back([loop, counter, count, p]() {
+          pinThread(cpuFor(2 + p));
+          for (int64_t i = 0; i < count; ++i) {
+            loop->queueInLoop([counter]() { counter->fetch_add(1, std::memory_order_relaxed); });
+          }
+        });
+      }
+      for (std::thread &t : threads) {
+        t.join();
+      }
+      while (executed.load(std::memory_order_acquire) < n) {
+        std::this_thread::yield();
+      }
+    });
+  }
+}
+
+static void addChannelBenchmarks(Harness *h, EventLoop *mainLoop) {
+  // Channel 只用来直接调用 handleEvent，不注册到 poller
+  h->add("channel.handleEvent/untied", [mainLoop](int64_t n) {
+    int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    Channel channel(mainLoop, fd);
+    int64_t reads = 0;
+    channel.setReadCallback([&reads](Timestamp) { ++reads; });
+    channel.set_revents(EPOLLIN);
+    Timestamp now = Timestamp::now();
+    for (int64_t i = 0; i < n; ++i) {
+      channel.handleEvent(now);
+    }
+    doNotOptimize(reads);
+    ::close(fd);
+  });
+
+  h->add("channel.handleEvent/tied", [mainLoop](int64_t n) {
+    int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    Channel channel(mainLoop, fd);
+    std::shared_ptr<int> owner = std::make_shared<int>(0);
+    channel.tie(owner);
+    int64_t reads = 0;
+    channel.setReadCallback([&reads](Timestamp) { ++reads; });
+    channel.set_revents(EPOLLIN);
+    Timestamp now = Timestamp::now();
+    for (int64_t i = 0; i < n; ++i) {
+      channel.handleEvent(now);
+    }
+    doNotOptimize(reads);
+    ::close(fd);
+  });
+
+  // 已注册的 channel 切换写事件，每次操作一次 EPOLL_CTL_MOD
+  h->add("poller.updateChannel/mod", [mainLoop](int64_t n) {
+    int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    Channel channel(mainLoop, fd);
+    channel.enableReading();
+    for (int64_t i = 0; i < n; ++i) {
+      if (i & 1) {
+        channel.disableWriting();
+      } else {
+        channel.enableWriting();
+      }
+    }
+    channel.disableAll();
+    channel.remove();
+    ::close(fd);
+  });
+
+  // 每次操作一次 EPOLL_CTL_ADD 和一次 EPOLL_CTL_DEL
+  h->add("poller.updateChannel/add_del", [mainLoop](int64_t n) {
+    int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    Channel channel(mainLoop, fd);
+    for (int64_t i = 0; i < n; ++i) {
+      channel.enableReading();
+      channel.disableAll();
+    }
+    channel.remove();
+    ::close(fd);
+  });
+}
+
+static void addTimeAndLogBenchmarks(Harness *h, EventLoop *loop) {
+  h->add("time.Timestamp::now", [](int64_t n) {
+    for (int64_t i = 0; i < n; ++i) {
+      doNotOptimize(Timestamp::now());
+    }
+  });
+
+  // 在 loop 线程中读取本轮 poll 返回时缓存的时间
+  h->add("time.EventLoop::cachedNow", [loop](int64_t n) {
+    runSync(loop, [n]() {
+      for (int64_t i = 0; i < n; ++i) {
+        doNotOptimize(EventLoop::cachedNow());
+      }
+    });
+  });
+
+  h->add("log.LOG_DEBUG/filtered", [](int64_t n) {
+    Logger::setLogLevel(INFO);
+    for (int64_t i = 0; i < n; ++i) {
+      LOG_DEBUG("fd = %d events = %d\n", static_cast<int>(i), 1);
+    }
+    Logger::setLogLevel(ERROR);
+  });
+
+  // 只计格式化(时间、级别前缀和消息)的开销，输出到空函数
+  h->add("log.LOG_INFO/null_output", [](int64_t n) {
+    Logger::instance().setOutput([](int, const char *, size_t) {});
+    Logger::setLogLevel(INFO);
+    for (int64_t i = 0; i < n; ++i) {
+      LOG_INFO("fd = %d peer = %s\n", static_cast<int>(i), "127.0.0.1:9981");
+    }
+    Logger::setLogLevel(ERROR);
+    Logger::instance().setOutput([](int, const char *msg, size_t len) { ::fwrite(msg, 1, len, stdout); });
+  });
+}
+
+int main(int argc, char *argv[]) {
+  Options options;
+  int opt;
+  while ((opt = ::getopt(argc, argv, "f:s:t:c:o:")) != -1) {
+    switch (opt) {
+      case 'f': options.filter = optarg; break;
+      case 's': options.samples = std::max(1, atoi(optarg)); break;
+      case 't': options.sampleMs = std::max(1, atoi(optarg)); break;
+      case 'c': options.cpu = atoi(optarg); break;
+      case 'o': options.output = optarg; break;
+      default:
+        fprintf(stderr, "usage: %s [-f filter] [-s samples] [-t sampleMs] [-c cpu] [-o output.json]\n", argv[0]);
+        return 1;
+    }
+  }
+  Logger::setLogLevel(ERROR);
+  g_baseCpu = options.cpu;
+  pinThread(cpuFor(0));
+
+  // 主线程的 loop 不运行，只用来承载 Channel/Poller 测试
+  EventLoop mainLoop;
+  EventLoopThread loopThread;
+  EventLoop *loop = loopThread.startLoop();
+  runSync(loop, []() { pinThread(cpuFor(1)); });
+
+  Harness harness(options);
+  addBufferBenchmarks(&harness);
+  addQueueBenchmarks(&harness, loop);
+  addChannelBenchmarks(&harness, &mainLoop);
+  addTimeAndLogBenchmarks(&harness, loop);
+  harness.runAll();
+
+  if (!options.output.empty()) {
+    FILE *out = ::fopen(options.output.c_str(), "w");
+    if (out == nullptr) {
+      fprintf(stderr, "cannot open %s: %s\n", options.output.c_str(), strerror(errno));
+      return 1;
+    }
+    harness.writeJson(out);
+    ::fclose(out);
+  }
+  return 0;
+}
@@ -0,0 +1,565 @@
+/*
+ * pingpong(echo) 吞吐和连接数扩展性的基准测试套件，结果输出为 JSON，用于在版本之间对比回归
+ * 用法: pingpong_bench [-d seconds] [-s scenarios] [-c connections] [-l loops] [-t clientThreads]
+ *                      [-m sizes] [-n connCounts] [-L loopCounts] [-o output.json] [-r ip:port]
+ * 服务器(TcpServer 回显)和客户端(每个连接一个 TcpClient，分布在 -t 个 EventLoopThread 上)在同一进程中，
+ * 每组参数重新启动一次服务器；场景(-s，逗号分隔，默认全部)：
+ *   size    -c 个连接，消息大小按 -m 扫描(默认 16 到 64K)：pingpong 吞吐和每秒消息数
+ *   conns   64 字节消息，连接数按 -n 扫描(默认 1 到 100k)：每秒消息数和建立全部连接的耗时
+ *   loops   -c 个连接、64 字节消息，服务器 subLoop 数按 -L 扫描(默认 1 2 4)：每秒消息数
+ *   churn   -c 个并发的短连接：连接 → 发送 64 字节 → 服务器回显后关闭 → 客户端立即重连：每秒完成的连接数
+ * pingpong：每个连接建立后发送一条消息，两端收到多少就原样回送多少，客户端统计收到的字节数
+ * 启动时把 RLIMIT_NOFILE 提升到硬上限，超过 fd 上限能容纳的连接数记为 skipped；
+ * 连接数超过 20000 时客户端轮流连接 127.0.0.1、127.0.0.2 ...，每个目的地址有一套独立的本地端口
+ * -r 压测外部的 echo 服务器(比如另一个版本)，此时只运行 size 和 conns 场景
+ * JSON 写到 -o 指定的文件(默认 stdout)，进度和可读的表格写到 stderr
+ */
+
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+#include "TcpClient.h"
+#include "TcpServer.h"
+#include "Timestamp.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <errno.h>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/resource.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static const uint16_t kPort = 9978;
+static const int kConnectionsPerAddress = 20000;
+static const int kConnectBatch = 1000;       // 每批发起的连接数，避免 SYN 超过 listen 队列
+static const size_t kChurnMessageSize = 64;
+static const size_t kConnsMessageSize = 64;
+
+struct Options {
+  Options()
+      : seconds(2.0)
+      , scenarios("size,conns,loops,churn")
+      , connections(16)
+      , loops(2)
+      , clientThreads(2)
+      , sizes("16,256,4096,65536")
+      , connCounts("1,10,100,1000,10000,100000")
+      , loopCounts("1,2,4") {}
+
+  double seconds;
+  std::string scenarios;
+  int connections;
+  int loops;
+  int clientThreads;
+  std::string sizes;
+  std::string connCounts;
+  std::string loopCounts;
+  std::string output;
+  std::string remote; // ip:port，为空时使用进程内的服务器
+};
+
+static int64_t nowMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static std::vector<long> parseList(const std::string &s) {
+  std::vector<long> values;
+  size_t pos = 0;
+  while (pos < s.size()) {
+    size_t comma = s.find(',', pos);
+    if (comma == std::string::npos) {
+      comma = s.size();
+    }
+    if (comma > pos) {
+      values.push_back(atol(s.substr(pos, comma - pos).c_str()));
+    }
+    pos = comma + 1;
+  }
+  return values;
+}
+
+static bool hasScenario(const Options &options, const char *name) {
+  std::string list = "," + options.scenarios + ",";
+  return list.find(std::string(",") + name + ",") != std::string::npos;
+}
+
+// 进程内的 echo 服务器，closeAfterReply 时回显后关闭连接(短连接场景，由服务器主动关闭，TIME_WAIT 留在服务器一侧)
+class EchoServer {
+public:
+  EchoServer(int loops, bool closeAfterReply) : loop_(nullptr), server_(nullptr) {
+    thread_ = std::thread([this, loops, closeAfterReply]() {
+      EventLoop loop;
+      TcpServer server(&loop, InetAddress(kPort), "PingpongBench");
+      server.setThreadNum(loops);
+      server.setConnectionCallback([](const TcpConnectionPtr &) {});
+      server.setMessageCallback([closeAfterReply](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        conn->send(buf);
+        if (closeAfterReply) {
+          conn->shutdown();
+        }
+      });
+      server.start();
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        loop_ = &loop;
+        server_ = &server;
+        cond_.notify_one();
+      }
+      loop.loop();
+    });
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (loop_ == nullptr) {
+      cond_.wait(lock);
+    }
+    // 等待 Acceptor::listen 在 mainLoop 中执行
+    lock.unlock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+
+  ~EchoServer() {
+    EventLoop *loop = loop_;
+    TcpServer *server = server_;
+    loop->runInLoop([server, loop]() { server->stop(0, [loop]() { loop->quit(); }); });
+    thread_.join();
+  }
+
+private:
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  EventLoop *loop_;
+  TcpServer *server_;
+};
+
+// 客户端的累计统计，每个客户端线程一份，只由该线程写
+struct Counters {
+  Counters() : echo(true), bytes(0), cycles(0), connected(0), failed(0) {}
+  std::atomic<bool> echo;         // pingpong 是否继续回送，由主线程在结束测量时清除
+  std::atomic<int64_t> bytes;     // 收到的字节数
+  std::atomic<int64_t> cycles;    // 短连接场景完成的连接数
+  std::atomic<int64_t> connected; // 当前建立的连接数
+  std::atomic<int64_t> failed;    // 连接失败次数(Connector 会自动重试)
+};
+
+struct Totals {
+  Totals() : bytes(0), cycles(0), connected(0), failed(0) {}
+  int64_t bytes;
+  int64_t cycles;
+  int64_t connected;
+  int64_t failed;
+};
+
+/*
+ * 压测客户端：connections 个 TcpClient 按轮询分布在 threads 个 EventLoopThread 上
+ * pingpong 模式下连接建立后发送一条 size 字节的消息，之后收到什么就回送什么；
+ * churn 模式下连接建立后发送一条消息，服务器回显后关闭，TcpClient 的自动重连立即发起下一个连接
+ */
+class LoadClient {
+public:
+  LoadClient(const std::vector<InetAddress> &addrs, int threads, size_t size, bool churn)
+      : addrs_(addrs), message_(size, 'x'), churn_(churn) {
+    for (int i = 0; i < threads; ++i) {
+      std::unique_ptr<Worker> worker(new Worker());
+      worker->thread.reset(new EventLoopThread());
+      worker->loop = worker->thread->startLoop();
+      workers_.push_back(std::move(worker));
+    }
+  }
+
+  ~LoadClient() {
+    // TcpClient 在所属的 loop 中析构，不会与该 loop 中的 removeConnection 竞争
+    for (std::unique_ptr<Worker> &w : workers_) {
+      Worker *worker = w.get();
+      std::promise<void> done;
+      worker->loop->runInLoop([worker, &done]() {
+        worker->clients.clear();
+        done.set_value();
+      });
+      done.get_future().wait();
+    }
+    // 等待析构时 shutdown 的连接关闭
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    workers_.clear();
+  }
+
+  // 分批发起 n 个连接，每批等到全部建立(或超时)后再发起下一批，返回建立全部连接的耗时(微秒)，超时返回 -1
+  int64_t connect(int n, double timeoutSeconds) {
+    int64_t start = nowMicros();
+    int64_t deadline = start + static_cast<int64_t>(timeoutSeconds * 1e6);
+    for (int begin = 0; begin < n; begin += kConnectBatch) {
+      int end = std::min(n, begin + kConnectBatch);
+      for (int i = begin; i < end; ++i) {
+        addClient(i);
+      }
+      if (churn_) {
+        continue;
+      }
+      while (totals().connected < end) {
+        if (nowMicros() > deadline) {
+          return -1;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+    return nowMicros() - start;
+  }
+
+  // pingpong 停止回送，等在途的消息收完，之后关闭连接时两端的接收缓冲区都是空的，不会触发 RST
+  void quiesce() {
+    for (std::unique_ptr<Worker> &worker : workers_) {
+      worker->counters.echo.store(false, std::memory_order_relaxed);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+
+  // 停止自动重连，已经建立的连接继续到服务器关闭为止
+  void stop() {
+    for (std::unique_ptr<Worker> &w : workers_) {
+      Worker *worker = w.get();
+      std::promise<void> done;
+      worker->loop->runInLoop([worker, &done]() {
+        for (std::unique_ptr<TcpClient> &client : worker->clients) {
+          client->stop();
+        }
+        done.set_value();
+      });
+      done.get_future().wait();
+    }
+  }
+
+  Totals totals() const {
+    Totals t;
+    for (const std::unique_ptr<Worker> &worker : workers_) {
+      t.bytes += worker->counters.bytes.load(std::memory_order_relaxed);
+      t.cycles += worker->counters.cycles.load(std::memory_order_relaxed);
+      t.connected += worker->counters.connected.load(std::memory_order_relaxed);
+      t.failed += worker->counters.failed.load(std::memory_order_relaxed);
+    }
+    return t;
+  }
+
+private:
+  struct Worker {
+    std::unique_ptr<EventLoopThread> thread;
+    EventLoop *loop;
+    Counters counters;
+    std::vector<std::unique_ptr<TcpClient>> clients; // 只在 loop 线程中修改
+  };
+
+  void addClient(int i) {
+    Worker *worker = workers_[i % workers_.size()].get();
+    const InetAddress &addr = addrs_[(i / static_cast<int>(workers_.size())) % addrs_.size()];
+    Counters *counters = &worker->counters;
+    const std::string *message = &message_;
+    bool churn = churn_;
+    worker->loop->runInLoop([worker, addr, counters, message, churn]() {
+      std::unique_ptr<TcpClient> client(new TcpClient(worker->loop, addr, "PingpongBenchClient"));
+      client->setConnectionCallback([counters, message, churn](const TcpConnectionPtr &conn) {
+        if (conn->connected()) {
+          counters->connected.fetch_add(1, std::memory_order_relaxed);
+          conn->send(*message);
+        } else {
+          counters->connected.fetch_sub(1, std::memory_order_relaxed);
+          if (churn) {
+            counters->cycles.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+      });
+      client->setMessageCallback([counters, churn](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        counters->bytes.fetch_add(buf->readableBytes(), std::memory_order_relaxed);
+        if (churn || !counters->echo.load(std::memory_order_relaxed)) {
+          buf->retrieveAll();
+        } else {
+          conn->send(buf);
+        }
+      });
+      client->setConnectFailedCallback(
+          [counters](int) { counters->failed.fetch_add(1, std::memory_order_relaxed); });
+      if (churn) {
+        client->enableRetry();
+      }
+      client->connect();
+      worker->clients.push_back(std::move(client));
+    });
+  }
+
+  const std::vector<InetAddress> addrs_;
+  const std::string message_;
+  const bool churn_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+};
+
+// 一次测量的结果，序列化为 JSON 对象
+class Result {
+public:
+  explicit Result(const char *scenario) { add("scenario", scenario); }
+
+  void add(const char *key, const char *value) {
+    append(key);
+    json_ += '"';
+    json_ += value;
+    json_ += '"';
+  }
+  void add(const char *key, int64_t value) {
+    append(key);
+    json_ += std::to_string(value);
+  }
+  void add(const char *key, double value) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.3f", value);
+    append(key);
+    json_ += buf;
+  }
+  std::string json() const { return "{" + json_ + "}"; }
+
+private:
+  void append(const char *key) {
+    if (!json_.empty()) {
+      json_ += ", ";
+    }
+    json_ += '"';
+    json_ += key;
+    json_ += "\": ";
+  }
+  std::string json_;
+};
+
+class Suite {
+public:
+  explicit Suite(const Options &options) : options_(options), maxConnections_(0), remotePort_(0) {
+    // fd 上限提升到硬上限；进程内测试时每个连接占两个 fd
+    struct rlimit limit;
+    ::getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &limit);
+    ::getrlimit(RLIMIT_NOFILE, &limit);
+    nofile_ = static_cast<int64_t>(limit.rlim_cur);
+    int64_t usable = nofile_ - 256;
+    maxConnections_ = options_.remote.empty() ? usable / 2 : usable;
+    if (!options_.remote.empty()) {
+      size_t colon = options_.remote.rfind(':');
+      remoteIp_ = options_.remote.substr(0, colon);
+      remotePort_ = static_cast<uint16_t>(colon == std::string::npos ? kPort : atoi(options_.remote.c_str() + colon + 1));
+    }
+  }
+
+  void run() {
+    if (hasScenario(options_, "size")) {
+      for (long size : parseList(options_.sizes)) {
+        pingpong("size", options_.loops, options_.connections, static_cast<size_t>(size));
+      }
+    }
+    if (hasScenario(options_, "conns")) {
+      for (long n : parseList(options_.connCounts)) {
+        pingpong("conns", options_.loops, static_cast<int>(n), kConnsMessageSize);
+      }
+    }
+    if (hasScenario(options_, "loops")) {
+      for (long loops : parseList(options_.loopCounts)) {
+        if (options_.remote.empty()) {
+          pingpong("loops", static_cast<int>(loops), options_.connections, kConnsMessageSize);
+        } else {
+          skip("loops", "server_loops", loops, "needs the in-process server");
+        }
+      }
+    }
+    if (hasScenario(options_, "churn")) {
+      if (options_.remote.empty()) {
+        churn(options_.loops, options_.connections);
+      } else {
+        skip("churn", "connections", options_.connections, "needs the in-process server");
+      }
+    }
+  }
+
+  void writeJson(FILE *out) const {
+    fprintf(out, "{\n");
+    fprintf(out, "  \"bench\": \"pingpong\",\n");
+    fprintf(out, "  \"time\": \"%s\",\n", Timestamp::now().toFormattedString(false).c_str());
+    fprintf(out, "  \"host\": {\"cpus\": %u, \"nofile\": %lld},\n", std::thread::hardware_concurrency(),
+            static_cast<long long>(nofile_));
+    fprintf(out, "  \"config\": {\"seconds\": %.3f, \"connections\": %d, \"server_loops\": %d, "
+                 "\"client_threads\": %d, \"server\": \"%s\"},\n",
+            options_.seconds, options_.connections, options_.loops, options_.clientThreads,
+            options_.remote.empty() ? "in-process" : options_.remote.c_str());
+    fprintf(out, "  \"results\": [\n");
+    for (size_t i = 0; i < results_.size(); ++i) {
+      fprintf(out, "    %s%s\n", results_[i].c_str(), i + 1 < results_.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+  }
+
+private:
+  // 客户端的目的地址：连接数较多时轮流使用多个回环地址
+  std::vector<InetAddress> addresses(int connections) const {
+    std::vector<InetAddress> addrs;
+    if (!options_.remote.empty()) {
+      addrs.push_back(InetAddress(remotePort_, remoteIp_));
+      return addrs;
+    }
+    int count = std::max(1, (connections + kConnectionsPerAddress - 1) / kConnectionsPerAddress);
+    for (int i = 1; i <= count; ++i) {
+      addrs.push_back(InetAddress(kPort, "127.0.0." + std::to_string(i)));
+    }
+    return addrs;
+  }
+
+  void skip(const char *scenario, const char *key, int64_t value, const char *reason) {
+    Result result(scenario);
+    result.add(key, value);
+    result.add("skipped", reason);
+    results_.push_back(result.json());
+    fprintf(stderr, "%-6s %s=%lld skipped: %s\n", scenario, key, static_cast<long long>(value), reason);
+  }
+
+  void pingpong(const char *scenario, int loops, int connections, size_t size) {
+    if (connections > maxConnections_) {
+      skip(scenario, "connections", connections, "exceeds RLIMIT_NOFILE");
+      return;
+    }
+    std::unique_ptr<EchoServer> server;
+    if (options_.remote.empty()) {
+      server.reset(new EchoServer(loops, false));
+    }
+    int64_t connectUs;
+    double mibPerSec = 0;
+    double msgsPerSec = 0;
+    Totals end;
+    {
+      LoadClient client(addresses(connections), options_.clientThreads, size, false);
+      connectUs = client.connect(connections, 60);
+      if (connectUs >= 0) {
+        // 预热，让缓冲区和拥塞窗口到达稳定大小
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        Totals begin = client.totals();
+        int64_t start = nowMicros();
+        std::this_thread::sleep_for(std::chrono::microseconds(static_cast<int64_t>(options_.seconds * 1e6)));
+        end = client.totals();
+        double elapsed = (nowMicros() - start) / 1e6;
+        mibPerSec = (end.bytes - begin.bytes) / elapsed / (1024 * 1024);
+        msgsPerSec = (end.bytes - begin.bytes) / elapsed / size;
+      } else {
+        end = client.totals();
+      }
+      client.quiesce();
+      server.reset();
+    }
+    Result result(scenario);
+    result.add("server_loops", static_cast<int64_t>(options_.remote.empty() ? loops : 0));
+    result.add("client_threads", static_cast<int64_t>(options_.clientThreads));
+    result.add("connections", static_cast<int64_t>(connections));
+    result.add("message_size", static_cast<int64_t>(size));
+    result.add("seconds", options_.seconds);
+    if (connectUs < 0) {
+      result.add("skipped", "connect timeout");
+      result.add("connected", end.connected);
+    } else {
+      result.add("connect_ms", connectUs / 1000.0);
+      result.add("mib_per_sec", mibPerSec);
+      result.add("messages_per_sec", msgsPerSec);
+    }
+    result.add("connect_failures", end.failed);
+    results_.push_back(result.json());
+    if (connectUs < 0) {
+      fprintf(stderr, "%-6s loops %2d conns %6d size %6zu  connect timeout (%lld connected)\n", scenario, loops,
+              connections, size, static_cast<long long>(end.connected));
+    } else {
+      fprintf(stderr, "%-6s loops %2d conns %6d size %6zu  %10.1f MiB/s %12.0f msg/s  connect %.1f ms\n", scenario,
+              loops, connections, size, mibPerSec, msgsPerSec, connectUs / 1000.0);
+    }
+  }
+
+  void churn(int loops, int connections) {
+    if (connections > maxConnections_) {
+      skip("churn", "connections", connections, "exceeds RLIMIT_NOFILE");
+      return;
+    }
+    EchoServer server(loops, true);
+    double perSec;
+    Totals begin;
+    Totals end;
+    {
+      LoadClient client(addresses(connections), options_.clientThreads, kChurnMessageSize, true);
+      client.connect(connections, 60);
+      std::this_thread::sleep_for(std::chrono::milliseconds(200));
+      begin = client.totals();
+      int64_t start = nowMicros();
+      std::this_thread::sleep_for(std::chrono::microseconds(static_cast<int64_t>(options_.seconds * 1e6)));
+      end = client.totals();
+      perSec = (end.cycles - begin.cycles) / ((nowMicros() - start) / 1e6);
+      client.stop();
+      // 等待最后一轮连接被服务器关闭
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    Result result("churn");
+    result.add("server_loops", static_cast<int64_t>(loops));
+    result.add("client_threads", static_cast<int64_t>(options_.clientThreads));
+    result.add("connections", static_cast<int64_t>(connections));
+    result.add("message_size", static_cast<int64_t>(kChurnMessageSize));
+    result.add("seconds", options_.seconds);
+    result.add("connections_per_sec", perSec);
+    result.add("connect_failures", end.failed - begin.failed);
+    results_.push_back(result.json());
+    fprintf(stderr, "%-6s loops %2d conns %6d size %6zu  %10.0f conn/s  %lld connect failures\n", "churn", loops,
+            connections, kChurnMessageSize, perSec, static_cast<long long>(end.failed - begin.failed));
+  }
+
+  const Options options_;
+  int64_t nofile_;
+  int64_t maxConnections_;
+  std::string remoteIp_;
+  uint16_t remotePort_;
+  std::vector<std::string> results_;
+};
+
+int main(int argc, char *argv[]) {
+  Options options;
+  int opt;
+  while ((opt = ::getopt(argc, argv, "d:s:c:l:t:m:n:L:o:r:")) != -1) {
+    switch (opt) {
+      case 'd': options.seconds = atof(optarg); break;
+      case 's': options.scenarios = optarg; break;
+      case 'c': options.connections = std::max(1, atoi(optarg)); break;
+      case 'l': options.loops = std::max(0, atoi(optarg)); break;
+      case 't': options.clientThreads = std::max(1, atoi(optarg)); break;
+      case 'm': options.sizes = optarg; break;
+      case 'n': options.connCounts = optarg; break;
+      case 'L': options.loopCounts = optarg; break;
+      case 'o': options.output = optarg; break;
+      case 'r': options.remote = optarg; break;
+      default:
+        fprintf(stderr, "usage: %s [-d seconds] [-s size,conns,loops,churn] [-c connections] [-l loops] "
+                        "[-t clientThreads] [-m sizes] [-n connCounts] [-L loopCounts] [-o output.json] "
+                        "[-r ip:port]\n", argv[0]);
+        return 1;
+    }
+  }
+  ::signal(SIGPIPE, SIG_IGN);
+  Logger::setLogLevel(ERROR);
+
+  Suite suite(options);
+  suite.run();
+  FILE *out = options.output.empty() ? stdout : ::fopen(options.output.c_str(), "w");
+  if (out == nullptr) {
+    fprintf(stderr, "cannot open %s: %s\n", options.output.c_str(), strerror(errno));
+    return 1;
+  }
+  suite.writeJson(out);
+  if (out != stdout) {
+    ::fclose(out);
+  }
+  return 0;
+}
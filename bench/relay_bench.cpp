@@ -0,0 +1,223 @@
+/*
+ * splice 零拷贝转发与用户态拷贝转发的吞吐对比
+ * 用法: relay_bench [splice|copy] [connections] [seconds] [pipeSize]
+ * 同一进程中运行三部分：
+ *   backend  echo 服务器
+ *   proxy    单 loop 的代理，每个前端连接用 TcpClient 在同一个 loop 中建立一条到 backend 的连接
+ *            splice 模式用 TcpRelay 转发；copy 模式在 messageCallback 中 send，用 setBackpressure 限制缓冲
+ *   client   每个连接一个写线程持续写 64KB 数据块，读线程统计回送的字节数(数据经过代理两次)
+ */
+
+#include "EventLoop.h"
+#include "TcpClient.h"
+#include "TcpRelay.h"
+#include "TcpServer.h"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static const uint16_t kBackendPort = 9994;
+static const uint16_t kProxyPort = 9995;
+static const size_t kChunk = 64 * 1024;
+static const size_t kHighWaterMark = 1024 * 1024;
+static const size_t kLowWaterMark = 256 * 1024;
+
+// 在新线程中运行 loop，返回时 loop 已经开始运行
+class LoopThread {
+public:
+  template <typename Setup>
+  explicit LoopThread(Setup setup) : loop_(nullptr) {
+    thread_ = std::thread([this, setup]() {
+      EventLoop loop;
+      std::shared_ptr<void> state = setup(&loop);
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        loop_ = &loop;
+        cond_.notify_one();
+      }
+      loop.loop();
+    });
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (loop_ == nullptr) {
+      cond_.wait(lock);
+    }
+  }
+  ~LoopThread() {
+    loop_->quit();
+    thread_.join();
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  EventLoop *loop_;
+  std::thread thread_;
+};
+
+struct Proxy {
+  Proxy(EventLoop *loop, bool useSplice, size_t pipeSize)
+      : server(loop, InetAddress(kProxyPort), "RelayProxy"), useSplice(useSplice), pipeSize(pipeSize) {}
+
+  TcpServer server;
+  bool useSplice;
+  size_t pipeSize;
+  std::vector<std::shared_ptr<TcpClient>> clients; // 只在 loop 线程中访问，bench 结束时统一释放
+};
+
+static void onFrontConnection(Proxy *proxy, const TcpConnectionPtr &front) {
+  if (!front->connected()) {
+    return;
+  }
+  // 上游连接建立前暂停读取前端，数据留在内核缓冲区
+  front->stopRead();
+  std::shared_ptr<TcpClient> client(
+      new TcpClient(front->getLoop(), InetAddress(kBackendPort, "127.0.0.1"), "RelayUpstream"));
+  std::weak_ptr<TcpConnection> weakFront(front);
+  bool useSplice = proxy->useSplice;
+  size_t pipeSize = proxy->pipeSize;
+  client->setConnectionCallback([weakFront, useSplice, pipeSize](const TcpConnectionPtr &up) {
+    TcpConnectionPtr front = weakFront.lock();
+    if (!up->connected()) {
+      if (front && !useSplice) {
+        front->shutdown();
+      }
+      return;
+    }
+    if (!front || !front->connected()) {
+      up->shutdown();
+      return;
+    }
+    if (useSplice) {
+      if (!TcpRelay::start(front, up, pipeSize)) {
+        up->shutdown();
+        front->shutdown();
+      }
+      return;
+    }
+    std::weak_ptr<TcpConnection> weakUp(up);
+    front->setMessageCallback([weakUp](const TcpConnectionPtr &, Buffer *buf, Timestamp) {
+      TcpConnectionPtr up = weakUp.lock();
+      if (up) {
+        up->send(buf);
+      } else {
+        buf->retrieveAll();
+      }
+    });
+    up->setMessageCallback([weakFront](const TcpConnectionPtr &, Buffer *buf, Timestamp) {
+      TcpConnectionPtr front = weakFront.lock();
+      if (front) {
+        front->send(buf);
+      } else {
+        buf->retrieveAll();
+      }
+    });
+    up->setBackpressure(front, kHighWaterMark, kLowWaterMark);
+    front->setBackpressure(up, kHighWaterMark, kLowWaterMark);
+    front->startRead();
+  });
+  client->connect();
+  proxy->clients.push_back(client);
+}
+
+static bool writeAll(int fd, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = ::write(fd, data, len);
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+static void clientFunc(double seconds, std::atomic<int64_t> *received) {
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr;
+  ::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(kProxyPort);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+    perror("connect");
+    ::close(fd);
+    return;
+  }
+  std::atomic<bool> stop(false);
+  std::thread writer([&]() {
+    std::string chunk(kChunk, 'x');
+    while (!stop && writeAll(fd, chunk.data(), chunk.size())) {
+    }
+  });
+  char buf[65536];
+  int64_t count = 0;
+  auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+  while (std::chrono::steady_clock::now() < end) {
+    ssize_t n = ::read(fd, buf, sizeof(buf));
+    if (n <= 0) {
+      break;
+    }
+    count += n;
+  }
+  stop = true;
+  ::shutdown(fd, SHUT_RDWR);
+  writer.join();
+  ::close(fd);
+  *received += count;
+}
+
+int main(int argc, char *argv[]) {
+  bool useSplice = argc <= 1 || strcmp(argv[1], "copy") != 0;
+  int connections = argc > 2 ? atoi(argv[2]) : 1;
+  double seconds = argc > 3 ? atof(argv[3]) : 3.0;
+  size_t pipeSize = argc > 4 ? atoi(argv[4]) : TcpRelay::kDefaultPipeSize;
+  // 测试结束时客户端直接关闭连接，代理和 backend 可能向已关闭的连接写数据
+  ::signal(SIGPIPE, SIG_IGN);
+
+  LoopThread backend([](EventLoop *loop) {
+    std::shared_ptr<TcpServer> server(new TcpServer(loop, InetAddress(kBackendPort), "RelayBackend"));
+    server->setConnectionCallback([](const TcpConnectionPtr &) {});
+    server->setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) { conn->send(buf); });
+    server->start();
+    return std::shared_ptr<void>(server);
+  });
+  LoopThread proxyThread([useSplice, pipeSize](EventLoop *loop) {
+    std::shared_ptr<Proxy> proxy(new Proxy(loop, useSplice, pipeSize));
+    Proxy *p = proxy.get();
+    proxy->server.setConnectionCallback([p](const TcpConnectionPtr &conn) { onFrontConnection(p, conn); });
+    proxy->server.start();
+    return std::shared_ptr<void>(proxy);
+  });
+  // 等待 Acceptor::listen 在 loop 中执行
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  std::atomic<int64_t> received(0);
+  std::vector<std::thread> clients;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < connections; ++i) {
+    clients.emplace_back(clientFunc, seconds, &received);
+  }
+  for (std::thread &t : clients) {
+    t.join();
+  }
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  // 等代理处理完关闭事件
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  fprintf(stderr, "mode=%s connections=%d pipeSize=%zu MiB/s=%.1f\n", useSplice ? "splice" : "copy",
+          connections, pipeSize, received / elapsed / 1024 / 1024);
+  return 0;
+}
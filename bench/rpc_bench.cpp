@@ -0,0 +1,194 @@
+/*
+ * RPC 小负载调用的吞吐和延迟，服务端和客户端 subLoop 数从 1 增加到 N
+ * 用法: rpc_bench [seconds] [maxLoops] [window] [payloadSize]
+ * 服务端 RpcServer 有 n 个 subLoop，客户端在 n 个 loop 上各建一个 RpcClient，
+ * 每个客户端保持 window 个调用在途(回调中立即发起下一个调用)，统计每秒调用数、延迟 p50/p99，
+ * 以及稳定状态下每次调用的内存分配次数(替换全局 operator new 计数)；
+ * 调用路径本身不分配，剩下的少量分配来自 auto-cork 每轮循环登记一次的 flush，被同一轮中的所有调用分摊
+ */
+
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Logger.h"
+#include "RpcClient.h"
+#include "RpcServer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const uint16_t kPort = 9993;
+
+static std::atomic<int64_t> g_allocations(0);
+
+void *operator new(size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  void *p = ::malloc(size != 0 ? size : 1);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept { ::free(p); }
+void operator delete(void *p, size_t) noexcept { ::free(p); }
+
+static int64_t nowMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// 一个客户端 loop 上的压测状态，只在该 loop 线程中访问
+struct Caller {
+  RpcClient *client;
+  std::string payload;
+  bool running;
+  int64_t calls;
+  std::vector<int64_t> latencies; // 预先分配，只采样前 capacity 个
+
+  void issue() {
+    int64_t start = nowMicros();
+    // 捕获两个 8 字节的值，std::function 可以就地存放，不分配内存
+    client->call("echo", payload.data(), payload.size(), [this, start](const RpcResult &result) {
+      if (!result.ok()) {
+        return;
+      }
+      ++calls;
+      if (latencies.size() < latencies.capacity()) {
+        latencies.push_back(nowMicros() - start);
+      }
+      if (running) {
+        issue();
+      }
+    });
+  }
+};
+
+int main(int argc, char *argv[]) {
+  double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+  int maxLoops = argc > 2 ? atoi(argv[2]) : 4;
+  int window = argc > 3 ? atoi(argv[3]) : 64;
+  size_t payloadSize = argc > 4 ? static_cast<size_t>(atoi(argv[4])) : 32;
+  ::signal(SIGPIPE, SIG_IGN);
+  Logger::setLogLevel(ERROR);
+
+  EventLoop *serverLoop = nullptr;
+  RpcServer *server = nullptr;
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::thread serverThread([&]() {
+    EventLoop loop;
+    RpcServer rpcServer(&loop, InetAddress(kPort, "127.0.0.1"), "RpcBench");
+    rpcServer.registerMethod("echo", [](const char *payload, size_t len, const RpcResponder &responder) {
+      responder.reply(payload, len);
+    });
+    rpcServer.setThreadNum(maxLoops);
+    rpcServer.start();
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      serverLoop = &loop;
+      server = &rpcServer;
+      cond.notify_one();
+    }
+    loop.loop();
+  });
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (serverLoop == nullptr) {
+      cond.wait(lock);
+    }
+  }
+  // 等待 Acceptor::listen 在 mainLoop 中执行
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  fprintf(stderr, "window %d, payload %zu bytes\n", window, payloadSize);
+  fprintf(stderr, "%6s %12s %10s %10s %14s\n", "loops", "calls/s", "p50_us", "p99_us", "allocs/call");
+  for (int loops = 1; loops <= maxLoops; loops *= 2) {
+    // 服务端按轮询把连接分给 subLoop，n 个连接正好分到 n 个不同的 subLoop 上(maxLoops 个中的前 n 个)
+    std::vector<std::unique_ptr<EventLoopThread>> threads;
+    std::vector<std::unique_ptr<RpcClient>> clients;
+    std::vector<std::unique_ptr<Caller>> callers;
+    for (int i = 0; i < loops; ++i) {
+      threads.emplace_back(new EventLoopThread());
+      EventLoop *loop = threads.back()->startLoop();
+      clients.emplace_back(new RpcClient(loop, InetAddress(kPort, "127.0.0.1"), "RpcBenchClient"));
+      clients.back()->connect();
+      Caller *caller = new Caller();
+      caller->client = clients.back().get();
+      caller->payload.assign(payloadSize, 'x');
+      caller->running = true;
+      caller->calls = 0;
+      caller->latencies.reserve(1 << 20);
+      callers.emplace_back(caller);
+    }
+    while (std::any_of(clients.begin(), clients.end(),
+                       [](const std::unique_ptr<RpcClient> &c) { return !c->connected(); })) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    for (int i = 0; i < loops; ++i) {
+      Caller *caller = callers[i].get();
+      clients[i]->getLoop()->runInLoop([caller, window]() {
+        for (int w = 0; w < window; ++w) {
+          caller->issue();
+        }
+      });
+    }
+    // 预热，让调用表、缓冲区和延迟采样都到达稳定大小
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int64_t callsBefore = 0;
+    for (int i = 0; i < loops; ++i) {
+      std::promise<int64_t> p;
+      Caller *caller = callers[i].get();
+      clients[i]->getLoop()->runInLoop([caller, &p]() {
+        caller->latencies.clear();
+        p.set_value(caller->calls);
+      });
+      callsBefore += p.get_future().get();
+    }
+    int64_t allocsBefore = g_allocations.load();
+    int64_t start = nowMicros();
+    std::this_thread::sleep_for(std::chrono::microseconds(static_cast<int64_t>(seconds * 1e6)));
+    int64_t allocsAfter = g_allocations.load();
+    int64_t elapsed = nowMicros() - start;
+
+    int64_t callsAfter = 0;
+    std::vector<int64_t> latencies;
+    for (int i = 0; i < loops; ++i) {
+      std::promise<int64_t> p;
+      Caller *caller = callers[i].get();
+      clients[i]->getLoop()->runInLoop([caller, &p, &latencies]() {
+        caller->running = false;
+        latencies.insert(latencies.end(), caller->latencies.begin(), caller->latencies.end());
+        p.set_value(caller->calls);
+      });
+      callsAfter += p.get_future().get();
+    }
+    std::sort(latencies.begin(), latencies.end());
+    int64_t calls = callsAfter - callsBefore;
+    double p50 = latencies.empty() ? 0 : latencies[latencies.size() / 2];
+    double p99 = latencies.empty() ? 0 : latencies[latencies.size() * 99 / 100];
+    fprintf(stderr, "%6d %12.0f %10.1f %10.1f %14.3f\n", loops, calls * 1e6 / elapsed, p50, p99,
+            calls > 0 ? static_cast<double>(allocsAfter - allocsBefore) / calls : 0.0);
+
+    // 等在途调用结束后再析构客户端
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    clients.clear();
+    threads.clear();
+  }
+
+  serverLoop->runInLoop([server, serverLoop]() { server->server()->stop(0, [serverLoop]() { serverLoop->quit(); }); });
+  serverThread.join();
+  return 0;
+}
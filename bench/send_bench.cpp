@@ -0,0 +1,113 @@
+/*
+ * 跨线程 TcpConnection::send 吞吐测试
+ * 用法: send_bench [copy|move|raw|buffer|shared] [msgSize] [messages]
+ * 一个非 loop 线程不断调用 send，同进程中的阻塞客户端读取并统计字节数
+ *   copy   send(const std::string&)，每条消息拷贝一次
+ *   move   send(std::string&&)，每条消息新建一个 string 后移动
+ *   raw    send(const void*, size_t)，每条消息拷贝一次
+ *   buffer send(Buffer*)，交换 Buffer 的底层存储
+ *   shared send(shared_ptr<const std::string>)，所有消息共享同一份数据
+ */
+
+#include "EventLoop.h"
+#include "TcpServer.h"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+static const uint16_t kPort = 9982;
+
+int main(int argc, char *argv[]) {
+  std::string mode = argc > 1 ? argv[1] : "copy";
+  size_t msgSize = argc > 2 ? atoi(argv[2]) : 256;
+  int64_t messages = argc > 3 ? atoll(argv[3]) : 200000;
+
+  std::mutex mutex;
+  TcpConnectionPtr connection;
+  EventLoop *serverLoop = nullptr;
+  std::thread serverThread([&]() {
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "SendBench");
+    server.setThreadNum(1);
+    server.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+      std::unique_lock<std::mutex> lock(mutex);
+      connection = conn->connected() ? conn : TcpConnectionPtr();
+    });
+    server.setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp) { buf->retrieveAll(); });
+    server.start();
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      serverLoop = &loop;
+    }
+    loop.loop();
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr;
+  ::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(kPort);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+    perror("connect");
+    return 1;
+  }
+  TcpConnectionPtr conn;
+  while (!conn) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    std::unique_lock<std::mutex> lock(mutex);
+    conn = connection;
+  }
+
+  const int64_t total = messages * static_cast<int64_t>(msgSize);
+  auto start = std::chrono::steady_clock::now();
+  std::thread producer([&]() {
+    const std::string message(msgSize, 'x');
+    std::shared_ptr<const std::string> shared(new std::string(message));
+    Buffer buf;
+    for (int64_t i = 0; i < messages; ++i) {
+      if (mode == "copy") {
+        conn->send(message);
+      } else if (mode == "move") {
+        conn->send(std::string(msgSize, 'x'));
+      } else if (mode == "raw") {
+        conn->send(message.data(), message.size());
+      } else if (mode == "buffer") {
+        buf.append(message.data(), message.size());
+        conn->send(&buf);
+      } else {
+        conn->send(shared);
+      }
+    }
+  });
+
+  char buf[65536];
+  int64_t received = 0;
+  while (received < total) {
+    ssize_t n = ::read(fd, buf, sizeof(buf));
+    if (n <= 0) {
+      break;
+    }
+    received += n;
+  }
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  producer.join();
+  ::close(fd);
+  conn.reset();
+  serverLoop->quit();
+  serverThread.join();
+
+  fprintf(stderr, "mode=%s msgSize=%zu messages=%ld sends/s=%.0f MiB/s=%.2f\n", mode.c_str(),
+          msgSize, messages, messages / elapsed, received / elapsed / 1024 / 1024);
+  return 0;
+}
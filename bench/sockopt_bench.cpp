@@ -0,0 +1,275 @@
+/*
+ * socket 选项对回环网络延迟和吞吐的影响
+ * 用法: sockopt_bench [seconds]
+ * 依次用每组 SocketOptions 启动服务器，测三项指标：
+ *   rtt      单连接 64 字节请求，服务器分两次 send 回复(模拟响应头 + 响应体)，统计往返延迟 p50/p99
+ *   stream   单连接持续写入 64KB 数据块，服务器原样回送，统计回送吞吐
+ *   connect  串行建立短连接：connect + 64 字节请求 + 读回复 + close，统计平均耗时(fastopen 组用 MSG_FASTOPEN 发送请求)
+ */
+
+#include "EventLoop.h"
+#include "TcpServer.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static const uint16_t kBasePort = 9984;
+static const size_t kRequestSize = 64;
+static const size_t kStreamChunk = 64 * 1024;
+
+struct Config {
+  const char *name;
+  SocketOptions options;
+};
+
+static std::vector<Config> makeConfigs() {
+  std::vector<Config> configs;
+  Config c;
+  c.name = "default";
+  configs.push_back(c);
+
+  c = Config();
+  c.name = "nodelay";
+  c.options.tcpNoDelay = true;
+  configs.push_back(c);
+
+  c = Config();
+  c.name = "buf64k";
+  c.options.sendBufferSize = 64 * 1024;
+  c.options.recvBufferSize = 64 * 1024;
+  configs.push_back(c);
+
+  c = Config();
+  c.name = "buf4m";
+  c.options.sendBufferSize = 4 * 1024 * 1024;
+  c.options.recvBufferSize = 4 * 1024 * 1024;
+  configs.push_back(c);
+
+  c = Config();
+  c.name = "notsent16k";
+  c.options.notSentLowat = 16 * 1024;
+  configs.push_back(c);
+
+  c = Config();
+  c.name = "quickack";
+  c.options.quickAck = true;
+  configs.push_back(c);
+
+  c = Config();
+  c.name = "deferaccept";
+  c.options.deferAcceptSeconds = 1;
+  configs.push_back(c);
+
+  c = Config();
+  c.name = "fastopen";
+  c.options.fastOpenQueue = 256;
+  configs.push_back(c);
+
+  c = Config();
+  c.name = "backlog4096";
+  c.options.backlog = 4096;
+  configs.push_back(c);
+  return configs;
+}
+
+static double nowSeconds() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static sockaddr_in serverAddr(uint16_t port) {
+  sockaddr_in addr;
+  ::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  return addr;
+}
+
+static int connectTo(uint16_t port) {
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = serverAddr(port);
+  if (::connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+    perror("connect");
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static bool writeAll(int fd, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = ::write(fd, data, len);
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+static bool readAll(int fd, char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = ::read(fd, data, len);
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+// 小请求分两次 send 回复，大块数据原样回送
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+  if (buf->readableBytes() <= kRequestSize) {
+    conn->send(buf->peek(), 4);
+    conn->send(buf->peek() + 4, buf->readableBytes() - 4);
+    buf->retrieveAll();
+  } else {
+    conn->send(buf);
+  }
+}
+
+static void runRtt(uint16_t port, double seconds, double *p50, double *p99) {
+  int fd = connectTo(port);
+  std::vector<double> samples;
+  char out[kRequestSize];
+  char in[kRequestSize];
+  ::memset(out, 'x', sizeof(out));
+  double end = nowSeconds() + seconds;
+  while (fd >= 0 && nowSeconds() < end) {
+    double start = nowSeconds();
+    if (!writeAll(fd, out, sizeof(out)) || !readAll(fd, in, sizeof(in))) {
+      break;
+    }
+    samples.push_back((nowSeconds() - start) * 1e6);
+  }
+  ::close(fd);
+  std::sort(samples.begin(), samples.end());
+  *p50 = samples.empty() ? 0 : samples[samples.size() / 2];
+  *p99 = samples.empty() ? 0 : samples[samples.size() * 99 / 100];
+}
+
+static double runStream(uint16_t port, double seconds) {
+  int fd = connectTo(port);
+  if (fd < 0) {
+    return 0;
+  }
+  std::atomic<bool> stop(false);
+  std::thread writer([&]() {
+    std::string chunk(kStreamChunk, 'x');
+    while (!stop && writeAll(fd, chunk.data(), chunk.size())) {
+    }
+  });
+  char buf[65536];
+  int64_t received = 0;
+  double start = nowSeconds();
+  double end = start + seconds;
+  while (nowSeconds() < end) {
+    ssize_t n = ::read(fd, buf, sizeof(buf));
+    if (n <= 0) {
+      break;
+    }
+    received += n;
+  }
+  double elapsed = nowSeconds() - start;
+  stop = true;
+  ::shutdown(fd, SHUT_RDWR);
+  writer.join();
+  ::close(fd);
+  return received / elapsed / 1024 / 1024;
+}
+
+static double runConnect(uint16_t port, double seconds, bool fastOpen) {
+  char out[kRequestSize];
+  char in[kRequestSize];
+  ::memset(out, 'x', sizeof(out));
+  sockaddr_in addr = serverAddr(port);
+  int count = 0;
+  double start = nowSeconds();
+  double end = start + seconds;
+  while (nowSeconds() < end) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    bool ok;
+    if (fastOpen) {
+      // 有 TFO cookie 时请求随 SYN 一起发出，否则内核退化为普通的三次握手
+      ok = ::sendto(fd, out, sizeof(out), MSG_FASTOPEN, (sockaddr *)&addr, sizeof(addr)) ==
+           static_cast<ssize_t>(sizeof(out));
+    } else {
+      ok = ::connect(fd, (sockaddr *)&addr, sizeof(addr)) == 0 && writeAll(fd, out, sizeof(out));
+    }
+    ok = ok && readAll(fd, in, sizeof(in));
+    ::close(fd);
+    if (!ok) {
+      break;
+    }
+    ++count;
+  }
+  return count > 0 ? (nowSeconds() - start) * 1e6 / count : 0;
+}
+
+int main(int argc, char *argv[]) {
+  double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+  // stream 测试结束时关闭连接，服务器和写线程可能向已关闭的连接写数据
+  ::signal(SIGPIPE, SIG_IGN);
+  std::vector<Config> configs = makeConfigs();
+
+  fprintf(stderr, "%-12s %10s %10s %12s %12s\n", "config", "rtt_p50us", "rtt_p99us", "stream_MiB/s",
+          "connect_us");
+  for (size_t i = 0; i < configs.size(); ++i) {
+    const Config &config = configs[i];
+    uint16_t port = static_cast<uint16_t>(kBasePort + i);
+    EventLoop *serverLoop = nullptr;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::thread serverThread([&]() {
+      EventLoop loop;
+      TcpServer server(&loop, InetAddress(port), "SockoptBench");
+      server.setThreadNum(1);
+      server.setSocketOptions(config.options);
+      server.setConnectionCallback([](const TcpConnectionPtr &) {});
+      server.setMessageCallback(onMessage);
+      server.start();
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        serverLoop = &loop;
+        cond.notify_one();
+      }
+      loop.loop();
+    });
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (serverLoop == nullptr) {
+        cond.wait(lock);
+      }
+    }
+    // 等待 Acceptor::listen 在 mainLoop 中执行
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    double p50 = 0;
+    double p99 = 0;
+    runRtt(port, seconds, &p50, &p99);
+    double stream = runStream(port, seconds);
+    double connectUs = runConnect(port, seconds, config.options.fastOpenQueue > 0);
+    fprintf(stderr, "%-12s %10.1f %10.1f %12.1f %12.1f\n", config.name, p50, p99, stream, connectUs);
+
+    serverLoop->quit();
+    serverThread.join();
+  }
+  return 0;
+}
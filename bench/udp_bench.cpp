@@ -0,0 +1,127 @@
+/*
+ * UDP 批量收发(recvmmsg/sendmmsg)与逐个收发(recvfrom/sendto)的包速率对比
+ * 用法: udp_bench [batched|single] [echo|sink] [senders] [seconds] [payload] [gro]
+ * 同一进程中运行 UdpServer(单 loop)和 senders 个发送线程，发送线程用 sendmmsg 尽可能快地发送 payload 字节的数据报
+ *   sink  服务器只收取数据报，统计接收包速率
+ *   echo  服务器把每个数据报原样回送，同时统计发送包速率(回送的报文发往发送线程的 socket，不读取)
+ *   gro   服务器开启 UDP_GRO(回环上内核不一定合并，结果以输出中的 gro 状态为准)
+ */
+
+#include "EventLoop.h"
+#include "UdpServer.h"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static const uint16_t kPort = 9996;
+static const int kSendBatch = 64;
+
+static void senderFunc(size_t payload, std::atomic<bool> *stop, std::atomic<int64_t> *sent) {
+  int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in addr;
+  ::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(kPort);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  std::string data(payload, 'x');
+  std::vector<mmsghdr> msgs(kSendBatch);
+  std::vector<iovec> iovs(kSendBatch);
+  for (int i = 0; i < kSendBatch; ++i) {
+    iovs[i].iov_base = &data[0];
+    iovs[i].iov_len = data.size();
+    ::memset(&msgs[i].msg_hdr, 0, sizeof(msghdr));
+    msgs[i].msg_hdr.msg_name = &addr;
+    msgs[i].msg_hdr.msg_namelen = sizeof(addr);
+    msgs[i].msg_hdr.msg_iov = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+  int64_t count = 0;
+  while (!*stop) {
+    int n = ::sendmmsg(fd, &msgs[0], kSendBatch, 0);
+    if (n < 0) {
+      break;
+    }
+    count += n;
+  }
+  *sent += count;
+  ::close(fd);
+}
+
+int main(int argc, char *argv[]) {
+  bool batched = argc <= 1 || strcmp(argv[1], "single") != 0;
+  bool echo = argc > 2 && strcmp(argv[2], "echo") == 0;
+  int senders = argc > 3 ? atoi(argv[3]) : 1;
+  double seconds = argc > 4 ? atof(argv[4]) : 3.0;
+  size_t payload = argc > 5 ? atoi(argv[5]) : 64;
+  bool gro = argc > 6 && strcmp(argv[6], "gro") == 0;
+
+  UdpOptions options;
+  options.batchSize = batched ? 64 : 1;
+  options.gro = gro;
+  options.recvBufferSize = 4 * 1024 * 1024;
+
+  EventLoop *serverLoop = nullptr;
+  UdpServer *server = nullptr;
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::thread serverThread([&]() {
+    EventLoop loop;
+    UdpServer udpServer(&loop, InetAddress(kPort), "UdpBench", options);
+    if (echo) {
+      udpServer.setMessageCallback([](UdpChannel *channel, const char *data, size_t len,
+                                      const InetAddress &peer, Timestamp) { channel->send(data, len, peer); });
+    }
+    udpServer.start();
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      serverLoop = &loop;
+      server = &udpServer;
+      cond.notify_one();
+    }
+    loop.loop();
+  });
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (serverLoop == nullptr) {
+      cond.wait(lock);
+    }
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  std::atomic<bool> stop(false);
+  std::atomic<int64_t> sent(0);
+  std::vector<std::thread> threads;
+  int64_t received0 = server->packetsReceived();
+  int64_t echoed0 = server->packetsSent();
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < senders; ++i) {
+    threads.emplace_back(senderFunc, payload, &stop, &sent);
+  }
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  int64_t received = server->packetsReceived() - received0;
+  int64_t echoed = server->packetsSent() - echoed0;
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  stop = true;
+  for (std::thread &t : threads) {
+    t.join();
+  }
+  bool groEnabled = !server->channels().empty() && server->channels()[0]->groEnabled();
+  serverLoop->quit();
+  serverThread.join();
+
+  fprintf(stderr, "mode=%s %s senders=%d payload=%zu gro=%d sent/s=%.0f rx_pps=%.0f tx_pps=%.0f\n",
+          batched ? "batched" : "single", echo ? "echo" : "sink", senders, payload, groEnabled,
+          sent / elapsed, received / elapsed, echoed / elapsed);
+  return 0;
+}
@@ -0,0 +1,176 @@
+/*
+ * 同一主机上 Unix 域 socket 与回环 TCP(IPv4/IPv6) 的延迟和吞吐对比
+ * 用法: uds_bench [seconds]
+ * 对每种地址启动同一个 echo TcpServer，测两项指标：
+ *   rtt      单连接 64 字节请求-回复，统计往返延迟 p50/p99
+ *   stream   单连接持续写入 64KB 数据块，服务器原样回送，统计回送吞吐
+ */
+
+#include "EventLoop.h"
+#include "TcpServer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static const size_t kRequestSize = 64;
+static const size_t kStreamChunk = 64 * 1024;
+
+struct Target {
+  const char *name;
+  InetAddress listenAddr;
+  InetAddress connectAddr;
+};
+
+static double nowSeconds() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int connectTo(const InetAddress &addr) {
+  int fd = ::socket(addr.family(), SOCK_STREAM, 0);
+  if (::connect(fd, addr.getSockAddr(), addr.length()) < 0) {
+    perror("connect");
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static bool writeAll(int fd, const char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = ::write(fd, data, len);
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+static bool readAll(int fd, char *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = ::read(fd, data, len);
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+static void runRtt(const InetAddress &addr, double seconds, double *p50, double *p99) {
+  int fd = connectTo(addr);
+  std::vector<double> samples;
+  char out[kRequestSize];
+  char in[kRequestSize];
+  ::memset(out, 'x', sizeof(out));
+  double end = nowSeconds() + seconds;
+  while (fd >= 0 && nowSeconds() < end) {
+    double start = nowSeconds();
+    if (!writeAll(fd, out, sizeof(out)) || !readAll(fd, in, sizeof(in))) {
+      break;
+    }
+    samples.push_back((nowSeconds() - start) * 1e6);
+  }
+  ::close(fd);
+  std::sort(samples.begin(), samples.end());
+  *p50 = samples.empty() ? 0 : samples[samples.size() / 2];
+  *p99 = samples.empty() ? 0 : samples[samples.size() * 99 / 100];
+}
+
+static double runStream(const InetAddress &addr, double seconds) {
+  int fd = connectTo(addr);
+  if (fd < 0) {
+    return 0;
+  }
+  std::atomic<bool> stop(false);
+  std::thread writer([&]() {
+    std::string chunk(kStreamChunk, 'x');
+    while (!stop && writeAll(fd, chunk.data(), chunk.size())) {
+    }
+  });
+  char buf[65536];
+  int64_t received = 0;
+  double start = nowSeconds();
+  double end = start + seconds;
+  while (nowSeconds() < end) {
+    ssize_t n = ::read(fd, buf, sizeof(buf));
+    if (n <= 0) {
+      break;
+    }
+    received += n;
+  }
+  double elapsed = nowSeconds() - start;
+  stop = true;
+  ::shutdown(fd, SHUT_RDWR);
+  writer.join();
+  ::close(fd);
+  return received / elapsed / 1024 / 1024;
+}
+
+int main(int argc, char *argv[]) {
+  double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+  // stream 测试结束时关闭连接，服务器和写线程可能向已关闭的连接写数据
+  ::signal(SIGPIPE, SIG_IGN);
+
+  std::vector<Target> targets;
+  targets.push_back(Target{"tcp4", InetAddress(9997, "127.0.0.1"), InetAddress(9997, "127.0.0.1")});
+  targets.push_back(Target{"tcp6", InetAddress(9998, "::1"), InetAddress(9998, "::1")});
+  std::string path = "/tmp/cmuduo_uds_bench." + std::to_string(::getpid()) + ".sock";
+  targets.push_back(Target{"unix", InetAddress::unixAddress(path), InetAddress::unixAddress(path)});
+  targets.push_back(
+      Target{"unix-abs", InetAddress::unixAddress("@cmuduo_uds_bench"), InetAddress::unixAddress("@cmuduo_uds_bench")});
+
+  fprintf(stderr, "%-10s %-36s %10s %10s %12s\n", "target", "address", "rtt_p50us", "rtt_p99us",
+          "stream_MiB/s");
+  for (const Target &target : targets) {
+    EventLoop *serverLoop = nullptr;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::thread serverThread([&]() {
+      EventLoop loop;
+      TcpServer server(&loop, target.listenAddr, "UdsBench");
+      server.setThreadNum(1);
+      server.setConnectionCallback([](const TcpConnectionPtr &) {});
+      server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) { conn->send(buf); });
+      server.start();
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        serverLoop = &loop;
+        cond.notify_one();
+      }
+      loop.loop();
+    });
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (serverLoop == nullptr) {
+        cond.wait(lock);
+      }
+    }
+    // 等待 Acceptor::listen 在 mainLoop 中执行
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    double p50 = 0;
+    double p99 = 0;
+    runRtt(target.connectAddr, seconds, &p50, &p99);
+    double stream = runStream(target.connectAddr, seconds);
+    fprintf(stderr, "%-10s %-36s %10.1f %10.1f %12.1f\n", target.name,
+            target.listenAddr.toIpPort().c_str(), p50, p99, stream);
+
+    serverLoop->quit();
+    serverThread.join();
+  }
+  return 0;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <cmuduo/Buffer.h>
+#include <cmuduo/TcpConnection.h>
+
+#include <deque>
+#include <stdint.h>
+#include <string>
+
+/*
+ * 流水线回复的排序队列(kv_server 和 pubsub_broker 共用)：同一连接上的命令可能交给其他 loop 异步执行，
+ * 完成的先后与命令顺序不同，回复必须按命令顺序写出
+ *   同步命令：out = begin(conn)，写入回复，end(out)；没有回复在排队时 out 就是 outputBuffer()，零拷贝
+ *   异步命令：seq = reserve() 占住位置，结果回到连接所在的 loop 后 complete(conn, seq, reply)
+ *   关闭连接(QUIT、协议错误)：shutdownAfterDrain(conn)，排队的回复全部写出后才 shutdown，之后的命令不再执行
+ * 只在连接所在的 loop 线程中使用
+ */
+class OrderedReplies {
+public:
+  OrderedReplies() : firstSeq_(0), closing_(false) {}
+
+  // 回复的写入位置：没有排队的回复时直接写 outputBuffer_，否则先写在 scratch_ 中
+  Buffer *begin(const TcpConnectionPtr &conn) { return pending_.empty() ? conn->outputBuffer() : &scratch_; }
+  void end(Buffer *out) {
+    if (out == &scratch_) {
+      PendingReply reply = {true, scratch_.retrieveAllAsString()};
+      pending_.push_back(std::move(reply));
+    }
+  }
+
+  // 为异步执行的命令占住回复的位置，返回它的序号
+  uint64_t reserve() {
+    PendingReply reply = {false, std::string()};
+    pending_.push_back(std::move(reply));
+    return firstSeq_ + pending_.size() - 1;
+  }
+
+  // 填入序号为 seq 的回复(取走 reply 的内容)，按顺序写出队首所有已经完成的回复
+  void complete(const TcpConnectionPtr &conn, uint64_t seq, std::string &reply) {
+    PendingReply &slot = pending_[seq - firstSeq_];
+    slot.done = true;
+    slot.reply.swap(reply);
+    while (!pending_.empty() && pending_.front().done) {
+      const std::string &r = pending_.front().reply;
+      conn->outputBuffer()->append(r.data(), r.size());
+      pending_.pop_front();
+      ++firstSeq_;
+    }
+    conn->flush();
+    if (closing_ && pending_.empty()) {
+      conn->shutdown();
+    }
+  }
+
+  // 立即 shutdown 会让 complete 发现连接已断开，丢掉还在其他 loop 上执行的命令的回复
+  void shutdownAfterDrain(const TcpConnectionPtr &conn) {
+    closing_ = true;
+    conn->flush();
+    if (pending_.empty()) {
+      conn->shutdown();
+    }
+  }
+  bool closing() const { return closing_; }
+
+private:
+  // 等待异步结果的回复，done 之前占住位置以保持回复顺序
+  struct PendingReply {
+    bool done;
+    std::string reply;
+  };
+
+  uint64_t firstSeq_; // pending_.front() 的序号
+  std::deque<PendingReply> pending_;
+  Buffer scratch_;
+  bool closing_;      // 已经调用 shutdownAfterDrain，等待排队的回复写完
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include <cmuduo/EventLoop.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*
+ * 每个 subLoop 一份的状态(kv_server 的分片、pubsub_broker 的订阅表)，T 需要有 EventLoop *loop 成员
+ * 在 TcpServer 的 ThreadInitCallback 中调用 init，状态在所属 loop 线程中创建，current() 返回当前 loop 线程的那一份
+ * 所有 subLoop 的 ThreadInitCallback 都在 TcpServer::start 返回前执行完，之后 all() 只读，可以在任意 loop 线程中访问
+ */
+template <typename T>
+class PerLoop {
+public:
+  T *init(EventLoop *loop) {
+    std::unique_ptr<T> state(new T());
+    state->loop = loop;
+    t_current = state.get();
+    std::unique_lock<std::mutex> lock(mutex_);
+    states_.push_back(std::move(state));
+    return t_current;
+  }
+
+  // 当前 loop 线程的状态，不是 subLoop 线程时为空
+  static T *current() { return t_current; }
+
+  const std::vector<std::unique_ptr<T>> &all() const { return states_; }
+  size_t size() const { return states_.size(); }
+
+private:
+  static __thread T *t_current;
+
+  std::mutex mutex_; // 只在 init 中保护 states_
+  std::vector<std::unique_ptr<T>> states_;
+};
+
+template <typename T>
+__thread T *PerLoop<T>::t_current = nullptr;
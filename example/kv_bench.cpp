@@ -0,0 +1,320 @@
+/*
+ * kv_server 的压测工具，工作负载与 redis-benchmark 类似，也可以压测 Redis 本身
+ * 用法: kv_bench [-h host] [-p port] [-c clients] [-n requests] [-P pipeline] [-d dataSize]
+ *                [-r keyspace] [-T threads] [-t tests] [-3]
+ *   -t  逗号分隔的测试：ping,set,get,incr,mset,mget(默认全部)，mset/mget 每条命令 10 个 key
+ *   -r  key 在 [0, keyspace) 中随机取，默认 0 表示所有请求用同一个 key
+ *   -3  连接建立后发送 HELLO 3 切换到 RESP3
+ * 客户端用 TcpClient 分布在 threads 个 loop 上，命令用 RespWriter 直接写入 outputBuffer_，
+ * 回复用 RespReader 解析；每个客户端同时发出 pipeline 条命令，全部回复后再发下一批
+ */
+
+#include <cmuduo/Buffer.h>
+#include <cmuduo/EventLoop.h>
+#include <cmuduo/EventLoopThread.h>
+#include <cmuduo/Logger.h>
+#include <cmuduo/RespCodec.h>
+#include <cmuduo/TcpClient.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+static int64_t nowMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+struct Options {
+  Options()
+      : host("127.0.0.1"), port(6380), clients(50), requests(100000), pipeline(1), dataSize(3),
+        keyspace(0), threads(1), tests("ping,set,get,incr,mset,mget"), resp3(false) {}
+  std::string host;
+  uint16_t port;
+  int clients;
+  int64_t requests;
+  int pipeline;
+  size_t dataSize;
+  int64_t keyspace;
+  int threads;
+  std::string tests;
+  bool resp3;
+};
+
+class Bench;
+
+// 一个客户端连接，只在所属 loop 线程中访问
+struct Client {
+  Bench *bench;
+  size_t worker;
+  std::unique_ptr<TcpClient> tcp;
+  TcpConnectionPtr conn;
+  bool helloPending;  // 等待 HELLO 3 的回复
+  int awaiting;       // 本批还没有收到回复的命令数
+  int64_t sendTime;
+  std::mt19937_64 rng;
+  RespValue reply;
+};
+
+class Bench {
+public:
+  explicit Bench(const Options &options) : options_(options), value_(options.dataSize, 'x') {}
+
+  void run() {
+    for (int i = 0; i < options_.threads; ++i) {
+      threads_.emplace_back(new EventLoopThread());
+      loops_.push_back(threads_.back()->startLoop());
+      latencies_.emplace_back();
+    }
+    connected_ = 0;
+    for (int i = 0; i < options_.clients; ++i) {
+      Client *c = new Client();
+      c->bench = this;
+      c->worker = static_cast<size_t>(i % options_.threads);
+      c->helloPending = options_.resp3;
+      c->awaiting = 0;
+      c->rng.seed(static_cast<uint64_t>(i) * 7919 + 1);
+      c->tcp.reset(new TcpClient(loops_[c->worker], InetAddress(options_.port, options_.host), "KvBench"));
+      c->tcp->setConnectionCallback([this, c](const TcpConnectionPtr &conn) { onConnection(c, conn); });
+      c->tcp->setMessageCallback([this, c](const TcpConnectionPtr &, Buffer *buf, Timestamp) { onMessage(c, buf); });
+      clients_.emplace_back(c);
+      c->tcp->connect();
+    }
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (connected_ < options_.clients) {
+        cond_.wait(lock);
+      }
+    }
+
+    std::string tests = options_.tests + ",";
+    size_t start = 0;
+    size_t comma;
+    while ((comma = tests.find(',', start)) != std::string::npos) {
+      std::string test = tests.substr(start, comma - start);
+      start = comma + 1;
+      if (!test.empty()) {
+        runTest(test);
+      }
+    }
+
+    for (std::unique_ptr<Client> &c : clients_) {
+      c->tcp->disconnect();
+    }
+    ::usleep(100 * 1000);
+  }
+
+private:
+  void onConnection(Client *c, const TcpConnectionPtr &conn) {
+    if (!conn->connected()) {
+      return;
+    }
+    conn->setTcpNoDelay(true);
+    c->conn = conn;
+    if (c->helloPending) {
+      const char *argv[] = {"HELLO", "3"};
+      size_t lens[] = {5, 1};
+      RespWriter::appendCommand(conn->outputBuffer(), 2, argv, lens);
+      conn->flush();
+      return;
+    }
+    markConnected();
+  }
+
+  void markConnected() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ++connected_;
+    cond_.notify_all();
+  }
+
+  void onMessage(Client *c, Buffer *buf) {
+    for (;;) {
+      ssize_t n = RespReader::read(buf->peek(), buf->readableBytes(), &c->reply);
+      if (n == 0) {
+        break;
+      }
+      if (n < 0) {
+        fprintf(stderr, "protocol error from server\n");
+        ::exit(1);
+      }
+      if (c->reply.isError() && !errorReported_.exchange(true)) {
+        fprintf(stderr, "server error: %s\n", c->reply.str.toString().c_str());
+      }
+      buf->retrieve(static_cast<size_t>(n));
+      if (c->helloPending) {
+        c->helloPending = false;
+        markConnected();
+        continue;
+      }
+      if (--c->awaiting == 0) {
+        latencies_[c->worker].push_back(nowMicros() - c->sendTime);
+        sendBatch(c);
+      }
+    }
+  }
+
+  // 领取并发送下一批命令，请求数用完时结束
+  void sendBatch(Client *c) {
+    int64_t claimed = issued_.fetch_add(options_.pipeline);
+    int64_t count = std::min<int64_t>(options_.pipeline, options_.requests - claimed);
+    if (count <= 0) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (++finishedClients_ == options_.clients) {
+        cond_.notify_all();
+      }
+      return;
+    }
+    Buffer *out = c->conn->outputBuffer();
+    for (int64_t i = 0; i < count; ++i) {
+      appendCommand(c, out);
+    }
+    c->awaiting = static_cast<int>(count);
+    c->sendTime = nowMicros();
+    c->conn->flush();
+  }
+
+  void appendCommand(Client *c, Buffer *out) {
+    const char *argv[21];
+    size_t lens[21];
+    char keys[10][32];
+    int keyCount = (test_ == "mset" || test_ == "mget") ? 10 : 1;
+    for (int k = 0; k < keyCount; ++k) {
+      int64_t id = options_.keyspace > 0 ? static_cast<int64_t>(c->rng() % options_.keyspace) : 0;
+      ::snprintf(keys[k], sizeof(keys[k]), "key:%012lld", static_cast<long long>(id));
+    }
+    size_t argc = 0;
+    if (test_ == "ping") {
+      argv[argc] = "PING";
+      lens[argc++] = 4;
+    } else if (test_ == "set" || test_ == "get" || test_ == "incr") {
+      argv[argc] = test_ == "set" ? "SET" : (test_ == "get" ? "GET" : "INCR");
+      lens[argc] = ::strlen(argv[argc]);
+      ++argc;
+      argv[argc] = test_ == "incr" ? "counter:rand" : keys[0];
+      lens[argc] = ::strlen(argv[argc]);
+      ++argc;
+      if (test_ == "set") {
+        argv[argc] = value_.data();
+        lens[argc++] = value_.size();
+      }
+    } else {
+      bool mset = test_ == "mset";
+      argv[argc] = mset ? "MSET" : "MGET";
+      lens[argc++] = 4;
+      for (int k = 0; k < keyCount; ++k) {
+        argv[argc] = keys[k];
+        lens[argc++] = ::strlen(keys[k]);
+        if (mset) {
+          argv[argc] = value_.data();
+          lens[argc++] = value_.size();
+        }
+      }
+    }
+    RespWriter::appendCommand(out, argc, argv, lens);
+  }
+
+  void runTest(const std::string &test) {
+    if (test != "ping" && test != "set" && test != "get" && test != "incr" && test != "mset" && test != "mget") {
+      fprintf(stderr, "unknown test %s\n", test.c_str());
+      return;
+    }
+    test_ = test;
+    issued_ = 0;
+    finishedClients_ = 0;
+    for (size_t i = 0; i < loops_.size(); ++i) {
+      // 在各自的 loop 中清空，避免与上一个测试的回调竞争
+      std::promise<void> cleared;
+      loops_[i]->runInLoop([this, i, &cleared]() {
+        latencies_[i].clear();
+        cleared.set_value();
+      });
+      cleared.get_future().wait();
+    }
+    int64_t start = nowMicros();
+    for (std::unique_ptr<Client> &c : clients_) {
+      Client *client = c.get();
+      loops_[client->worker]->runInLoop([this, client]() { sendBatch(client); });
+    }
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (finishedClients_ < options_.clients) {
+        cond_.wait(lock);
+      }
+    }
+    double elapsed = (nowMicros() - start) / 1e6;
+
+    std::vector<int64_t> all;
+    for (size_t i = 0; i < loops_.size(); ++i) {
+      std::promise<void> copied;
+      loops_[i]->runInLoop([this, i, &all, &copied]() {
+        all.insert(all.end(), latencies_[i].begin(), latencies_[i].end());
+        copied.set_value();
+      });
+      copied.get_future().wait();
+    }
+    std::sort(all.begin(), all.end());
+    auto percentile = [&all](double p) {
+      return all.empty() ? 0.0 : all[std::min(all.size() - 1, static_cast<size_t>(all.size() * p))] / 1000.0;
+    };
+    std::string name = test;
+    std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+    printf("%-6s %12.2f requests/s  latency(ms) p50 %.3f  p95 %.3f  p99 %.3f  max %.3f\n", name.c_str(),
+           options_.requests / elapsed, percentile(0.50), percentile(0.95), percentile(0.99),
+           all.empty() ? 0.0 : all.back() / 1000.0);
+  }
+
+  const Options options_;
+  const std::string value_;
+  std::vector<std::unique_ptr<EventLoopThread>> threads_;
+  std::vector<EventLoop *> loops_;
+  std::vector<std::unique_ptr<Client>> clients_;
+  std::vector<std::vector<int64_t>> latencies_; // 每个 loop 一个，只在该 loop 中写
+  std::string test_;                            // 测试开始前设置，测试期间只读
+  std::atomic<int64_t> issued_;
+  std::atomic<bool> errorReported_{false};
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  int connected_;
+  int finishedClients_;
+};
+
+int main(int argc, char *argv[]) {
+  Options options;
+  int opt;
+  while ((opt = ::getopt(argc, argv, "h:p:c:n:P:d:r:T:t:3")) != -1) {
+    switch (opt) {
+      case 'h': options.host = optarg; break;
+      case 'p': options.port = static_cast<uint16_t>(atoi(optarg)); break;
+      case 'c': options.clients = std::max(1, atoi(optarg)); break;
+      case 'n': options.requests = atoll(optarg); break;
+      case 'P': options.pipeline = std::max(1, atoi(optarg)); break;
+      case 'd': options.dataSize = static_cast<size_t>(atoi(optarg)); break;
+      case 'r': options.keyspace = atoll(optarg); break;
+      case 'T': options.threads = std::max(1, atoi(optarg)); break;
+      case 't': options.tests = optarg; break;
+      case '3': options.resp3 = true; break;
+      default:
+        fprintf(stderr, "usage: %s [-h host] [-p port] [-c clients] [-n requests] [-P pipeline] [-d dataSize] "
+                        "[-r keyspace] [-T threads] [-t tests] [-3]\n", argv[0]);
+        return 1;
+    }
+  }
+  ::signal(SIGPIPE, SIG_IGN);
+  Logger::setLogLevel(ERROR);
+  Bench bench(options);
+  bench.run();
+  return 0;
+}
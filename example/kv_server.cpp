@@ -0,0 +1,482 @@
+/*
+ * 按 EventLoop 分片的内存 KV 服务器，使用 Redis 协议(RESP2/RESP3)，可以用 redis-cli 或 kv_bench 访问
+ * 用法: kv_server [port] [threads]
+ *
+ * 每个 subLoop 拥有一个分片(一个 unordered_map)，key 按哈希分到各个分片，分片只在所属 loop 线程中访问，没有全局锁
+ * 连接所在 loop 的分片上的命令就地执行，回复直接写入 outputBuffer_；其他分片上的命令拷贝参数后
+ * queueInLoop 到分片所属的 loop 执行，回复再 queueInLoop 回连接所在的 loop
+ * 同一连接上流水线中的命令可能在不同分片上乱序完成，回复按命令顺序排队后写出
+ * MGET/MSET/DEL/EXISTS 按分片拆开并行执行后汇总，DBSIZE/FLUSHALL 作用于所有分片
+ *
+ * 支持的命令：PING ECHO GET SET(不支持过期选项) SETNX GETSET APPEND STRLEN INCR DECR INCRBY DECRBY
+ *             MGET MSET DEL EXISTS DBSIZE FLUSHALL HELLO SELECT COMMAND CONFIG QUIT
+ */
+
+#include <cmuduo/Buffer.h>
+#include <cmuduo/EventLoop.h>
+#include <cmuduo/Logger.h>
+#include <cmuduo/RespCodec.h>
+#include <cmuduo/TcpServer.h>
+
+#include "OrderedReplies.h"
+#include "PerLoop.h"
+
+#include <errno.h>
+#include <functional>
+#include <limits.h>
+#include <memory>
+#include <stdlib.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class KvServer {
+public:
+  KvServer(EventLoop *loop, const InetAddress &addr, int numThreads)
+      : server_(loop, addr, "KvServer") {
+    server_.setThreadNum(numThreads);
+    server_.setAutoCork(true);
+    // 其他分片的回复可能在之后的几轮循环中陆续写出，关闭 Nagle，避免与客户端的延迟 ACK 叠加出几十毫秒的延迟
+    SocketOptions options;
+    options.tcpNoDelay = true;
+    server_.setSocketOptions(options);
+    server_.setThreadInitCallback(std::bind(&KvServer::initShard, this, std::placeholders::_1));
+    server_.setConnectionCallback(std::bind(&KvServer::onConnection, this, std::placeholders::_1));
+  }
+
+  void start() {
+    server_.start();
+    LOG_INFO("KvServer started with %zu shards\n", shards_.size());
+  }
+
+private:
+  struct Shard {
+    EventLoop *loop;
+    std::unordered_map<std::string, std::string> data;
+    std::string key; // 查找用的临时 key，复用容量
+  };
+
+  struct Session {
+    Session() : protocol(2) {}
+    RespCommandParser parser;
+    RespCommand command;
+    int protocol;           // HELLO 协商的协议版本
+    OrderedReplies replies; // 其他分片上的命令异步完成，回复按命令顺序写出
+  };
+  using SessionPtr = std::shared_ptr<Session>;
+
+  // 多 key 命令在各个分片上的执行状态，各分片只写属于自己的 key 的结果
+  struct Gather {
+    enum Kind { kMGet, kMSet, kDel, kExists, kDbSize, kFlushAll };
+    Kind kind;
+    int protocol;
+    std::vector<std::string> args;
+    std::vector<std::pair<bool, std::string>> values; // MGET 的结果，按 key 的顺序
+    int64_t count;                                    // DEL/EXISTS/DBSIZE 的合计
+    size_t remaining;                                 // 还没有完成的分片数
+  };
+  using GatherPtr = std::shared_ptr<Gather>;
+
+  void initShard(EventLoop *loop) { shards_.init(loop); }
+
+  Shard *shardOf(const RespSlice &key) const {
+    // FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < key.size; ++i) {
+      h = (h ^ static_cast<unsigned char>(key.data[i])) * 1099511628211ULL;
+    }
+    return shards_.all()[h % shards_.size()].get();
+  }
+
+  void onConnection(const TcpConnectionPtr &conn) {
+    if (!conn->connected()) {
+      return;
+    }
+    SessionPtr session = std::make_shared<Session>();
+    conn->setMessageCallback([this, session](const TcpConnectionPtr &c, Buffer *buf, Timestamp) {
+      onMessage(c, session, buf);
+    });
+  }
+
+  void onMessage(const TcpConnectionPtr &conn, const SessionPtr &session, Buffer *buf) {
+    while (conn->connected()) {
+      if (session->replies.closing()) {
+        buf->retrieveAll(); // QUIT 或协议错误之后的命令不再执行
+        break;
+      }
+      RespCommandParser::Result result = session->parser.parse(buf, &session->command);
+      if (result == RespCommandParser::kNeedMore) {
+        break;
+      }
+      if (result == RespCommandParser::kError) {
+        Buffer *out = session->replies.begin(conn);
+        RespWriter::appendError(out, (std::string("ERR ") + session->parser.error()).c_str());
+        session->replies.end(out);
+        session->replies.shutdownAfterDrain(conn);
+        buf->retrieveAll();
+        return;
+      }
+      if (session->command.argc() > 0) {
+        execute(conn, session);
+      }
+      buf->retrieve(session->parser.consumed());
+      session->parser.reset();
+      session->command.reset();
+    }
+    conn->flush();
+  }
+
+  // 在连接所在的 loop 中执行：填入序号为 seq 的回复，按顺序写出已经完成的回复
+  static void completeReply(const std::weak_ptr<TcpConnection> &weakConn, const std::weak_ptr<Session> &weakSession,
+                            uint64_t seq, std::string &reply) {
+    TcpConnectionPtr conn = weakConn.lock();
+    SessionPtr session = weakSession.lock();
+    if (!conn || !session || !conn->connected()) {
+      return;
+    }
+    session->replies.complete(conn, seq, reply);
+  }
+
+  void execute(const TcpConnectionPtr &conn, const SessionPtr &session) {
+    const RespCommand &cmd = session->command;
+    size_t argc = cmd.argc();
+    if (cmd.is("MGET") || cmd.is("MSET") || cmd.is("DEL") || cmd.is("EXISTS") || cmd.is("DBSIZE") ||
+        cmd.is("FLUSHALL")) {
+      executeGather(conn, session);
+      return;
+    }
+    if (isKeyCommand(cmd) && argc >= 2) {
+      Shard *shard = shardOf(cmd.arg(1));
+      if (shard != shards_.current()) {
+        forward(conn, session, shard);
+        return;
+      }
+    }
+    Buffer *out = session->replies.begin(conn);
+    if (cmd.is("PING")) {
+      if (argc > 1) {
+        RespWriter::appendBulkString(out, cmd.arg(1).data, cmd.arg(1).size);
+      } else {
+        RespWriter::appendSimpleString(out, "PONG");
+      }
+    } else if (cmd.is("ECHO") && argc == 2) {
+      RespWriter::appendBulkString(out, cmd.arg(1).data, cmd.arg(1).size);
+    } else if (cmd.is("HELLO")) {
+      hello(session.get(), out);
+    } else if (cmd.is("SELECT") || cmd.is("QUIT")) {
+      RespWriter::appendSimpleString(out, "OK");
+      if (cmd.is("QUIT")) {
+        session->replies.end(out);
+        session->replies.shutdownAfterDrain(conn);
+        return;
+      }
+    } else if (cmd.is("COMMAND") || cmd.is("CONFIG")) {
+      // redis-benchmark/redis-cli 启动时会发送，返回空数组
+      RespWriter::appendArrayHeader(out, 0);
+    } else if (isKeyCommand(cmd)) {
+      // 单 key 命令最多 3 个参数，参数过多时 executeKeyCommand 只检查 argc 后回复错误
+      RespSlice args[3];
+      for (size_t i = 0; i < argc && i < 3; ++i) {
+        args[i] = cmd.arg(i);
+      }
+      executeKeyCommand(shards_.current(), args, argc, session->protocol, out);
+    } else {
+      std::string name = cmd.arg(0).toString();
+      RespWriter::appendError(out, ("ERR unknown command '" + name + "'").c_str());
+    }
+    session->replies.end(out);
+  }
+
+  static bool isKeyCommand(const RespCommand &cmd) {
+    return cmd.is("GET") || cmd.is("SET") || cmd.is("SETNX") || cmd.is("GETSET") || cmd.is("APPEND") ||
+           cmd.is("STRLEN") || cmd.is("INCR") || cmd.is("DECR") || cmd.is("INCRBY") || cmd.is("DECRBY");
+  }
+
+  void hello(Session *session, Buffer *out) {
+    const RespCommand &cmd = session->command;
+    if (cmd.argc() > 1) {
+      int protocol = atoi(cmd.arg(1).toString().c_str());
+      if (protocol != 2 && protocol != 3) {
+        RespWriter::appendError(out, "NOPROTO unsupported protocol version");
+        return;
+      }
+      session->protocol = protocol;
+    }
+    RespWriter::appendMapHeader(out, 3, session->protocol);
+    RespWriter::appendBulkString(out, std::string("server"));
+    RespWriter::appendBulkString(out, std::string("cmuduo-kv"));
+    RespWriter::appendBulkString(out, std::string("proto"));
+    RespWriter::appendInteger(out, session->protocol);
+    RespWriter::appendBulkString(out, std::string("mode"));
+    RespWriter::appendBulkString(out, std::string("standalone"));
+  }
+
+  // 在其他分片上执行单 key 命令
+  void forward(const TcpConnectionPtr &conn, const SessionPtr &session, Shard *shard) {
+    const RespCommand &cmd = session->command;
+    std::vector<std::string> args(cmd.argc());
+    for (size_t i = 0; i < cmd.argc(); ++i) {
+      args[i] = cmd.arg(i).toString();
+    }
+    uint64_t seq = session->replies.reserve();
+    int protocol = session->protocol;
+    EventLoop *owner = conn->getLoop();
+    std::weak_ptr<TcpConnection> weakConn(conn);
+    std::weak_ptr<Session> weakSession(session);
+    shard->loop->queueInLoop([shard, args, protocol, owner, weakConn, weakSession, seq]() {
+      std::vector<RespSlice> slices(args.size());
+      for (size_t i = 0; i < args.size(); ++i) {
+        slices[i] = RespSlice(args[i].data(), args[i].size());
+      }
+      Buffer out;
+      executeKeyCommand(shard, slices.data(), slices.size(), protocol, &out);
+      std::string reply = out.retrieveAllAsString();
+      owner->queueInLoop([weakConn, weakSession, seq, reply]() mutable {
+        completeReply(weakConn, weakSession, seq, reply);
+      });
+    });
+  }
+
+  static void wrongArgs(Buffer *out, const RespSlice &name) {
+    RespWriter::appendError(out, ("ERR wrong number of arguments for '" + name.toString() + "' command").c_str());
+  }
+
+  // 在 shard 所属的 loop 中执行单 key 命令
+  static void executeKeyCommand(Shard *shard, const RespSlice *args, size_t argc, int protocol, Buffer *out) {
+    const RespSlice &name = args[0];
+    shard->key.assign(args[1].data, args[1].size);
+    std::unordered_map<std::string, std::string> &data = shard->data;
+    if (name.equalsIgnoreCase("GET")) {
+      if (argc != 2) {
+        return wrongArgs(out, name);
+      }
+      auto it = data.find(shard->key);
+      if (it == data.end()) {
+        RespWriter::appendNull(out, protocol);
+      } else {
+        RespWriter::appendBulkString(out, it->second);
+      }
+    } else if (name.equalsIgnoreCase("SET") || name.equalsIgnoreCase("SETNX") || name.equalsIgnoreCase("GETSET")) {
+      if (argc != 3) {
+        return wrongArgs(out, name);
+      }
+      auto it = data.find(shard->key);
+      if (name.equalsIgnoreCase("SETNX")) {
+        if (it == data.end()) {
+          data[shard->key].assign(args[2].data, args[2].size);
+        }
+        RespWriter::appendInteger(out, it == data.end() ? 1 : 0);
+        return;
+      }
+      if (name.equalsIgnoreCase("GETSET")) {
+        if (it == data.end()) {
+          RespWriter::appendNull(out, protocol);
+        } else {
+          RespWriter::appendBulkString(out, it->second);
+        }
+      }
+      if (it == data.end()) {
+        data[shard->key].assign(args[2].data, args[2].size);
+      } else {
+        it->second.assign(args[2].data, args[2].size);
+      }
+      if (name.equalsIgnoreCase("SET")) {
+        RespWriter::appendSimpleString(out, "OK");
+      }
+    } else if (name.equalsIgnoreCase("APPEND")) {
+      if (argc != 3) {
+        return wrongArgs(out, name);
+      }
+      std::string &value = data[shard->key];
+      value.append(args[2].data, args[2].size);
+      RespWriter::appendInteger(out, static_cast<int64_t>(value.size()));
+    } else if (name.equalsIgnoreCase("STRLEN")) {
+      if (argc != 2) {
+        return wrongArgs(out, name);
+      }
+      auto it = data.find(shard->key);
+      RespWriter::appendInteger(out, it == data.end() ? 0 : static_cast<int64_t>(it->second.size()));
+    } else {
+      // INCR/DECR/INCRBY/DECRBY
+      bool by = name.equalsIgnoreCase("INCRBY") || name.equalsIgnoreCase("DECRBY");
+      if (argc != (by ? 3u : 2u)) {
+        return wrongArgs(out, name);
+      }
+      char *end = nullptr;
+      std::string deltaString = by ? args[2].toString() : "1";
+      errno = 0;
+      long long delta = ::strtoll(deltaString.c_str(), &end, 10);
+      if (*end != '\0' || deltaString.empty() || errno == ERANGE) {
+        return RespWriter::appendError(out, "ERR value is not an integer or out of range");
+      }
+      if (name.equalsIgnoreCase("DECR") || name.equalsIgnoreCase("DECRBY")) {
+        if (delta == LLONG_MIN) {
+          return RespWriter::appendError(out, "ERR decrement would overflow");
+        }
+        delta = -delta;
+      }
+      std::string &value = data[shard->key];
+      long long current = 0;
+      if (!value.empty()) {
+        current = ::strtoll(value.c_str(), &end, 10);
+        if (*end != '\0' || errno == ERANGE) {
+          return RespWriter::appendError(out, "ERR value is not an integer or out of range");
+        }
+      }
+      // 先检查再相加，有符号溢出是未定义行为
+      if ((delta > 0 && current > LLONG_MAX - delta) || (delta < 0 && current < LLONG_MIN - delta)) {
+        return RespWriter::appendError(out, "ERR increment or decrement would overflow");
+      }
+      current += delta;
+      value = std::to_string(current);
+      RespWriter::appendInteger(out, current);
+    }
+  }
+
+  void executeGather(const TcpConnectionPtr &conn, const SessionPtr &session) {
+    const RespCommand &cmd = session->command;
+    GatherPtr gather = std::make_shared<Gather>();
+    size_t firstKey = 1;
+    size_t step = 1;
+    if (cmd.is("MGET")) {
+      gather->kind = Gather::kMGet;
+    } else if (cmd.is("MSET")) {
+      gather->kind = Gather::kMSet;
+      step = 2;
+    } else if (cmd.is("DEL")) {
+      gather->kind = Gather::kDel;
+    } else if (cmd.is("EXISTS")) {
+      gather->kind = Gather::kExists;
+    } else if (cmd.is("DBSIZE")) {
+      gather->kind = Gather::kDbSize;
+    } else {
+      gather->kind = Gather::kFlushAll;
+    }
+    bool allShards = gather->kind == Gather::kDbSize || gather->kind == Gather::kFlushAll;
+    size_t argc = cmd.argc();
+    if ((!allShards && argc < 2) || (step == 2 && argc % 2 != 1)) {
+      Buffer *out = session->replies.begin(conn);
+      wrongArgs(out, cmd.arg(0));
+      session->replies.end(out);
+      return;
+    }
+    gather->protocol = session->protocol;
+    gather->args.resize(argc);
+    for (size_t i = 0; i < argc; ++i) {
+      gather->args[i] = cmd.arg(i).toString();
+    }
+    gather->count = 0;
+    if (gather->kind == Gather::kMGet) {
+      gather->values.resize(argc - 1);
+    }
+
+    // 按分片分组 key 的下标
+    std::unordered_map<Shard *, std::vector<size_t>> groups;
+    if (allShards) {
+      for (const std::unique_ptr<Shard> &shard : shards_.all()) {
+        groups[shard.get()];
+      }
+    } else {
+      for (size_t i = firstKey; i < argc; i += step) {
+        groups[shardOf(cmd.arg(i))].push_back(i);
+      }
+    }
+    gather->remaining = groups.size();
+    uint64_t seq = session->replies.reserve();
+    EventLoop *owner = conn->getLoop();
+    std::weak_ptr<TcpConnection> weakConn(conn);
+    std::weak_ptr<Session> weakSession(session);
+    for (auto &group : groups) {
+      Shard *shard = group.first;
+      std::vector<size_t> keys;
+      keys.swap(group.second);
+      // 其他 loop 上的分片 queueInLoop 过去执行，与连接同一个 loop 的分片由 runInLoop 直接执行；
+      // 各分片的结果都 queueInLoop 回 owner 统一汇总，所以汇总总是在所有分片执行之后进行
+      shard->loop->runInLoop([shard, keys, gather, owner, weakConn, weakSession, seq]() {
+        int64_t partial = executePartial(shard, gather.get(), keys);
+        owner->queueInLoop([gather, partial, weakConn, weakSession, seq]() {
+          gather->count += partial;
+          if (--gather->remaining == 0) {
+            Buffer out;
+            finishGather(gather.get(), &out);
+            std::string reply = out.retrieveAllAsString();
+            completeReply(weakConn, weakSession, seq, reply);
+          }
+        });
+      });
+    }
+  }
+
+  // 在分片所属的 loop 中执行多 key 命令中属于这个分片的部分，返回计数
+  static int64_t executePartial(Shard *shard, Gather *gather, const std::vector<size_t> &keys) {
+    std::unordered_map<std::string, std::string> &data = shard->data;
+    int64_t count = 0;
+    switch (gather->kind) {
+      case Gather::kMGet:
+        for (size_t i : keys) {
+          auto it = data.find(gather->args[i]);
+          if (it != data.end()) {
+            gather->values[i - 1] = std::make_pair(true, it->second);
+          }
+        }
+        break;
+      case Gather::kMSet:
+        for (size_t i : keys) {
+          data[gather->args[i]] = gather->args[i + 1];
+        }
+        break;
+      case Gather::kDel:
+        for (size_t i : keys) {
+          count += static_cast<int64_t>(data.erase(gather->args[i]));
+        }
+        break;
+      case Gather::kExists:
+        for (size_t i : keys) {
+          count += data.count(gather->args[i]) ? 1 : 0;
+        }
+        break;
+      case Gather::kDbSize:
+        count = static_cast<int64_t>(data.size());
+        break;
+      case Gather::kFlushAll:
+        data.clear();
+        break;
+    }
+    return count;
+  }
+
+  static void finishGather(const Gather *gather, Buffer *out) {
+    switch (gather->kind) {
+      case Gather::kMGet:
+        RespWriter::appendArrayHeader(out, gather->values.size());
+        for (const std::pair<bool, std::string> &value : gather->values) {
+          if (value.first) {
+            RespWriter::appendBulkString(out, value.second);
+          } else {
+            RespWriter::appendNull(out, gather->protocol);
+          }
+        }
+        break;
+      case Gather::kMSet:
+      case Gather::kFlushAll:
+        RespWriter::appendSimpleString(out, "OK");
+        break;
+      default:
+        RespWriter::appendInteger(out, gather->count);
+        break;
+    }
+  }
+
+  TcpServer server_;
+  PerLoop<Shard> shards_; // 每个 subLoop 一个分片
+};
+
+int main(int argc, char *argv[]) {
+  uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 6380);
+  int threads = argc > 2 ? atoi(argv[2]) : 4;
+  EventLoop loop;
+  KvServer server(&loop, InetAddress(port), threads);
+  server.start();
+  loop.loop();
+  return 0;
+}
@@ -0,0 +1,304 @@
+/*
+ * 按主题发布/订阅的消息代理，使用 Redis 的 pub/sub 协议(RESP2)，可以用 redis-cli 访问
+ * 用法: pubsub_broker [port] [threads]
+ *   redis-cli -p 6380 subscribe news
+ *   redis-cli -p 6380 publish news hello
+ *
+ * 订阅关系按 loop 保存：每个 subLoop 有自己的 主题 → 订阅者 表，只记录本 loop 上的连接，只在本 loop 线程中访问
+ * PUBLISH 把消息编码成一个 PayloadSlice，每个 loop 只 queueInLoop 一次，由该 loop 遍历本地的订阅者，
+ * 各连接的发送队列引用同一份编码好的消息，不拷贝；一次广播的跨线程投递和内存与 loop 数成正比，与订阅者数无关
+ * PUBLISH 的回复是收到消息的订阅者数，最后一个完成投递的 loop 把回复交回发布者所在的 loop
+ * 发送队列积压超过 kMaxSubscriberBacklog 的慢订阅者被断开(与 Redis 的 client-output-buffer-limit pubsub 相同)
+ *
+ * 支持的命令：SUBSCRIBE UNSUBSCRIBE PUBLISH PING QUIT
+ */
+
+#include <cmuduo/Buffer.h>
+#include <cmuduo/EventLoop.h>
+#include <cmuduo/Logger.h>
+#include <cmuduo/PayloadSlice.h>
+#include <cmuduo/RespCodec.h>
+#include <cmuduo/TcpServer.h>
+
+#include "OrderedReplies.h"
+#include "PerLoop.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <stdlib.h>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class PubSubBroker {
+public:
+  static const size_t kMaxSubscriberBacklog = 32 * 1024 * 1024;
+
+  PubSubBroker(EventLoop *loop, const InetAddress &addr, int numThreads)
+      : server_(loop, addr, "PubSubBroker") {
+    server_.setThreadNum(numThreads);
+    // 同一轮循环中投递给同一订阅者的多条消息合并成一次 writev
+    server_.setAutoCork(true);
+    SocketOptions options;
+    options.tcpNoDelay = true;
+    server_.setSocketOptions(options);
+    server_.setThreadInitCallback(std::bind(&PubSubBroker::initLoop, this, std::placeholders::_1));
+    server_.setConnectionCallback(std::bind(&PubSubBroker::onConnection, this, std::placeholders::_1));
+  }
+
+  void start() {
+    server_.start();
+    LOG_INFO("PubSubBroker started with %zu loops\n", loops_.size());
+  }
+
+private:
+  // 一个 loop 上的订阅关系
+  struct LoopTopics {
+    EventLoop *loop;
+    std::unordered_map<std::string, std::vector<TcpConnectionPtr>> subscribers;
+  };
+
+  struct Session {
+    RespCommandParser parser;
+    RespCommand command;
+    std::unordered_set<std::string> topics; // 本连接订阅的主题
+    OrderedReplies replies;                 // PUBLISH 的回复等各 loop 投递完成后才能写出，之后的回复排在它后面
+  };
+  using SessionPtr = std::shared_ptr<Session>;
+
+  // 一次广播：所有 loop 共享同一份编码好的消息
+  struct Fanout {
+    std::string topic;
+    PayloadSlice message;
+    std::atomic<int64_t> receivers;
+    std::atomic<size_t> remaining;   // 还没有完成投递的 loop 数
+    EventLoop *owner;                // 发布者所在的 loop
+    std::weak_ptr<TcpConnection> publisher;
+    std::weak_ptr<Session> session;
+    uint64_t seq;
+  };
+  using FanoutPtr = std::shared_ptr<Fanout>;
+
+  void initLoop(EventLoop *loop) { loops_.init(loop); }
+
+  // 当前 loop 线程的订阅关系
+  static LoopTopics *localTopics() { return PerLoop<LoopTopics>::current(); }
+
+  void onConnection(const TcpConnectionPtr &conn) {
+    if (!conn->connected()) {
+      return;
+    }
+    SessionPtr session = std::make_shared<Session>();
+    conn->setMessageCallback([this, session](const TcpConnectionPtr &c, Buffer *buf, Timestamp) {
+      onMessage(c, session, buf);
+    });
+    // 连接关闭时从本 loop 的订阅表中移除；连接回调在连接所在的 loop 中执行
+    conn->setConnectionCallback([session](const TcpConnectionPtr &c) {
+      if (!c->connected()) {
+        for (const std::string &topic : session->topics) {
+          removeSubscriber(topic, c);
+        }
+        session->topics.clear();
+      }
+    });
+  }
+
+  void onMessage(const TcpConnectionPtr &conn, const SessionPtr &session, Buffer *buf) {
+    while (conn->connected()) {
+      if (session->replies.closing()) {
+        buf->retrieveAll(); // QUIT 或协议错误之后的命令不再执行
+        break;
+      }
+      RespCommandParser::Result result = session->parser.parse(buf, &session->command);
+      if (result == RespCommandParser::kNeedMore) {
+        break;
+      }
+      if (result == RespCommandParser::kError) {
+        Buffer *out = session->replies.begin(conn);
+        RespWriter::appendError(out, (std::string("ERR ") + session->parser.error()).c_str());
+        session->replies.end(out);
+        session->replies.shutdownAfterDrain(conn);
+        buf->retrieveAll();
+        return;
+      }
+      if (session->command.argc() > 0) {
+        execute(conn, session);
+      }
+      buf->retrieve(session->parser.consumed());
+      session->parser.reset();
+      session->command.reset();
+    }
+    conn->flush();
+  }
+
+  void execute(const TcpConnectionPtr &conn, const SessionPtr &session) {
+    const RespCommand &cmd = session->command;
+    size_t argc = cmd.argc();
+    if (cmd.is("PUBLISH") && argc == 3) {
+      publish(conn, session);
+      return;
+    }
+    Buffer *out = session->replies.begin(conn);
+    if (cmd.is("SUBSCRIBE") && argc >= 2) {
+      for (size_t i = 1; i < argc; ++i) {
+        std::string topic = cmd.arg(i).toString();
+        if (session->topics.insert(topic).second) {
+          localTopics()->subscribers[topic].push_back(conn);
+        }
+        appendSubscription(out, "subscribe", &topic, session->topics.size());
+      }
+    } else if (cmd.is("UNSUBSCRIBE")) {
+      std::vector<std::string> topics;
+      if (argc == 1) {
+        topics.assign(session->topics.begin(), session->topics.end());
+      }
+      for (size_t i = 1; i < argc; ++i) {
+        topics.push_back(cmd.arg(i).toString());
+      }
+      if (topics.empty()) {
+        appendSubscription(out, "unsubscribe", nullptr, 0);
+      }
+      for (const std::string &topic : topics) {
+        if (session->topics.erase(topic) > 0) {
+          removeSubscriber(topic, conn);
+        }
+        appendSubscription(out, "unsubscribe", &topic, session->topics.size());
+      }
+    } else if (cmd.is("PING")) {
+      if (argc > 1) {
+        RespWriter::appendBulkString(out, cmd.arg(1).data, cmd.arg(1).size);
+      } else {
+        RespWriter::appendSimpleString(out, "PONG");
+      }
+    } else if (cmd.is("QUIT")) {
+      RespWriter::appendSimpleString(out, "OK");
+      session->replies.end(out);
+      session->replies.shutdownAfterDrain(conn);
+      return;
+    } else if (cmd.is("COMMAND")) {
+      // redis-cli 启动时会发送，返回空数组
+      RespWriter::appendArrayHeader(out, 0);
+    } else if (cmd.is("SUBSCRIBE") || cmd.is("PUBLISH")) {
+      RespWriter::appendError(out, ("ERR wrong number of arguments for '" + cmd.arg(0).toString() +
+                                    "' command").c_str());
+    } else {
+      RespWriter::appendError(out, ("ERR unknown command '" + cmd.arg(0).toString() + "'").c_str());
+    }
+    session->replies.end(out);
+  }
+
+  // topic 为空指针时是没有订阅任何主题时的 UNSUBSCRIBE
+  static void appendSubscription(Buffer *out, const char *kind, const std::string *topic, size_t count) {
+    RespWriter::appendArrayHeader(out, 3);
+    RespWriter::appendBulkString(out, std::string(kind));
+    if (topic == nullptr) {
+      RespWriter::appendNull(out, 2);
+    } else {
+      RespWriter::appendBulkString(out, *topic);
+    }
+    RespWriter::appendInteger(out, static_cast<int64_t>(count));
+  }
+
+  // 在连接所在的 loop 中执行
+  static void removeSubscriber(const std::string &topic, const TcpConnectionPtr &conn) {
+    auto &subscribersByTopic = localTopics()->subscribers;
+    auto it = subscribersByTopic.find(topic);
+    if (it == subscribersByTopic.end()) {
+      return;
+    }
+    std::vector<TcpConnectionPtr> &subscribers = it->second;
+    auto pos = std::find(subscribers.begin(), subscribers.end(), conn);
+    if (pos != subscribers.end()) {
+      *pos = std::move(subscribers.back());
+      subscribers.pop_back();
+    }
+    if (subscribers.empty()) {
+      subscribersByTopic.erase(it);
+    }
+  }
+
+  void publish(const TcpConnectionPtr &conn, const SessionPtr &session) {
+    const RespCommand &cmd = session->command;
+    // 消息只编码一次，之后所有 loop、所有订阅者共享
+    Buffer frame;
+    RespWriter::appendArrayHeader(&frame, 3);
+    RespWriter::appendBulkString(&frame, std::string("message"));
+    RespWriter::appendBulkString(&frame, cmd.arg(1).data, cmd.arg(1).size);
+    RespWriter::appendBulkString(&frame, cmd.arg(2).data, cmd.arg(2).size);
+
+    FanoutPtr fanout = std::make_shared<Fanout>();
+    fanout->topic = cmd.arg(1).toString();
+    fanout->message = PayloadSlice::take(&frame);
+    fanout->receivers = 0;
+    fanout->remaining = loops_.size();
+    fanout->owner = conn->getLoop();
+    fanout->publisher = conn;
+    fanout->session = session;
+    fanout->seq = session->replies.reserve();
+
+    for (const std::unique_ptr<LoopTopics> &topics : loops_.all()) {
+      if (topics.get() == localTopics()) {
+        deliver(fanout);
+      } else {
+        topics->loop->queueInLoop(std::bind(&PubSubBroker::deliver, fanout));
+      }
+    }
+  }
+
+  // 在每个 loop 中执行一次：把消息挂到本 loop 所有订阅者的发送队列上
+  static void deliver(const FanoutPtr &fanout) {
+    int64_t receivers = 0;
+    auto &subscribersByTopic = localTopics()->subscribers;
+    auto it = subscribersByTopic.find(fanout->topic);
+    if (it != subscribersByTopic.end()) {
+      for (const TcpConnectionPtr &conn : it->second) {
+        if (conn->pendingBytes() > kMaxSubscriberBacklog) {
+          // 慢订阅者：断开后由连接回调从订阅表中移除，这里不能修改正在遍历的数组
+          LOG_INFO("PubSubBroker: subscriber %s is too slow, %zu bytes pending, closing\n",
+                   conn->name().c_str(), conn->pendingBytes());
+          conn->forceClose();
+          continue;
+        }
+        conn->send(fanout->message);
+        ++receivers;
+      }
+    }
+    fanout->receivers.fetch_add(receivers, std::memory_order_relaxed);
+    if (fanout->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      if (fanout->owner->isInLoopThread()) {
+        completePublish(fanout);
+      } else {
+        fanout->owner->queueInLoop(std::bind(&PubSubBroker::completePublish, fanout));
+      }
+    }
+  }
+
+  // 在发布者所在的 loop 中执行：填入 PUBLISH 的回复，按顺序写出已经完成的回复
+  static void completePublish(const FanoutPtr &fanout) {
+    TcpConnectionPtr conn = fanout->publisher.lock();
+    SessionPtr session = fanout->session.lock();
+    if (!conn || !session || !conn->connected()) {
+      return;
+    }
+    Buffer out;
+    RespWriter::appendInteger(&out, fanout->receivers.load(std::memory_order_relaxed));
+    std::string reply = out.retrieveAllAsString();
+    session->replies.complete(conn, fanout->seq, reply);
+  }
+
+  TcpServer server_;
+  PerLoop<LoopTopics> loops_; // 每个 subLoop 一份订阅关系
+};
+
+int main(int argc, char *argv[]) {
+  uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 6380);
+  int threads = argc > 2 ? atoi(argv[2]) : 4;
+  EventLoop loop;
+  PubSubBroker broker(&loop, InetAddress(port), threads);
+  broker.start();
+  loop.loop();
+  return 0;
+}
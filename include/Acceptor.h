@@ -1,9 +1,12 @@
 #pragma once
 #include "Channel.h"
 #include "Socket.h"
+#include "SocketOptions.h"
 #include "noncopyable.h"
 
 #include <functional>
+#include <string>
+#include <sys/types.h>
 
 /*
  * Acceptor 主要封装了 listenfd 相关的操作(socket、bind、listen)，listen 成功后打包成 acceptChannel 注册在 mainLoop 中监听新连接
@@ -26,16 +29,26 @@ public:
     newConnectionCallback_ = std::move(cb);
   }
 
+  // 在 listen 之前设置监听 socket 的选项
+  void setSocketOptions(const SocketOptions &options) { options_ = options; }
+
   bool listenning() const { return listenning_; }
   void listen();
+  // 停止监听，之后不能再 listen：对监听 socket 执行 shutdown，backlog 中还没 accept 的连接被重置，
+  // 新的连接请求立即被拒绝，客户端可以马上重试其他实例；监听的 Unix 域 socket 文件被删除
+  void stop();
 
 private:
   void handleRead();
+  void removeUnixPath();
 
   // Acceptor 就运行在用户定义的 baseLoop 中，专用于监听 I/O
   EventLoop *loop_;
   Socket acceptSocket_;
+  std::string unixPath_; // 监听 Unix 域 socket 文件时的路径，停止监听或析构时删除
+  ino_t unixInode_;      // bind 创建的 socket 文件的 inode，只删除自己创建的文件
   Channel acceptChannel_;
   NewConnectionCallback newConnectionCallback_; // 有新连接时，执行 TcpServer 提供的回调函数
+  SocketOptions options_;
   bool listenning_;
 };
@@ -0,0 +1,92 @@
+#pragma once
+#include "noncopyable.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string.h>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+
+/*
+ * 异步日志后端(双缓冲)
+ * 前端(各个 loop 线程)调用 append 只把日志行拷贝到当前缓冲区，临界区内没有任何 I/O；
+ * 当前缓冲区写满后移入待写队列，换上备用缓冲区，并唤醒后台线程
+ * 后台线程每隔 flushInterval 秒(或被唤醒时)把当前缓冲区和待写队列整体交换出来，在锁外批量写入 LogFile，
+ * 写完后把缓冲区还给前端复用，稳定运行后不再分配内存
+ * 后台写不过来时前端不会阻塞：待写队列达到 maxPendingBuffers 后新的日志被丢弃并计数，
+ * 后台线程在之后写入一行 "dropped N log messages" 提示丢失
+ *
+ * 用法：
+ *   AsyncLogging log("/var/log/server", 512 * 1024 * 1024);
+ *   log.start();
+ *   Logger::instance().setOutput([&log](int, const char *msg, size_t len) { log.append(msg, len); });
+ *   // LOG_FATAL 退出进程前调用，否则致命错误那一行还在缓冲区中就丢失了
+ *   Logger::instance().setFlush([&log]() { log.flush(); });
+ */
+class AsyncLogging : noncopyable {
+public:
+  static const size_t kBufferSize = 4 * 1024 * 1024;
+
+  AsyncLogging(const std::string &basename, off_t rollSize, int flushInterval = 3,
+               size_t maxPendingBuffers = 16);
+  ~AsyncLogging();
+
+  // 可以在任意线程中调用
+  void append(const char *logline, size_t len);
+
+  // 同步刷新：等后台线程把调用之前 append 的日志全部写入文件并 fflush 后返回
+  // 后台线程没有运行时直接返回
+  void flush();
+
+  void start();
+  // 把已经 append 的日志全部写入文件后停止后台线程，之后的 append 只进入缓冲区，不再写出
+  void stop();
+
+  // 因后台写不过来而丢弃的日志条数
+  int64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+  // 定长缓冲区
+  class Buffer : noncopyable {
+  public:
+    Buffer() : data_(new char[kBufferSize]), cur_(data_.get()) {}
+    size_t avail() const { return static_cast<size_t>(data_.get() + kBufferSize - cur_); }
+    size_t length() const { return static_cast<size_t>(cur_ - data_.get()); }
+    const char *data() const { return data_.get(); }
+    void append(const char *buf, size_t len) {
+      ::memcpy(cur_, buf, len);
+      cur_ += len;
+    }
+    void reset() { cur_ = data_.get(); }
+
+  private:
+    std::unique_ptr<char[]> data_;
+    char *cur_;
+  };
+  using BufferPtr = std::unique_ptr<Buffer>;
+  using BufferVector = std::vector<BufferPtr>;
+
+  void threadFunc();
+
+  const int flushInterval_;
+  const std::string basename_;
+  const off_t rollSize_;
+  const size_t maxPendingBuffers_;
+  std::atomic<bool> running_;
+  std::thread thread_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::condition_variable flushCond_; // 通知 flush 的调用者刷新已经完成
+  int64_t flushRequested_;            // flush 请求的序号，由 mutex_ 保护
+  int64_t flushCompleted_;            // 后台线程已经完成的最大请求序号，由 mutex_ 保护
+  BufferPtr currentBuffer_;  // 前端正在写的缓冲区
+  BufferPtr nextBuffer_;     // 备用缓冲区
+  BufferVector buffers_;     // 写满待写出的缓冲区
+  BufferVector freeBuffers_; // 后台写完后归还的空缓冲区
+  std::atomic<int64_t> dropped_;
+};
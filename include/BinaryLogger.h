@@ -0,0 +1,281 @@
+#pragma once
+#include "Logger.h"
+#include "Timestamp.h"
+#include "noncopyable.h"
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <type_traits>
+
+/*
+ * 二进制日志(延迟格式化)，用于需要在生产环境常开的热路径日志(每个事件、每个连接)
+ * 日志语句所在线程只把调用点 ID、时间戳和原始参数拷贝进本线程的无锁环形缓冲区，不调用 snprintf；
+ * 后台线程按调用点记录的格式串和参数类型还原参数，格式化后交给 Logger 的输出(比如 AsyncLogging)
+ *
+ * 用法：
+ *   BinaryLogger::start();
+ *   LOG_BIN_INFO("fd = %d events = %d", fd, events);
+ * 输出与 LOG_INFO("[%s:%s:%d]\n" fmt, __FILE__, __FUNCTION__, __LINE__, ...) 相同，文件、函数和行号记录在调用点中，
+ * 不随每条日志拷贝；BinaryLogger 没有启动时日志语句退化为同步的 Logger::log
+ *
+ * 参数只支持算术类型、枚举、指针和 C 字符串(按值拷贝，char* 参数拷贝字符串内容)
+ * 各线程的缓冲区互相独立，不同线程的日志之间只保证各自的先后顺序；缓冲区满或单条记录超过缓冲区一半时丢弃日志并计数，不阻塞
+ */
+
+// 一个日志调用点，作为日志语句中的静态对象常量初始化，id 在第一次写日志时分配
+struct BinaryLogSite {
+  constexpr BinaryLogSite(int lvl, const char *fmt, const char *f, const char *fn, int ln)
+      : level(lvl), format(fmt), file(f), function(fn), line(ln), id(0) {}
+
+  const int level;
+  const char *const format;
+  const char *const file;
+  const char *const function;
+  const int line;
+  std::atomic<uint32_t> id;
+};
+
+/*
+ * 单生产者单消费者的字节环形缓冲区，每个写日志的线程一个
+ * head_/tail_ 单调递增，记录按 8 字节对齐且在缓冲区中连续存放，到末尾放不下时写一个填充记录后回绕
+ */
+class BinaryLogRing : noncopyable {
+public:
+  struct Header {
+    uint32_t siteId;   // 0 表示填充记录
+    uint32_t length;   // 整条记录的长度，包括 Header
+    int64_t microSeconds;
+  };
+
+  explicit BinaryLogRing(size_t capacity);
+
+  // 生产者：预留 n 字节(n 已按 8 字节对齐)，空间不足时返回 nullptr 并计入 dropped
+  char *reserve(size_t n) {
+    size_t offset = static_cast<size_t>(head_) & mask_;
+    size_t toEnd = capacity_ - offset;
+    size_t need = toEnd < n ? toEnd + n : n;
+    if (capacity_ - static_cast<size_t>(head_ - cachedTail_) < need) {
+      cachedTail_ = tail_.load(std::memory_order_acquire);
+      if (capacity_ - static_cast<size_t>(head_ - cachedTail_) < need) {
+        countDropped();
+        return nullptr;
+      }
+    }
+    if (toEnd < n) {
+      // 末尾放不下，剩余部分作为填充，不足一个 Header 时消费者自动跳过
+      if (toEnd >= sizeof(Header)) {
+        Header *pad = reinterpret_cast<Header *>(buffer_.get() + offset);
+        pad->siteId = 0;
+        pad->length = static_cast<uint32_t>(toEnd);
+      }
+      head_ += toEnd;
+      offset = 0;
+    }
+    return buffer_.get() + offset;
+  }
+  // 生产者：发布 reserve 得到的 n 字节
+  void commit(size_t n) { published_.store(head_ += n, std::memory_order_release); }
+
+  // 消费者：取出所有已发布的记录，对每条非填充记录调用 f(header)
+  template <typename F>
+  size_t drain(F f) {
+    uint64_t end = published_.load(std::memory_order_acquire);
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    size_t count = 0;
+    while (tail < end) {
+      size_t offset = static_cast<size_t>(tail) & mask_;
+      size_t toEnd = capacity_ - offset;
+      if (toEnd < sizeof(Header)) {
+        tail += toEnd;
+        continue;
+      }
+      const Header *header = reinterpret_cast<const Header *>(buffer_.get() + offset);
+      if (header->siteId != 0) {
+        f(*header);
+        ++count;
+      }
+      tail += header->length;
+    }
+    tail_.store(tail, std::memory_order_release);
+    return count;
+  }
+
+  size_t capacity() const { return capacity_; }
+  // 生产者：记录一条被丢弃的日志(缓冲区满或者记录过长)
+  void countDropped() { dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+  int64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+  // 所属线程已退出，消费者取完剩余记录后即可释放
+  bool closed() const { return closed_.load(std::memory_order_acquire); }
+  void close() { closed_.store(true, std::memory_order_release); }
+
+private:
+  const size_t capacity_;
+  const size_t mask_;
+  std::unique_ptr<char[]> buffer_;
+  // 生产者使用
+  uint64_t head_;
+  uint64_t cachedTail_;
+  std::atomic<int64_t> dropped_;
+  // 生产者和消费者分在不同的 cache line
+  alignas(64) std::atomic<uint64_t> published_;
+  alignas(64) std::atomic<uint64_t> tail_;
+  std::atomic<bool> closed_;
+};
+
+namespace binlog {
+
+// 参数的编码方式：算术类型、枚举和指针按值拷贝，C 字符串拷贝为 长度 + 内容(含 '\0')
+template <typename T>
+struct ArgCodec {
+  static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value,
+                "LOG_BIN_* only supports arithmetic, enum, pointer and C string arguments");
+  using Value = T;
+  static size_t size(T) { return sizeof(T); }
+  static char *encode(char *p, T v) {
+    ::memcpy(p, &v, sizeof(T));
+    return p + sizeof(T);
+  }
+  static const char *decode(const char *p, Value *v) {
+    ::memcpy(v, p, sizeof(T));
+    return p + sizeof(T);
+  }
+};
+
+struct StringCodec {
+  using Value = const char *;
+  static size_t size(const char *s) { return sizeof(uint32_t) + (s != nullptr ? ::strlen(s) : 6) + 1; }
+  static char *encode(char *p, const char *s) {
+    if (s == nullptr) {
+      s = "(null)";
+    }
+    uint32_t len = static_cast<uint32_t>(::strlen(s) + 1);
+    ::memcpy(p, &len, sizeof(len));
+    ::memcpy(p + sizeof(len), s, len);
+    return p + sizeof(len) + len;
+  }
+  static const char *decode(const char *p, Value *v) {
+    uint32_t len;
+    ::memcpy(&len, p, sizeof(len));
+    *v = p + sizeof(len);
+    return p + sizeof(len) + len;
+  }
+};
+
+template <>
+struct ArgCodec<const char *> : StringCodec {};
+template <>
+struct ArgCodec<char *> : StringCodec {};
+
+template <typename T>
+using Codec = ArgCodec<typename std::decay<T>::type>;
+
+inline size_t argsSize() { return 0; }
+template <typename T, typename... Rest>
+size_t argsSize(const T &arg, const Rest &...rest) {
+  return Codec<T>::size(arg) + argsSize(rest...);
+}
+
+inline char *encodeArgs(char *p) { return p; }
+template <typename T, typename... Rest>
+char *encodeArgs(char *p, const T &arg, const Rest &...rest) {
+  return encodeArgs(Codec<T>::encode(p, arg), rest...);
+}
+
+// 按参数类型依次还原参数，全部还原后调用一次 snprintf
+template <typename... Args>
+struct Decoder;
+
+template <>
+struct Decoder<> {
+  template <typename... Vals>
+  static int format(char *buf, size_t len, const BinaryLogSite &site, const char *, Vals... vals) {
+    return ::snprintf(buf, len, site.format, site.file, site.function, site.line, vals...);
+  }
+};
+
+template <typename T, typename... Rest>
+struct Decoder<T, Rest...> {
+  template <typename... Vals>
+  static int format(char *buf, size_t len, const BinaryLogSite &site, const char *p, Vals... vals) {
+    typename Codec<T>::Value v;
+    p = Codec<T>::decode(p, &v);
+    return Decoder<Rest...>::format(buf, len, site, p, vals..., v);
+  }
+};
+
+template <typename... Args>
+int decode(char *buf, size_t len, const BinaryLogSite &site, const char *args) {
+  return Decoder<Args...>::format(buf, len, site, args);
+}
+
+} // namespace binlog
+
+class BinaryLogger : noncopyable {
+public:
+  using DecodeFunc = int (*)(char *buf, size_t len, const BinaryLogSite &site, const char *args);
+
+  static const size_t kDefaultRingSize = 1024 * 1024;
+
+  // 启动后台格式化线程，ringSize 是之后每个写日志线程的缓冲区大小(向上取整为 2 的幂)
+  static void start(size_t ringSize = kDefaultRingSize);
+  // 格式化并输出所有已写入的日志后停止后台线程，之后的日志退化为同步输出
+  static void stop();
+  static bool active() { return active_.load(std::memory_order_relaxed); }
+  // 所有线程因缓冲区满或单条记录超过缓冲区一半而丢弃的日志条数
+  static int64_t dropped();
+
+  template <typename... Args>
+  static void log(BinaryLogSite &site, const Args &...args) {
+    uint32_t id = site.id.load(std::memory_order_acquire);
+    if (id == 0) {
+      id = registerSite(&site, &binlog::decode<Args...>);
+    }
+    size_t length = (sizeof(BinaryLogRing::Header) + binlog::argsSize(args...) + 7) & ~size_t(7);
+    BinaryLogRing *ring = threadRing();
+    if (ring == nullptr) {
+      return;
+    }
+    if (length > ring->capacity() / 2) {
+      ring->countDropped();
+      return;
+    }
+    char *p = ring->reserve(length);
+    if (p == nullptr) {
+      return;
+    }
+    BinaryLogRing::Header *header = reinterpret_cast<BinaryLogRing::Header *>(p);
+    header->siteId = id;
+    header->length = static_cast<uint32_t>(length);
+    header->microSeconds = Timestamp::now().microSecondsSinceEpoch();
+    binlog::encodeArgs(p + sizeof(BinaryLogRing::Header), args...);
+    ring->commit(length);
+  }
+
+private:
+  static uint32_t registerSite(BinaryLogSite *site, DecodeFunc decode);
+  // 当前线程的缓冲区，第一次调用时创建；线程正在退出(缓冲区已经交还)时返回 nullptr
+  static BinaryLogRing *threadRing();
+  static void threadFunc();
+
+  static std::atomic<bool> active_;
+};
+
+#define LOG_BIN_AT(level, LogmsgFormat, ...)\
+  do {\
+    if (Logger::enabled(level)) {\
+      if (BinaryLogger::active()) {\
+        static BinaryLogSite binaryLogSite(level, "[%s:%s:%d]\n" LogmsgFormat, __FILE__, __FUNCTION__, __LINE__);\
+        BinaryLogger::log(binaryLogSite, ##__VA_ARGS__);\
+      } else {\
+        Logger::instance().log(level, nullptr, "[%s:%s:%d]\n" LogmsgFormat, __FILE__, __FUNCTION__,\
+                               __LINE__, ##__VA_ARGS__);\
+      }\
+    }\
+  } while(0)
+
+#define LOG_BIN_DEBUG(LogmsgFormat, ...) LOG_BIN_AT(DEBUG, LogmsgFormat, ##__VA_ARGS__)
+#define LOG_BIN_INFO(LogmsgFormat, ...) LOG_BIN_AT(INFO, LogmsgFormat, ##__VA_ARGS__)
+#define LOG_BIN_ERROR(LogmsgFormat, ...) LOG_BIN_AT(ERROR, LogmsgFormat, ##__VA_ARGS__)
@@ -2,6 +2,7 @@
 
 #include "Logger.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -48,6 +49,13 @@ public:
 
   void retrieveAll() { readerIndex_ = writerIndex_ = kCheapPrepend; }
 
+  // 交换两个缓冲区的底层存储，不拷贝数据
+  void swap(Buffer &rhs) {
+    buffer_.swap(rhs.buffer_);
+    std::swap(readerIndex_, rhs.readerIndex_);
+    std::swap(writerIndex_, rhs.writerIndex_);
+  }
+
   // 把 onMessage 函数上报的 Buffer 数据转成string类型的数据
   // 读取 Buffer 中的所有可读数据
   std::string retrieveAllAsString() {
@@ -77,6 +85,8 @@ public:
   }
 
   char *beginWrite() { return begin() + writerIndex_; }
+  // 数据已经直接写到 beginWrite() 处(调用前用 ensureWritableBytes 保证空间)
+  void hasWritten(size_t len) { writerIndex_ += len; }
 
   const char *beginWrite() const { return begin() + writerIndex_; }
 
@@ -8,6 +8,8 @@
 class Buffer;
 class Timestamp;
 class TcpConnection;
+class UdpChannel;
+class InetAddress;
 
 using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
 // 后续使用这些函数对象的时候，第一个参数传递的是智能指针(by shared_from_this)
@@ -18,3 +20,6 @@ using CloseCallback = std::function<void(const TcpConnectionPtr &)>;
 using WriteCompleteCallback = std::function<void(const TcpConnectionPtr &)>;
 using MessageCallback = std::function<void(const TcpConnectionPtr &, Buffer *, Timestamp)>;
 using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr &, size_t)>;
+// UDP 数据报到达：开启 GRO 时内核合并的报文已经按原始边界拆开，每个数据报调用一次
+using UdpMessageCallback = std::function<void(UdpChannel *, const char *data, size_t len,
+                                              const InetAddress &peer, Timestamp)>;
@@ -89,6 +89,8 @@ public:
 
   // on loop per thread
   EventLoop *ownerLoop() { return loop_; }
+  // 连接迁移时更换所属的 loop，调用前 channel 必须已从原 loop 的 poller 中 remove
+  void setOwnerLoop(EventLoop *loop) { loop_ = loop; }
   void remove();
 
 private:
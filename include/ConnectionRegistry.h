@@ -0,0 +1,68 @@
+#pragma once
+#include "Callbacks.h"
+#include "noncopyable.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/*
+ * TcpServer 的连接表，按 64 位连接 ID 做 O(1) 的插入、查找和删除
+ * 连接 ID 的低 32 位是槽位下标，高 32 位是槽位的代数(generation)：槽位每次释放后代数加一，
+ * 所以已关闭连接的旧 ID 即使槽位被复用也查不到新连接；代数从 1 开始，0 不是合法的连接 ID
+ * 空闲槽位串成链表，稳定运行后插入删除不申请内存，不做字符串哈希
+ * 不加锁，只能在 TcpServer 的 baseLoop 中访问
+ */
+
+class ConnectionRegistry : noncopyable {
+public:
+  ConnectionRegistry();
+
+  // 预留一个槽位并返回连接 ID，之后用 assign 放入连接
+  uint64_t allocate();
+  void assign(uint64_t id, const TcpConnectionPtr &conn);
+  // ID 已失效时返回 nullptr
+  const TcpConnectionPtr *find(uint64_t id) const;
+  // ID 已失效时返回 false
+  bool remove(uint64_t id);
+  void clear();
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // 遍历所有连接，回调中不能插入或删除连接
+  template <typename Func>
+  void forEach(Func func) const {
+    for (const Slot &slot : slots_) {
+      if (slot.conn) {
+        func(slot.conn);
+      }
+    }
+  }
+  template <typename Func>
+  void forEach(Func func) {
+    for (Slot &slot : slots_) {
+      if (slot.conn) {
+        func(slot.conn);
+      }
+    }
+  }
+
+private:
+  struct Slot {
+    Slot() : generation(1), nextFree(kNoSlot), used(false) {}
+    uint32_t generation;
+    uint32_t nextFree;      // 空闲时指向下一个空闲槽位
+    bool used;
+    TcpConnectionPtr conn;
+  };
+  static const uint32_t kNoSlot = UINT32_MAX;
+
+  static uint32_t slotIndex(uint64_t id) { return static_cast<uint32_t>(id); }
+  static uint32_t generation(uint64_t id) { return static_cast<uint32_t>(id >> 32); }
+  const Slot *lookup(uint64_t id) const;
+
+  std::vector<Slot> slots_;
+  uint32_t freeHead_;       // 空闲链表头
+  size_t size_;             // 已分配的槽位数
+};
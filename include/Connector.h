@@ -0,0 +1,73 @@
+#pragma once
+#include "InetAddress.h"
+#include "TimerId.h"
+#include "noncopyable.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+/*
+ * 主动发起连接，由 TcpClient 使用
+ * 非阻塞 connect：返回 EINPROGRESS 后把 sockfd 封装成 channel 注册写事件，可写时检查 SO_ERROR 判断是否连接成功
+ * 连接失败时按指数退避(初始 initRetryDelayMs，每次翻倍，最大 maxRetryDelayMs)在 loop 的定时器上重试
+ * 成功后 channel 从 poller 上删除，sockfd 通过 newConnectionCallback_ 交给 TcpClient 创建 TcpConnection
+ */
+
+class Channel;
+class EventLoop;
+
+class Connector : noncopyable, public std::enable_shared_from_this<Connector> {
+public:
+  using NewConnectionCallback = std::function<void(int sockfd)>;
+  // 每次连接失败时调用，参数是失败原因的 errno，回调中可以调用 stop 放弃重试
+  using ConnectFailedCallback = std::function<void(int err)>;
+
+  Connector(EventLoop *loop, const InetAddress &serverAddr);
+  ~Connector();
+
+  void setNewConnectionCallback(const NewConnectionCallback &cb) { newConnectionCallback_ = cb; }
+  void setConnectFailedCallback(const ConnectFailedCallback &cb) { connectFailedCallback_ = cb; }
+  // 在 start 之前设置重试间隔
+  void setRetryDelay(int initRetryDelayMs, int maxRetryDelayMs) {
+    initRetryDelayMs_ = initRetryDelayMs;
+    maxRetryDelayMs_ = maxRetryDelayMs;
+    retryDelayMs_ = initRetryDelayMs;
+  }
+
+  const InetAddress &serverAddress() const { return serverAddr_; }
+
+  void start();   // 可以跨线程调用
+  void restart(); // 只能在 loop 线程中调用，重置重试间隔后重新连接
+  void stop();    // 可以跨线程调用
+
+private:
+  enum StateE { kDisconnected, kConnecting, kConnected };
+  static const int kDefaultInitRetryDelayMs = 500;
+  static const int kDefaultMaxRetryDelayMs = 30 * 1000;
+
+  void setState(StateE state) { state_ = state; }
+  void startInLoop();
+  void stopInLoop();
+  void connect();
+  void connecting(int sockfd);
+  void handleWrite();
+  void handleError();
+  void retry(int sockfd, int err);
+  int removeAndResetChannel();
+  void resetChannel();
+
+  EventLoop *loop_;
+  InetAddress serverAddr_;
+  std::atomic_bool connect_;   // 用户是否要求连接
+  std::atomic_int state_;
+  std::unique_ptr<Channel> channel_; // 正在连接的 sockfd 对应的 channel
+  NewConnectionCallback newConnectionCallback_;
+  ConnectFailedCallback connectFailedCallback_;
+  int initRetryDelayMs_;
+  int maxRetryDelayMs_;
+  int retryDelayMs_;           // 下一次重试的间隔
+  TimerId retryTimer_;
+};
+
+using ConnectorPtr = std::shared_ptr<Connector>;
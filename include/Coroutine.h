@@ -0,0 +1,303 @@
+#pragma once
+/*
+ * 基于 C++20 协程的 TcpConnection 读写接口(可选组件，只有头文件)
+ * 库本身仍按 C++11 编译，使用方包含本头文件时需以 -std=c++20 编译
+ *
+ * 用法：在连接建立的回调(运行在该连接所属的 subLoop 中)里启动一个协程
+ *   CoTask session(CoConnection conn) {
+ *     std::string line = co_await conn.readUntil("\r\n");
+ *     co_await conn.write(line);
+ *     co_await conn.sleep(100);
+ *   }
+ *   server.setConnectionCallback([](const TcpConnectionPtr &conn) {
+ *     if (conn->connected()) session(CoConnection(conn));
+ *   });
+ *
+ * 协程总是在连接所属 loop 的线程中被 messageCallback / writeCompleteCallback / 定时器回调恢复执行，
+ * 不会发生线程切换；协程帧从所在线程(即所在 loop)的 CoFramePool 中分配
+ */
+
+#if __cplusplus < 202002L
+#error "Coroutine.h requires C++20, compile with -std=c++20"
+#endif
+
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "TcpConnection.h"
+#include "noncopyable.h"
+
+#include <algorithm>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <new>
+#include <string>
+
+/*
+ * 协程帧内存池
+ * one loop per thread，所以 thread_local 的池子就是 per-loop 的池子
+ * 按 64 字节向上取整分级，释放的帧挂在对应级别的空闲链表上，稳定运行后不再向系统申请内存
+ */
+class CoFramePool : noncopyable {
+public:
+  static CoFramePool &instance() {
+    thread_local CoFramePool pool;
+    return pool;
+  }
+
+  void *allocate(size_t size) {
+    size_t idx = classIndex(size);
+    if (idx >= kNumClasses) {
+      return ::operator new(size);
+    }
+    FreeNode *node = freeLists_[idx];
+    if (node != nullptr) {
+      freeLists_[idx] = node->next;
+      return node;
+    }
+    return ::operator new((idx + 1) * kGranularity);
+  }
+
+  void deallocate(void *p, size_t size) {
+    size_t idx = classIndex(size);
+    if (idx >= kNumClasses) {
+      ::operator delete(p);
+      return;
+    }
+    FreeNode *node = static_cast<FreeNode *>(p);
+    node->next = freeLists_[idx];
+    freeLists_[idx] = node;
+  }
+
+  ~CoFramePool() {
+    for (FreeNode *&head : freeLists_) {
+      while (head != nullptr) {
+        FreeNode *next = head->next;
+        ::operator delete(head);
+        head = next;
+      }
+    }
+  }
+
+private:
+  struct FreeNode {
+    FreeNode *next;
+  };
+
+  static const size_t kGranularity = 64;
+  static const size_t kNumClasses = 64; // 最大缓存 4K 的协程帧
+
+  static size_t classIndex(size_t size) { return (size + kGranularity - 1) / kGranularity - 1; }
+
+  CoFramePool() : freeLists_() {}
+
+  FreeNode *freeLists_[kNumClasses];
+};
+
+/*
+ * 不需要等待结果的协程类型：创建后立即执行，执行结束后自动销毁协程帧
+ */
+class CoTask {
+public:
+  struct promise_type {
+    CoTask get_return_object() { return CoTask(); }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+
+    static void *operator new(size_t size) { return CoFramePool::instance().allocate(size); }
+    static void operator delete(void *p, size_t size) { CoFramePool::instance().deallocate(p, size); }
+  };
+};
+
+/*
+ * 协程视角下的 TcpConnection
+ * 构造时接管连接的 message/connection/writeComplete 回调，所以应在连接建立后立即创建
+ * 回调中只持有 weak_ptr<State>，协程结束后 State 析构，不会和 TcpConnection 循环引用
+ * writeCompleteCallback 只在写操作真正需要挂起时才安装，数据一次写完的快路径没有额外开销
+ */
+class CoConnection {
+  struct State;
+
+public:
+  explicit CoConnection(const TcpConnectionPtr &conn) : state_(std::make_shared<State>(conn)) {
+    std::weak_ptr<State> weak(state_);
+    conn->setMessageCallback([weak](const TcpConnectionPtr &, Buffer *, Timestamp) {
+      std::shared_ptr<State> st = weak.lock();
+      if (st) {
+        st->onMessage();
+      }
+    });
+    conn->setConnectionCallback([weak](const TcpConnectionPtr &c) {
+      std::shared_ptr<State> st = weak.lock();
+      if (st && !c->connected()) {
+        st->onClose();
+      }
+    });
+  }
+
+  const TcpConnectionPtr &connection() const { return state_->conn; }
+  EventLoop *getLoop() const { return state_->conn->getLoop(); }
+  // 对端已关闭连接
+  bool eof() const { return state_->closed; }
+
+  struct ReadAwaiter {
+    State *st;
+    bool await_ready() { return st->tryRead() || st->closed; }
+    void await_suspend(std::coroutine_handle<> h) { st->reader = h; }
+    std::string await_resume() { return std::move(st->result); }
+  };
+
+  struct WriteAwaiter {
+    State *st;
+    bool await_ready() { return st->writeDone() || st->closed; }
+    void await_suspend(std::coroutine_handle<> h) {
+      st->writer = h;
+      st->watchWriteComplete();
+    }
+    bool await_resume() { return !st->closed; }
+  };
+
+  struct SleepAwaiter {
+    EventLoop *loop;
+    int64_t ms;
+    bool await_ready() { return ms <= 0; }
+    void await_suspend(std::coroutine_handle<> h) {
+      loop->runAfter(static_cast<double>(ms) / 1000, [h]() { h.resume(); });
+    }
+    void await_resume() {}
+  };
+
+  // 读到 delim 为止，返回的数据包含 delim；连接关闭时返回空串
+  // delim 为空时与 readExactly(0) 一样立即完成，返回空串，不消耗缓冲区中的数据
+  ReadAwaiter readUntil(const std::string &delim) {
+    state_->mode = State::kUntil;
+    state_->delim = delim;
+    return ReadAwaiter{state_.get()};
+  }
+
+  // 读当前缓冲区中所有数据(至少 1 字节)；连接关闭时返回空串
+  ReadAwaiter readSome() {
+    state_->mode = State::kSome;
+    return ReadAwaiter{state_.get()};
+  }
+
+  // 读 n 个字节；连接关闭时返回空串
+  ReadAwaiter readExactly(size_t n) {
+    state_->mode = State::kExactly;
+    state_->length = n;
+    return ReadAwaiter{state_.get()};
+  }
+
+  // 数据全部交给内核后恢复；连接关闭时返回 false
+  WriteAwaiter write(const std::string &data) {
+    state_->conn->send(data);
+    return WriteAwaiter{state_.get()};
+  }
+
+  WriteAwaiter write(Buffer *buf) {
+    state_->conn->send(buf->retrieveAllAsString());
+    return WriteAwaiter{state_.get()};
+  }
+
+  SleepAwaiter sleep(int64_t ms) { return SleepAwaiter{getLoop(), ms}; }
+
+private:
+  struct State : std::enable_shared_from_this<State> {
+    enum Mode { kUntil, kExactly, kSome };
+
+    explicit State(const TcpConnectionPtr &c) : conn(c), mode(kUntil), length(0), closed(false) {}
+
+    // 缓冲区中的数据满足读条件时，取出到 result
+    bool tryRead() {
+      Buffer *buf = conn->inputBuffer();
+      if (mode == kSome) {
+        if (buf->readableBytes() == 0) {
+          return false;
+        }
+        result = buf->retrieveAllAsString();
+        return true;
+      }
+      if (mode == kExactly) {
+        if (buf->readableBytes() < length) {
+          return false;
+        }
+        result = buf->retrieveAsString(length);
+        return true;
+      }
+      if (delim.empty()) {
+        result.clear();
+        return true;
+      }
+      const char *begin = buf->peek();
+      const char *end = begin + buf->readableBytes();
+      const char *pos = std::search(begin, end, delim.begin(), delim.end());
+      if (pos == end) {
+        return false;
+      }
+      result = buf->retrieveAsString(pos - begin + delim.size());
+      return true;
+    }
+
+    // auto-cork 合并中的数据和排队的文件、PayloadSlice 都写完才算完成
+    bool writeDone() { return conn->outputDrained(); }
+
+    void onMessage() {
+      if (reader && tryRead()) {
+        resume(reader);
+      }
+    }
+
+    void watchWriteComplete() {
+      std::weak_ptr<State> weak(shared_from_this());
+      conn->setWriteCompleteCallback([weak](const TcpConnectionPtr &) {
+        std::shared_ptr<State> st = weak.lock();
+        if (st) {
+          st->onWriteComplete();
+        }
+      });
+    }
+
+    void onWriteComplete() {
+      // 之前一次直接写完的 send 也会排队触发该回调，需要确认输出确实已经清空
+      if (writer && writeDone()) {
+        conn->setWriteCompleteCallback(WriteCompleteCallback());
+        resume(writer);
+      }
+    }
+
+    void onClose() {
+      closed = true;
+      if (reader) {
+        result.clear();
+        resume(reader);
+      }
+      if (writer) {
+        resume(writer);
+      }
+    }
+
+    static void resume(std::coroutine_handle<> &h) {
+      std::coroutine_handle<> handle = h;
+      h = nullptr;
+      handle.resume();
+    }
+
+    TcpConnectionPtr conn;
+    Mode mode;
+    std::string delim;
+    size_t length;
+    std::string result;
+    bool closed;
+    std::coroutine_handle<> reader;
+    std::coroutine_handle<> writer;
+  };
+
+  std::shared_ptr<State> state_;
+};
+
+// 在 loop 所在线程中挂起当前协程 ms 毫秒
+inline CoConnection::SleepAwaiter coSleep(EventLoop *loop, int64_t ms) {
+  return CoConnection::SleepAwaiter{loop, ms};
+}
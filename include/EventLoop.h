@@ -1,5 +1,6 @@
 #pragma once
 #include "CurrentThread.h"
+#include "TimerId.h"
 #include "Timestamp.h" // 类中使用的是Timestamp变量而非指针，编译需要知道这个类的大小，所以前置声明不满足要求
 #include "noncopyable.h"
 
@@ -16,6 +17,7 @@
 
 class Channel;
 class Poller;
+class TimerQueue;
 
 class EventLoop : noncopyable {
 public:
@@ -27,13 +29,35 @@ public:
   void loop(); // 开启事件循环
   void quit(); // 退出事件循环
 
+  // poller 返回的时间(微秒精度)，每轮循环刷新一次
   Timestamp pollReturnTime() const { return pollReturnTime_; }
+  // 当前线程所属 loop 缓存的时间，即本轮 poll 返回的时间，读取时不调用 clock_gettime
+  // 用于回调中对精度要求不高的计时(比如空闲超时、统计)，误差不超过本轮循环处理事件所用的时间
+  // 不在 loop 线程中调用时退化为 Timestamp::now()
+  static Timestamp cachedNow();
+
+  // loop 处理事件和回调(即不阻塞在 poll 上)的累计时间，单位微秒，可以跨线程读取
+  // 两次采样的差值除以采样间隔就是这段时间内 loop 的繁忙程度
+  int64_t busyTimeUs() const { return busyTimeUs_.load(std::memory_order_relaxed); }
 
   void runInLoop(Functor cb);     // 在当前 loop 中执行 cb
   void queueInLoop(Functor cb);   // 把 cb 放在队列中，唤醒 loop 所在线程的执行 cb
 
   void wakeup();                  // mainReactor 唤醒 subReactor(用来唤醒 loop 所在的线程)
 
+  // 在本轮循环处理完所有事件和 pendingFunctors 之后执行 cb，只能在 loop 所在线程中调用
+  // 用于把一轮循环中的多次操作合并成一次，比如 TcpConnection 的 auto-cork 合并写
+  void runAtIterationEnd(Functor cb);
+
+  // 定时器，可以跨线程调用，回调总是在 loop 所在线程中执行
+  TimerId runAfter(double delay, Functor cb);     // delay 秒后执行一次 cb
+  TimerId runEvery(double interval, Functor cb);  // 每隔 interval 秒执行一次 cb
+  void cancel(TimerId timerId);
+
+  // 把对象的生命周期绑定到 loop 上，loop 析构时(仍在 loop 线程中，定时器和 poller 都还可用)按添加的逆序销毁
+  // 用于 UpstreamPool 这类 per-loop 的对象，只能在 loop 所在线程中调用
+  void attach(std::shared_ptr<void> object) { attachments_.push_back(std::move(object)); }
+
   // channel 的方法 ==> EventLoop 的这两个方法 ==> poller 上的update/removeChannel 方法
   void updateChannel(Channel *channel);
   void removeChannel(Channel *channel);
@@ -45,6 +69,7 @@ public:
 private:
   void handleRead();                        // 唤醒线程时被公有方法调用
   void doPendingFunctors();                 // 执行回调，回调函数都放在 vector<Functor> 中
+  void doIterationEndFunctors();            // 执行 runAtIterationEnd 登记的回调
 
   using ChannelList = std::vector<Channel *>;
 
@@ -55,6 +80,8 @@ private:
 
   Timestamp pollReturnTime_;                // poller 返回发生事件的 channels 的时间点
   std::unique_ptr<Poller> poller_;          // EventLoop 管理的 poller，监听所有 channels 上发生的事件
+  std::unique_ptr<TimerQueue> timerQueue_;  // 定时器队列，通过 timerfd 注册在 poller 上
+  std::atomic<int64_t> busyTimeUs_;         // 累计繁忙时间，只由 loop 线程写
 
   // muduo 通过 eventfd 系统调用实现线程间的通信，wakeFd_ 是该系统调用创建的。mainLoop 获取一个新用户连接
   // 时，通过轮询算法选择一个subLoop(有可能阻塞)，通过 wakeupFd_ 唤醒(向这个 fd 写一个数据)选择的 subLoop
@@ -69,4 +96,11 @@ private:
   // 如果当前线程不是该回调函数对应的 loop 所属的线程，就要放在一个队列中，唤醒相应的线程之后再执行该回调函数
   std::vector<Functor> pendingFunctors_;    // 存储 loop 需要执行的所有的回调操作
   std::mutex mutex_;                        // 互斥锁，用来保护上面 vector<Functor> 的线程安全操作
+
+  // 只在 loop 线程中访问，不需要加锁；两个 vector 轮换使用，复用已分配的内存
+  std::vector<Functor> iterationEndFunctors_;
+  std::vector<Functor> runningIterationEndFunctors_;
+  bool callingIterationEndFunctors_;
+
+  std::vector<std::shared_ptr<void>> attachments_; // attach 绑定到 loop 上的对象
 };
\ No newline at end of file
@@ -1,8 +1,10 @@
 #pragma once
 #include "noncopyable.h"
 
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -11,12 +13,17 @@ class EventLoopThread;
 
 /*
  * 事件循环线程池
+ * start() 之后仍可以通过 addLoop/detachLoop 增减 subLoop
+ * getNextLoop 只读取定长的原子槽位数组，不加锁，增减 subLoop 时也不会阻塞读者
 */
 
 class EventLoopThreadPool : noncopyable {
 public:
   using ThreadInitCallback = std::function<void(EventLoop *)>;
 
+  // subLoop 数量上限
+  static const int kMaxLoops = 256;
+
   EventLoopThreadPool(EventLoop *baseLoop, const std::string &nameArg);
   ~EventLoopThreadPool();
 
@@ -26,10 +33,18 @@ public:
 
   void start(const ThreadInitCallback &cb = ThreadInitCallback());
 
+  // 运行时新增一个 subLoop，阻塞到新线程中的 loop 创建完成，返回新 loop
+  EventLoop *addLoop();
+  // 把 loop 从线程池中摘下，之后 getNextLoop 不会再返回它
+  // 返回该 loop 所在的线程对象，由调用者在 loop 上的连接处理完后析构(析构时退出 loop 并 join 线程)
+  std::unique_ptr<EventLoopThread> detachLoop(EventLoop *loop);
+
   // 如果工作在多线程中，baseLoop 会通过轮询的方式获取 subLoop，如果用户没有 setThreadNum，则返回的就是主线程的 mainLoop
   EventLoop *getNextLoop();
 
   std::vector<EventLoop *> getAllLoops();
+  // 当前 subLoop 数量
+  int numLoops() const { return numLoops_.load(std::memory_order_acquire); }
 
   bool started() const { return started_; }
   const std::string name() const { return name_; }
@@ -39,7 +54,15 @@ private:
   std::string name_;
   bool started_;
   int numThreads_;
-  int next_;
+  std::atomic<unsigned> next_;
+  int nameIndex_;                // 新线程的名称序号，只增不减
+  ThreadInitCallback threadInitCallback_;
+
+  std::mutex mutex_;             // 保护写者：threads_ 和槽位的增删
   std::vector<std::unique_ptr<EventLoopThread>> threads_; // 所有事件的线程
-  std::vector<EventLoop *> loops_; // 所有事件线程对应的 loop 指针，通过调用 EventLoopThread 的 startLoop 可以获得一个指针
-};
\ No newline at end of file
+  std::vector<EventLoop *> loops_; // 和 threads_ 一一对应，通过调用 EventLoopThread 的 startLoop 可以获得一个指针
+
+  // 读者(getNextLoop)看到的 loop 集合：先写槽位再增加数量，删除时把最后一个槽位挪到空位再减少数量
+  std::atomic<EventLoop *> loopSlots_[kMaxLoops];
+  std::atomic<int> numLoops_;
+};
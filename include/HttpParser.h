@@ -0,0 +1,64 @@
+#pragma once
+#include "HttpRequest.h"
+
+#include <stddef.h>
+
+class Buffer;
+
+/*
+ * 可恢复的 HTTP/1.x 请求解析器，直接在 Buffer::peek() 上解析，不拷贝请求行和头部
+ * 数据不完整时返回 kNeedMore 并记住已经解析到的位置，下次收到数据后从该位置继续，不会重复扫描
+ * 请求完整时返回 kComplete，请求占用缓冲区开头的 consumed() 个字节，处理完后由调用者 retrieve 并 reset
+ * 支持 Content-Length 和 chunked 请求体，流水线上的多个请求逐个解析
+ * 请求行和头部(包括 chunked 的 trailer)受 maxHeaderBytes 限制，chunk 大小行过长时返回 400
+ */
+class HttpParser {
+public:
+  enum Result { kNeedMore, kComplete, kError };
+
+  static const size_t kDefaultMaxHeaderBytes = 64 * 1024;
+  static const size_t kDefaultMaxBodyBytes = 8 * 1024 * 1024;
+
+  explicit HttpParser(size_t maxHeaderBytes = kDefaultMaxHeaderBytes,
+                      size_t maxBodyBytes = kDefaultMaxBodyBytes);
+
+  Result parse(const Buffer *buf, HttpRequest *request);
+
+  size_t consumed() const { return pos_; }
+  // kError 时应回复的状态码：400 格式错误，413 请求体过大，431 头部过大，501 不支持的传输编码
+  int errorStatus() const { return errorStatus_; }
+  // 头部已经收完，请求带有 Expect: 100-continue 且请求体还没有收到，调用者回复 100 Continue 后调用 clearExpectContinue
+  bool expectContinue() const { return expectContinue_; }
+  void clearExpectContinue() { expectContinue_ = false; }
+
+  void reset();
+
+private:
+  enum State { kRequestLine, kHeaders, kBody, kChunkSize, kChunkData, kChunkDataEnd, kTrailers, kDone };
+
+  // 从 scan_ 开始查找下一行，找到时返回 true，[*begin, *end) 是去掉行尾 CRLF 的内容
+  bool nextLine(const char *data, size_t readable, size_t *begin, size_t *end);
+  bool parseRequestLine(const char *data, size_t begin, size_t end, HttpRequest *request);
+  bool parseHeader(const char *data, size_t begin, size_t end, HttpRequest *request);
+  // 头部结束，根据 Content-Length/Transfer-Encoding 决定如何读取请求体
+  bool finishHeaders(HttpRequest *request);
+  Result fail(int status) {
+    errorStatus_ = status;
+    return kError;
+  }
+
+  const size_t maxHeaderBytes_;
+  const size_t maxBodyBytes_;
+  State state_;
+  size_t pos_;            // 已经解析的字节数(相对于请求起始位置)
+  size_t scan_;           // 查找行尾的起始位置，pos_ <= scan_
+  size_t contentLength_;
+  size_t chunkRemaining_;
+  size_t trailerStart_;   // trailer 部分的起始位置，用于限制 trailer 的总长度
+  bool hasContentLength_;
+  bool hasTransferEncoding_;
+  bool connectionClose_;
+  bool connectionKeepAlive_;
+  bool expectContinue_;
+  int errorStatus_;
+};
@@ -0,0 +1,114 @@
+#pragma once
+#include "Timestamp.h"
+
+#include <stddef.h>
+#include <string.h>
+#include <string>
+#include <strings.h>
+#include <vector>
+
+/*
+ * 指向请求数据中一段字符的引用，不拥有内存
+ * HttpRequest 中的 HttpSlice 直接指向 TcpConnection 的 inputBuffer_，只在 HttpCallback 执行期间有效
+ */
+struct HttpSlice {
+  HttpSlice() : data(""), size(0) {}
+  HttpSlice(const char *d, size_t n) : data(d), size(n) {}
+
+  bool empty() const { return size == 0; }
+  std::string toString() const { return std::string(data, size); }
+  bool equals(const char *s, size_t n) const { return size == n && std::char_traits<char>::compare(data, s, n) == 0; }
+  bool equalsIgnoreCase(const char *s, size_t n) const { return size == n && ::strncasecmp(data, s, n) == 0; }
+  bool operator==(const std::string &s) const { return equals(s.data(), s.size()); }
+
+  const char *data;
+  size_t size;
+};
+
+/*
+ * 一个 HTTP/1.x 请求，由 HttpParser 填写
+ * 请求行和头部以偏移量记录在缓冲区中，请求完整后由 HttpParser 设置基址，访问时才转换成 HttpSlice，
+ * 解析过程中缓冲区扩容搬移数据不影响已经解析的部分
+ */
+class HttpRequest {
+public:
+  enum Method { kInvalid, kGet, kHead, kPost, kPut, kDelete, kOptions, kPatch };
+  enum Version { kUnknown, kHttp10, kHttp11 };
+
+  HttpRequest() { reset(); }
+
+  Method method() const { return method_; }
+  HttpSlice methodString() const { return slice(methodRange_); }
+  Version version() const { return version_; }
+  // 请求目标，比如 /index.html?a=1，以及其中的路径和查询串(不含 '?')
+  HttpSlice target() const { return slice(target_); }
+  HttpSlice path() const { return slice(path_); }
+  HttpSlice query() const { return slice(query_); }
+
+  // 按名字(大小写不敏感)查找头部，不存在时返回空的 HttpSlice
+  HttpSlice header(const char *field) const {
+    size_t n = ::strlen(field);
+    for (const Header &h : headers_) {
+      if (slice(h.name).equalsIgnoreCase(field, n)) {
+        return slice(h.value);
+      }
+    }
+    return HttpSlice();
+  }
+  size_t headerCount() const { return headers_.size(); }
+  HttpSlice headerName(size_t i) const { return slice(headers_[i].name); }
+  HttpSlice headerValue(size_t i) const { return slice(headers_[i].value); }
+
+  // 请求体：Content-Length 请求体直接指向缓冲区，chunked 请求体解码后保存在请求中
+  HttpSlice body() const {
+    return chunked_ ? HttpSlice(chunkedBody_.data(), chunkedBody_.size()) : slice(body_);
+  }
+  bool chunked() const { return chunked_; }
+  // 处理完这个请求后是否保持连接(HTTP/1.1 默认保持，HTTP/1.0 需要 Connection: keep-alive)
+  bool keepAlive() const { return keepAlive_; }
+
+  Timestamp receiveTime() const { return receiveTime_; }
+  void setReceiveTime(Timestamp t) { receiveTime_ = t; }
+
+  void reset() {
+    base_ = "";
+    method_ = kInvalid;
+    version_ = kUnknown;
+    methodRange_ = target_ = path_ = query_ = body_ = Range();
+    headers_.clear(); // 保留容量，同一连接上的下一个请求不再分配
+    chunkedBody_.clear();
+    chunked_ = false;
+    keepAlive_ = false;
+  }
+
+private:
+  friend class HttpParser;
+
+  // 相对于请求起始位置的偏移量和长度
+  struct Range {
+    Range() : offset(0), length(0) {}
+    Range(size_t o, size_t n) : offset(o), length(n) {}
+    size_t offset;
+    size_t length;
+  };
+  struct Header {
+    Range name;
+    Range value;
+  };
+
+  HttpSlice slice(Range r) const { return HttpSlice(base_ + r.offset, r.length); }
+
+  const char *base_;
+  Method method_;
+  Version version_;
+  Range methodRange_;
+  Range target_;
+  Range path_;
+  Range query_;
+  Range body_;
+  std::vector<Header> headers_;
+  std::string chunkedBody_;
+  bool chunked_;
+  bool keepAlive_;
+  Timestamp receiveTime_;
+};
@@ -0,0 +1,69 @@
+#pragma once
+#include "Callbacks.h"
+#include "HttpRequest.h"
+#include "noncopyable.h"
+
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <sys/types.h>
+
+class Buffer;
+
+/*
+ * HTTP 响应，状态行、头部和响应体直接序列化到 TcpConnection 的 outputBuffer_ 中，不经过中间字符串
+ * 调用顺序：setStatus(可选，默认 200) → addHeader(任意次) → 以下三者之一结束响应
+ *   send(body)            带 Content-Length 的响应体
+ *   sendFile(fd, ...)     响应体用 sendfile 从文件直接发送，见 TcpConnection::sendFile
+ *   beginChunked → writeChunk(任意次) → endChunked   chunked 编码的流式响应体
+ * 在 HttpCallback 中没有结束的响应可以在之后(同一个 loop 线程中)继续写，比如等待后端结果后再 send，
+ * 或者分多次 writeChunk；响应结束前同一连接上流水线中的后续请求不会被处理，保证响应的顺序
+ */
+class HttpResponse : noncopyable {
+public:
+  HttpResponse();
+
+  void setStatus(int code, const char *reason = nullptr);
+  void addHeader(const char *name, const char *value);
+  void addHeader(const char *name, const std::string &value) { addHeader(name, value.c_str()); }
+  void setContentType(const char *type) { addHeader("Content-Type", type); }
+  // 响应结束后关闭连接
+  void setCloseConnection(bool on) { close_ = on; }
+  bool closeConnection() const { return close_; }
+
+  void send(const char *body, size_t len);
+  void send(const std::string &body) { send(body.data(), body.size()); }
+  // 连接接管 fd；HEAD 请求时不发送文件内容，fd 直接关闭
+  void sendFile(int fd, off_t offset, size_t length);
+
+  void beginChunked();
+  void writeChunk(const char *data, size_t len);
+  void writeChunk(const std::string &data) { writeChunk(data.data(), data.size()); }
+  void endChunked();
+
+  bool finished() const { return state_ == kFinished; }
+  int status() const { return status_; }
+  // 响应所属的连接，连接已经关闭时为空
+  TcpConnectionPtr connection() const { return conn_.lock(); }
+
+private:
+  friend class HttpServer;
+  enum State { kIdle, kHeaders, kChunked, kFinished };
+
+  // HttpServer 在调用 HttpCallback 前为每个请求重置响应
+  void reset(const TcpConnectionPtr &conn, const HttpRequest &request);
+  // 取得输出缓冲区，第一次调用时写入状态行；连接已经关闭时返回 nullptr
+  Buffer *output(TcpConnectionPtr *conn);
+  void writeHeaderEnd(Buffer *out, int64_t contentLength);
+  void finish(const TcpConnectionPtr &conn);
+
+  std::weak_ptr<TcpConnection> conn_;
+  State state_;
+  int status_;
+  const char *reason_;
+  bool close_;
+  bool head_;           // HEAD 请求，只发送头部
+  bool http10_;         // HTTP/1.0 不支持 chunked，流式响应以关闭连接结束
+  bool dispatching_;    // 正在 HttpCallback 中，由 HttpServer 在回调返回后统一 flush
+  std::function<void()> finishCallback_; // 在 HttpCallback 之外结束响应时通知 HttpServer
+};
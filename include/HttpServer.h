@@ -0,0 +1,67 @@
+#pragma once
+#include "Callbacks.h"
+#include "HttpParser.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "TcpServer.h"
+#include "noncopyable.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+
+/*
+ * 基于 TcpServer 的 HTTP/1.1 服务器
+ * 请求由 HttpParser 直接在连接的 inputBuffer_ 上增量解析，响应由 HttpResponse 直接写入 outputBuffer_
+ * 支持 keep-alive 和流水线：一次读到的多个请求依次处理，它们的响应在回调返回后合并成一次写；
+ * 响应没有结束(异步响应)时暂停处理同一连接上的后续请求，响应结束后继续
+ *
+ * 用法：
+ *   HttpServer server(&loop, InetAddress(8000), "http");
+ *   server.setHttpCallback([](const HttpRequest &req, HttpResponse *resp) {
+ *     resp->setContentType("text/plain");
+ *     resp->send("hello\n");
+ *   });
+ *   server.start();
+ */
+class HttpServer : noncopyable {
+public:
+  // 请求中的 HttpSlice 只在回调执行期间有效，异步响应需要的数据应在回调中拷贝
+  using HttpCallback = std::function<void(const HttpRequest &, HttpResponse *)>;
+
+  HttpServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &name,
+             TcpServer::Option option = TcpServer::kNoReusePort);
+
+  void setHttpCallback(const HttpCallback &cb) { httpCallback_ = cb; }
+  void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+  // 请求行加头部、请求体的大小上限，作用于之后的新连接
+  void setMaxHeaderBytes(size_t bytes) { maxHeaderBytes_ = bytes; }
+  void setMaxBodyBytes(size_t bytes) { maxBodyBytes_ = bytes; }
+  // 底层的 TcpServer，用于设置 socket 选项、限速和优雅停止等
+  TcpServer *server() { return &server_; }
+
+  void start();
+
+private:
+  // 每个连接的解析状态，由连接的 messageCallback 持有，随连接释放
+  struct Session {
+    Session(size_t maxHeaderBytes, size_t maxBodyBytes) : parser(maxHeaderBytes, maxBodyBytes) {}
+    HttpParser parser;
+    HttpRequest request;
+    HttpResponse response;
+  };
+  using SessionPtr = std::shared_ptr<Session>;
+
+  void onConnection(const TcpConnectionPtr &conn);
+  void onMessage(const TcpConnectionPtr &conn, const SessionPtr &session, Buffer *buf, Timestamp receiveTime);
+  // 处理缓冲区中完整的请求，直到需要更多数据或者当前响应没有结束
+  void processRequests(const TcpConnectionPtr &conn, const SessionPtr &session, Timestamp receiveTime);
+  // 异步响应结束
+  void onResponseFinished(const std::weak_ptr<TcpConnection> &weakConn, const std::weak_ptr<Session> &weakSession);
+  void sendError(const TcpConnectionPtr &conn, Session *session, int status);
+
+  TcpServer server_;
+  HttpCallback httpCallback_;
+  size_t maxHeaderBytes_;
+  size_t maxBodyBytes_;
+};
@@ -1,23 +1,51 @@
 #pragma once
 /*
- * 封装 socket 地址类型
+ * 封装 socket 地址类型，支持 IPv4、IPv6 和 Unix 域(AF_UNIX) 地址
+ * TcpServer/Acceptor/Connector 按地址族创建 socket，同一套 TcpServer/TcpConnection 可以监听其中任意一种
  */
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 class InetAddress {
 public:
-  explicit InetAddress(uint16_t port = 0, std::string ip = "127.0.0.1");
-  explicit InetAddress(const sockaddr_in &addr) : addr_(addr) {}
-  std::string toIp() const;
-  std::string toIpPort() const;
-  uint16_t toPort() const;
+  // ip 可以是 IPv4 或 IPv6 的数字地址，为空或 "0.0.0.0" 时绑定 INADDR_ANY，"::" 时绑定 in6addr_any
+  // ip 无法解析(比如主机名 "localhost" 或拼写错误)时地址无效，不会退化成 ANY：
+  // Acceptor 监听无效地址时 LOG_FATAL，Connector 连接无效地址时直接报告连接失败(EINVAL)
+  explicit InetAddress(uint16_t port = 0, std::string ip = "0.0.0.0");
+  explicit InetAddress(const sockaddr_in &addr);
+  explicit InetAddress(const sockaddr_in6 &addr);
+  // accept/getsockname/recvfrom 等返回的任意地址族的地址
+  InetAddress(const sockaddr *addr, socklen_t len);
 
-  const sockaddr_in *getSockAddr() const { return &addr_; }
-  void setSockAddr(const sockaddr_in &addr) { addr_ = addr; }
+  // Unix 域地址：path 以 '@' 开头时使用 Linux 抽象命名空间(不在文件系统中创建 socket 文件)
+  // path 超过 sun_path 的长度时地址无效，不会截断
+  static InetAddress unixAddress(const std::string &path);
+
+  sa_family_t family() const { return addr_.sin_family; }
+  // 由无法解析的 ip 或过长的 Unix 域路径构造的地址无效，长度为 0，bind/connect 都会失败
+  bool valid() const { return len_ > 0; }
+  bool isUnix() const { return family() == AF_UNIX; }
+  // 文件系统中的 Unix 域 socket 路径，其他地址(包括抽象命名空间)返回空串
+  std::string unixPath() const;
+
+  std::string toIp() const;      // Unix 域地址返回路径
+  std::string toIpPort() const;  // "ip:port"、"[ipv6]:port" 或 "unix:path"
+  uint16_t toPort() const;       // Unix 域地址返回 0
+
+  const sockaddr *getSockAddr() const { return reinterpret_cast<const sockaddr *>(&addr_); }
+  socklen_t length() const { return len_; }
+  void setSockAddr(const sockaddr_in &addr);
+  void setSockAddr(const sockaddr *addr, socklen_t len);
 
 private:
-  sockaddr_in addr_;
-};
\ No newline at end of file
+  union {
+    sockaddr_in addr_;
+    sockaddr_in6 addr6_;
+    sockaddr_un addrUn_;
+  };
+  socklen_t len_;
+};
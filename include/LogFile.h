@@ -0,0 +1,50 @@
+#pragma once
+#include "noncopyable.h"
+
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+#include <sys/types.h>
+#include <time.h>
+
+/*
+ * 滚动日志文件
+ * 文件名为 basename.年月日-时分秒.主机名.pid.log
+ * 写入的数据超过 rollSize 字节，或者跨过 rollInterval 秒的整数倍边界(默认按天)时切换到新文件
+ * 每隔 flushInterval 秒 fflush 一次，文件使用 64KB 的用户态缓冲区，写操作是 fwrite_unlocked
+ * threadSafe 为 false 时不加锁，由调用者保证单线程写入(AsyncLogging 的后台线程)
+ */
+class LogFile : noncopyable {
+public:
+  LogFile(const std::string &basename, off_t rollSize, bool threadSafe = true, int flushInterval = 3,
+          int rollInterval = 60 * 60 * 24);
+  ~LogFile();
+
+  void append(const char *logline, size_t len);
+  void flush();
+  // 切换到新文件，同一秒内重复调用不会切换(文件名相同)
+  bool rollFile();
+
+  off_t writtenBytes() const { return writtenBytes_; }
+
+private:
+  void appendUnlocked(const char *logline, size_t len);
+  std::string getLogFileName(time_t now) const;
+
+  const std::string basename_;
+  const off_t rollSize_;
+  const int flushInterval_;
+  const int rollInterval_;
+  std::unique_ptr<std::mutex> mutex_;
+
+  FILE *fp_;
+  char buffer_[64 * 1024];
+  off_t writtenBytes_; // 当前文件已写入的字节数
+  int count_;          // 距离上次检查时间以来的 append 次数，每 kCheckTimeRoll 次才取一次时间
+  time_t startOfPeriod_;
+  time_t lastRoll_;
+  time_t lastFlush_;
+
+  static const int kCheckTimeRoll = 1024;
+};
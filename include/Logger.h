@@ -3,72 +3,132 @@
  *日志类
 */
 
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <stddef.h>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "noncopyable.h"
 
-// LOG_INFO("%s %d", arg1, arg2)
-#define LOG_INFO(LogmsgFormat, ...)\
-  do {\
-    Logger &logger = Logger::instance();\
-    logger.setLogLevel(INFO);\
-    char buf[1024] = {0};\
-    snprintf(buf, 1024, LogmsgFormat, ##__VA_ARGS__);\
-    logger.log(buf);\
-  } while(0)
-
-#define LOG_ERROR(LogmsgFormat, ...)\
-  do {\
-    Logger &logger = Logger::instance();\
-    logger.setLogLevel(ERROR);\
-    char buf[1024] = {0};\
-    snprintf(buf, 1024, LogmsgFormat, ##__VA_ARGS__);\
-    logger.log(buf);\
-  } while(0)
-
-#define LOG_FATAL(LogmsgFormat, ...)\
-  do {\
-    Logger &logger = Logger::instance();\
-    logger.setLogLevel(FATAL);\
-    char buf[1024] = {0};\
-    snprintf(buf, 1024, LogmsgFormat, ##__VA_ARGS__);\
-    logger.log(buf);\
-    exit(-1);\
-  } while(0)
-
-#ifdef MUDUDEBUG
-#define LOG_DEBUG(LogmsgFormat, ...)\
-  do {\
-    Logger &logger = Logger::instance();\
-    logger.setLogLevel(DEBUG);\
-    char buf[1024] = {0};\
-    snprintf(buf, 1024, LogmsgFormat, ##__VA_ARGS__);\
-    logger.log(buf);\
-  } while(0)
-#else
-  #define LOG_DEBUG(LogmsgFormat, ...)
-#endif
-
-// 定义日志级别: INFO ERROR FATAL DEBUG
+// 定义日志级别，从低到高: DEBUG INFO ERROR FATAL
 enum LogLevel {
+  DEBUG, // 调试信息
   INFO,  // 普通信息
   ERROR, // 错误信息
-  FATAL, // core信息
-  DEBUG  // 调试信息
+  FATAL  // core信息
 };
 
-// 日志类，写成单例
+class LogModule;
+class Timestamp;
 
+// 日志类，写成单例
+// 最低级别是运行时可调的原子变量，日志语句先比较级别，低于最低级别时不格式化、不求值参数，只有一次分支；
+// 日志行格式化在调用线程的栈上完成，连同级别一起交给 OutputFunc 输出，默认写到 stdout；
+// 替换为 AsyncLogging::append 后由后台线程写文件，日志语句所在线程不再做 I/O
 class Logger : noncopyable {
 public:
+  using OutputFunc = std::function<void(int level, const char *msg, size_t len)>;
+  using FlushFunc = std::function<void()>;
+
   // 获取日志唯一的实例对象
   static Logger &instance();
-  // 设置日志级别
-  void setLogLevel(int level);
-  // 写日志
-  void log(std::string msg);
+
+  // 全局最低日志级别，可以跨线程调用；未单独设置级别的模块跟随全局级别
+  static void setLogLevel(int level);
+  static int logLevel() { return g_logLevel.load(std::memory_order_relaxed); }
+  static bool enabled(int level) { return level >= g_logLevel.load(std::memory_order_relaxed); }
+
+  // 单独设置某个模块的最低级别，模块可以在之后才构造(比如其他编译单元中的全局 LogModule)
+  static void setModuleLevel(const std::string &module, int level);
+  // 取消模块的单独设置，恢复跟随全局级别
+  static void resetModuleLevel(const std::string &module);
+
+  // 写日志，module 为空表示不属于任何模块
+  void log(int level, const LogModule *module, const char *fmt, ...)
+      __attribute__((format(printf, 4, 5)));
+  // 刷新输出，LOG_FATAL 在退出进程前调用
+  void flush();
+  // 输出已经格式化好的一行(包括结尾的换行)，供 BinaryLogger 的后台线程使用
+  void output(int level, const char *line, size_t len) { output_(level, line, len); }
+  // 格式化行首 "[级别]时间 [模块] : "，返回长度
+  static size_t formatPrefix(char *buf, size_t len, int level, Timestamp time, const LogModule *module);
+
+  // 设置输出目标，应在启动 loop 线程之前设置
+  void setOutput(const OutputFunc &output) { output_ = output; }
+  void setFlush(const FlushFunc &flush) { flush_ = flush; }
+
+private:
+  friend class LogModule;
+
+  Logger();
+  void registerModule(LogModule *module);
+  void unregisterModule(LogModule *module);
+
+  static std::atomic<int> g_logLevel;
+
+  OutputFunc output_;
+  FlushFunc flush_;
+
+  // 已构造的模块和按名字单独设置的级别，只在设置级别和模块构造/析构时访问
+  std::mutex mutex_;
+  std::vector<LogModule *> modules_;
+  std::unordered_map<std::string, int> moduleLevels_;
+};
+
+/*
+ * 日志模块：一组可以单独调整级别的日志语句，一般定义为编译单元内的静态对象
+ *   static LogModule g_tcpLog("tcp");
+ *   LOG_MODULE_DEBUG(g_tcpLog, "fd=%d", fd);
+ *   Logger::setModuleLevel("tcp", DEBUG);
+ * level_ 总是保存生效的级别(单独设置的级别或者全局级别)，所以模块的判断和全局的一样只有一次比较
+ */
+class LogModule : noncopyable {
+public:
+  explicit LogModule(const char *name);
+  ~LogModule();
+
+  const char *name() const { return name_; }
+  bool enabled(int level) const { return level >= level_.load(std::memory_order_relaxed); }
 
 private:
-  int logLevel_;
-  Logger(){}
-};
\ No newline at end of file
+  friend class Logger;
+
+  const char *name_;
+  std::atomic<int> level_;
+  bool inherit_; // 是否跟随全局级别，由 Logger::mutex_ 保护
+};
+
+#define LOG_AT(level, LogmsgFormat, ...)\
+  do {\
+    if (Logger::enabled(level)) {\
+      Logger::instance().log(level, nullptr, LogmsgFormat, ##__VA_ARGS__);\
+    }\
+  } while(0)
+
+#define LOG_MODULE_AT(module, level, LogmsgFormat, ...)\
+  do {\
+    if ((module).enabled(level)) {\
+      Logger::instance().log(level, &(module), LogmsgFormat, ##__VA_ARGS__);\
+    }\
+  } while(0)
+
+// LOG_INFO("%s %d", arg1, arg2)
+#define LOG_DEBUG(LogmsgFormat, ...) LOG_AT(DEBUG, LogmsgFormat, ##__VA_ARGS__)
+#define LOG_INFO(LogmsgFormat, ...) LOG_AT(INFO, LogmsgFormat, ##__VA_ARGS__)
+#define LOG_ERROR(LogmsgFormat, ...) LOG_AT(ERROR, LogmsgFormat, ##__VA_ARGS__)
+
+// FATAL 不受级别限制，总是输出并退出进程
+#define LOG_FATAL(LogmsgFormat, ...)\
+  do {\
+    Logger &logger = Logger::instance();\
+    logger.log(FATAL, nullptr, LogmsgFormat, ##__VA_ARGS__);\
+    logger.flush();\
+    exit(-1);\
+  } while(0)
+
+#define LOG_MODULE_DEBUG(module, LogmsgFormat, ...) LOG_MODULE_AT(module, DEBUG, LogmsgFormat, ##__VA_ARGS__)
+#define LOG_MODULE_INFO(module, LogmsgFormat, ...) LOG_MODULE_AT(module, INFO, LogmsgFormat, ##__VA_ARGS__)
+#define LOG_MODULE_ERROR(module, LogmsgFormat, ...) LOG_MODULE_AT(module, ERROR, LogmsgFormat, ##__VA_ARGS__)
@@ -0,0 +1,57 @@
+#pragma once
+#include "Buffer.h"
+
+#include <memory>
+#include <stddef.h>
+#include <string>
+#include <utility>
+
+/*
+ * 引用计数的不可变数据片段：多个连接的发送队列可以引用同一份数据，而不是各自拷贝一份
+ * 拷贝 PayloadSlice 只增加引用计数(一次原子操作)，底层存储在最后一个引用释放时回收
+ * 典型用法是广播：消息只编码一次，TcpConnection::send(const PayloadSlice&) 把片段挂在连接的发送队列上，
+ * 写出时直接从共享的存储 writev，不经过各连接的 outputBuffer_
+ * 存储创建后不再修改，可以在任意线程之间传递和读取
+ */
+class PayloadSlice {
+public:
+  PayloadSlice() : offset_(0), size_(0) {}
+  // 接管 data 的内容(移动，不拷贝)
+  explicit PayloadSlice(std::string &&data)
+      : storage_(std::make_shared<const std::string>(std::move(data))), offset_(0), size_(storage_->size()) {}
+  // 引用 storage 中 [offset, offset + len) 的部分
+  PayloadSlice(const std::shared_ptr<const std::string> &storage, size_t offset, size_t len)
+      : storage_(storage), offset_(offset), size_(len) {}
+  explicit PayloadSlice(const std::shared_ptr<const std::string> &storage)
+      : storage_(storage), offset_(0), size_(storage ? storage->size() : 0) {}
+
+  // 拷贝一次数据生成片段
+  static PayloadSlice copyOf(const void *data, size_t len) {
+    return PayloadSlice(std::string(static_cast<const char *>(data), len));
+  }
+  // 取走 buf 中所有可读数据生成片段，调用后 buf 为空
+  static PayloadSlice take(Buffer *buf) { return PayloadSlice(buf->retrieveAllAsString()); }
+
+  const char *data() const { return size_ > 0 ? storage_->data() + offset_ : ""; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // 共享同一存储的子片段，offset 和 len 超出范围时截断
+  PayloadSlice slice(size_t offset, size_t len) const {
+    if (offset > size_) {
+      offset = size_;
+    }
+    if (len > size_ - offset) {
+      len = size_ - offset;
+    }
+    return PayloadSlice(storage_, offset_ + offset, len);
+  }
+
+  // 共享这份存储的片段数，用于统计和调试
+  long useCount() const { return storage_.use_count(); }
+
+private:
+  std::shared_ptr<const std::string> storage_;
+  size_t offset_;
+  size_t size_;
+};
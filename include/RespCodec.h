@@ -0,0 +1,149 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <strings.h>
+#include <sys/types.h>
+#include <vector>
+
+class Buffer;
+
+/*
+ * Redis 序列化协议(RESP2/RESP3)的流式编解码
+ *   RespCommandParser  服务端：在 Buffer::peek() 上增量解析命令(多条 bulk string 组成的数组，或者内联命令)，不拷贝参数
+ *   RespReader         客户端：解析任意 RESP2/RESP3 回复
+ *   RespWriter         把命令或回复直接编码到 Buffer 中
+ */
+
+// 指向缓冲区中一段数据的引用，不拥有内存
+struct RespSlice {
+  RespSlice() : data(""), size(0) {}
+  RespSlice(const char *d, size_t n) : data(d), size(n) {}
+
+  std::string toString() const { return std::string(data, size); }
+  bool equalsIgnoreCase(const char *s) const {
+    size_t n = ::strlen(s);
+    return size == n && ::strncasecmp(data, s, n) == 0;
+  }
+
+  const char *data;
+  size_t size;
+};
+
+/*
+ * 一条命令，参数以偏移量记录，命令完整后由 RespCommandParser 设置基址
+ * arg 返回的 RespSlice 指向连接的 inputBuffer_，只在 retrieve 之前有效
+ */
+class RespCommand {
+public:
+  RespCommand() : base_("") {}
+
+  size_t argc() const { return args_.size(); }
+  RespSlice arg(size_t i) const { return RespSlice(base_ + args_[i].offset, args_[i].length); }
+  // 命令名(第一个参数)是否为 name，大小写不敏感
+  bool is(const char *name) const { return !args_.empty() && arg(0).equalsIgnoreCase(name); }
+
+  void reset() {
+    base_ = "";
+    args_.clear(); // 保留容量，下一条命令不再分配
+  }
+
+private:
+  friend class RespCommandParser;
+  struct Range {
+    size_t offset;
+    size_t length;
+  };
+
+  const char *base_;
+  std::vector<Range> args_;
+};
+
+// 可恢复的命令解析器，数据不完整时记住位置，下次从该位置继续；流水线上的多条命令逐条解析
+class RespCommandParser {
+public:
+  enum Result { kNeedMore, kComplete, kError };
+
+  static const size_t kDefaultMaxBulkBytes = 64 * 1024 * 1024;
+  static const size_t kMaxLineBytes = 64 * 1024;  // 数组头、bulk 头和内联命令的最大长度
+  static const int64_t kMaxArgs = 1024 * 1024;
+
+  explicit RespCommandParser(size_t maxBulkBytes = kDefaultMaxBulkBytes);
+
+  // kComplete 时命令占用缓冲区开头的 consumed() 个字节，处理完后由调用者 retrieve 并 reset
+  Result parse(const Buffer *buf, RespCommand *command);
+  size_t consumed() const { return pos_; }
+  // kError 时的错误描述，可以作为 -ERR 回复
+  const char *error() const { return error_; }
+  void reset();
+
+private:
+  enum State { kStart, kArgHeader, kArgData };
+
+  // 从 pos_ 开始查找 CRLF 结尾的一行，找到时返回 true，[pos_, *lineEnd) 是去掉 CRLF 的内容
+  bool findLine(const char *data, size_t readable, size_t *lineEnd);
+  Result parseInline(const char *data, size_t lineEnd, RespCommand *command);
+  Result fail(const char *error) {
+    error_ = error;
+    return kError;
+  }
+
+  const size_t maxBulkBytes_;
+  State state_;
+  size_t pos_;
+  size_t scan_;        // 查找行尾的起始位置
+  int64_t expected_;   // 数组中的参数个数
+  size_t bulkLength_;  // 当前 bulk string 的长度
+  const char *error_;
+};
+
+// 一个 RESP 值，字符串指向被解析的数据，嵌套的元素保存在 elements 中(map 按 key、value 交替展开)
+struct RespValue {
+  enum Type {
+    kSimpleString, kError, kInteger, kBulkString, kArray, kNull,
+    // 以下是 RESP3 新增的类型
+    kBoolean, kDouble, kBigNumber, kBulkError, kVerbatimString, kMap, kSet, kPush
+  };
+
+  bool isError() const { return type == kError || type == kBulkError; }
+
+  Type type;
+  RespSlice str;       // 字符串类、错误、大数和浮点数的原始文本
+  int64_t integer;     // kInteger，kBoolean 时为 0/1
+  double number;       // kDouble
+  std::vector<RespValue> elements;
+};
+
+class RespReader {
+public:
+  static const int kMaxDepth = 64;
+
+  // 从 data 开头解析一个完整的值：成功时返回占用的字节数，数据不完整时返回 0，格式错误时返回 -1
+  // RESP3 的属性(|)被跳过，value 是属性之后的值
+  static ssize_t read(const char *data, size_t len, RespValue *value);
+};
+
+/*
+ * 编码：protocol 为 2 或 3，RESP3 特有的类型在 RESP2 连接上按 Redis 的方式降级
+ * (null → $-1，map → 2n 个元素的数组，boolean → 整数，double → bulk string)
+ */
+class RespWriter {
+public:
+  static void appendSimpleString(Buffer *buf, const char *s, size_t len);
+  static void appendSimpleString(Buffer *buf, const char *s);
+  static void appendError(Buffer *buf, const char *message);
+  static void appendInteger(Buffer *buf, int64_t value);
+  static void appendBulkString(Buffer *buf, const char *s, size_t len);
+  static void appendBulkString(Buffer *buf, const std::string &s) { appendBulkString(buf, s.data(), s.size()); }
+  static void appendNull(Buffer *buf, int protocol);
+  static void appendArrayHeader(Buffer *buf, size_t count);
+  static void appendMapHeader(Buffer *buf, size_t count, int protocol);
+  static void appendBoolean(Buffer *buf, bool value, int protocol);
+  static void appendDouble(Buffer *buf, double value, int protocol);
+
+  // 客户端：把 argc 个参数编码成一条命令
+  static void appendCommand(Buffer *buf, size_t argc, const char *const *argv, const size_t *argvLen);
+  static void appendCommand(Buffer *buf, const std::vector<std::string> &args);
+};
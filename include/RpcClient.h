@@ -0,0 +1,84 @@
+#pragma once
+#include "Callbacks.h"
+#include "TcpClient.h"
+#include "noncopyable.h"
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// 一次调用的结果，data 指向输入缓冲区，只在回调执行期间有效
+struct RpcResult {
+  enum Status {
+    kOk,           // 调用成功，data 是回复
+    kError,        // 服务端回复错误(比如方法不存在)，data 是错误信息
+    kTimeout,      // 超过期限没有收到回复，之后到达的回复被丢弃
+    kDisconnected  // 连接没有建立或者在回复到达前断开
+  };
+
+  bool ok() const { return status == kOk; }
+  std::string toString() const { return std::string(data, size); }
+
+  Status status;
+  uint64_t id;
+  const char *data;
+  size_t size;
+};
+
+// future 形式调用的结果，拥有回复数据
+struct RpcReply {
+  bool ok() const { return status == RpcResult::kOk; }
+
+  RpcResult::Status status;
+  std::string data;
+};
+
+/*
+ * RPC 客户端，一个连接上可以同时有任意多个调用在途，回复按请求 ID 匹配，可以乱序到达
+ * 调用表属于客户端所在的 loop，只在该 loop 线程中访问，不加锁；需要在多个 loop 上发起调用时每个 loop 各建一个 RpcClient
+ * 在 loop 线程中调用时：请求帧直接写入 outputBuffer_(auto-cork，同一轮循环中的请求合并成一次写)，
+ * 调用记录放在复用的槽位中，超时用复用的最小堆管理，稳定状态下每次调用不分配内存
+ * (回调本身的 std::function 捕获不超过两个指针时也不分配)；在其他线程中调用时转到 loop 线程执行，需要拷贝参数
+ */
+class RpcClient : noncopyable {
+public:
+  using Callback = std::function<void(const RpcResult &)>;
+
+  static constexpr double kDefaultTimeout = 5.0;
+  // 超时检查的间隔，即超时的精度
+  static constexpr double kTimeoutResolution = 0.01;
+
+  RpcClient(EventLoop *loop, const InetAddress &serverAddr, const std::string &name);
+  ~RpcClient();
+
+  void connect() { client_.connect(); }
+  void disconnect() { client_.disconnect(); }
+  void enableRetry() { client_.enableRetry(); }
+  // 连接建立和断开时在 loop 线程中调用，需要在 connect 之前设置
+  void setConnectionCallback(const ConnectionCallback &cb);
+  bool connected() const {
+    TcpConnectionPtr conn = client_.connection();
+    return conn && conn->connected();
+  }
+  EventLoop *getLoop() const { return client_.getLoop(); }
+
+  // 发起调用，可以跨线程调用，cb 在 loop 线程中执行；timeout 秒内没有回复时以 kTimeout 结束
+  void call(const char *method, const char *payload, size_t len, Callback cb, double timeout = kDefaultTimeout);
+  void call(const char *method, const std::string &payload, Callback cb, double timeout = kDefaultTimeout) {
+    call(method, payload.data(), payload.size(), std::move(cb), timeout);
+  }
+  // future 形式的调用，不能在 loop 线程中等待结果
+  std::future<RpcReply> call(const char *method, const std::string &payload, double timeout = kDefaultTimeout);
+
+  // 在途调用数，只能在 loop 线程中调用
+  size_t inflight() const;
+
+private:
+  class CallTable;
+
+  std::shared_ptr<CallTable> table_; // 由连接的回调共同持有，连接可能比 RpcClient 活得久
+  TcpClient client_;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Buffer;
+
+/*
+ * RPC 帧格式(整数都是网络字节序)：
+ *   +----------+--------+--------+--------------------------+---------+
+ *   | length 4 | id 8   | type 1 | methodLen 1 + method     | payload |
+ *   +----------+--------+--------+--------------------------+---------+
+ * length 是其后的字节数；method 部分只在请求帧中出现
+ * 响应帧的 id 与请求相同，一个连接上可以同时有任意多个请求在途，响应可以乱序到达
+ */
+struct RpcFrame {
+  enum Type { kRequest = 0, kResponse = 1, kError = 2 };
+
+  Type type;
+  uint64_t id;
+  const char *method;
+  size_t methodLen;
+  const char *payload; // 指向输入缓冲区，只在处理这一帧期间有效
+  size_t payloadLen;
+  size_t frameSize;    // 整个帧占用的字节数，处理完后从缓冲区 retrieve
+};
+
+class RpcCodec {
+public:
+  enum Result { kNeedMore, kFrame, kBadFrame };
+
+  static const size_t kLengthSize = 4;
+  static const size_t kHeaderSize = kLengthSize + 8 + 1;
+  static const size_t kMaxMethodLen = 255;
+  static const size_t kDefaultMaxFrameSize = 64 * 1024 * 1024;
+
+  // 从 data 开头解析一帧，不拷贝数据；帧长度超过 maxFrameSize 或格式错误时返回 kBadFrame
+  static Result parse(const char *data, size_t len, size_t maxFrameSize, RpcFrame *frame);
+
+  // 把请求/响应帧直接追加到 buf 中
+  static void appendRequest(Buffer *buf, uint64_t id, const char *method, size_t methodLen,
+                            const char *payload, size_t payloadLen);
+  static void appendResponse(Buffer *buf, RpcFrame::Type type, uint64_t id, const char *payload,
+                             size_t payloadLen);
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include "Callbacks.h"
+#include "RpcCodec.h"
+#include "TcpServer.h"
+#include "noncopyable.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * 回复一个 RPC 请求，可以拷贝后在方法返回之后(比如等待后端结果)再回复，每个请求只能回复一次
+ * 在连接所在的 loop 线程中回复时帧直接写入 outputBuffer_，本轮循环末尾与其他回复合并成一次写；
+ * 在其他线程中回复时编码后交给 TcpConnection::send；连接已经关闭时回复被丢弃
+ */
+class RpcResponder {
+public:
+  RpcResponder() : id_(0) {}
+
+  void reply(const char *data, size_t len) const { send(RpcFrame::kResponse, data, len); }
+  void reply(const std::string &data) const { reply(data.data(), data.size()); }
+  // 回复错误，调用方收到 RpcResult::kError，message 作为结果数据
+  void fail(const std::string &message) const { send(RpcFrame::kError, message.data(), message.size()); }
+
+  uint64_t id() const { return id_; }
+  TcpConnectionPtr connection() const { return conn_.lock(); }
+
+private:
+  friend class RpcServer;
+  RpcResponder(const TcpConnectionPtr &conn, uint64_t id) : conn_(conn), id_(id) {}
+  void send(RpcFrame::Type type, const char *data, size_t len) const;
+
+  std::weak_ptr<TcpConnection> conn_;
+  uint64_t id_;
+};
+
+/*
+ * 基于 TcpServer 的 RPC 服务端，按方法名分发请求
+ * 一次读到的多个请求帧依次分发，请求帧直接在 inputBuffer_ 上解析，方法查找、回复编码都不分配内存
+ * 连接开启 auto-cork，同一轮循环中的回复合并成一次写
+ */
+class RpcServer : noncopyable {
+public:
+  // payload 指向输入缓冲区，只在方法执行期间有效
+  using Method = std::function<void(const char *payload, size_t len, const RpcResponder &responder)>;
+
+  RpcServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &name,
+            TcpServer::Option option = TcpServer::kNoReusePort);
+
+  // 注册方法，方法名不超过 RpcCodec::kMaxMethodLen 字节，需要在 start 之前调用
+  void registerMethod(const std::string &name, const Method &method);
+  void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+  void setMaxFrameSize(size_t bytes) { maxFrameSize_ = bytes; }
+  // 底层的 TcpServer，用于设置 socket 选项、限速和优雅停止等
+  TcpServer *server() { return &server_; }
+
+  void start();
+
+private:
+  void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+  void dispatch(const TcpConnectionPtr &conn, const RpcFrame &frame);
+  // 按方法名二分查找，未注册时返回 nullptr
+  const Method *findMethod(const char *name, size_t len) const;
+
+  TcpServer server_;
+  size_t maxFrameSize_;
+  std::vector<std::pair<std::string, Method>> methods_; // 按方法名排序
+};
@@ -6,6 +6,7 @@
  */
 
 class InetAddress;
+struct SocketOptions;
 
 class Socket : noncopyable {
 public:
@@ -15,7 +16,7 @@ public:
 
   int fd() const { return sockfd_; }
   void bindAddress(const InetAddress &localaddr);
-  void listen();
+  void listen(int backlog = 1024);
   int accept(InetAddress *peeraddr);
 
   void shutdownWrite();
@@ -24,6 +25,15 @@ public:
   void setReuseAddr(bool on);
   void setReusePort(bool on);
   void setKeepAlive(bool on);
+  void setSendBufferSize(int bytes);
+  void setRecvBufferSize(int bytes);
+  void setNotSentLowat(int bytes);
+  void setQuickAck(bool on);
+  void setDeferAccept(int seconds);
+  void setFastOpen(int queueLength);
+  // 按 SocketOptions 设置监听/已连接 socket 的选项，取默认值的选项不做系统调用
+  void applyListenOptions(const SocketOptions &options);
+  void applyConnectionOptions(const SocketOptions &options);
   static int getSocketError(int sockfd);
 
 private:
@@ -0,0 +1,36 @@
+#pragma once
+
+/*
+ * TcpServer 的 socket 选项策略
+ * 监听相关的选项(backlog、TCP_DEFER_ACCEPT、TCP_FASTOPEN)在 listen 时作用于 listenfd；
+ * 缓冲区大小也设置在 listenfd 上，由 accept 得到的连接继承(必须在 listen 之前设置才能协商窗口扩大因子)；
+ * 其余选项在每个新连接建立时作用于 connfd
+ * 取值为 0/false 的选项保持内核默认值，不做系统调用(keepAlive 默认开启，与之前的行为一致)
+ * 监听 Unix 域 socket 时 TCP 级别的选项(TCP_*)不起作用，setsockopt 失败会被忽略
+ */
+
+struct SocketOptions {
+  SocketOptions()
+      : backlog(1024)
+      , deferAcceptSeconds(0)
+      , fastOpenQueue(0)
+      , sendBufferSize(0)
+      , recvBufferSize(0)
+      , tcpNoDelay(false)
+      , keepAlive(true)
+      , notSentLowat(0)
+      , quickAck(false) {}
+
+  // listenfd
+  int backlog;            // listen 的 backlog
+  int deferAcceptSeconds; // TCP_DEFER_ACCEPT：客户端发来数据(或超时)后 accept 才返回
+  int fastOpenQueue;      // TCP_FASTOPEN：TFO 请求队列长度，需要内核 net.ipv4.tcp_fastopen 开启服务端支持
+  int sendBufferSize;     // SO_SNDBUF(字节)
+  int recvBufferSize;     // SO_RCVBUF(字节)
+
+  // connfd
+  bool tcpNoDelay;        // TCP_NODELAY：关闭 Nagle 算法
+  bool keepAlive;         // SO_KEEPALIVE
+  int notSentLowat;       // TCP_NOTSENT_LOWAT(字节)：内核中未发送的数据低于该值时才报告可写，减少发送队列中的排队延迟
+  bool quickAck;          // TCP_QUICKACK：立即发送 ACK，内核会在之后自动恢复延迟 ACK，所以只影响连接建立后的一段时间
+};
@@ -0,0 +1,74 @@
+#pragma once
+/*
+ * 对外的客户端编程使用的类
+ * 通过 Connector 在 loop 中非阻塞地发起连接，连接成功后和 TcpServer 一样用 TcpConnection 收发数据
+ * 一个 TcpClient 同时最多管理一个连接
+ */
+
+#include "Callbacks.h"
+#include "Connector.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "SocketOptions.h"
+#include "TcpConnection.h"
+#include "noncopyable.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+class TcpClient : noncopyable {
+public:
+  // 连接失败时调用，参数是失败原因的 errno，见 Connector::ConnectFailedCallback
+  using ConnectFailedCallback = Connector::ConnectFailedCallback;
+
+  TcpClient(EventLoop *loop, const InetAddress &serverAddr, const std::string &nameArg);
+  ~TcpClient();
+
+  void connect();    // 发起连接，可以跨线程调用
+  void disconnect(); // 关闭已建立的连接(shutdown 写端)，可以跨线程调用
+  void stop();       // 停止正在进行的连接和重试，可以跨线程调用
+
+  TcpConnectionPtr connection() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return connection_;
+  }
+
+  EventLoop *getLoop() const { return loop_; }
+  const std::string &name() const { return name_; }
+  bool retry() const { return retry_; }
+  // 已建立的连接断开后自动重新连接
+  void enableRetry() { retry_ = true; }
+  // 连接失败的重试间隔，见 Connector::setRetryDelay，在 connect 之前设置
+  void setRetryDelay(int initRetryDelayMs, int maxRetryDelayMs) {
+    connector_->setRetryDelay(initRetryDelayMs, maxRetryDelayMs);
+  }
+  // 连接建立后作用于 connfd 的 socket 选项，只使用其中的连接级选项
+  void setSocketOptions(const SocketOptions &options) { socketOptions_ = options; }
+
+  // 以下回调都不是线程安全的，需要在 connect 之前设置
+  void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+  void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+  void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+  void setConnectFailedCallback(const ConnectFailedCallback &cb) {
+    connector_->setConnectFailedCallback(cb);
+  }
+
+private:
+  // 在 loop 线程中执行
+  void newConnection(int sockfd);
+  void removeConnection(const TcpConnectionPtr &conn);
+
+  EventLoop *loop_;
+  ConnectorPtr connector_;
+  const std::string name_;
+  ConnectionCallback connectionCallback_;
+  MessageCallback messageCallback_;
+  WriteCompleteCallback writeCompleteCallback_;
+  SocketOptions socketOptions_;
+  std::atomic_bool retry_;
+  std::atomic_bool connect_;
+  int nextConnId_;              // 只在 loop 线程中访问
+  mutable std::mutex mutex_;
+  TcpConnectionPtr connection_; // 由 mutex_ 保护
+};
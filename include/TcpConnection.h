@@ -2,15 +2,21 @@
 #include "Buffer.h"
 #include "Callbacks.h"
 #include "InetAddress.h"
+#include "PayloadSlice.h"
 #include "noncopyable.h"
 
 #include <atomic>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
 
 class Socket;
 class Channel;
 class EventLoop;
+class TokenBucket;
+class TcpRelay;
+struct SocketOptions;
 
 /*
  * 一个连接成功的客户端对应一个 TcpConnection
@@ -23,20 +29,67 @@ class TcpConnection : noncopyable,
 public:
   TcpConnection(EventLoop *loop, const std::string &nameArg, int sockfd,
                 const InetAddress &localAddr, const InetAddress &peerAddr);
+  // TcpServer 使用：id 是连接表中的连接 ID，名字在第一次调用 name() 时才由 *namePrefix + seq 格式化，
+  // 所有连接共享同一个 namePrefix，建立连接时不需要格式化和分配字符串
+  TcpConnection(EventLoop *loop, uint64_t id, const std::shared_ptr<const std::string> &namePrefix,
+                int64_t seq, int sockfd, const InetAddress &localAddr, const InetAddress &peerAddr);
   ~TcpConnection();
 
-  EventLoop *getLoop() const { return loop_; }
-  const std::string &name() const { return name_; }
+  // 连接可能被迁移到其他 loop，所以 loop_ 是原子的
+  EventLoop *getLoop() const { return loop_.load(std::memory_order_acquire); }
+  uint64_t id() const { return id_; }
+  const std::string &name() const;
   const InetAddress &localAddress() const { return localAddr_; }
   const InetAddress &peerAddress() const { return peerAddr_; }
 
   bool connected() const { return state_ == kConnected; }
   bool disconnected() const { return state_ == kDisconnected; }
 
-  // 发送数据
+  // 只能在 loop 所在线程中访问
+  Buffer *inputBuffer() { return &inputBuffer_; }
+  Buffer *outputBuffer() { return &outputBuffer_; }
+
+  // 发送数据，可以跨线程调用
+  // 在 loop 线程中调用时都直接发送，不拷贝；跨线程调用时各重载最多拷贝一次数据：
+  // const std::string& 和 (data, len) 拷贝一次；std::string&& 移动；
+  // Buffer* 交换底层存储(调用后 buf 为空)；shared_ptr<const std::string> 只增加引用计数
   void send(const std::string &buf);
-  // 关闭连接
+  void send(std::string &&buf);
+  void send(const void *data, size_t len);
+  void send(Buffer *buf);
+  void send(const std::shared_ptr<const std::string> &buf);
+  // 发送共享的不可变数据，不拷贝到 outputBuffer_：片段挂在发送队列上，写出时直接从共享存储 writev，
+  // 同一份数据广播给大量连接时内存和拷贝开销与连接数无关；短于 kInlinePayloadSize 的片段直接拷贝，
+  // 跨线程调用只增加引用计数
+  void send(const PayloadSlice &payload);
+  // 发送文件 fd 中 [offset, offset + count) 的内容，用 sendfile 由内核直接从页缓存发送，不经过用户态
+  // 排在此前 send 的数据之后、此后 send 的数据之前；连接接管 fd，发送完或连接关闭时关闭它，可以跨线程调用
+  void sendFile(int fd, off_t offset, size_t count);
+  // 发送直接写入 outputBuffer() 的数据(比如直接序列化到输出缓冲区的响应)，只能在 loop 线程中调用
+  void flush();
+  // 关闭连接：outputBuffer_ 中的数据发送完后关闭写端(半关闭)，等对端关闭后连接才真正关闭
   void shutdown();
+  // 立即关闭连接，不再等待 outputBuffer_ 中的数据发送完，也不等对端关闭，可以跨线程调用
+  void forceClose();
+
+  // 暂停/恢复读取，可以跨线程调用
+  // 停读后数据留在内核接收缓冲区，TCP 窗口收缩，由协议本身对发送方产生背压
+  void startRead();
+  void stopRead();
+  // 只能在 loop 线程中访问
+  bool isReading() const { return reading_; }
+  // 等待写出的字节数：outputBuffer_ 加上发送队列中引用的数据(不含 sendFile 的文件)，只能在 loop 线程中访问
+  size_t pendingBytes() const { return outputBuffer_.readableBytes() + queuedPayloadBytes_; }
+  // outputBuffer_ 和发送队列(包括 sendFile 的文件)都已写完，所有数据都交给了内核，只能在 loop 线程中访问
+  bool outputDrained() const { return 0 == outputBuffer_.readableBytes() && pendingSegments_.empty(); }
+
+  // 短于这个长度的 PayloadSlice 直接拷贝进 outputBuffer_，与前后的数据合并写出，比排队引用更省
+  static const size_t kInlinePayloadSize = 256;
+
+  // 背压关联(比如代理中 source 的数据转发到本连接)：本连接 outputBuffer_ 中待发送的数据达到 highWaterMark 时
+  // 让 source 停读，发送到 lowWaterMark 以下时恢复 source 的读取，两个连接可以在不同的 loop 中
+  // 这样 outputBuffer_ 的大小有上界，背压经由 TCP 窗口一路传到最初的发送方；source 为空时解除关联
+  void setBackpressure(const TcpConnectionPtr &source, size_t highWaterMark, size_t lowWaterMark);
 
   // 设置回调
   void setConnectionCallback(const ConnectionCallback &cb) {
@@ -55,6 +108,40 @@ public:
   }
   void setCloseCallback(const CloseCallback &cb) { closeCallback_ = std::move(cb); }
 
+  // 带宽限制，可以跨线程调用，运行时随时调整；rate <= 0 表示取消限制，burst <= 0 时取 100ms 的流量
+  // 令牌不足时不再注册 EPOLLOUT(读方向则暂停读取)，连接挂在所在 loop 的限速队列上，由 loop 的定时 tick 检查令牌后恢复
+  // 读方向的限速与 startRead/stopRead 相互独立，两者都允许时才会读取
+  void setSendRate(double bytesPerSecond, double burst = 0);
+  void setReadRate(double bytesPerSecond, double burst = 0);
+  // 多个连接共享的令牌桶(比如 TcpServer 的总带宽)，与连接自己的限制同时生效，nullptr 表示取消
+  void setSharedSendBucket(const std::shared_ptr<TokenBucket> &bucket);
+  void setSharedReadBucket(const std::shared_ptr<TokenBucket> &bucket);
+  // 因限速而暂停写/读的累计时间(微秒)，正在进行的暂停结束后才计入，可以跨线程调用
+  int64_t sendThrottledUs() const { return sendThrottledUs_.load(std::memory_order_relaxed); }
+  int64_t readThrottledUs() const { return readThrottledUs_.load(std::memory_order_relaxed); }
+
+  // socket 选项，可以跨线程调用(setsockopt 本身是线程安全的)，用于在运行时覆盖 TcpServer 的 SocketOptions
+  // applySocketOptions 只设置 options 中取非默认值的连接级选项
+  void applySocketOptions(const SocketOptions &options);
+  void setTcpNoDelay(bool on);
+  void setKeepAlive(bool on);
+  void setQuickAck(bool on);
+  void setNotSentLowat(int bytes);
+  void setSendBufferSize(int bytes);
+  void setRecvBufferSize(int bytes);
+
+  // auto-cork 模式：一轮循环内的多次 send 只追加到 outputBuffer_，在本轮循环末尾合并成一次写
+  // 减少小消息的系统调用次数和 TCP 小包数量，只能在 loop 线程中或连接建立前设置
+  void setAutoCork(bool on) { autoCork_ = on; }
+
+  // 把连接迁移到 newLoop，可以跨线程调用
+  // channel 的注册、输入输出缓冲区和回调都随连接一起迁移，迁移期间内核缓冲区暂存数据，不会丢失字节
+  // 迁移前已经排队的 writeComplete/highWaterMark 回调也转交给新 loop 执行
+  void migrateTo(EventLoop *newLoop);
+
+  // 自上次调用以来该连接收发的字节数，用于挑选需要迁移的热点连接
+  int64_t takeTrafficSample() { return traffic_.exchange(0, std::memory_order_relaxed); }
+
   // 连接建立
   void connectEstablished();
   // 连接销毁
@@ -70,12 +157,53 @@ private:
   void handleError();
 
   void sendInLoop(const void *data, size_t len);
+  void sendString(const std::string &data) { sendInLoop(data.data(), data.size()); }
+  void sendBuffer(const std::shared_ptr<Buffer> &buf) { sendInLoop(buf->peek(), buf->readableBytes()); }
+  void sendPayloadInLoop(const PayloadSlice &payload);
+  void sendFileInLoop(int fd, off_t offset, size_t count);
   void shutdownInLoop();
+  void forceCloseInLoop();
+  void flushCorked();
+  void startReadInLoop();
+  void stopReadInLoop();
+  void setBackpressureInLoop(const std::weak_ptr<TcpConnection> &source, size_t highWaterMark,
+                             size_t lowWaterMark);
+  void updateBackpressure();
+  void setRateInLoop(bool send, double bytesPerSecond, double burst);
+  void setSharedBucketInLoop(bool send, const std::shared_ptr<TokenBucket> &bucket);
+  size_t sendQuota();
+  size_t readQuota();
+  ssize_t writeOutput(int *savedErrno);
+  void consumeOutput(size_t n);
+  void flushOutput();
+  void clearPendingSegments();
+  void enableWritingOrThrottle();
+  void throttleWrite();
+  void throttleRead();
+  void parkThrottled();
+  void onThrottleTick();
+  void tryResumeThrottled();
+  static void throttleTick();
+  void migrateInLoop(EventLoop *newLoop);
+  void attachInLoop(bool reading, bool writing);
+  // 排队执行 writeCompleteCallback_/highWaterMarkCallback_，排队期间连接被迁移时在新 loop 中执行
+  void queueWriteComplete();
+  void writeCompleteInLoop(const WriteCompleteCallback &cb);
+  void queueHighWaterMark(size_t len);
+  void highWaterMarkInLoop(const HighWaterMarkCallback &cb, size_t len);
+  friend class TcpRelay;
+  void addTraffic(size_t n) {
+    traffic_.store(traffic_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
 
-  EventLoop *loop_; // 这里绝对不是 mainLoop，因为 TcpConnection 都是在 subLoop 中管理的
-  const std::string name_;
+  std::atomic<EventLoop *> loop_; // 这里绝对不是 mainLoop，因为 TcpConnection 都是在 subLoop 中管理的
+  const uint64_t id_;     // 连接 ID，不属于 TcpServer 的连接为 0
+  const std::shared_ptr<const std::string> namePrefix_;
+  const int64_t nameSeq_;
+  mutable std::string name_;          // namePrefix_ 不为空时由 name() 延迟格式化
+  mutable std::once_flag nameOnce_;
   std::atomic_int state_;
-  bool reading_;
+  bool reading_;          // 是否在读取数据，由 startRead/stopRead 控制
 
   // 和 Acceptor 类似， 只不过 Acceptor 在 mainLoop， 而 TcpConnection 在 subLoop
   std::unique_ptr<Socket> socket_;
@@ -94,4 +222,42 @@ private:
   size_t highWaterMark_;  // 高水位线避免发送过快
   Buffer inputBuffer_;    // 接收数据的缓冲区
   Buffer outputBuffer_;   // 发送数据的缓冲区
+  std::atomic<int64_t> traffic_; // 收发字节数，只由 loop 线程写
+  bool autoCork_;         // 是否合并一轮循环内的写
+  bool flushPending_;     // 是否已登记本轮循环末尾的 flush
+
+  // 背压关联的上游连接，以及本连接 outputBuffer_ 的高/低水位线，backpressureHigh_ 为 0 表示未关联
+  std::weak_ptr<TcpConnection> backpressureSource_;
+  size_t backpressureHigh_;
+  size_t backpressureLow_;
+  bool sourcePaused_;     // 是否已经让上游停读
+
+  // 带宽限制：连接自己的令牌桶和共享的令牌桶，为空表示不限制
+  std::shared_ptr<TokenBucket> sendBucket_;
+  std::shared_ptr<TokenBucket> sharedSendBucket_;
+  std::shared_ptr<TokenBucket> readBucket_;
+  std::shared_ptr<TokenBucket> sharedReadBucket_;
+  bool sendThrottled_;    // 令牌不足，暂停写
+  bool readThrottled_;    // 令牌不足，暂停读
+  bool throttleParked_;   // 是否已挂在 loop 的限速队列上
+  int64_t sendThrottledSince_;
+  int64_t readThrottledSince_;
+  std::atomic<int64_t> sendThrottledUs_;
+  std::atomic<int64_t> readThrottledUs_;
+
+  // 发送队列中不在 outputBuffer_ 里的数据：sendFile 的文件(fd >= 0)或 PayloadSlice 引用的共享数据(fd 为 -1)
+  // position 是它之前的 outputBuffer_ 数据在输出流中的结束位置(outputWritten_ 的计数)
+  struct PendingSegment {
+    int fd;
+    off_t offset;           // 文件：下一次 sendfile 的偏移；共享数据：已经写出的字节数
+    size_t remaining;
+    int64_t position;
+    PayloadSlice payload;
+  };
+  std::deque<PendingSegment> pendingSegments_;
+  int64_t outputWritten_; // 累计从 outputBuffer_ 写出的字节数
+  size_t queuedPayloadBytes_; // 发送队列中共享数据未写出的字节数
+
+  // splice 转发：不为空时读写事件都交给 relay 处理，见 TcpRelay
+  std::shared_ptr<TcpRelay> relay_;
 };
\ No newline at end of file
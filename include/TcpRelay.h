@@ -0,0 +1,69 @@
+#pragma once
+#include "Callbacks.h"
+#include "noncopyable.h"
+
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 两个 TcpConnection 之间基于 splice(2) 的零拷贝转发(L4 代理)
+ * 每个方向一个 pipe：src socket --splice--> pipe --splice--> dst socket，数据不经过用户态的 Buffer
+ * relay 接管两个连接的读写事件，连接的 messageCallback 不再被调用，限速和背压设置也不再生效
+ * 流量控制：pipe 满时停止读 src，pipe 中有数据而 dst 不可写时等待 dst 的 EPOLLOUT，pipe 容量就是每个方向在用户进程中的缓冲上限
+ * 半关闭：src 读到 EOF 且 pipe 中的数据全部写给 dst 后 shutdown(dst, SHUT_WR)，另一个方向继续转发；
+ * 两个方向都结束或任意一方出错时关闭两个连接
+ */
+
+class TcpConnection;
+
+class TcpRelay : noncopyable, public std::enable_shared_from_this<TcpRelay> {
+public:
+  static const size_t kDefaultPipeSize = 64 * 1024;
+
+  // 在 a、b 所在的 loop 线程中调用，两个连接必须属于同一个 loop 且都已建立
+  // 连接的 inputBuffer 中已经读到的数据先转给对方，之后的数据都用 splice 转发；失败时返回 nullptr
+  // relay 由两个连接持有，结束后自动释放；转发期间连接不会被迁移到其他 loop
+  static std::shared_ptr<TcpRelay> start(const TcpConnectionPtr &a, const TcpConnectionPtr &b,
+                                         size_t pipeSize = kDefaultPipeSize);
+
+  ~TcpRelay();
+
+  // 两个方向已经转发的字节数
+  int64_t bytesAtoB() const { return forward_.bytes; }
+  int64_t bytesBtoA() const { return backward_.bytes; }
+
+private:
+  friend class TcpConnection;
+
+  // 一个方向的转发状态
+  struct Direction {
+    Direction() : pipeRead(-1), pipeWrite(-1), capacity(0), inPipe(0), bytes(0), srcEof(false), dstShutdown(false) {}
+    int pipeRead;
+    int pipeWrite;
+    size_t capacity;  // pipe 容量
+    size_t inPipe;    // pipe 中待写给 dst 的字节数
+    int64_t bytes;
+    bool srcEof;      // src 已读到 EOF
+    bool dstShutdown; // 已经 shutdown(dst, SHUT_WR)
+  };
+
+  TcpRelay(const TcpConnectionPtr &a, const TcpConnectionPtr &b);
+  bool openPipe(Direction *dir, size_t pipeSize);
+
+  // 由 TcpConnection 的 handleRead/handleWrite 调用
+  void handleRead(TcpConnection *conn);
+  void handleWrite(TcpConnection *conn);
+  // 关闭两个连接，可以重复调用
+  void close();
+
+  // 在 src、dst 之间尽可能多地搬运数据，出错时返回 false
+  bool pump(Direction *dir, TcpConnection *src, TcpConnection *dst);
+  void updateInterest(TcpConnection *a, TcpConnection *b);
+
+  std::weak_ptr<TcpConnection> a_;
+  std::weak_ptr<TcpConnection> b_;
+  Direction forward_;  // a -> b
+  Direction backward_; // b -> a
+  bool closed_;
+};
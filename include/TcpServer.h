@@ -14,10 +14,14 @@
 #include "Buffer.h"
 #include "Acceptor.h"
 #include "Callbacks.h"
+#include "ConnectionRegistry.h"
 #include "EventLoop.h"
 #include "InetAddress.h"
 #include "TcpConnection.h"
+#include "EventLoopThread.h"
 #include "EventLoopThreadPool.h"
+#include "SocketOptions.h"
+#include "TokenBucket.h"
 
 #include <string>
 #include <memory>
@@ -28,6 +32,7 @@
 class TcpServer : noncopyable {
 public:
   using ThreadInitCallback = std::function<void(EventLoop *)>;
+  using StopCallback = std::function<void()>;
 
   enum Option {
     kNoReusePort,
@@ -44,10 +49,55 @@ public:
 
   // 设置底层 loop 个数
   void setThreadNum(int numThreads);
+  // socket 选项策略，见 SocketOptions；监听相关的选项需要在 start 之前设置，连接相关的选项作用于之后的新连接
+  // 已有连接可以通过 TcpConnection::setTcpNoDelay 等方法单独覆盖，只能在 baseLoop 中调用
+  void setSocketOptions(const SocketOptions &options);
+  const SocketOptions &socketOptions() const { return socketOptions_; }
+  // 新连接是否开启 auto-cork 合并写，见 TcpConnection::setAutoCork
+  void setAutoCork(bool on) { autoCork_ = on; }
 
   // 开启服务器监听(开启 Acceptor 的 listen)
   void start();
 
+  // 优雅停止，可以跨线程调用，只生效一次：
+  // 1. 停止监听(见 Acceptor::stop)，不再接受新连接
+  // 2. 在各个 subLoop 中并行地 shutdown 所有连接，outputBuffer_ 中的数据发完后半关闭，等待对端关闭
+  // 3. drainTimeout 秒后仍未关闭的连接被 forceClose；drainTimeout <= 0 时立即 forceClose
+  // 所有连接都关闭后在 baseLoop 中调用 cb，通常在 cb 中退出 baseLoop
+  void stop(double drainTimeout, const StopCallback &cb = StopCallback());
+
+  // 按连接 ID(TcpConnection::id) 查找连接，连接已关闭(即使 ID 的槽位已被新连接复用)时返回 nullptr
+  // 只能在 baseLoop 中调用
+  TcpConnectionPtr getConnection(uint64_t id) const {
+    const TcpConnectionPtr *conn = connections_.find(id);
+    return conn != nullptr ? *conn : TcpConnectionPtr();
+  }
+  size_t numConnections() const { return connections_.size(); }
+
+  // 开启连接的自动再均衡：每隔 interval 秒采样一次各 subLoop 的繁忙比例(busyTime / interval)，
+  // 最忙和最闲的 loop 相差超过 threshold 时，把最忙 loop 上的一个热点连接迁移到最闲的 loop
+  // 可以跨线程调用，采样和迁移决策都在 baseLoop 中执行
+  void enableRebalance(double interval, double threshold = 0.2);
+
+  // 运行时新增一个 subLoop，之后的新连接会轮询到它上面，可以跨线程调用
+  EventLoop *addSubLoop();
+  // 退役一个 subLoop(nullptr 表示最后一个)：不再给它分配新连接，把它上面的连接迁移到其他 loop，
+  // 正在关闭的连接等其自行关闭，loop 上没有连接后退出该线程，可以跨线程调用
+  void retireSubLoop(EventLoop *loop = nullptr);
+
+  // 开启线程池自动伸缩：每隔 interval 秒计算 subLoop 的平均繁忙比例，
+  // 高于 scaleUpRatio 时增加一个 subLoop，低于 scaleDownRatio 时退役最闲的一个，数量保持在 [minLoops, maxLoops]
+  void enableAutoScale(int minLoops, int maxLoops, double interval = 1.0,
+                       double scaleUpRatio = 0.75, double scaleDownRatio = 0.25);
+
+  // 带宽限制(字节/秒)，rate <= 0 表示取消，burst <= 0 时取 100ms 的流量，可以跨线程、在运行时随时调整
+  // Connection 系列限制每个连接各自的带宽，对已有连接和之后的新连接都生效，见 TcpConnection::setSendRate
+  // Total 系列限制整个服务器所有连接的总带宽，所有连接共享同一个令牌桶
+  void setConnectionSendRate(double bytesPerSecond, double burst = 0);
+  void setConnectionReadRate(double bytesPerSecond, double burst = 0);
+  void setTotalSendRate(double bytesPerSecond, double burst = 0);
+  void setTotalReadRate(double bytesPerSecond, double burst = 0);
+
 private:
   // 根据轮询算法，选择并唤醒一个 subLoop，将当前的 connfd 封装成 channel 分发给 subLoop，并设置回调
   // 该函数运行在主线程中，如果想执行子线程 loop 的回调，必须调用 QueueInLoop，通过 wakeupFd_ 唤醒相应的子线程
@@ -55,9 +105,27 @@ private:
 
   void removeConnection(const TcpConnectionPtr &conn);
   void removeConnectionInLoop(const TcpConnectionPtr &conn);
+  // 定时在 baseLoop 中执行的再均衡逻辑
+  void rebalance();
+  // 以下都在 baseLoop 中执行
+  void retireSubLoopInLoop(EventLoop *loop);
+  void checkRetiring(EventLoop *loop);
+  void finishRetire(EventLoop *loop);
+  void autoScale();
+  void setConnectionRateInLoop(bool send, double bytesPerSecond, double burst);
+  void setTotalRateInLoop(bool send, double bytesPerSecond, double burst);
+  void stopInLoop(double drainTimeout, const StopCallback &cb);
+  void forceCloseAll();
+  void checkStopped();
+
+  // 正在退役的 subLoop
+  struct RetiringLoop {
+    std::unique_ptr<EventLoopThread> thread;
+    TimerId timer; // 下一次检查 loop 上是否还有连接的定时器
+  };
+  static constexpr double kRetireCheckInterval = 0.1;
 
 
-  using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
   EventLoop *loop_;                                 // 用户定义的 baseLoop
 
   const std::string ipPort_;
@@ -75,6 +143,36 @@ private:
   ThreadInitCallback threadInitCallback_;           // loop 线程初始化时的回调
   std::atomic_int started_;
 
-  int nextConnId_;                                  // 在主线程中处理，不涉及多线程访问问题，所以不需要定义为原子整型
-  ConnectionMap connections_;                       // 保存所有的连接
+  bool autoCork_;                                   // 新连接是否开启 auto-cork
+  SocketOptions socketOptions_;                     // 作用于 listenfd 和每个新连接的 socket 选项
+  std::shared_ptr<const std::string> namePrefix_;   // 连接名称前缀 "name-ip:port#"，所有连接共享
+  int64_t nextConnId_;                              // 连接名称中的序号，在主线程中处理，不涉及多线程访问问题，所以不需要定义为原子整型
+  ConnectionRegistry connections_;                  // 保存所有的连接，按连接 ID 索引
+
+  TimerId rebalanceTimer_;                          // 再均衡定时器
+  double rebalanceInterval_;
+  double rebalanceThreshold_;
+  std::unordered_map<EventLoop *, int64_t> loopBusySamples_; // 上一次采样时各 loop 的累计繁忙时间
+
+  std::unordered_map<EventLoop *, RetiringLoop> retiringLoops_;
+  TimerId autoScaleTimer_;                          // 自动伸缩定时器
+  int minLoops_;
+  int maxLoops_;
+  double autoScaleInterval_;
+  double scaleUpRatio_;
+  double scaleDownRatio_;
+  std::unordered_map<EventLoop *, int64_t> autoScaleSamples_;
+
+  // 带宽限制，都只在 baseLoop 中访问
+  double connSendRate_;                             // 每个连接的发送带宽，0 表示不限制
+  double connSendBurst_;
+  double connReadRate_;                             // 每个连接的接收带宽，0 表示不限制
+  double connReadBurst_;
+  std::shared_ptr<TokenBucket> totalSendBucket_;    // 所有连接共享的发送令牌桶，为空表示不限制
+  std::shared_ptr<TokenBucket> totalReadBucket_;    // 所有连接共享的接收令牌桶，为空表示不限制
+
+  // 优雅停止，都只在 baseLoop 中访问
+  bool stopping_;
+  TimerId drainTimer_;                              // drainTimeout 到期后强制关闭剩余连接
+  StopCallback stopCallback_;
 };
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+#include "noncopyable.h"
+
+#include <atomic>
+#include <functional>
+#include <stdint.h>
+
+/*
+ * 定时器，由 TimerQueue 管理
+ * 到期时间使用单调时钟(CLOCK_MONOTONIC)的微秒数，不受系统时间被修改的影响
+ */
+
+class Timer : noncopyable {
+public:
+  using TimerCallback = std::function<void()>;
+
+  Timer(TimerCallback cb, int64_t when, int64_t intervalUs)
+      : callback_(std::move(cb))
+      , expiration_(when)
+      , interval_(intervalUs)
+      , repeat_(intervalUs > 0)
+      , sequence_(++numCreated_) {}
+
+  void run() const { callback_(); }
+
+  int64_t expiration() const { return expiration_; }
+  bool repeat() const { return repeat_; }
+  int64_t sequence() const { return sequence_; }
+
+  // 周期定时器到期后，重新计算下一次到期时间
+  void restart(int64_t now) { expiration_ = now + interval_; }
+
+  // 单调时钟的当前时间(微秒)
+  static int64_t now();
+  static int64_t numCreated() { return numCreated_; }
+
+private:
+  const TimerCallback callback_;
+  int64_t expiration_;      // 到期时间(单调时钟微秒数)
+  const int64_t interval_;  // 周期定时器的间隔(微秒)，0 表示一次性定时器
+  const bool repeat_;
+  const int64_t sequence_;  // 全局唯一序号，和 Timer 地址一起标识一个定时器
+
+  static std::atomic<int64_t> numCreated_;
+};
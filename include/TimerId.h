@@ -0,0 +1,23 @@
+#pragma once
+#include <stdint.h>
+
+class Timer;
+
+/*
+ * 定时器的标识，用于取消定时器
+ * 仅保存 Timer 地址和序号，不拥有 Timer 对象
+ */
+
+class TimerId {
+public:
+  TimerId() : timer_(nullptr), sequence_(0) {}
+  TimerId(Timer *timer, int64_t seq) : timer_(timer), sequence_(seq) {}
+
+  bool valid() const { return timer_ != nullptr; }
+
+  friend class TimerQueue;
+
+private:
+  Timer *timer_;
+  int64_t sequence_;
+};
@@ -0,0 +1,55 @@
+#pragma once
+#include "Channel.h"
+#include "Timer.h"
+#include "TimerId.h"
+#include "noncopyable.h"
+
+#include <set>
+#include <utility>
+#include <vector>
+
+class EventLoop;
+
+/*
+ * 定时器队列，每个 EventLoop 一个
+ * 借助 timerfd 把定时事件转换为 fd 上的可读事件，和其他 channel 一样注册在 loop 的 poller 上
+ * 所有定时器按到期时间保存在 std::set 中，timerfd 总是设置为最早到期的那个时间
+ */
+
+class TimerQueue : noncopyable {
+public:
+  explicit TimerQueue(EventLoop *loop);
+  ~TimerQueue();
+
+  // 可以跨线程调用，when 为单调时钟微秒数，intervalUs > 0 表示周期定时器
+  TimerId addTimer(Timer::TimerCallback cb, int64_t when, int64_t intervalUs);
+  void cancel(TimerId timerId);
+
+private:
+  using Entry = std::pair<int64_t, Timer *>;
+  using TimerList = std::set<Entry>;
+  using ActiveTimer = std::pair<Timer *, int64_t>;
+  using ActiveTimerSet = std::set<ActiveTimer>;
+
+  void addTimerInLoop(Timer *timer);
+  void cancelInLoop(TimerId timerId);
+  // timerfd 可读时调用
+  void handleRead();
+
+  // 取出所有已到期的定时器
+  std::vector<Entry> getExpired(int64_t now);
+  // 周期定时器重新插入，一次性定时器释放
+  void reset(const std::vector<Entry> &expired, int64_t now);
+  // 插入定时器，返回最早到期时间是否改变
+  bool insert(Timer *timer);
+  void resetTimerfd(int64_t expiration);
+
+  EventLoop *loop_;
+  const int timerfd_;
+  Channel timerfdChannel_;
+
+  TimerList timers_;               // 按到期时间排序
+  ActiveTimerSet activeTimers_;    // 按 Timer 地址排序，用于 cancel
+  bool callingExpiredTimers_;      // 是否正在执行到期定时器的回调
+  ActiveTimerSet cancelingTimers_; // 回调执行期间被取消的周期定时器，不再重新插入
+};
@@ -1,20 +1,60 @@
 #pragma once
 /*
  * 时间类
+ * 保存自 Epoch 以来的微秒数，now() 通过 clock_gettime(CLOCK_REALTIME) 取得，vDSO 实现，不陷入内核
 */
 #include <iostream>
+#include <stddef.h>
+#include <stdint.h>
 #include <string>
+#include <time.h>
 
 // 时间类
 class Timestamp {
 public:
+  static const int kMicroSecondsPerSecond = 1000 * 1000;
+
   Timestamp();
   explicit Timestamp(int64_t microSecondsSinceEpoch);
   // 获取当前时间
   static Timestamp now();
-  // 时间转为字符串
+  // 单调时钟的纳秒数，用于测量比微秒更短的间隔；不受系统时间调整影响，起点不是 Epoch，不能转换为日期
+  static int64_t nowNanos();
+
+  int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+  time_t secondsSinceEpoch() const {
+    return static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond);
+  }
+  bool valid() const { return microSecondsSinceEpoch_ > 0; }
+
+  // 时间转为字符串 "2024/01/02 03:04:05"
   std::string toString() const;
+  // 带微秒的字符串 "2024/01/02 03:04:05.123456"
+  std::string toFormattedString(bool showMicroseconds = true) const;
+  // 格式化到 buf 中，返回写入的长度(不含结尾的 '\0')，len 至少为 32
+  // 每个线程缓存上一次格式化的秒，秒数不变时只重新填写微秒部分，不调用 localtime_r，供日志使用
+  size_t formatTo(char *buf, size_t len, bool showMicroseconds = true) const;
 
 private:
   int64_t microSecondsSinceEpoch_;
-};
\ No newline at end of file
+};
+
+inline bool operator<(Timestamp lhs, Timestamp rhs) {
+  return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator==(Timestamp lhs, Timestamp rhs) {
+  return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
+}
+
+// high - low 的秒数
+inline double timeDifference(Timestamp high, Timestamp low) {
+  int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+  return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
+
+// timestamp 之后 seconds 秒的时间
+inline Timestamp addTime(Timestamp timestamp, double seconds) {
+  int64_t delta = static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+  return Timestamp(timestamp.microSecondsSinceEpoch() + delta);
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "noncopyable.h"
+
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 令牌桶，用于限制发送/接收带宽
+ * 每秒生成 rate 个令牌(字节)，最多积攒 burst 个；取令牌时按流逝的时间惰性补充，不需要定时器
+ * 令牌数可以被透支成负数(比如一次 read 读多了，或者多个 loop 同时消费同一个桶)，之后由补充的令牌偿还
+ * 加锁保护，可以被多个 loop 共享(TcpServer 的总带宽限制)，也可以在运行时调整速率
+ */
+
+class TokenBucket : noncopyable {
+public:
+  // rate <= 0 表示不限速；burst <= 0 时取 100ms 的令牌量
+  TokenBucket(double rate, double burst);
+
+  void setRate(double rate, double burst);
+  double rate() const;
+
+  // 当前可用的令牌数，不限速时返回 SIZE_MAX
+  size_t available();
+  // 消费 n 个令牌，可以透支
+  void consume(size_t n);
+
+private:
+  void refill(int64_t now);
+
+  mutable std::mutex mutex_;
+  double rate_;    // 每秒生成的令牌数
+  double burst_;   // 桶容量
+  double tokens_;  // 当前令牌数
+  int64_t lastRefill_; // 上次补充令牌的时间(单调时钟微秒数)
+};
@@ -0,0 +1,142 @@
+#pragma once
+#include "Callbacks.h"
+#include "InetAddress.h"
+#include "Socket.h"
+#include "Timestamp.h"
+#include "noncopyable.h"
+
+#include <atomic>
+#include <memory>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <string>
+#include <sys/socket.h>
+#include <vector>
+
+class Channel;
+class EventLoop;
+
+/*
+ * UdpChannel 的选项
+ * 取值为 0/false 的选项保持内核默认值，不做系统调用
+ */
+struct UdpOptions {
+  UdpOptions()
+      : batchSize(64)
+      , maxDatagramSize(2048)
+      , gro(false)
+      , reusePort(false)
+      , sendBufferSize(0)
+      , recvBufferSize(0)
+      , maxPendingSends(4096) {}
+
+  int batchSize;          // 一次 recvmmsg/sendmmsg 处理的最大报文数，1 表示逐个 recvfrom/sendto
+  size_t maxDatagramSize; // 接收槽大小，超过的报文被截断并丢弃(计入 truncated)
+  bool gro;               // UDP_GRO：内核把同一条流的多个报文合并后一次交付，接收槽扩大到 64KB
+  bool reusePort;         // SO_REUSEPORT：多个 socket 绑定同一端口，由内核按四元组哈希分流
+  int sendBufferSize;     // SO_SNDBUF(字节)
+  int recvBufferSize;     // SO_RCVBUF(字节)
+  size_t maxPendingSends; // 发送队列上限(报文数)，队列满时新报文被丢弃(计入 dropped)
+};
+
+/*
+ * 一个绑定在某个 EventLoop 上的 UDP socket，地址族(IPv4/IPv6)与绑定地址相同
+ * 接收：可读时用 recvmmsg 一次收取 batchSize 个报文到预先分配的接收槽中，逐个调用 messageCallback
+ * 发送：send 只把报文追加到发送队列，本轮循环末尾用 sendmmsg 批量发出(与 TcpConnection 的 auto-cork 类似)，
+ * 内核发送缓冲区满时等待 EPOLLOUT；sendSegments 用 UDP_SEGMENT(GSO) 把一大块数据一次交给内核，
+ * 由内核(或网卡)切成多个数据报，内核不支持时退化为逐个报文发送
+ * 只能在 loop 线程中构造、start 和 close，send 可以跨线程调用
+ */
+class UdpChannel : noncopyable, public std::enable_shared_from_this<UdpChannel> {
+public:
+  UdpChannel(EventLoop *loop, const InetAddress &bindAddr, const UdpOptions &options = UdpOptions());
+  ~UdpChannel();
+
+  // 开始接收数据报
+  void start();
+  // 停止收发并从 poller 中移除，发送队列中未发出的报文被丢弃
+  void close();
+
+  void setMessageCallback(const UdpMessageCallback &cb) { messageCallback_ = cb; }
+
+  // 发送一个数据报，可以跨线程调用
+  void send(const void *data, size_t len, const InetAddress &peer);
+  // 把 data 按 segmentSize 切成多个数据报发给同一个 peer，最后一个可以不足 segmentSize，可以跨线程调用
+  void sendSegments(const void *data, size_t len, size_t segmentSize, const InetAddress &peer);
+
+  EventLoop *getLoop() const { return loop_; }
+  int fd() const { return socket_.fd(); }
+  // 实际绑定的地址(绑定端口 0 时由内核分配)
+  const InetAddress &localAddress() const { return localAddr_; }
+  bool groEnabled() const { return groEnabled_; }
+  bool gsoEnabled() const { return gsoEnabled_; }
+
+  // 统计，可以跨线程读取
+  int64_t packetsReceived() const { return packetsReceived_.load(std::memory_order_relaxed); }
+  int64_t packetsSent() const { return packetsSent_.load(std::memory_order_relaxed); }
+  int64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+  int64_t truncated() const { return truncated_.load(std::memory_order_relaxed); }
+
+private:
+  // 发送队列中的一项，segmentSize 不为 0 时是一组 GSO 报文
+  struct PendingSend {
+    std::string data;
+    InetAddress addr;
+    size_t segmentSize;
+  };
+
+  void handleRead(Timestamp receiveTime);
+  void handleWrite();
+  void readBatched(Timestamp receiveTime);
+  void readSingle(Timestamp receiveTime);
+  void deliver(const char *data, size_t len, size_t segmentSize, const sockaddr *addr,
+               socklen_t addrLen, Timestamp receiveTime);
+
+  void sendString(const std::string &data, size_t segmentSize, const InetAddress &addr);
+  void sendInLoop(const char *data, size_t len, size_t segmentSize, const InetAddress &addr);
+  void enqueue(const char *data, size_t len, size_t segmentSize, const InetAddress &addr);
+  void flush();
+  // 发出队首的若干项，返回发出的项数，内核缓冲区满时返回 0
+  size_t flushBatched();
+  size_t flushSingle();
+  void prepareSend(size_t i, PendingSend *item);
+  void sendSegmentsSingly(const PendingSend &item);
+  void countSent(const PendingSend &item);
+  void add(std::atomic<int64_t> *counter, int64_t n) {
+    counter->store(counter->load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  EventLoop *loop_;
+  Socket socket_;
+  InetAddress localAddr_;
+  std::unique_ptr<Channel> channel_;
+  const UdpOptions options_;
+  bool groEnabled_;
+  bool gsoEnabled_;
+  bool started_;
+  bool closed_;
+  bool flushPending_;     // 是否已登记本轮循环末尾的 flush
+  UdpMessageCallback messageCallback_;
+
+  // 接收槽：batchSize 个 slotSize_ 字节的缓冲区，连同 recvmmsg 需要的结构一次分配、反复使用
+  size_t slotSize_;
+  std::vector<char> recvBuffer_;
+  std::vector<mmsghdr> recvMsgs_;
+  std::vector<iovec> recvIovs_;
+  std::vector<sockaddr_in6> recvAddrs_; // 能容纳 IPv4 和 IPv6 地址
+  std::vector<uint64_t> recvControl_;
+
+  // 发送队列：[sendHead_, sendCount_) 是待发送的项，发完后整体复位，string 的容量被复用
+  std::vector<PendingSend> sendQueue_;
+  size_t sendHead_;
+  size_t sendCount_;
+  std::vector<mmsghdr> sendMsgs_;
+  std::vector<iovec> sendIovs_;
+  std::vector<uint64_t> sendControl_;
+
+  // 统计，只由 loop 线程写
+  std::atomic<int64_t> packetsReceived_;
+  std::atomic<int64_t> packetsSent_;
+  std::atomic<int64_t> dropped_;
+  std::atomic<int64_t> truncated_;
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include "Callbacks.h"
+#include "InetAddress.h"
+#include "UdpChannel.h"
+#include "noncopyable.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class EventLoop;
+class EventLoopThreadPool;
+
+/*
+ * UDP 服务器：每个 subLoop 一个绑定在同一端口上的 UdpChannel(SO_REUSEPORT)
+ * 内核按四元组把数据报分到各个 socket，同一个对端的报文总是由同一个 loop 处理，loop 之间没有共享状态
+ * 没有设置线程数时只在 baseLoop 中创建一个 socket
+ * 回复直接调用回调参数中的 UdpChannel::send，在本轮循环末尾和同一 loop 的其他回复一起用 sendmmsg 发出
+ */
+class UdpServer : noncopyable {
+public:
+  using ThreadInitCallback = std::function<void(EventLoop *)>;
+
+  UdpServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &nameArg,
+            const UdpOptions &options = UdpOptions());
+  ~UdpServer();
+
+  void setThreadInitCallback(const ThreadInitCallback &cb) { threadInitCallback_ = cb; }
+  void setMessageCallback(const UdpMessageCallback &cb) { messageCallback_ = cb; }
+  // 设置 subLoop 个数，即 socket 个数，需要在 start 之前调用
+  void setThreadNum(int numThreads);
+
+  // 启动线程池，在每个 loop 中创建并绑定 UdpChannel；多个 socket 时监听端口不能为 0
+  void start();
+
+  const std::string &name() const { return name_; }
+  // 已经创建的 UdpChannel，可以跨线程调用
+  std::vector<std::shared_ptr<UdpChannel>> channels() const;
+
+  // 所有 UdpChannel 的统计之和，可以跨线程调用
+  int64_t packetsReceived() const;
+  int64_t packetsSent() const;
+  int64_t dropped() const;
+
+private:
+  void startInLoop(EventLoop *loop);
+
+  EventLoop *loop_;
+  const InetAddress listenAddr_;
+  const std::string name_;
+  UdpOptions options_;
+  std::shared_ptr<EventLoopThreadPool> threadPool_;
+  UdpMessageCallback messageCallback_;
+  ThreadInitCallback threadInitCallback_;
+  std::atomic_int started_;
+
+  mutable std::mutex mutex_;
+  std::vector<std::shared_ptr<UdpChannel>> channels_;
+};
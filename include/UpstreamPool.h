@@ -0,0 +1,75 @@
+#pragma once
+#include "Callbacks.h"
+#include "InetAddress.h"
+#include "SocketOptions.h"
+#include "noncopyable.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * per-loop 的上游连接池
+ * 每个 loop 对每个后端地址有一个池子(forLoop)，池中的连接都属于该 loop，acquire/release 都在 loop 线程中完成，
+ * 代理类的服务在 subLoop 的回调中直接复用已建立(TCP 握手、慢启动都已完成)的上游连接，没有跨线程交接
+ * 空闲连接按 LIFO 复用，最近用过的连接最"热"；空闲连接被对端关闭时自动移出池子
+ * 每个上游连接由一个 TcpClient 建立，连接失败时不重试，直接以空指针回调 acquire 的调用者
+ * 所有方法都只能在 loop 所在线程中调用；池子需要由 shared_ptr 持有(forLoop 或 std::make_shared 创建)
+ */
+
+class EventLoop;
+class TcpClient;
+
+class UpstreamPool : noncopyable, public std::enable_shared_from_this<UpstreamPool> {
+public:
+  // 拿到连接时调用，连接失败时参数为空
+  using AcquireCallback = std::function<void(const TcpConnectionPtr &)>;
+
+  // 当前 loop 上连接 backend 的池子，第一次调用时创建并绑定到 loop 上(EventLoop::attach)，随 loop 一起析构
+  static UpstreamPool *forLoop(EventLoop *loop, const InetAddress &backend);
+
+  UpstreamPool(EventLoop *loop, const InetAddress &backend);
+  ~UpstreamPool();
+
+  // 拿一个连接：有空闲连接时立即回调，否则新建连接，连接建立后回调
+  // 拿到的连接由调用者设置 messageCallback 收发数据，不要替换它的 connectionCallback
+  void acquire(const AcquireCallback &cb);
+  // 归还连接：连接仍然有效且空闲连接数没有超过上限时放回池中，否则关闭
+  void release(const TcpConnectionPtr &conn);
+
+  // 池中最多保留的空闲连接数
+  void setMaxIdle(size_t maxIdle) { maxIdle_ = maxIdle; }
+  // 上游连接的 socket 选项，只使用其中的连接级选项
+  void setSocketOptions(const SocketOptions &options) { socketOptions_ = options; }
+  // 已经交给调用者(没有归还)的连接被关闭时调用
+  void setCloseCallback(const ConnectionCallback &cb) { closeCallback_ = cb; }
+
+  const InetAddress &backend() const { return backend_; }
+  size_t idleCount() const { return idle_.size(); }
+  // 池子管理的所有连接数，包括正在建立、空闲和已经交给调用者的连接
+  size_t size() const { return upstreams_.size(); }
+
+private:
+  struct Upstream {
+    std::unique_ptr<TcpClient> client;
+    AcquireCallback waiter; // 连接建立前等待该连接的 acquire 回调
+    TcpConnectionPtr conn;
+  };
+
+  void onConnection(TcpClient *client, const TcpConnectionPtr &conn);
+  void onConnectFailed(TcpClient *client, int err);
+  void removeUpstream(TcpClient *client);
+  bool removeIdle(const TcpConnectionPtr &conn);
+
+  EventLoop *loop_;
+  const InetAddress backend_;
+  const std::string name_;
+  size_t maxIdle_;
+  SocketOptions socketOptions_;
+  ConnectionCallback closeCallback_;
+  std::unordered_map<TcpClient *, Upstream> upstreams_;
+  std::unordered_map<TcpConnection *, TcpClient *> owners_; // 已建立的连接属于哪个 TcpClient
+  std::vector<TcpConnectionPtr> idle_;
+};
@@ -4,12 +4,13 @@
 
 #include <errno.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 // 创建非阻塞 socket
-static int createNonblocking() {
-  int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+static int createNonblocking(sa_family_t family) {
+  int sockfd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
   if (sockfd < 0) {
     LOG_FATAL("[%s:%s:%d]\nlisten socket create error: %d!\n", __FILE__,
               __FUNCTION__, __LINE__, errno);
@@ -17,15 +18,58 @@ static int createNonblocking() {
   return sockfd;
 }
 
+// 上次运行遗留的 Unix 域 socket 文件会让 bind 失败(EADDRINUSE)，只删除确认无人监听的 socket 文件：
+// 路径上是普通文件(比如写错的路径)或者另一个仍在运行的服务的 socket 时不接管，直接报错
+static void removeStaleUnixSocket(const InetAddress &listenAddr) {
+  std::string path = listenAddr.unixPath();
+  struct stat st;
+  if (::lstat(path.c_str(), &st) != 0) {
+    return; // 路径不存在，bind 会创建
+  }
+  if (!S_ISSOCK(st.st_mode)) {
+    LOG_FATAL("[%s:%s:%d]\n%s exists and is not a socket, refuse to remove it\n", __FILE__,
+              __FUNCTION__, __LINE__, path.c_str());
+  }
+  // 非阻塞 connect 探测：只有 ECONNREFUSED 说明没有进程在监听，backlog 满(EAGAIN)或连接成功都说明仍在使用
+  int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (probe < 0) {
+    LOG_FATAL("[%s:%s:%d]\nprobe socket create error: %d!\n", __FILE__, __FUNCTION__, __LINE__, errno);
+  }
+  int ret = ::connect(probe, listenAddr.getSockAddr(), listenAddr.length());
+  int savedErrno = errno;
+  ::close(probe);
+  if (ret != 0 && savedErrno == ECONNREFUSED) {
+    ::unlink(path.c_str());
+  } else if (ret == 0 || savedErrno == EAGAIN || savedErrno == EINPROGRESS) {
+    LOG_FATAL("[%s:%s:%d]\n%s is in use by another server\n", __FILE__, __FUNCTION__, __LINE__,
+              path.c_str());
+  }
+  // 其他错误(比如探测期间文件被删除)交给 bind 报告
+}
+
 // 有新用户连接时，最终相应的就是 TcpServer::newConnection 方法
 Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport)
     : loop_(loop) // 通过 loop 获取 poller 从而将新连接打包好的 channel 发送给 poller
-    , acceptSocket_(createNonblocking()) // 1. 创建非阻塞的 listenFd
+    , acceptSocket_(createNonblocking(listenAddr.family())) // 1. 创建非阻塞的 listenFd，地址族与监听地址相同
+    , unixPath_(listenAddr.unixPath())
+    , unixInode_(0)
     , acceptChannel_(loop, acceptSocket_.fd()) // 封装 acceptChannel_，通过 mainLoop 完成在 poller 上的监听
     , listenning_(false) {
+  // 无法解析的地址不能退化成监听所有网卡
+  if (!listenAddr.valid()) {
+    LOG_FATAL("[%s:%s:%d]\ninvalid listen address %s\n", __FILE__, __FUNCTION__, __LINE__,
+              listenAddr.toIpPort().c_str());
+  }
   acceptSocket_.setReuseAddr(true);      // 2. 设置 sockOption
   acceptSocket_.setReusePort(true);
+  if (!unixPath_.empty()) {
+    removeStaleUnixSocket(listenAddr);
+  }
   acceptSocket_.bindAddress(listenAddr); // 3. bind 刚才创建的 socket
+  struct stat st;
+  if (!unixPath_.empty() && ::stat(unixPath_.c_str(), &st) == 0) {
+    unixInode_ = st.st_ino;
+  }
   //! Acceptor 只设置 readCallback，因为它只关心新用户连接事件，而在
   //! TcpConnection 中则关心已连接用户的所有事件
   // TcpServer::start() 会调用 Acceptor.listen()
@@ -38,14 +82,36 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reusepor
 Acceptor::~Acceptor() {
   acceptChannel_.disableAll();
   acceptChannel_.remove();
+  removeUnixPath();
+}
+
+// 滚动发布时新实例可能已经在同一路径上重新 bind，只删除 inode 与自己创建时相同的文件
+void Acceptor::removeUnixPath() {
+  struct stat st;
+  if (!unixPath_.empty() && ::stat(unixPath_.c_str(), &st) == 0 && st.st_ino == unixInode_) {
+    ::unlink(unixPath_.c_str());
+  }
+  unixPath_.clear();
 }
 
 void Acceptor::listen() {
   listenning_ = true;
-  acceptSocket_.listen();         // listen
+  acceptSocket_.applyListenOptions(options_);
+  acceptSocket_.listen(options_.backlog); // listen
   acceptChannel_.enableReading(); // 将 acceptChannel_ 注册到 poller 中
 }
 
+void Acceptor::stop() {
+  if (!listenning_) {
+    return;
+  }
+  listenning_ = false;
+  acceptChannel_.disableAll();
+  acceptChannel_.remove();
+  ::shutdown(acceptSocket_.fd(), SHUT_RDWR);
+  removeUnixPath();
+}
+
 // 当 listenfd 有新用户连接时调用
 void Acceptor::handleRead() {
   InetAddress peerAddr;
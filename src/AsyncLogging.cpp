@@ -0,0 +1,158 @@
+#include "AsyncLogging.h"
+#include "LogFile.h"
+
+#include <chrono>
+#include <stdio.h>
+
+AsyncLogging::AsyncLogging(const std::string &basename, off_t rollSize, int flushInterval,
+                           size_t maxPendingBuffers)
+    : flushInterval_(flushInterval)
+    , basename_(basename)
+    , rollSize_(rollSize)
+    , maxPendingBuffers_(maxPendingBuffers > 0 ? maxPendingBuffers : 1)
+    , running_(false)
+    , flushRequested_(0)
+    , flushCompleted_(0)
+    , currentBuffer_(new Buffer)
+    , nextBuffer_(new Buffer)
+    , dropped_(0) {
+  buffers_.reserve(maxPendingBuffers_ + 1);
+}
+
+AsyncLogging::~AsyncLogging() {
+  if (running_) {
+    stop();
+  }
+}
+
+void AsyncLogging::append(const char *logline, size_t len) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (currentBuffer_->avail() > len) {
+    currentBuffer_->append(logline, len);
+    return;
+  }
+  if (len >= kBufferSize) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  // 当前缓冲区写满，换上一个空缓冲区；后台积压过多或者没有空缓冲区可用时丢弃这条日志
+  BufferPtr fresh;
+  if (buffers_.size() < maxPendingBuffers_) {
+    if (nextBuffer_) {
+      fresh = std::move(nextBuffer_);
+    } else if (!freeBuffers_.empty()) {
+      fresh = std::move(freeBuffers_.back());
+      freeBuffers_.pop_back();
+    } else {
+      fresh.reset(new Buffer);
+    }
+  }
+  if (!fresh) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  buffers_.push_back(std::move(currentBuffer_));
+  currentBuffer_ = std::move(fresh);
+  currentBuffer_->append(logline, len);
+  cond_.notify_one();
+}
+
+void AsyncLogging::flush() {
+  // 后台线程自己不能等自己
+  if (!running_ || std::this_thread::get_id() == thread_.get_id()) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  int64_t request = ++flushRequested_;
+  cond_.notify_one();
+  while (flushCompleted_ < request && running_) {
+    flushCond_.wait(lock);
+  }
+}
+
+void AsyncLogging::start() {
+  if (running_.exchange(true)) {
+    return;
+  }
+  thread_ = std::thread(&AsyncLogging::threadFunc, this);
+}
+
+void AsyncLogging::stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.notify_one();
+  }
+  thread_.join();
+  // 后台线程退出前已经写完所有缓冲区，唤醒还在等待的 flush
+  std::unique_lock<std::mutex> lock(mutex_);
+  flushCond_.notify_all();
+}
+
+void AsyncLogging::threadFunc() {
+  // 只有后台线程写文件，LogFile 不需要加锁
+  LogFile output(basename_, rollSize_, false, flushInterval_);
+  BufferVector buffersToWrite;
+  buffersToWrite.reserve(maxPendingBuffers_ + 1);
+  int64_t reportedDrops = 0;
+  bool running = true;
+  int64_t flushRequest = 0;
+  while (running) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (buffers_.empty() && running_ && flushRequested_ == flushCompleted_) {
+        cond_.wait_for(lock, std::chrono::seconds(flushInterval_));
+      }
+      running = running_;
+      // 这次交换出来的缓冲区包含了此前所有 flush 请求之前 append 的日志
+      flushRequest = flushRequested_;
+      if (currentBuffer_->length() > 0 || !buffers_.empty()) {
+        buffers_.push_back(std::move(currentBuffer_));
+        buffersToWrite.swap(buffers_);
+        // 用归还的空缓冲区替换前端的当前缓冲区和备用缓冲区
+        if (!freeBuffers_.empty()) {
+          currentBuffer_ = std::move(freeBuffers_.back());
+          freeBuffers_.pop_back();
+        } else {
+          currentBuffer_.reset(new Buffer);
+        }
+      }
+      if (!nextBuffer_ && !freeBuffers_.empty()) {
+        nextBuffer_ = std::move(freeBuffers_.back());
+        freeBuffers_.pop_back();
+      }
+    }
+
+    // 锁外批量写文件，前端在此期间可以继续 append
+    int64_t drops = dropped_.load(std::memory_order_relaxed);
+    if (drops != reportedDrops) {
+      char buf[128];
+      int n = ::snprintf(buf, sizeof(buf), "AsyncLogging dropped %ld log messages, %ld in total\n",
+                         static_cast<long>(drops - reportedDrops), static_cast<long>(drops));
+      output.append(buf, static_cast<size_t>(n));
+      reportedDrops = drops;
+    }
+    for (const BufferPtr &buffer : buffersToWrite) {
+      output.append(buffer->data(), buffer->length());
+    }
+    output.flush();
+
+    // 写完的缓冲区还给前端复用，除 nextBuffer_ 外最多缓存 2 个，多余的释放
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (flushCompleted_ < flushRequest) {
+      flushCompleted_ = flushRequest;
+      flushCond_.notify_all();
+    }
+    for (BufferPtr &buffer : buffersToWrite) {
+      buffer->reset();
+      if (!nextBuffer_) {
+        nextBuffer_ = std::move(buffer);
+      } else if (freeBuffers_.size() < 2) {
+        freeBuffers_.push_back(std::move(buffer));
+      }
+    }
+    buffersToWrite.clear();
+  }
+}
@@ -0,0 +1,185 @@
+#include "BinaryLogger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// 调用点表、各线程的缓冲区和后台线程
+struct BinaryLogState {
+  BinaryLogState() : ringSize(BinaryLogger::kDefaultRingSize), running(false), retiredDropped(0) {}
+
+  std::mutex mutex;
+  std::vector<BinaryLogSite *> sites; // 下标为 id - 1
+  std::vector<BinaryLogger::DecodeFunc> decoders;
+  std::vector<std::shared_ptr<BinaryLogRing>> rings;
+  size_t ringSize;
+  std::thread thread;
+  std::atomic<bool> running;
+  int64_t retiredDropped; // 已释放的缓冲区丢弃的日志条数
+};
+
+BinaryLogState &state() {
+  static BinaryLogState s;
+  return s;
+}
+
+__thread BinaryLogRing *t_ring = nullptr;
+__thread bool t_ringReleased = false;
+
+// 线程退出时把缓冲区标记为关闭，后台线程取完剩余的日志后释放
+struct RingHolder {
+  std::shared_ptr<BinaryLogRing> ring;
+  ~RingHolder() {
+    if (ring) {
+      ring->close();
+    }
+    t_ring = nullptr;
+    t_ringReleased = true;
+  }
+};
+
+size_t roundUpPowerOfTwo(size_t n) {
+  size_t size = 4096;
+  while (size < n) {
+    size <<= 1;
+  }
+  return size;
+}
+
+} // namespace
+
+std::atomic<bool> BinaryLogger::active_(false);
+
+BinaryLogRing::BinaryLogRing(size_t capacity)
+    : capacity_(roundUpPowerOfTwo(capacity))
+    , mask_(capacity_ - 1)
+    , buffer_(new char[capacity_])
+    , head_(0)
+    , cachedTail_(0)
+    , dropped_(0)
+    , published_(0)
+    , tail_(0)
+    , closed_(false) {
+  // 预先触发缺页，热路径上写日志时不再发生缺页中断
+  ::memset(buffer_.get(), 0, capacity_);
+}
+
+void BinaryLogger::start(size_t ringSize) {
+  BinaryLogState &s = state();
+  std::unique_lock<std::mutex> lock(s.mutex);
+  if (s.running) {
+    return;
+  }
+  s.ringSize = roundUpPowerOfTwo(ringSize);
+  s.running = true;
+  s.thread = std::thread(&BinaryLogger::threadFunc);
+  active_.store(true, std::memory_order_relaxed);
+}
+
+void BinaryLogger::stop() {
+  BinaryLogState &s = state();
+  std::thread thread;
+  {
+    std::unique_lock<std::mutex> lock(s.mutex);
+    if (!s.running) {
+      return;
+    }
+    // 先让新的日志走同步输出，后台线程再取完缓冲区中剩余的日志
+    active_.store(false, std::memory_order_relaxed);
+    s.running = false;
+    thread.swap(s.thread);
+  }
+  thread.join();
+}
+
+int64_t BinaryLogger::dropped() {
+  BinaryLogState &s = state();
+  std::unique_lock<std::mutex> lock(s.mutex);
+  int64_t total = s.retiredDropped;
+  for (const std::shared_ptr<BinaryLogRing> &ring : s.rings) {
+    total += ring->dropped();
+  }
+  return total;
+}
+
+uint32_t BinaryLogger::registerSite(BinaryLogSite *site, DecodeFunc decode) {
+  BinaryLogState &s = state();
+  std::unique_lock<std::mutex> lock(s.mutex);
+  // 可能有多个线程同时第一次执行同一个调用点
+  uint32_t id = site->id.load(std::memory_order_relaxed);
+  if (id == 0) {
+    s.sites.push_back(site);
+    s.decoders.push_back(decode);
+    id = static_cast<uint32_t>(s.sites.size());
+    site->id.store(id, std::memory_order_release);
+  }
+  return id;
+}
+
+BinaryLogRing *BinaryLogger::threadRing() {
+  if (t_ring == nullptr && !t_ringReleased) {
+    static thread_local RingHolder holder;
+    BinaryLogState &s = state();
+    std::unique_lock<std::mutex> lock(s.mutex);
+    holder.ring = std::make_shared<BinaryLogRing>(s.ringSize);
+    s.rings.push_back(holder.ring);
+    t_ring = holder.ring.get();
+  }
+  return t_ring;
+}
+
+void BinaryLogger::threadFunc() {
+  BinaryLogState &s = state();
+  std::vector<std::shared_ptr<BinaryLogRing>> rings;
+  std::vector<BinaryLogSite *> sites;
+  std::vector<DecodeFunc> decoders;
+  char line[1280];
+  const size_t kMaxLen = sizeof(line) - 1; // 留一个字节给末尾的换行
+  Logger &logger = Logger::instance();
+
+  // 格式化一条记录，调用点是在本地副本之后注册的时候重新复制调用点表
+  auto format = [&](const BinaryLogRing::Header &header) {
+    if (header.siteId > sites.size()) {
+      std::unique_lock<std::mutex> lock(s.mutex);
+      sites = s.sites;
+      decoders = s.decoders;
+    }
+    const BinaryLogSite &site = *sites[header.siteId - 1];
+    const char *args = reinterpret_cast<const char *>(&header + 1);
+    size_t len = Logger::formatPrefix(line, kMaxLen, site.level, Timestamp(header.microSeconds), nullptr);
+    int n = decoders[header.siteId - 1](line + len, kMaxLen - len, site, args);
+    len = std::min(len + static_cast<size_t>(n < 0 ? 0 : n), kMaxLen - 1);
+    line[len++] = '\n';
+    logger.output(site.level, line, len);
+  };
+
+  while (true) {
+    bool running = s.running.load();
+    {
+      std::unique_lock<std::mutex> lock(s.mutex);
+      rings = s.rings;
+    }
+    size_t count = 0;
+    for (const std::shared_ptr<BinaryLogRing> &ring : rings) {
+      // 先看是否关闭再取记录，关闭之后不会再有新的记录
+      bool closed = ring->closed();
+      count += ring->drain(format);
+      if (closed) {
+        std::unique_lock<std::mutex> lock(s.mutex);
+        s.retiredDropped += ring->dropped();
+        s.rings.erase(std::remove(s.rings.begin(), s.rings.end(), ring), s.rings.end());
+      }
+    }
+    if (count == 0) {
+      if (!running) {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  logger.flush();
+}
@@ -1,5 +1,6 @@
 #include "Channel.h"
 #include "EventLoop.h"
+#include "BinaryLogger.h"
 #include "Logger.h"
 
 #include <sys/epoll.h>
@@ -50,8 +51,7 @@ void Channel::handleEvent(Timestamp receiveTime) {
 
 // 根据 poller 通知的 channel 发生的具体事件，由 channel 负责调用具体的回调操作
 void Channel::handleEventWithGuard(Timestamp receiveTime) {
-  LOG_INFO("[%s:%s:%d]\nchannel handleEvent revents: %d\n", __FILE__,
-           __FUNCTION__, __LINE__, revents_);
+  LOG_BIN_INFO("channel handleEvent revents: %d\n", revents_);
   if ((revents_ & EPOLLHUP) && !(revents_ & EPOLLIN)) {
     if (closeCallback_) {
       closeCallback_();
@@ -0,0 +1,66 @@
+#include "ConnectionRegistry.h"
+#include "TcpConnection.h"
+
+ConnectionRegistry::ConnectionRegistry() : freeHead_(kNoSlot), size_(0) {}
+
+uint64_t ConnectionRegistry::allocate() {
+  uint32_t index;
+  if (freeHead_ != kNoSlot) {
+    index = freeHead_;
+    freeHead_ = slots_[index].nextFree;
+  } else {
+    index = static_cast<uint32_t>(slots_.size());
+    slots_.emplace_back();
+  }
+  slots_[index].used = true;
+  ++size_;
+  return (static_cast<uint64_t>(slots_[index].generation) << 32) | index;
+}
+
+void ConnectionRegistry::assign(uint64_t id, const TcpConnectionPtr &conn) {
+  Slot *slot = const_cast<Slot *>(lookup(id));
+  if (slot != nullptr) {
+    slot->conn = conn;
+  }
+}
+
+const TcpConnectionPtr *ConnectionRegistry::find(uint64_t id) const {
+  const Slot *slot = lookup(id);
+  return slot != nullptr && slot->conn ? &slot->conn : nullptr;
+}
+
+bool ConnectionRegistry::remove(uint64_t id) {
+  Slot *slot = const_cast<Slot *>(lookup(id));
+  if (slot == nullptr) {
+    return false;
+  }
+  slot->conn.reset();
+  slot->used = false;
+  // 代数为 0 的 ID 不合法，回绕时跳过 0
+  if (++slot->generation == 0) {
+    slot->generation = 1;
+  }
+  slot->nextFree = freeHead_;
+  freeHead_ = slotIndex(id);
+  --size_;
+  return true;
+}
+
+void ConnectionRegistry::clear() {
+  slots_.clear();
+  freeHead_ = kNoSlot;
+  size_ = 0;
+}
+
+// 槽位下标越界、槽位空闲或代数不匹配时返回 nullptr
+const ConnectionRegistry::Slot *ConnectionRegistry::lookup(uint64_t id) const {
+  uint32_t index = slotIndex(id);
+  if (index >= slots_.size()) {
+    return nullptr;
+  }
+  const Slot &slot = slots_[index];
+  if (!slot.used || slot.generation != generation(id)) {
+    return nullptr;
+  }
+  return &slot;
+}
@@ -0,0 +1,207 @@
+#include "Connector.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "Socket.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// 创建非阻塞 socket
+static int createNonblocking(sa_family_t family) {
+  int sockfd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (sockfd < 0) {
+    LOG_FATAL("[%s:%s:%d]\nconnect socket create error: %d!\n", __FILE__, __FUNCTION__,
+              __LINE__, errno);
+  }
+  return sockfd;
+}
+
+// 连接本机上的临时端口时，本地端口可能恰好等于目标端口，内核会让 socket 连上自己(Unix 域 socket 不会)
+static bool isSelfConnect(int sockfd) {
+  sockaddr_in6 local;
+  sockaddr_in6 peer;
+  socklen_t len = sizeof(local);
+  ::memset(&local, 0, sizeof(local));
+  ::memset(&peer, 0, sizeof(peer));
+  if (::getsockname(sockfd, (sockaddr *)&local, &len) < 0) {
+    return false;
+  }
+  len = sizeof(peer);
+  if (::getpeername(sockfd, (sockaddr *)&peer, &len) < 0) {
+    return false;
+  }
+  if (local.sin6_family == AF_INET) {
+    const sockaddr_in *local4 = reinterpret_cast<const sockaddr_in *>(&local);
+    const sockaddr_in *peer4 = reinterpret_cast<const sockaddr_in *>(&peer);
+    return local4->sin_port == peer4->sin_port && local4->sin_addr.s_addr == peer4->sin_addr.s_addr;
+  }
+  if (local.sin6_family == AF_INET6) {
+    return local.sin6_port == peer.sin6_port &&
+           ::memcmp(&local.sin6_addr, &peer.sin6_addr, sizeof(local.sin6_addr)) == 0;
+  }
+  return false;
+}
+
+Connector::Connector(EventLoop *loop, const InetAddress &serverAddr)
+    : loop_(loop)
+    , serverAddr_(serverAddr)
+    , connect_(false)
+    , state_(kDisconnected)
+    , initRetryDelayMs_(kDefaultInitRetryDelayMs)
+    , maxRetryDelayMs_(kDefaultMaxRetryDelayMs)
+    , retryDelayMs_(kDefaultInitRetryDelayMs) {}
+
+Connector::~Connector() {}
+
+void Connector::start() {
+  connect_ = true;
+  loop_->runInLoop(std::bind(&Connector::startInLoop, shared_from_this()));
+}
+
+void Connector::restart() {
+  setState(kDisconnected);
+  retryDelayMs_ = initRetryDelayMs_;
+  connect_ = true;
+  startInLoop();
+}
+
+void Connector::stop() {
+  connect_ = false;
+  loop_->runInLoop(std::bind(&Connector::stopInLoop, shared_from_this()));
+}
+
+void Connector::startInLoop() {
+  retryTimer_ = TimerId();
+  if (connect_ && state_ == kDisconnected) {
+    connect();
+  }
+}
+
+void Connector::stopInLoop() {
+  if (retryTimer_.valid()) {
+    loop_->cancel(retryTimer_);
+    retryTimer_ = TimerId();
+  }
+  if (state_ == kConnecting) {
+    setState(kDisconnected);
+    int sockfd = removeAndResetChannel();
+    ::close(sockfd);
+  }
+}
+
+void Connector::connect() {
+  // 无法解析的地址，重试也不会成功
+  if (!serverAddr_.valid()) {
+    LOG_ERROR("[%s:%s:%d]\nConnector::connect to invalid address %s\n", __FILE__, __FUNCTION__,
+              __LINE__, serverAddr_.toIpPort().c_str());
+    if (connectFailedCallback_) {
+      connectFailedCallback_(EINVAL);
+    }
+    return;
+  }
+  int sockfd = createNonblocking(serverAddr_.family());
+  int ret = ::connect(sockfd, serverAddr_.getSockAddr(), serverAddr_.length());
+  int savedErrno = (ret == 0) ? 0 : errno;
+  switch (savedErrno) {
+  case 0:
+  case EINPROGRESS:
+  case EINTR:
+  case EISCONN:
+    connecting(sockfd);
+    break;
+
+  // 暂时性的错误，稍后重试
+  case EAGAIN:
+  case EADDRINUSE:
+  case EADDRNOTAVAIL:
+  case ECONNREFUSED:
+  case ENETUNREACH:
+  case ENOENT: // Unix 域 socket 的服务端还没有创建 socket 文件
+    retry(sockfd, savedErrno);
+    break;
+
+  default:
+    LOG_ERROR("[%s:%s:%d]\nConnector::connect to %s error: %d\n", __FILE__, __FUNCTION__,
+              __LINE__, serverAddr_.toIpPort().c_str(), savedErrno);
+    ::close(sockfd);
+    if (connectFailedCallback_) {
+      connectFailedCallback_(savedErrno);
+    }
+    break;
+  }
+}
+
+// 连接正在进行，等待 sockfd 可写
+void Connector::connecting(int sockfd) {
+  setState(kConnecting);
+  channel_.reset(new Channel(loop_, sockfd));
+  channel_->tie(shared_from_this());
+  channel_->setWriteCallback(std::bind(&Connector::handleWrite, this));
+  channel_->setErrorCallback(std::bind(&Connector::handleError, this));
+  channel_->enableWriting();
+}
+
+// 在 channel 的回调中不能直接析构 channel，先从 poller 上删除，再在之后的回调中释放
+int Connector::removeAndResetChannel() {
+  channel_->disableAll();
+  channel_->remove();
+  int sockfd = channel_->fd();
+  loop_->queueInLoop(std::bind(&Connector::resetChannel, shared_from_this()));
+  return sockfd;
+}
+
+void Connector::resetChannel() { channel_.reset(); }
+
+void Connector::handleWrite() {
+  if (state_ != kConnecting) {
+    return;
+  }
+  int sockfd = removeAndResetChannel();
+  int err = Socket::getSocketError(sockfd);
+  if (err != 0) {
+    LOG_ERROR("[%s:%s:%d]\nConnector::handleWrite - SO_ERROR = %d %s\n", __FILE__, __FUNCTION__,
+              __LINE__, err, strerror(err));
+    retry(sockfd, err);
+  } else if (isSelfConnect(sockfd)) {
+    LOG_ERROR("[%s:%s:%d]\nConnector::handleWrite - self connect\n", __FILE__, __FUNCTION__,
+              __LINE__);
+    retry(sockfd, ECONNREFUSED);
+  } else {
+    setState(kConnected);
+    if (connect_ && newConnectionCallback_) {
+      newConnectionCallback_(sockfd);
+    } else {
+      ::close(sockfd);
+    }
+  }
+}
+
+void Connector::handleError() {
+  if (state_ == kConnecting) {
+    int sockfd = removeAndResetChannel();
+    int err = Socket::getSocketError(sockfd);
+    LOG_ERROR("[%s:%s:%d]\nConnector::handleError - SO_ERROR = %d %s\n", __FILE__, __FUNCTION__,
+              __LINE__, err, strerror(err));
+    retry(sockfd, err);
+  }
+}
+
+// 关闭失败的 sockfd，按指数退避在定时器上重新连接
+void Connector::retry(int sockfd, int err) {
+  ::close(sockfd);
+  setState(kDisconnected);
+  if (connectFailedCallback_) {
+    connectFailedCallback_(err);
+  }
+  if (connect_) {
+    LOG_INFO("[%s:%s:%d]\nConnector::retry - retry connecting to %s in %d milliseconds\n",
+             __FILE__, __FUNCTION__, __LINE__, serverAddr_.toIpPort().c_str(), retryDelayMs_);
+    retryTimer_ = loop_->runAfter(retryDelayMs_ / 1000.0,
+                                  std::bind(&Connector::startInLoop, shared_from_this()));
+    retryDelayMs_ = std::min(retryDelayMs_ * 2, maxRetryDelayMs_);
+  }
+}
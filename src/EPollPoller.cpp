@@ -1,5 +1,6 @@
 #include "EPollPoller.h"
 #include "Channel.h"
+#include "BinaryLogger.h"
 #include "Logger.h"
 #include "errno.h"
 #include <string.h>
@@ -47,8 +48,7 @@ void EPollPoller::update(int operation, Channel *channel) {
 // update/removeChannel
 void EPollPoller::updateChannel(Channel *channel) {
   const int index = channel->index();
-  LOG_INFO("[%s:%s:%d]\nfd = %d events = %d index = %d\n", __FILE__,
-           __FUNCTION__, __LINE__, channel->fd(), channel->events(), index);
+  LOG_BIN_INFO("fd = %d events = %d index = %d\n", channel->fd(), channel->events(), index);
 
   if (index == kNew || index == kDeleted) {
     if (index == kNew) {
@@ -72,8 +72,7 @@ void EPollPoller::updateChannel(Channel *channel) {
 // 将 channel 从 poller 中删除
 void EPollPoller::removeChannel(Channel *channel) {
   int fd = channel->fd();
-  LOG_INFO("[%s:%s:%d]\nfd = %d events = %d\n", __FILE__, __FUNCTION__,
-           __LINE__, fd, channel->events());
+  LOG_BIN_INFO("fd = %d events = %d\n", fd, channel->events());
   channels_.erase(fd);
   int index = channel->index();
   if (index == kAdded) {
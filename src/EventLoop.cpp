@@ -2,6 +2,7 @@
 #include "Channel.h"
 #include "Logger.h"
 #include "Poller.h"
+#include "TimerQueue.h"
 
 #include <errno.h>
 #include <fcntl.h>
@@ -34,10 +35,12 @@ EventLoop::EventLoop()
     , callingPendingFunctors_(false)
     , threadId_(CurrentThread::tid())
     , poller_(Poller::newDefaultPoller(this))
+    , timerQueue_(new TimerQueue(this))
+    , busyTimeUs_(0)
     , wakeupFd_(createEventFd()) // 注册一个 fd,但还没设置该 fd 感兴趣的事件
-    , wakeupChannel_(new Channel(this, wakeupFd_)) { // 唤醒 subReactor
-  LOG_DEBUG("EventLoop created %p in thread %d\n", __FILE__, __FUNCTION__,
-            __LINE__, this, threadId_);
+    , wakeupChannel_(new Channel(this, wakeupFd_)) // 唤醒 subReactor
+    , callingIterationEndFunctors_(false) {
+  LOG_DEBUG("EventLoop created %p in thread %d", this, threadId_);
   if (t_loopInThisThread) {
     // 当前线程已经创建了一个 EventLoop 对象
     LOG_FATAL("[%s:%s:%d]\nAnother EventLoop %p exists in this thread %d\n",
@@ -54,6 +57,10 @@ EventLoop::EventLoop()
 }
 
 EventLoop::~EventLoop() {
+  // 先销毁绑定在 loop 上的对象，它们的析构函数可能还要取消定时器、从 poller 上删除 channel
+  while (!attachments_.empty()) {
+    attachments_.pop_back();
+  }
   wakeupChannel_->disableAll(); // 设置 channel 对所有事件都不感兴趣
   wakeupChannel_->remove();     // 删除 channel
   ::close(wakeupFd_);           // 然后关闭 fd，线程阻塞
@@ -73,6 +80,7 @@ void EventLoop::loop() {
     // 之间通信(唤醒subLoop)的 wakeupfd_ loop() 方法通过调用 poller 封装的 I/O
     // 复用接口，获取 activeChannels_ 中所有的 channel
     pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+    int64_t busyStart = Timer::now();
     for (Channel *channel : activeChannels_) {
       // Poller 监听哪些 channel 发生了事件，并将其上报给 EventLoop,通知 channel
       // 处理 events 事件 然后 channel 会通过 handleEvent 在
@@ -85,12 +93,24 @@ void EventLoop::loop() {
     // 分发给它 mainLoop 事先注册一个回调cb(需要subLoop执行)，wakeup subLoop
     // 后，执行之前 mainLoop 注册 cb
     doPendingFunctors();
+    // 本轮的事件和回调都处理完了，执行合并后的操作(比如 auto-cork 的连接统一 flush)
+    doIterationEndFunctors();
+    busyTimeUs_.store(busyTimeUs_.load(std::memory_order_relaxed) + Timer::now() - busyStart,
+                      std::memory_order_relaxed);
   }
   LOG_INFO("[%s:%s:%d]\nEventLoop %p stop looping!\n", __FILE__, __FUNCTION__,
            __LINE__, this);
   looping_ = false;
 }
 
+Timestamp EventLoop::cachedNow() {
+  EventLoop *loop = t_loopInThisThread;
+  if (loop != nullptr && loop->pollReturnTime_.valid()) {
+    return loop->pollReturnTime_;
+  }
+  return Timestamp::now();
+}
+
 // 退出事件循环，两种可能：
 // 1.loop在自己的线程中调用 quit()
 // 2.在非 loop 线程中调用 quit()，比如在一个 subLoop 中调用了 mainLoop 的quit()
@@ -110,7 +130,8 @@ void EventLoop::runInLoop(Functor cb) {
     cb();
   } else {
     // 在非当前 loop 线程中执行 cb，就需要唤醒 loop 所在的线程执行 cb
-    queueInLoop(cb);
+    // cb 中可能绑定了大块数据(比如跨线程 send 的 string)，一路移动而不是拷贝
+    queueInLoop(std::move(cb));
   }
 }
 
@@ -119,7 +140,7 @@ void EventLoop::queueInLoop(Functor cb) {
   // 出了代码块锁就消失了
   {
     std::unique_lock<std::mutex> lock(mutex_);
-    pendingFunctors_.emplace_back(cb);
+    pendingFunctors_.emplace_back(std::move(cb));
   }
   // 唤醒相应的、需要执行上面回调操作的 loop 线程
   // 1. 当前代码所在线程不是要执行回调的 loop 线程，需要唤醒那个 loop 线程
@@ -133,6 +154,14 @@ void EventLoop::queueInLoop(Functor cb) {
   }
 }
 
+void EventLoop::runAtIterationEnd(Functor cb) {
+  iterationEndFunctors_.emplace_back(std::move(cb));
+  // 已经错过了本轮的执行时机，或者 loop 还没有开始运行，需要唤醒 loop 再走一轮，避免阻塞在 poll 上
+  if (callingIterationEndFunctors_ || !looping_) {
+    wakeup();
+  }
+}
+
 // 唤醒线程时被公有方法调用
 void EventLoop::handleRead() {
   uint64_t one = 1;
@@ -157,6 +186,18 @@ void EventLoop::wakeup() {
   }
 }
 
+TimerId EventLoop::runAfter(double delay, Functor cb) {
+  int64_t when = Timer::now() + static_cast<int64_t>(delay * 1000 * 1000);
+  return timerQueue_->addTimer(std::move(cb), when, 0);
+}
+
+TimerId EventLoop::runEvery(double interval, Functor cb) {
+  int64_t intervalUs = static_cast<int64_t>(interval * 1000 * 1000);
+  return timerQueue_->addTimer(std::move(cb), Timer::now() + intervalUs, intervalUs);
+}
+
+void EventLoop::cancel(TimerId timerId) { timerQueue_->cancel(timerId); }
+
 // channel 的方法 ==> EventLoop 的这两个方法 ==> poller 上的update/removeChannel
 // 方法
 void EventLoop::updateChannel(Channel *channel) {
@@ -190,4 +231,20 @@ void EventLoop::doPendingFunctors() {
     functor(); // 执行当前 loop 需要执行的回调操作
   }
   callingPendingFunctors_ = false;
-}
\ No newline at end of file
+}
+
+void EventLoop::doIterationEndFunctors() {
+  if (iterationEndFunctors_.empty()) {
+    return;
+  }
+  runningIterationEndFunctors_.swap(iterationEndFunctors_);
+  // 这些回调中 queueInLoop 的回调也要唤醒 loop，和 doPendingFunctors 中的情况一样
+  callingPendingFunctors_ = true;
+  callingIterationEndFunctors_ = true;
+  for (const Functor &functor : runningIterationEndFunctors_) {
+    functor();
+  }
+  runningIterationEndFunctors_.clear();
+  callingIterationEndFunctors_ = false;
+  callingPendingFunctors_ = false;
+}
@@ -1,5 +1,6 @@
 #include "EventLoopThreadPool.h"
 #include "EventLoopThread.h"
+#include "Logger.h"
 
 #include <memory>
 
@@ -8,7 +9,13 @@ EventLoopThreadPool::EventLoopThreadPool(EventLoop *baseLoop, const std::string
     , name_(nameArg)
     , started_(false)
     , numThreads_(0)
-    , next_(0) {}
+    , next_(0)
+    , nameIndex_(0)
+    , numLoops_(0) {
+  for (std::atomic<EventLoop *> &slot : loopSlots_) {
+    slot.store(nullptr, std::memory_order_relaxed);
+  }
+}
 
 // 由于在 EventLoopThread 中绑定的新线程执行的函数中，创建的 EventLoop
 // 是个栈对象，所以当事件循环的 poller
@@ -17,13 +24,10 @@ EventLoopThreadPool::~EventLoopThreadPool() {}
 
 void EventLoopThreadPool::start(const ThreadInitCallback &cb) {
   started_ = true;
+  threadInitCallback_ = cb;
   // 如果用户设置了多线程模式，就执行这段逻辑，不执行下一段
   for (int i = 0; i < numThreads_; ++i) {
-    char buf[name_.size() + 32];
-    snprintf(buf, sizeof(buf), "%s%d", name_.c_str(), i);
-    EventLoopThread *t = new EventLoopThread(cb, buf);
-    threads_.push_back(std::unique_ptr<EventLoopThread>(t));
-    loops_.push_back(t->startLoop()); // 创建线程，绑定一个新的EventLoop，并返回它的地址
+    addLoop();
   }
 
   // 整个服务端只有一个线程，运行着 baseloop_
@@ -32,25 +36,81 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb) {
   }
 }
 
+EventLoop *EventLoopThreadPool::addLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  int n = numLoops_.load(std::memory_order_relaxed);
+  if (n >= kMaxLoops) {
+    LOG_ERROR("[%s:%s:%d]\nEventLoopThreadPool [%s] reached max loops %d\n", __FILE__,
+              __FUNCTION__, __LINE__, name_.c_str(), kMaxLoops);
+    return nullptr;
+  }
+  char buf[name_.size() + 32];
+  snprintf(buf, sizeof(buf), "%s%d", name_.c_str(), nameIndex_++);
+  EventLoopThread *t = new EventLoopThread(threadInitCallback_, buf);
+  threads_.push_back(std::unique_ptr<EventLoopThread>(t));
+  EventLoop *loop = t->startLoop(); // 创建线程，绑定一个新的EventLoop，并返回它的地址
+  loops_.push_back(loop);
+  // 先发布槽位，再让读者看到新的数量
+  loopSlots_[n].store(loop, std::memory_order_release);
+  numLoops_.store(n + 1, std::memory_order_release);
+  return loop;
+}
+
+std::unique_ptr<EventLoopThread> EventLoopThreadPool::detachLoop(EventLoop *loop) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  std::unique_ptr<EventLoopThread> thread;
+  for (size_t i = 0; i < loops_.size(); ++i) {
+    if (loops_[i] == loop) {
+      thread = std::move(threads_[i]);
+      threads_.erase(threads_.begin() + i);
+      loops_.erase(loops_.begin() + i);
+      break;
+    }
+  }
+  if (!thread) {
+    return thread;
+  }
+  int n = numLoops_.load(std::memory_order_relaxed);
+  for (int i = 0; i < n; ++i) {
+    if (loopSlots_[i].load(std::memory_order_relaxed) == loop) {
+      // 用最后一个槽位填补空位；读者可能短暂地读到被摘下的 loop，此时它仍在运行，是安全的
+      loopSlots_[i].store(loopSlots_[n - 1].load(std::memory_order_relaxed), std::memory_order_release);
+      numLoops_.store(n - 1, std::memory_order_release);
+      loopSlots_[n - 1].store(nullptr, std::memory_order_release);
+      break;
+    }
+  }
+  return thread;
+}
+
 // 如果工作在多线程中，baseLoop 会默认一轮询的方式分配 channel 给 subLoop
 EventLoop *EventLoopThreadPool::getNextLoop() {
   // 如果单线程，就是用户线程
   EventLoop *loop = baseLoop_;
   // 如果多线程，轮询获取下一个处理事件的 loop
-  if (!loops_.empty()) {
-    loop = loops_[next_];
-    ++next_;
-    if (next_ >= loops_.size()) {
-      next_ = 0;
+  int n = numLoops_.load(std::memory_order_acquire);
+  if (n > 0) {
+    unsigned idx = next_.fetch_add(1, std::memory_order_relaxed) % n;
+    EventLoop *slot = loopSlots_[idx].load(std::memory_order_acquire);
+    // 数量和槽位不是一起读取的，并发删除时可能读到空槽位
+    if (slot != nullptr) {
+      loop = slot;
     }
   }
   return loop;
 }
 
 std::vector<EventLoop *> EventLoopThreadPool::getAllLoops() {
-  if (loops_.empty()) {
-    return std::vector<EventLoop *>(1, baseLoop_);
-  } else {
-    return loops_;
+  std::vector<EventLoop *> loops;
+  int n = numLoops_.load(std::memory_order_acquire);
+  for (int i = 0; i < n; ++i) {
+    EventLoop *loop = loopSlots_[i].load(std::memory_order_acquire);
+    if (loop != nullptr) {
+      loops.push_back(loop);
+    }
   }
-}
\ No newline at end of file
+  if (loops.empty()) {
+    loops.push_back(baseLoop_);
+  }
+  return loops;
+}
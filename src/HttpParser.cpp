@@ -0,0 +1,360 @@
+#include "HttpParser.h"
+#include "Buffer.h"
+
+#include <string.h>
+
+namespace {
+
+// chunk 大小行(含 chunk 扩展)的长度上限，防止没有换行的大小行让输入缓冲区无限增长
+const size_t kMaxChunkSizeLineBytes = 1024;
+
+bool isToken(const char *begin, const char *end, const char *s) {
+  size_t n = ::strlen(s);
+  return static_cast<size_t>(end - begin) == n && ::strncasecmp(begin, s, n) == 0;
+}
+
+// value 中是否包含逗号分隔的 token(大小写不敏感)，用于 Connection 和 Transfer-Encoding
+bool hasToken(const char *begin, const char *end, const char *token) {
+  while (begin < end) {
+    const char *comma = static_cast<const char *>(::memchr(begin, ',', end - begin));
+    const char *itemEnd = comma != nullptr ? comma : end;
+    const char *b = begin;
+    const char *e = itemEnd;
+    while (b < e && (*b == ' ' || *b == '\t')) {
+      ++b;
+    }
+    while (e > b && (e[-1] == ' ' || e[-1] == '\t')) {
+      --e;
+    }
+    if (isToken(b, e, token)) {
+      return true;
+    }
+    begin = itemEnd + 1;
+  }
+  return false;
+}
+
+HttpRequest::Method parseMethod(const char *begin, size_t n) {
+  switch (n) {
+    case 3:
+      if (::memcmp(begin, "GET", 3) == 0) return HttpRequest::kGet;
+      if (::memcmp(begin, "PUT", 3) == 0) return HttpRequest::kPut;
+      break;
+    case 4:
+      if (::memcmp(begin, "POST", 4) == 0) return HttpRequest::kPost;
+      if (::memcmp(begin, "HEAD", 4) == 0) return HttpRequest::kHead;
+      break;
+    case 5:
+      if (::memcmp(begin, "PATCH", 5) == 0) return HttpRequest::kPatch;
+      break;
+    case 6:
+      if (::memcmp(begin, "DELETE", 6) == 0) return HttpRequest::kDelete;
+      break;
+    case 7:
+      if (::memcmp(begin, "OPTIONS", 7) == 0) return HttpRequest::kOptions;
+      break;
+    default:
+      break;
+  }
+  return HttpRequest::kInvalid;
+}
+
+// 解析十进制/十六进制数，溢出或含有非法字符时返回 false
+bool parseSize(const char *begin, const char *end, int base, size_t *out) {
+  if (begin == end) {
+    return false;
+  }
+  size_t value = 0;
+  for (const char *p = begin; p < end; ++p) {
+    int digit;
+    if (*p >= '0' && *p <= '9') {
+      digit = *p - '0';
+    } else if (base == 16 && *p >= 'a' && *p <= 'f') {
+      digit = *p - 'a' + 10;
+    } else if (base == 16 && *p >= 'A' && *p <= 'F') {
+      digit = *p - 'A' + 10;
+    } else {
+      return false;
+    }
+    if (value > (SIZE_MAX - digit) / base) {
+      return false;
+    }
+    value = value * base + digit;
+  }
+  *out = value;
+  return true;
+}
+
+} // namespace
+
+HttpParser::HttpParser(size_t maxHeaderBytes, size_t maxBodyBytes)
+    : maxHeaderBytes_(maxHeaderBytes), maxBodyBytes_(maxBodyBytes) {
+  reset();
+}
+
+void HttpParser::reset() {
+  state_ = kRequestLine;
+  pos_ = 0;
+  scan_ = 0;
+  contentLength_ = 0;
+  chunkRemaining_ = 0;
+  trailerStart_ = 0;
+  hasContentLength_ = false;
+  hasTransferEncoding_ = false;
+  connectionClose_ = false;
+  connectionKeepAlive_ = false;
+  expectContinue_ = false;
+  errorStatus_ = 0;
+}
+
+bool HttpParser::nextLine(const char *data, size_t readable, size_t *begin, size_t *end) {
+  const char *nl = static_cast<const char *>(::memchr(data + scan_, '\n', readable - scan_));
+  if (nl == nullptr) {
+    scan_ = readable;
+    return false;
+  }
+  *begin = pos_;
+  *end = nl - data;
+  if (*end > *begin && data[*end - 1] == '\r') {
+    --*end;
+  }
+  pos_ = scan_ = nl - data + 1;
+  return true;
+}
+
+HttpParser::Result HttpParser::parse(const Buffer *buf, HttpRequest *request) {
+  const char *data = buf->peek();
+  const size_t readable = buf->readableBytes();
+  size_t begin;
+  size_t end;
+  while (state_ != kDone) {
+    switch (state_) {
+      case kRequestLine:
+      case kHeaders:
+        if (!nextLine(data, readable, &begin, &end)) {
+          return scan_ > maxHeaderBytes_ ? fail(431) : kNeedMore;
+        }
+        if (pos_ > maxHeaderBytes_) {
+          return fail(431);
+        }
+        if (state_ == kRequestLine) {
+          // 容忍请求之间多余的空行(RFC 7230 3.5)
+          if (begin == end) {
+            continue;
+          }
+          if (!parseRequestLine(data, begin, end, request)) {
+            return fail(errorStatus_);
+          }
+          state_ = kHeaders;
+        } else if (begin == end) {
+          if (!finishHeaders(request)) {
+            return fail(errorStatus_);
+          }
+        } else if (!parseHeader(data, begin, end, request)) {
+          return fail(400);
+        }
+        break;
+      case kBody:
+        if (readable - pos_ < contentLength_) {
+          return kNeedMore;
+        }
+        request->body_ = HttpRequest::Range(pos_, contentLength_);
+        pos_ += contentLength_;
+        scan_ = pos_;
+        state_ = kDone;
+        break;
+      case kChunkSize: {
+        if (!nextLine(data, readable, &begin, &end)) {
+          return scan_ - pos_ > kMaxChunkSizeLineBytes ? fail(400) : kNeedMore;
+        }
+        if (end - begin > kMaxChunkSizeLineBytes) {
+          return fail(400);
+        }
+        // 忽略 chunk 扩展
+        const char *semi = static_cast<const char *>(::memchr(data + begin, ';', end - begin));
+        const char *sizeEnd = semi != nullptr ? semi : data + end;
+        while (sizeEnd > data + begin && (sizeEnd[-1] == ' ' || sizeEnd[-1] == '\t')) {
+          --sizeEnd;
+        }
+        if (!parseSize(data + begin, sizeEnd, 16, &chunkRemaining_)) {
+          return fail(400);
+        }
+        if (chunkRemaining_ > maxBodyBytes_ - request->chunkedBody_.size()) {
+          return fail(413);
+        }
+        if (chunkRemaining_ == 0) {
+          trailerStart_ = pos_;
+          state_ = kTrailers;
+        } else {
+          state_ = kChunkData;
+        }
+        break;
+      }
+      case kChunkData:
+        if (readable - pos_ < chunkRemaining_) {
+          return kNeedMore;
+        }
+        request->chunkedBody_.append(data + pos_, chunkRemaining_);
+        pos_ += chunkRemaining_;
+        scan_ = pos_;
+        state_ = kChunkDataEnd;
+        break;
+      case kChunkDataEnd:
+        // chunk 数据后面只能是 CRLF
+        if (!nextLine(data, readable, &begin, &end)) {
+          return scan_ - pos_ > 1 ? fail(400) : kNeedMore;
+        }
+        if (begin != end) {
+          return fail(400);
+        }
+        state_ = kChunkSize;
+        break;
+      case kTrailers:
+        // trailer 头部被忽略，空行表示请求结束；trailer 与头部一样受 maxHeaderBytes_ 限制
+        if (!nextLine(data, readable, &begin, &end)) {
+          return scan_ - trailerStart_ > maxHeaderBytes_ ? fail(431) : kNeedMore;
+        }
+        if (pos_ - trailerStart_ > maxHeaderBytes_) {
+          return fail(431);
+        }
+        if (begin == end) {
+          state_ = kDone;
+        }
+        break;
+      case kDone:
+        break;
+    }
+  }
+  request->base_ = data;
+  return kComplete;
+}
+
+// 失败时在 errorStatus_ 中记录状态码：格式正确但方法未知时为 501，其他为 400
+bool HttpParser::parseRequestLine(const char *data, size_t begin, size_t end, HttpRequest *request) {
+  errorStatus_ = 400;
+  const char *line = data + begin;
+  const char *lineEnd = data + end;
+  const char *sp1 = static_cast<const char *>(::memchr(line, ' ', lineEnd - line));
+  if (sp1 == nullptr) {
+    return false;
+  }
+  request->method_ = parseMethod(line, sp1 - line);
+  request->methodRange_ = HttpRequest::Range(begin, sp1 - line);
+  const char *target = sp1 + 1;
+  const char *sp2 = static_cast<const char *>(::memchr(target, ' ', lineEnd - target));
+  if (sp2 == nullptr || sp2 == target) {
+    return false;
+  }
+  request->target_ = HttpRequest::Range(target - data, sp2 - target);
+  const char *question = static_cast<const char *>(::memchr(target, '?', sp2 - target));
+  if (question != nullptr) {
+    request->path_ = HttpRequest::Range(target - data, question - target);
+    request->query_ = HttpRequest::Range(question + 1 - data, sp2 - question - 1);
+  } else {
+    request->path_ = request->target_;
+  }
+  const char *version = sp2 + 1;
+  if (lineEnd - version != 8 || ::memcmp(version, "HTTP/1.", 7) != 0) {
+    return false;
+  }
+  if (version[7] == '1') {
+    request->version_ = HttpRequest::kHttp11;
+  } else if (version[7] == '0') {
+    request->version_ = HttpRequest::kHttp10;
+  } else {
+    return false;
+  }
+  if (request->method_ == HttpRequest::kInvalid) {
+    errorStatus_ = 501;
+    return false;
+  }
+  errorStatus_ = 0;
+  return true;
+}
+
+bool HttpParser::parseHeader(const char *data, size_t begin, size_t end, HttpRequest *request) {
+  const char *line = data + begin;
+  const char *lineEnd = data + end;
+  // 不支持已废弃的多行头部
+  if (*line == ' ' || *line == '\t') {
+    return false;
+  }
+  const char *colon = static_cast<const char *>(::memchr(line, ':', lineEnd - line));
+  if (colon == nullptr || colon == line || colon[-1] == ' ' || colon[-1] == '\t') {
+    return false;
+  }
+  const char *value = colon + 1;
+  while (value < lineEnd && (*value == ' ' || *value == '\t')) {
+    ++value;
+  }
+  const char *valueEnd = lineEnd;
+  while (valueEnd > value && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t')) {
+    --valueEnd;
+  }
+  HttpRequest::Header header;
+  header.name = HttpRequest::Range(begin, colon - line);
+  header.value = HttpRequest::Range(value - data, valueEnd - value);
+  request->headers_.push_back(header);
+
+  // 只关心影响报文边界和连接管理的几个头部
+  switch (colon - line) {
+    case 6:
+      if (isToken(line, colon, "Expect") && isToken(value, valueEnd, "100-continue")) {
+        expectContinue_ = true;
+      }
+      break;
+    case 10:
+      if (isToken(line, colon, "Connection")) {
+        connectionClose_ = connectionClose_ || hasToken(value, valueEnd, "close");
+        connectionKeepAlive_ = connectionKeepAlive_ || hasToken(value, valueEnd, "keep-alive");
+      }
+      break;
+    case 14:
+      if (isToken(line, colon, "Content-Length")) {
+        size_t length;
+        if (!parseSize(value, valueEnd, 10, &length) || (hasContentLength_ && length != contentLength_)) {
+          return false;
+        }
+        hasContentLength_ = true;
+        contentLength_ = length;
+      }
+      break;
+    case 17:
+      if (isToken(line, colon, "Transfer-Encoding")) {
+        hasTransferEncoding_ = true;
+        request->chunked_ = request->chunked_ || hasToken(value, valueEnd, "chunked");
+      }
+      break;
+    default:
+      break;
+  }
+  return true;
+}
+
+bool HttpParser::finishHeaders(HttpRequest *request) {
+  if (request->version_ == HttpRequest::kHttp11) {
+    request->keepAlive_ = !connectionClose_;
+  } else {
+    request->keepAlive_ = connectionKeepAlive_ && !connectionClose_;
+  }
+  if (request->chunked_) {
+    // 同时带有 Content-Length 和 chunked 是请求走私的常见手法，直接拒绝
+    if (hasContentLength_) {
+      errorStatus_ = 400;
+      return false;
+    }
+    state_ = kChunkSize;
+  } else if (hasTransferEncoding_) {
+    errorStatus_ = 501;
+    return false;
+  } else if (contentLength_ > maxBodyBytes_) {
+    errorStatus_ = 413;
+    return false;
+  } else {
+    state_ = contentLength_ > 0 ? kBody : kDone;
+  }
+  if (state_ == kDone) {
+    expectContinue_ = false;
+  }
+  return true;
+}
@@ -0,0 +1,200 @@
+#include "HttpResponse.h"
+#include "Buffer.h"
+#include "Logger.h"
+#include "TcpConnection.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace {
+
+const char *reasonPhrase(int code) {
+  switch (code) {
+    case 100: return "Continue";
+    case 200: return "OK";
+    case 201: return "Created";
+    case 204: return "No Content";
+    case 206: return "Partial Content";
+    case 301: return "Moved Permanently";
+    case 302: return "Found";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 408: return "Request Timeout";
+    case 413: return "Payload Too Large";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    case 502: return "Bad Gateway";
+    case 503: return "Service Unavailable";
+    default: return "Unknown";
+  }
+}
+
+void appendString(Buffer *out, const char *s) { out->append(s, ::strlen(s)); }
+
+} // namespace
+
+HttpResponse::HttpResponse()
+    : state_(kFinished)
+    , status_(200)
+    , reason_(nullptr)
+    , close_(false)
+    , head_(false)
+    , http10_(false)
+    , dispatching_(false) {}
+
+void HttpResponse::reset(const TcpConnectionPtr &conn, const HttpRequest &request) {
+  conn_ = conn;
+  state_ = kIdle;
+  status_ = 200;
+  reason_ = nullptr;
+  close_ = !request.keepAlive();
+  head_ = request.method() == HttpRequest::kHead;
+  http10_ = request.version() == HttpRequest::kHttp10;
+}
+
+void HttpResponse::setStatus(int code, const char *reason) {
+  if (state_ != kIdle) {
+    LOG_ERROR("[%s:%s:%d]\nHttpResponse::setStatus %d after headers were written\n", __FILE__,
+              __FUNCTION__, __LINE__, code);
+    return;
+  }
+  status_ = code;
+  reason_ = reason;
+}
+
+Buffer *HttpResponse::output(TcpConnectionPtr *conn) {
+  *conn = conn_.lock();
+  if (!*conn || (*conn)->disconnected() || state_ == kFinished) {
+    return nullptr;
+  }
+  Buffer *out = (*conn)->outputBuffer();
+  if (state_ == kIdle) {
+    char line[128];
+    int n = ::snprintf(line, sizeof(line), "HTTP/1.1 %d %s\r\n", status_,
+                       reason_ != nullptr ? reason_ : reasonPhrase(status_));
+    out->append(line, static_cast<size_t>(n));
+    state_ = kHeaders;
+  }
+  return out;
+}
+
+void HttpResponse::addHeader(const char *name, const char *value) {
+  TcpConnectionPtr conn;
+  Buffer *out = output(&conn);
+  if (out == nullptr || state_ != kHeaders) {
+    return;
+  }
+  appendString(out, name);
+  out->append(": ", 2);
+  appendString(out, value);
+  out->append("\r\n", 2);
+}
+
+// 结束头部：contentLength < 0 表示 chunked(HTTP/1.0 时以关闭连接结束响应体)
+void HttpResponse::writeHeaderEnd(Buffer *out, int64_t contentLength) {
+  char line[64];
+  if (contentLength >= 0) {
+    int n = ::snprintf(line, sizeof(line), "Content-Length: %ld\r\n", static_cast<long>(contentLength));
+    out->append(line, static_cast<size_t>(n));
+  } else if (!http10_) {
+    appendString(out, "Transfer-Encoding: chunked\r\n");
+  }
+  if (close_) {
+    appendString(out, "Connection: close\r\n");
+  } else if (http10_) {
+    appendString(out, "Connection: keep-alive\r\n");
+  }
+  out->append("\r\n", 2);
+}
+
+void HttpResponse::send(const char *body, size_t len) {
+  TcpConnectionPtr conn;
+  Buffer *out = output(&conn);
+  if (out == nullptr || state_ != kHeaders) {
+    return;
+  }
+  writeHeaderEnd(out, static_cast<int64_t>(len));
+  if (!head_) {
+    out->append(body, len);
+  }
+  finish(conn);
+}
+
+void HttpResponse::sendFile(int fd, off_t offset, size_t length) {
+  TcpConnectionPtr conn;
+  Buffer *out = output(&conn);
+  if (out == nullptr || state_ != kHeaders) {
+    ::close(fd);
+    return;
+  }
+  writeHeaderEnd(out, static_cast<int64_t>(length));
+  if (head_ || length == 0) {
+    ::close(fd);
+  } else {
+    // 文件排在已经写入 outputBuffer_ 的头部之后发送
+    conn->sendFile(fd, offset, length);
+  }
+  finish(conn);
+}
+
+void HttpResponse::beginChunked() {
+  TcpConnectionPtr conn;
+  Buffer *out = output(&conn);
+  if (out == nullptr || state_ != kHeaders) {
+    return;
+  }
+  if (http10_) {
+    close_ = true;
+  }
+  writeHeaderEnd(out, -1);
+  state_ = kChunked;
+  if (!dispatching_) {
+    conn->flush();
+  }
+}
+
+void HttpResponse::writeChunk(const char *data, size_t len) {
+  TcpConnectionPtr conn;
+  Buffer *out = output(&conn);
+  // 长度为 0 的 chunk 表示响应体结束，由 endChunked 写出
+  if (out == nullptr || state_ != kChunked || len == 0 || head_) {
+    return;
+  }
+  if (http10_) {
+    out->append(data, len);
+  } else {
+    char line[32];
+    int n = ::snprintf(line, sizeof(line), "%zx\r\n", len);
+    out->append(line, static_cast<size_t>(n));
+    out->append(data, len);
+    out->append("\r\n", 2);
+  }
+  if (!dispatching_) {
+    conn->flush();
+  }
+}
+
+void HttpResponse::endChunked() {
+  TcpConnectionPtr conn;
+  Buffer *out = output(&conn);
+  if (out == nullptr || state_ != kChunked) {
+    return;
+  }
+  if (!http10_ && !head_) {
+    out->append("0\r\n\r\n", 5);
+  }
+  finish(conn);
+}
+
+// 响应结束；在 HttpCallback 中结束时由 HttpServer 在回调返回后处理，否则通知 HttpServer 继续处理后续请求
+void HttpResponse::finish(const TcpConnectionPtr &) {
+  state_ = kFinished;
+  if (!dispatching_ && finishCallback_) {
+    finishCallback_();
+  }
+}
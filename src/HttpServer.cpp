@@ -0,0 +1,122 @@
+#include "HttpServer.h"
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "TcpConnection.h"
+
+namespace {
+
+void defaultHttpCallback(const HttpRequest &, HttpResponse *resp) {
+  resp->setStatus(404);
+  resp->send("", 0);
+}
+
+} // namespace
+
+HttpServer::HttpServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &name,
+                       TcpServer::Option option)
+    : server_(loop, listenAddr, name, option)
+    , httpCallback_(defaultHttpCallback)
+    , maxHeaderBytes_(HttpParser::kDefaultMaxHeaderBytes)
+    , maxBodyBytes_(HttpParser::kDefaultMaxBodyBytes) {
+  server_.setConnectionCallback(std::bind(&HttpServer::onConnection, this, std::placeholders::_1));
+}
+
+void HttpServer::start() { server_.start(); }
+
+void HttpServer::onConnection(const TcpConnectionPtr &conn) {
+  if (!conn->connected()) {
+    return;
+  }
+  // Session 由连接的 messageCallback 持有，Session 中的 HttpResponse 只持有连接的 weak_ptr，不会循环引用
+  SessionPtr session = std::make_shared<Session>(maxHeaderBytes_, maxBodyBytes_);
+  std::weak_ptr<TcpConnection> weakConn(conn);
+  std::weak_ptr<Session> weakSession(session);
+  session->response.finishCallback_ = [this, weakConn, weakSession]() { onResponseFinished(weakConn, weakSession); };
+  conn->setMessageCallback([this, session](const TcpConnectionPtr &c, Buffer *buf, Timestamp receiveTime) {
+    onMessage(c, session, buf, receiveTime);
+  });
+}
+
+void HttpServer::onMessage(const TcpConnectionPtr &conn, const SessionPtr &session, Buffer *, Timestamp receiveTime) {
+  processRequests(conn, session, receiveTime);
+}
+
+void HttpServer::processRequests(const TcpConnectionPtr &conn, const SessionPtr &session, Timestamp receiveTime) {
+  Buffer *buf = conn->inputBuffer();
+  HttpResponse &response = session->response;
+  bool wrote = false;
+  while (response.finished() && conn->connected()) {
+    HttpParser::Result result = session->parser.parse(buf, &session->request);
+    if (result == HttpParser::kNeedMore) {
+      if (session->parser.expectContinue()) {
+        static const char kContinue[] = "HTTP/1.1 100 Continue\r\n\r\n";
+        conn->outputBuffer()->append(kContinue, sizeof(kContinue) - 1);
+        session->parser.clearExpectContinue();
+        wrote = true;
+      }
+      break;
+    }
+    if (result == HttpParser::kError) {
+      sendError(conn, session.get(), session->parser.errorStatus());
+      return;
+    }
+
+    session->request.setReceiveTime(receiveTime);
+    response.reset(conn, session->request);
+    response.dispatching_ = true;
+    httpCallback_(session->request, &response);
+    response.dispatching_ = false;
+    buf->retrieve(session->parser.consumed());
+    session->parser.reset();
+    session->request.reset();
+    wrote = true;
+    if (response.finished() && response.closeConnection()) {
+      conn->flush();
+      conn->shutdown();
+      return;
+    }
+  }
+  // 这一批请求的响应合并成一次写
+  if (wrote) {
+    conn->flush();
+  }
+}
+
+void HttpServer::onResponseFinished(const std::weak_ptr<TcpConnection> &weakConn,
+                                    const std::weak_ptr<Session> &weakSession) {
+  TcpConnectionPtr conn = weakConn.lock();
+  SessionPtr session = weakSession.lock();
+  if (!conn || !session || !conn->connected()) {
+    return;
+  }
+  conn->flush();
+  if (session->response.closeConnection()) {
+    conn->shutdown();
+    return;
+  }
+  // 继续处理响应期间到达的流水线请求；放到队列中执行，避免在用户代码中重入 HttpCallback
+  conn->getLoop()->queueInLoop([this, weakConn, weakSession]() {
+    TcpConnectionPtr c = weakConn.lock();
+    SessionPtr s = weakSession.lock();
+    if (c && s && s->response.finished()) {
+      processRequests(c, s, EventLoop::cachedNow());
+    }
+  });
+}
+
+// 请求无法解析，回复错误状态后关闭连接
+void HttpServer::sendError(const TcpConnectionPtr &conn, Session *session, int status) {
+  LOG_INFO("[%s:%s:%d]\nHttpServer bad request from %s, status %d\n", __FILE__, __FUNCTION__, __LINE__,
+            conn->peerAddress().toIpPort().c_str(), status);
+  HttpResponse &response = session->response;
+  response.reset(conn, session->request);
+  response.setCloseConnection(true);
+  response.setStatus(status);
+  response.dispatching_ = true;
+  response.send("", 0);
+  response.dispatching_ = false;
+  conn->flush();
+  conn->shutdown();
+  conn->inputBuffer()->retrieveAll();
+}
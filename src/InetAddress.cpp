@@ -1,34 +1,131 @@
 #include "InetAddress.h"
+#include "Logger.h"
 
+#include <algorithm>
+#include <stddef.h>
 #include <string.h>
 #include <strings.h> // bzero
 
 InetAddress::InetAddress(uint16_t port, std::string ip) {
-  bzero(&addr_, sizeof(addr_));
+  bzero(&addrUn_, sizeof(addrUn_));
+  if (ip.find(':') != std::string::npos) {
+    addr6_.sin6_family = AF_INET6;
+    addr6_.sin6_port = htons(port);
+    len_ = sizeof(addr6_);
+    if (::inet_pton(AF_INET6, ip.c_str(), &addr6_.sin6_addr) != 1) {
+      LOG_ERROR("[%s:%s:%d]\ninvalid IPv6 address: %s\n", __FILE__, __FUNCTION__, __LINE__, ip.c_str());
+      len_ = 0;
+    }
+    return;
+  }
   addr_.sin_family = AF_INET;
   addr_.sin_port = htons(port);
-  // addr_.sin_addr.s_addr = inet_addr(ip.c_str());
-  addr_.sin_addr.s_addr = htonl(INADDR_ANY);
+  len_ = sizeof(addr_);
+  if (ip.empty()) {
+    addr_.sin_addr.s_addr = htonl(INADDR_ANY);
+  } else if (::inet_pton(AF_INET, ip.c_str(), &addr_.sin_addr) != 1) {
+    LOG_ERROR("[%s:%s:%d]\ninvalid IPv4 address: %s\n", __FILE__, __FUNCTION__, __LINE__, ip.c_str());
+    len_ = 0;
+  }
+}
+
+InetAddress::InetAddress(const sockaddr_in &addr) { setSockAddr(addr); }
+
+InetAddress::InetAddress(const sockaddr_in6 &addr) { setSockAddr((const sockaddr *)&addr, sizeof(addr)); }
+
+InetAddress::InetAddress(const sockaddr *addr, socklen_t len) { setSockAddr(addr, len); }
+
+InetAddress InetAddress::unixAddress(const std::string &path) {
+  sockaddr_un addr;
+  bzero(&addr, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  size_t len = path.size();
+  if (len > sizeof(addr.sun_path) - 1) {
+    // 截断后会在另一个名字上 bind/connect，与无法解析的 ip 一样标记为无效地址
+    LOG_ERROR("[%s:%s:%d]\nunix socket path too long: %s\n", __FILE__, __FUNCTION__, __LINE__,
+              path.c_str());
+    InetAddress invalid((sockaddr *)&addr, sizeof(addr.sun_family));
+    invalid.len_ = 0;
+    return invalid;
+  }
+  ::memcpy(addr.sun_path, path.data(), len);
+  if (len > 0 && path[0] == '@') {
+    // 抽象命名空间以 '\0' 开头，名字的长度由地址长度决定
+    addr.sun_path[0] = '\0';
+    return InetAddress((sockaddr *)&addr, static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + len));
+  }
+  return InetAddress((sockaddr *)&addr, static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + len + 1));
+}
+
+void InetAddress::setSockAddr(const sockaddr_in &addr) {
+  bzero(&addrUn_, sizeof(addrUn_));
+  addr_ = addr;
+  len_ = sizeof(addr);
+}
+
+void InetAddress::setSockAddr(const sockaddr *addr, socklen_t len) {
+  bzero(&addrUn_, sizeof(addrUn_));
+  len = std::min(len, static_cast<socklen_t>(sizeof(addrUn_)));
+  ::memcpy(&addrUn_, addr, len);
+  len_ = len;
+}
+
+std::string InetAddress::unixPath() const {
+  size_t offset = offsetof(sockaddr_un, sun_path);
+  if (!isUnix() || len_ <= offset || addrUn_.sun_path[0] == '\0') {
+    return std::string();
+  }
+  return std::string(addrUn_.sun_path, strnlen(addrUn_.sun_path, len_ - offset));
 }
 
 std::string InetAddress::toIp() const {
   // 将 addr_中网络字节序的Ip地址转为本地字节序并输出
   char buf[64] = {0};
+  if (!valid()) {
+    return "<invalid>";
+  }
+  if (family() == AF_INET6) {
+    ::inet_ntop(AF_INET6, &addr6_.sin6_addr, buf, sizeof(buf));
+    return buf;
+  }
+  if (isUnix()) {
+    size_t offset = offsetof(sockaddr_un, sun_path);
+    if (len_ <= offset) {
+      return std::string(); // accept 得到的未命名地址
+    }
+    if (addrUn_.sun_path[0] == '\0') {
+      return "@" + std::string(addrUn_.sun_path + 1, len_ - offset - 1);
+    }
+    return unixPath();
+  }
   ::inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof(buf));
   return buf;
 }
 
 std::string InetAddress::toIpPort() const {
   // ip:port
+  if (isUnix()) {
+    return "unix:" + toIp();
+  }
   char buf[64] = {0};
+  uint16_t port = toPort();
+  if (family() == AF_INET6 || !valid()) {
+    snprintf(buf, sizeof(buf), family() == AF_INET6 ? "[%s]:%u" : "%s:%u", toIp().c_str(), port);
+    return buf;
+  }
   ::inet_ntop(AF_INET, &addr_.sin_addr, buf, sizeof(buf));
   size_t end = strlen(buf);
-  uint16_t port = ntohs(addr_.sin_port);
   sprintf(buf + end, ":%u", port);
   return buf;
 }
 
-uint16_t InetAddress::toPort() const { return ntohs(addr_.sin_port); }
+uint16_t InetAddress::toPort() const {
+  if (isUnix()) {
+    return 0;
+  }
+  // sin_port 和 sin6_port 的偏移相同
+  return ntohs(family() == AF_INET6 ? addr6_.sin6_port : addr_.sin_port);
+}
 
 // #define INET_ADDRESS_TEST
 #ifdef INET_ADDRESS_TEST
@@ -38,4 +135,4 @@ int main() {
   std::cout << addr.toIpPort() << '\n';
   return 0;
 }
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,128 @@
+#include "LogFile.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+LogFile::LogFile(const std::string &basename, off_t rollSize, bool threadSafe, int flushInterval,
+                 int rollInterval)
+    : basename_(basename)
+    , rollSize_(rollSize)
+    , flushInterval_(flushInterval)
+    , rollInterval_(rollInterval > 0 ? rollInterval : 60 * 60 * 24)
+    , mutex_(threadSafe ? new std::mutex : nullptr)
+    , fp_(nullptr)
+    , writtenBytes_(0)
+    , count_(0)
+    , startOfPeriod_(0)
+    , lastRoll_(0)
+    , lastFlush_(0) {
+  rollFile();
+}
+
+LogFile::~LogFile() {
+  if (fp_ != nullptr) {
+    ::fclose(fp_);
+  }
+}
+
+void LogFile::append(const char *logline, size_t len) {
+  if (mutex_) {
+    std::unique_lock<std::mutex> lock(*mutex_);
+    appendUnlocked(logline, len);
+  } else {
+    appendUnlocked(logline, len);
+  }
+}
+
+void LogFile::flush() {
+  if (fp_ == nullptr) {
+    return;
+  }
+  if (mutex_) {
+    std::unique_lock<std::mutex> lock(*mutex_);
+    ::fflush(fp_);
+  } else {
+    ::fflush(fp_);
+  }
+}
+
+void LogFile::appendUnlocked(const char *logline, size_t len) {
+  if (fp_ == nullptr) {
+    return;
+  }
+  size_t written = 0;
+  while (written < len) {
+    size_t n = ::fwrite_unlocked(logline + written, 1, len - written, fp_);
+    if (n == 0) {
+      int savedErrno = errno; // ferror 只返回错误标志，错误原因在 errno 中
+      if (::ferror(fp_)) {
+        // 日志系统自身出错只能写到 stderr，不能再调用 LOG_*
+        ::fprintf(stderr, "LogFile::append() failed: %s\n", ::strerror(savedErrno));
+      }
+      break;
+    }
+    written += n;
+  }
+  writtenBytes_ += written;
+
+  if (writtenBytes_ > rollSize_) {
+    rollFile();
+  } else if (++count_ >= kCheckTimeRoll) {
+    count_ = 0;
+    time_t now = ::time(nullptr);
+    time_t thisPeriod = now / rollInterval_ * rollInterval_;
+    if (thisPeriod != startOfPeriod_) {
+      rollFile();
+    } else if (now - lastFlush_ > flushInterval_) {
+      lastFlush_ = now;
+      ::fflush(fp_);
+    }
+  }
+}
+
+bool LogFile::rollFile() {
+  time_t now = ::time(nullptr);
+  if (now <= lastRoll_) {
+    return false;
+  }
+  std::string filename = getLogFileName(now);
+  FILE *fp = ::fopen(filename.c_str(), "ae"); // 'e' 即 O_CLOEXEC
+  if (fp == nullptr) {
+    ::fprintf(stderr, "LogFile: open %s failed: %s\n", filename.c_str(), ::strerror(errno));
+    return false;
+  }
+  if (fp_ != nullptr) {
+    ::fclose(fp_);
+  }
+  fp_ = fp;
+  ::setbuffer(fp_, buffer_, sizeof(buffer_));
+  writtenBytes_ = 0;
+  lastRoll_ = now;
+  lastFlush_ = now;
+  startOfPeriod_ = now / rollInterval_ * rollInterval_;
+  return true;
+}
+
+std::string LogFile::getLogFileName(time_t now) const {
+  std::string filename;
+  filename.reserve(basename_.size() + 64);
+  filename = basename_;
+
+  char timebuf[32];
+  struct tm tm;
+  ::gmtime_r(&now, &tm);
+  ::strftime(timebuf, sizeof(timebuf), ".%Y%m%d-%H%M%S.", &tm);
+  filename += timebuf;
+
+  char hostname[256] = {0};
+  if (::gethostname(hostname, sizeof(hostname) - 1) != 0) {
+    ::strcpy(hostname, "unknownhost");
+  }
+  filename += hostname;
+
+  char pidbuf[32];
+  ::snprintf(pidbuf, sizeof(pidbuf), ".%d.log", ::getpid());
+  filename += pidbuf;
+  return filename;
+}
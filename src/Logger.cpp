@@ -1,6 +1,45 @@
 #include "Logger.h"
 #include "Timestamp.h"
-#include <iostream>
+
+#include <algorithm>
+#include <stdarg.h>
+#include <stdio.h>
+
+namespace {
+
+void defaultOutput(int, const char *msg, size_t len) {
+  ::fwrite(msg, 1, len, stdout);
+}
+
+void defaultFlush() {
+  ::fflush(stdout);
+}
+
+const char *levelName(int level) {
+  switch (level) {
+    case DEBUG:
+      return "[DEBUG]";
+    case INFO:
+      return "[INFO]";
+    case ERROR:
+      return "[ERROR]";
+    case FATAL:
+      return "[FATAL]";
+    default:
+      return "";
+  }
+}
+
+} // namespace
+
+// 定义了 MUDUDEBUG 时默认输出调试日志
+#ifdef MUDUDEBUG
+std::atomic<int> Logger::g_logLevel(DEBUG);
+#else
+std::atomic<int> Logger::g_logLevel(INFO);
+#endif
+
+Logger::Logger() : output_(defaultOutput), flush_(defaultFlush) {}
 
 // 获取日志唯一的实例对象
 Logger &Logger::instance() {
@@ -8,28 +47,93 @@ Logger &Logger::instance() {
   return logger;
 };
 
-// 设置日志级别
+// 设置全局日志级别，同时更新跟随全局级别的模块
 void Logger::setLogLevel(int level) {
-  logLevel_ = level;
+  Logger &logger = instance();
+  std::unique_lock<std::mutex> lock(logger.mutex_);
+  g_logLevel.store(level, std::memory_order_relaxed);
+  for (LogModule *module : logger.modules_) {
+    if (module->inherit_) {
+      module->level_.store(level, std::memory_order_relaxed);
+    }
+  }
 }
 
-// 写日志  [级别信息] time : msg
-void Logger::log(std::string msg) {
-  switch (logLevel_) {
-    case INFO:
-      std::cout << "[INFO]";
-      break;
-    case ERROR:
-      std::cout << "[ERROR]";
-      break;
-    case FATAL:
-      std::cout << "[FATAL]";
-      break;
-    case DEBUG:
-      std::cout << "[DEBUG]";
-      break;
-    default:
-    break;
+void Logger::setModuleLevel(const std::string &name, int level) {
+  Logger &logger = instance();
+  std::unique_lock<std::mutex> lock(logger.mutex_);
+  logger.moduleLevels_[name] = level;
+  for (LogModule *module : logger.modules_) {
+    if (name == module->name_) {
+      module->inherit_ = false;
+      module->level_.store(level, std::memory_order_relaxed);
+    }
+  }
+}
+
+void Logger::resetModuleLevel(const std::string &name) {
+  Logger &logger = instance();
+  std::unique_lock<std::mutex> lock(logger.mutex_);
+  logger.moduleLevels_.erase(name);
+  for (LogModule *module : logger.modules_) {
+    if (name == module->name_) {
+      module->inherit_ = true;
+      module->level_.store(g_logLevel.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
   }
-  std::cout << Timestamp::now().toString() << " : " << msg << '\n';
-}
\ No newline at end of file
+}
+
+void Logger::registerModule(LogModule *module) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = moduleLevels_.find(module->name_);
+  module->inherit_ = it == moduleLevels_.end();
+  module->level_.store(module->inherit_ ? g_logLevel.load(std::memory_order_relaxed) : it->second,
+                       std::memory_order_relaxed);
+  modules_.push_back(module);
+}
+
+void Logger::unregisterModule(LogModule *module) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  modules_.erase(std::remove(modules_.begin(), modules_.end(), module), modules_.end());
+}
+
+size_t Logger::formatPrefix(char *buf, size_t len, int level, Timestamp time,
+                            const LogModule *module) {
+  // 时间部分使用 Timestamp 的每线程缓存，同一秒内的日志不再调用 localtime_r
+  char timeBuf[64];
+  time.formatTo(timeBuf, sizeof(timeBuf));
+  int n;
+  if (module != nullptr) {
+    n = ::snprintf(buf, len, "%s%s [%s] : ", levelName(level), timeBuf, module->name());
+  } else {
+    n = ::snprintf(buf, len, "%s%s : ", levelName(level), timeBuf);
+  }
+  return std::min(static_cast<size_t>(n < 0 ? 0 : n), len - 1);
+}
+
+// 写日志  [级别信息] time : msg，属于模块时为 [级别信息] time [模块] : msg
+// 整行在栈上的缓冲区中格式化，再一次交给 output_，多线程写日志时行与行之间不会交错
+void Logger::log(int level, const LogModule *module, const char *fmt, ...) {
+  char line[1280];
+  const size_t kMaxLen = sizeof(line) - 1; // 留一个字节给末尾的换行
+  size_t len = formatPrefix(line, kMaxLen, level, Timestamp::now(), module);
+  va_list args;
+  va_start(args, fmt);
+  int n = ::vsnprintf(line + len, kMaxLen - len, fmt, args);
+  va_end(args);
+  len = std::min(len + static_cast<size_t>(n < 0 ? 0 : n), kMaxLen - 1);
+  line[len++] = '\n';
+  output_(level, line, len);
+}
+
+void Logger::flush() {
+  flush_();
+}
+
+LogModule::LogModule(const char *name) : name_(name), level_(INFO), inherit_(true) {
+  Logger::instance().registerModule(this);
+}
+
+LogModule::~LogModule() {
+  Logger::instance().unregisterModule(this);
+}
@@ -0,0 +1,417 @@
+#include "RespCodec.h"
+#include "Buffer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace {
+
+// 解析十进制有符号整数，溢出或含有非法字符时返回 false
+bool parseInt(const char *begin, const char *end, int64_t *out) {
+  if (begin == end) {
+    return false;
+  }
+  bool negative = *begin == '-';
+  if (negative && ++begin == end) {
+    return false;
+  }
+  uint64_t value = 0;
+  for (const char *p = begin; p < end; ++p) {
+    if (*p < '0' || *p > '9') {
+      return false;
+    }
+    value = value * 10 + static_cast<uint64_t>(*p - '0');
+    if (value > static_cast<uint64_t>(INT64_MAX)) {
+      return false;
+    }
+  }
+  *out = negative ? -static_cast<int64_t>(value) : static_cast<int64_t>(value);
+  return true;
+}
+
+// 追加 "<prefix><value>\r\n"
+void appendPrefixed(Buffer *buf, char prefix, int64_t value) {
+  char tmp[24];
+  char *p = tmp + sizeof(tmp);
+  *--p = '\n';
+  *--p = '\r';
+  uint64_t v = value < 0 ? -static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+  do {
+    *--p = static_cast<char>('0' + v % 10);
+    v /= 10;
+  } while (v != 0);
+  if (value < 0) {
+    *--p = '-';
+  }
+  *--p = prefix;
+  buf->append(p, tmp + sizeof(tmp) - p);
+}
+
+void appendLine(Buffer *buf, char prefix, const char *s, size_t len) {
+  buf->ensureWritableBytes(len + 3);
+  char *p = buf->beginWrite();
+  p[0] = prefix;
+  ::memcpy(p + 1, s, len);
+  p[len + 1] = '\r';
+  p[len + 2] = '\n';
+  buf->hasWritten(len + 3);
+}
+
+const char *const kIncomplete = nullptr;
+
+// 解析一个值，返回值之后的位置；数据不完整时返回 nullptr，格式错误时设置 *error
+const char *readValue(const char *p, const char *end, RespValue *value, int depth, bool *error) {
+  if (p >= end) {
+    return kIncomplete;
+  }
+  if (depth > RespReader::kMaxDepth) {
+    *error = true;
+    return kIncomplete;
+  }
+  const char *line = p + 1;
+  const char *lf = static_cast<const char *>(::memchr(line, '\n', end - line));
+  if (lf == nullptr) {
+    return kIncomplete;
+  }
+  if (lf == line || lf[-1] != '\r') {
+    *error = true; // 行尾只有 '\n'
+    return kIncomplete;
+  }
+  const char *cr = lf - 1;
+  const char *next = cr + 2;
+  value->elements.clear();
+  int64_t n = 0;
+  switch (*p) {
+    case '+':
+      value->type = RespValue::kSimpleString;
+      value->str = RespSlice(line, cr - line);
+      return next;
+    case '-':
+      value->type = RespValue::kError;
+      value->str = RespSlice(line, cr - line);
+      return next;
+    case '(':
+      value->type = RespValue::kBigNumber;
+      value->str = RespSlice(line, cr - line);
+      return next;
+    case ':':
+      value->type = RespValue::kInteger;
+      if (!parseInt(line, cr, &value->integer)) {
+        *error = true;
+        return kIncomplete;
+      }
+      return next;
+    case '_':
+      value->type = RespValue::kNull;
+      return next;
+    case '#':
+      value->type = RespValue::kBoolean;
+      if (cr - line != 1 || (*line != 't' && *line != 'f')) {
+        *error = true;
+        return kIncomplete;
+      }
+      value->integer = *line == 't' ? 1 : 0;
+      return next;
+    case ',': {
+      char tmp[64];
+      size_t len = static_cast<size_t>(cr - line);
+      if (len == 0 || len >= sizeof(tmp)) {
+        *error = true;
+        return kIncomplete;
+      }
+      ::memcpy(tmp, line, len);
+      tmp[len] = '\0';
+      char *parsedEnd = nullptr;
+      value->type = RespValue::kDouble;
+      value->number = ::strtod(tmp, &parsedEnd);
+      value->str = RespSlice(line, len);
+      if (parsedEnd != tmp + len) {
+        *error = true;
+        return kIncomplete;
+      }
+      return next;
+    }
+    case '$':
+    case '!':
+    case '=': {
+      if (!parseInt(line, cr, &n) || n < -1) {
+        *error = true;
+        return kIncomplete;
+      }
+      if (n == -1) {
+        value->type = RespValue::kNull;
+        return next;
+      }
+      // 先和可读长度比较再加 2，n 可以大到 INT64_MAX，直接 n + 2 会有符号溢出
+      if (n > end - next || end - next - n < 2) {
+        return kIncomplete;
+      }
+      if (next[n] != '\r' || next[n + 1] != '\n') {
+        *error = true;
+        return kIncomplete;
+      }
+      value->type = *p == '$' ? RespValue::kBulkString
+                              : (*p == '!' ? RespValue::kBulkError : RespValue::kVerbatimString);
+      value->str = RespSlice(next, static_cast<size_t>(n));
+      // verbatim string 的内容以 "txt:" 这样的 3 字节格式和冒号开头
+      if (value->type == RespValue::kVerbatimString) {
+        if (n < 4) {
+          *error = true;
+          return kIncomplete;
+        }
+        value->str = RespSlice(next + 4, static_cast<size_t>(n - 4));
+      }
+      return next + n + 2;
+    }
+    case '*':
+    case '~':
+    case '>':
+    case '%':
+    case '|': {
+      if (!parseInt(line, cr, &n) || n < -1) {
+        *error = true;
+        return kIncomplete;
+      }
+      if (n == -1) {
+        value->type = RespValue::kNull;
+        return next;
+      }
+      size_t count = static_cast<size_t>(n) * (*p == '%' || *p == '|' ? 2 : 1);
+      // 每个元素至少 3 字节，据此拒绝声明了巨大长度的数组，避免预先分配过多内存
+      if (count > static_cast<size_t>(end - next) / 3 + 1) {
+        return kIncomplete;
+      }
+      if (*p == '|') {
+        // 属性：解析后丢弃，返回其后的值
+        RespValue attribute;
+        attribute.elements.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+          next = readValue(next, end, &attribute.elements[i], depth + 1, error);
+          if (next == kIncomplete) {
+            return kIncomplete;
+          }
+        }
+        return readValue(next, end, value, depth, error);
+      }
+      value->type = *p == '*' ? RespValue::kArray
+                              : (*p == '~' ? RespValue::kSet : (*p == '>' ? RespValue::kPush : RespValue::kMap));
+      value->elements.resize(count);
+      for (size_t i = 0; i < count; ++i) {
+        next = readValue(next, end, &value->elements[i], depth + 1, error);
+        if (next == kIncomplete) {
+          return kIncomplete;
+        }
+      }
+      return next;
+    }
+    default:
+      *error = true;
+      return kIncomplete;
+  }
+}
+
+} // namespace
+
+RespCommandParser::RespCommandParser(size_t maxBulkBytes)
+    : maxBulkBytes_(maxBulkBytes) {
+  reset();
+}
+
+void RespCommandParser::reset() {
+  state_ = kStart;
+  pos_ = 0;
+  scan_ = 0;
+  expected_ = 0;
+  bulkLength_ = 0;
+  error_ = "";
+}
+
+bool RespCommandParser::findLine(const char *data, size_t readable, size_t *lineEnd) {
+  size_t from = scan_ > pos_ ? scan_ : pos_;
+  const char *lf = static_cast<const char *>(::memchr(data + from, '\n', readable - from));
+  if (lf == nullptr) {
+    scan_ = readable;
+    return false;
+  }
+  size_t end = static_cast<size_t>(lf - data);
+  scan_ = end + 1;
+  *lineEnd = end > pos_ && data[end - 1] == '\r' ? end - 1 : end;
+  return true;
+}
+
+RespCommandParser::Result RespCommandParser::parseInline(const char *data, size_t lineEnd, RespCommand *command) {
+  command->args_.clear();
+  size_t i = pos_;
+  while (i < lineEnd) {
+    while (i < lineEnd && (data[i] == ' ' || data[i] == '\t')) {
+      ++i;
+    }
+    size_t begin = i;
+    while (i < lineEnd && data[i] != ' ' && data[i] != '\t') {
+      ++i;
+    }
+    if (i > begin) {
+      RespCommand::Range range = {begin, i - begin};
+      command->args_.push_back(range);
+    }
+  }
+  pos_ = scan_;
+  command->base_ = data;
+  return kComplete;
+}
+
+RespCommandParser::Result RespCommandParser::parse(const Buffer *buf, RespCommand *command) {
+  const char *data = buf->peek();
+  size_t readable = buf->readableBytes();
+  size_t lineEnd = 0;
+  for (;;) {
+    switch (state_) {
+      case kStart:
+        if (pos_ >= readable) {
+          return kNeedMore;
+        }
+        if (!findLine(data, readable, &lineEnd)) {
+          return readable - pos_ > kMaxLineBytes ? fail("Protocol error: too big request line") : kNeedMore;
+        }
+        if (data[pos_] != '*') {
+          // 内联命令，比如 telnet 中输入的 "PING"，参数按空白分隔，不支持引号
+          return parseInline(data, lineEnd, command);
+        }
+        if (!parseInt(data + pos_ + 1, data + lineEnd, &expected_) || expected_ > kMaxArgs) {
+          return fail("Protocol error: invalid multibulk length");
+        }
+        pos_ = scan_;
+        command->args_.clear();
+        if (expected_ <= 0) {
+          // 空数组，返回一条没有参数的命令，由调用者忽略
+          command->base_ = data;
+          return kComplete;
+        }
+        state_ = kArgHeader;
+        break;
+      case kArgHeader: {
+        if (pos_ >= readable) {
+          return kNeedMore;
+        }
+        if (data[pos_] != '$') {
+          return fail("Protocol error: expected '$'");
+        }
+        if (!findLine(data, readable, &lineEnd)) {
+          return readable - pos_ > kMaxLineBytes ? fail("Protocol error: too big bulk length") : kNeedMore;
+        }
+        int64_t length = 0;
+        if (!parseInt(data + pos_ + 1, data + lineEnd, &length) || length < 0 ||
+            static_cast<uint64_t>(length) > maxBulkBytes_) {
+          return fail("Protocol error: invalid bulk length");
+        }
+        bulkLength_ = static_cast<size_t>(length);
+        pos_ = scan_;
+        state_ = kArgData;
+        break;
+      }
+      case kArgData: {
+        if (readable - pos_ < bulkLength_ + 2) {
+          return kNeedMore;
+        }
+        if (data[pos_ + bulkLength_] != '\r' || data[pos_ + bulkLength_ + 1] != '\n') {
+          return fail("Protocol error: bulk string not terminated by CRLF");
+        }
+        RespCommand::Range range = {pos_, bulkLength_};
+        command->args_.push_back(range);
+        pos_ += bulkLength_ + 2;
+        scan_ = pos_;
+        if (static_cast<int64_t>(command->args_.size()) == expected_) {
+          command->base_ = data;
+          return kComplete;
+        }
+        state_ = kArgHeader;
+        break;
+      }
+    }
+  }
+}
+
+ssize_t RespReader::read(const char *data, size_t len, RespValue *value) {
+  bool error = false;
+  const char *end = readValue(data, data + len, value, 0, &error);
+  if (error) {
+    return -1;
+  }
+  return end == nullptr ? 0 : end - data;
+}
+
+void RespWriter::appendSimpleString(Buffer *buf, const char *s, size_t len) { appendLine(buf, '+', s, len); }
+
+void RespWriter::appendSimpleString(Buffer *buf, const char *s) { appendLine(buf, '+', s, ::strlen(s)); }
+
+void RespWriter::appendError(Buffer *buf, const char *message) { appendLine(buf, '-', message, ::strlen(message)); }
+
+void RespWriter::appendInteger(Buffer *buf, int64_t value) { appendPrefixed(buf, ':', value); }
+
+void RespWriter::appendBulkString(Buffer *buf, const char *s, size_t len) {
+  appendPrefixed(buf, '$', static_cast<int64_t>(len));
+  buf->ensureWritableBytes(len + 2);
+  char *p = buf->beginWrite();
+  ::memcpy(p, s, len);
+  p[len] = '\r';
+  p[len + 1] = '\n';
+  buf->hasWritten(len + 2);
+}
+
+void RespWriter::appendNull(Buffer *buf, int protocol) {
+  if (protocol >= 3) {
+    buf->append("_\r\n", 3);
+  } else {
+    buf->append("$-1\r\n", 5);
+  }
+}
+
+void RespWriter::appendArrayHeader(Buffer *buf, size_t count) {
+  appendPrefixed(buf, '*', static_cast<int64_t>(count));
+}
+
+void RespWriter::appendMapHeader(Buffer *buf, size_t count, int protocol) {
+  if (protocol >= 3) {
+    appendPrefixed(buf, '%', static_cast<int64_t>(count));
+  } else {
+    appendPrefixed(buf, '*', static_cast<int64_t>(count * 2));
+  }
+}
+
+void RespWriter::appendBoolean(Buffer *buf, bool value, int protocol) {
+  if (protocol >= 3) {
+    buf->append(value ? "#t\r\n" : "#f\r\n", 4);
+  } else {
+    appendInteger(buf, value ? 1 : 0);
+  }
+}
+
+void RespWriter::appendDouble(Buffer *buf, double value, int protocol) {
+  char tmp[64];
+  int n;
+  if (isinf(value)) {
+    n = ::snprintf(tmp, sizeof(tmp), "%s", value > 0 ? "inf" : "-inf");
+  } else {
+    n = ::snprintf(tmp, sizeof(tmp), "%.17g", value);
+  }
+  if (protocol >= 3) {
+    appendLine(buf, ',', tmp, static_cast<size_t>(n));
+  } else {
+    appendBulkString(buf, tmp, static_cast<size_t>(n));
+  }
+}
+
+void RespWriter::appendCommand(Buffer *buf, size_t argc, const char *const *argv, const size_t *argvLen) {
+  appendArrayHeader(buf, argc);
+  for (size_t i = 0; i < argc; ++i) {
+    appendBulkString(buf, argv[i], argvLen[i]);
+  }
+}
+
+void RespWriter::appendCommand(Buffer *buf, const std::vector<std::string> &args) {
+  appendArrayHeader(buf, args.size());
+  for (const std::string &arg : args) {
+    appendBulkString(buf, arg);
+  }
+}
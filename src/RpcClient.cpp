@@ -0,0 +1,240 @@
+#include "RpcClient.h"
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "RpcCodec.h"
+#include "TcpConnection.h"
+#include "Timer.h"
+
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+constexpr double RpcClient::kDefaultTimeout;
+constexpr double RpcClient::kTimeoutResolution;
+
+/*
+ * 一个 loop 上的调用表
+ * 请求 ID 的低 32 位是槽位下标，高 32 位是槽位的代数，槽位每次释放时代数加一，
+ * 超时或者重复的回复因为代数不匹配直接丢弃
+ * deadlines_ 是按期限排序的最小堆，调用结束时不从堆中删除，到期时发现代数不匹配就跳过；
+ * 堆中过期的项过多时整体清理一次，堆的大小与在途调用数同阶
+ * 期限使用与 TimerQueue 相同的单调时钟，系统时间被 NTP 调整时不会让在途调用集体超时或者迟迟不超时
+ */
+class RpcClient::CallTable {
+public:
+  explicit CallTable(EventLoop *loop) : loop_(loop), inflight_(0), timerStarted_(false) {}
+
+  void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+  size_t inflight() const { return inflight_; }
+
+  void onConnection(const TcpConnectionPtr &conn) {
+    if (conn->connected()) {
+      conn->setAutoCork(true);
+      conn_ = conn;
+      if (!timerStarted_) {
+        std::weak_ptr<CallTable> weakTable(self_);
+        sweepTimer_ = loop_->runEvery(kTimeoutResolution, [weakTable]() {
+          std::shared_ptr<CallTable> table = weakTable.lock();
+          if (table) {
+            table->sweep();
+          }
+        });
+        timerStarted_ = true;
+      }
+    } else {
+      close();
+    }
+    if (connectionCallback_) {
+      connectionCallback_(conn);
+    }
+  }
+
+  void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+    RpcFrame frame;
+    for (;;) {
+      RpcCodec::Result result =
+          RpcCodec::parse(buf->peek(), buf->readableBytes(), RpcCodec::kDefaultMaxFrameSize, &frame);
+      if (result == RpcCodec::kNeedMore) {
+        break;
+      }
+      if (result == RpcCodec::kBadFrame || frame.type == RpcFrame::kRequest) {
+        LOG_ERROR("[%s:%s:%d]\nRpcClient bad frame from %s, closing\n", __FILE__, __FUNCTION__, __LINE__,
+                  conn->peerAddress().toIpPort().c_str());
+        buf->retrieveAll();
+        conn->forceClose();
+        break;
+      }
+      complete(frame.id, frame.type == RpcFrame::kResponse ? RpcResult::kOk : RpcResult::kError, frame.payload,
+               frame.payloadLen);
+      buf->retrieve(frame.frameSize);
+    }
+  }
+
+  void start(const char *method, size_t methodLen, const char *payload, size_t len, Callback &cb,
+             double timeout) {
+    if (!conn_ || !conn_->connected()) {
+      RpcResult result = {RpcResult::kDisconnected, 0, "", 0};
+      cb(result);
+      return;
+    }
+    uint32_t index;
+    if (!freeSlots_.empty()) {
+      index = freeSlots_.back();
+      freeSlots_.pop_back();
+    } else {
+      index = static_cast<uint32_t>(slots_.size());
+      slots_.push_back(Slot());
+    }
+    Slot &slot = slots_[index];
+    slot.busy = true;
+    slot.callback = std::move(cb);
+    uint64_t id = makeId(index, slot.generation);
+    ++inflight_;
+
+    int64_t deadline = Timer::now() + static_cast<int64_t>(timeout * Timestamp::kMicroSecondsPerSecond);
+    if (deadlines_.size() > 2 * inflight_ + 64) {
+      compactDeadlines();
+    }
+    deadlines_.push_back(Deadline{deadline, id});
+    std::push_heap(deadlines_.begin(), deadlines_.end(), laterDeadline);
+
+    RpcCodec::appendRequest(conn_->outputBuffer(), id, method, methodLen, payload, len);
+    conn_->flush();
+  }
+
+  // 断开或者 RpcClient 析构：停止超时检查，所有在途调用以 kDisconnected 结束
+  void close() {
+    conn_.reset();
+    if (timerStarted_) {
+      loop_->cancel(sweepTimer_);
+      timerStarted_ = false;
+    }
+    for (size_t i = 0; i < slots_.size() && inflight_ > 0; ++i) {
+      if (slots_[i].busy) {
+        complete(makeId(static_cast<uint32_t>(i), slots_[i].generation), RpcResult::kDisconnected, "", 0);
+      }
+    }
+    deadlines_.clear();
+  }
+
+  std::weak_ptr<CallTable> self_;
+
+private:
+  struct Slot {
+    Slot() : generation(1), busy(false) {}
+    Callback callback;
+    uint32_t generation;
+    bool busy;
+  };
+  struct Deadline {
+    int64_t microSeconds; // 单调时钟微秒数
+    uint64_t id;
+  };
+
+  static uint64_t makeId(uint32_t index, uint32_t generation) {
+    return (static_cast<uint64_t>(generation) << 32) | index;
+  }
+  static bool laterDeadline(const Deadline &a, const Deadline &b) { return a.microSeconds > b.microSeconds; }
+
+  // id 对应的调用仍在途时返回槽位
+  Slot *find(uint64_t id) {
+    uint32_t index = static_cast<uint32_t>(id);
+    if (index >= slots_.size()) {
+      return nullptr;
+    }
+    Slot &slot = slots_[index];
+    return slot.busy && slot.generation == static_cast<uint32_t>(id >> 32) ? &slot : nullptr;
+  }
+
+  void complete(uint64_t id, RpcResult::Status status, const char *data, size_t size) {
+    Slot *slot = find(id);
+    if (slot == nullptr) {
+      return;
+    }
+    // 先释放槽位再回调，回调中可以发起新的调用
+    Callback cb(std::move(slot->callback));
+    slot->callback = nullptr;
+    slot->busy = false;
+    ++slot->generation;
+    freeSlots_.push_back(static_cast<uint32_t>(id));
+    --inflight_;
+    RpcResult result = {status, id, data, size};
+    cb(result);
+  }
+
+  void sweep() {
+    int64_t now = Timer::now();
+    while (!deadlines_.empty() && deadlines_.front().microSeconds <= now) {
+      uint64_t id = deadlines_.front().id;
+      std::pop_heap(deadlines_.begin(), deadlines_.end(), laterDeadline);
+      deadlines_.pop_back();
+      complete(id, RpcResult::kTimeout, "", 0);
+    }
+  }
+
+  void compactDeadlines() {
+    deadlines_.erase(std::remove_if(deadlines_.begin(), deadlines_.end(),
+                                    [this](const Deadline &d) { return find(d.id) == nullptr; }),
+                     deadlines_.end());
+    std::make_heap(deadlines_.begin(), deadlines_.end(), laterDeadline);
+  }
+
+  EventLoop *loop_;
+  TcpConnectionPtr conn_;
+  ConnectionCallback connectionCallback_;
+  std::vector<Slot> slots_;
+  std::vector<uint32_t> freeSlots_;
+  std::vector<Deadline> deadlines_;
+  size_t inflight_;
+  TimerId sweepTimer_;
+  bool timerStarted_;
+};
+
+RpcClient::RpcClient(EventLoop *loop, const InetAddress &serverAddr, const std::string &name)
+    : table_(std::make_shared<CallTable>(loop))
+    , client_(loop, serverAddr, name) {
+  table_->self_ = table_;
+  client_.setConnectionCallback(std::bind(&CallTable::onConnection, table_, std::placeholders::_1));
+  client_.setMessageCallback(std::bind(&CallTable::onMessage, table_, std::placeholders::_1,
+                                       std::placeholders::_2, std::placeholders::_3));
+}
+
+RpcClient::~RpcClient() {
+  std::shared_ptr<CallTable> table = table_;
+  client_.getLoop()->runInLoop([table]() { table->close(); });
+}
+
+void RpcClient::setConnectionCallback(const ConnectionCallback &cb) { table_->setConnectionCallback(cb); }
+
+void RpcClient::call(const char *method, const char *payload, size_t len, Callback cb, double timeout) {
+  size_t methodLen = ::strlen(method);
+  if (methodLen > RpcCodec::kMaxMethodLen) {
+    LOG_ERROR("[%s:%s:%d]\nRpcClient method name too long: %s\n", __FILE__, __FUNCTION__, __LINE__, method);
+    return;
+  }
+  EventLoop *loop = client_.getLoop();
+  if (loop->isInLoopThread()) {
+    table_->start(method, methodLen, payload, len, cb, timeout);
+  } else {
+    std::shared_ptr<CallTable> table = table_;
+    std::string m(method, methodLen);
+    std::string p(payload, len);
+    loop->queueInLoop([table, m, p, cb, timeout]() mutable {
+      table->start(m.data(), m.size(), p.data(), p.size(), cb, timeout);
+    });
+  }
+}
+
+std::future<RpcReply> RpcClient::call(const char *method, const std::string &payload, double timeout) {
+  std::shared_ptr<std::promise<RpcReply>> promise = std::make_shared<std::promise<RpcReply>>();
+  call(method, payload.data(), payload.size(), [promise](const RpcResult &result) {
+    RpcReply reply;
+    reply.status = result.status;
+    reply.data.assign(result.data, result.size);
+    promise->set_value(std::move(reply));
+  }, timeout);
+  return promise->get_future();
+}
+
+size_t RpcClient::inflight() const { return table_->inflight(); }
@@ -0,0 +1,87 @@
+#include "RpcCodec.h"
+#include "Buffer.h"
+
+#include <string.h>
+
+namespace {
+
+void putUint32(char *p, uint32_t v) {
+  p[0] = static_cast<char>(v >> 24);
+  p[1] = static_cast<char>(v >> 16);
+  p[2] = static_cast<char>(v >> 8);
+  p[3] = static_cast<char>(v);
+}
+
+uint32_t getUint32(const char *p) {
+  const unsigned char *u = reinterpret_cast<const unsigned char *>(p);
+  return (static_cast<uint32_t>(u[0]) << 24) | (static_cast<uint32_t>(u[1]) << 16) |
+         (static_cast<uint32_t>(u[2]) << 8) | static_cast<uint32_t>(u[3]);
+}
+
+// 写入 length、id 和 type，返回之后的写入位置
+char *putHeader(Buffer *buf, size_t total, uint64_t id, RpcFrame::Type type) {
+  buf->ensureWritableBytes(total);
+  char *p = buf->beginWrite();
+  putUint32(p, static_cast<uint32_t>(total - RpcCodec::kLengthSize));
+  putUint32(p + 4, static_cast<uint32_t>(id >> 32));
+  putUint32(p + 8, static_cast<uint32_t>(id));
+  p[12] = static_cast<char>(type);
+  return p + RpcCodec::kHeaderSize;
+}
+
+} // namespace
+
+RpcCodec::Result RpcCodec::parse(const char *data, size_t len, size_t maxFrameSize, RpcFrame *frame) {
+  if (len < kLengthSize) {
+    return kNeedMore;
+  }
+  size_t length = getUint32(data);
+  if (length < kHeaderSize - kLengthSize || length > maxFrameSize) {
+    return kBadFrame;
+  }
+  if (len < kLengthSize + length) {
+    return kNeedMore;
+  }
+  const char *end = data + kLengthSize + length;
+  frame->id = (static_cast<uint64_t>(getUint32(data + 4)) << 32) | getUint32(data + 8);
+  unsigned char type = static_cast<unsigned char>(data[12]);
+  const char *p = data + kHeaderSize;
+  frame->method = nullptr;
+  frame->methodLen = 0;
+  if (type == RpcFrame::kRequest) {
+    if (p == end) {
+      return kBadFrame;
+    }
+    frame->methodLen = static_cast<unsigned char>(*p++);
+    if (static_cast<size_t>(end - p) < frame->methodLen) {
+      return kBadFrame;
+    }
+    frame->method = p;
+    p += frame->methodLen;
+  } else if (type != RpcFrame::kResponse && type != RpcFrame::kError) {
+    return kBadFrame;
+  }
+  frame->type = static_cast<RpcFrame::Type>(type);
+  frame->payload = p;
+  frame->payloadLen = end - p;
+  frame->frameSize = kLengthSize + length;
+  return kFrame;
+}
+
+void RpcCodec::appendRequest(Buffer *buf, uint64_t id, const char *method, size_t methodLen,
+                             const char *payload, size_t payloadLen) {
+  size_t total = kHeaderSize + 1 + methodLen + payloadLen;
+  char *p = putHeader(buf, total, id, RpcFrame::kRequest);
+  *p++ = static_cast<char>(methodLen);
+  ::memcpy(p, method, methodLen);
+  ::memcpy(p + methodLen, payload, payloadLen);
+  buf->hasWritten(total);
+}
+
+void RpcCodec::appendResponse(Buffer *buf, RpcFrame::Type type, uint64_t id, const char *payload,
+                              size_t payloadLen) {
+  size_t total = kHeaderSize + payloadLen;
+  char *p = putHeader(buf, total, id, type);
+  ::memcpy(p, payload, payloadLen);
+  buf->hasWritten(total);
+}
@@ -0,0 +1,114 @@
+#include "RpcServer.h"
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "TcpConnection.h"
+
+#include <algorithm>
+#include <string.h>
+
+namespace {
+
+int compareName(const std::string &a, const char *b, size_t len) {
+  int r = ::memcmp(a.data(), b, std::min(a.size(), len));
+  if (r != 0) {
+    return r;
+  }
+  return a.size() < len ? -1 : (a.size() > len ? 1 : 0);
+}
+
+} // namespace
+
+void RpcResponder::send(RpcFrame::Type type, const char *data, size_t len) const {
+  TcpConnectionPtr conn = conn_.lock();
+  if (!conn) {
+    return;
+  }
+  if (conn->getLoop()->isInLoopThread()) {
+    if (conn->connected()) {
+      RpcCodec::appendResponse(conn->outputBuffer(), type, id_, data, len);
+      conn->flush();
+    }
+  } else {
+    Buffer buf;
+    RpcCodec::appendResponse(&buf, type, id_, data, len);
+    conn->send(&buf);
+  }
+}
+
+RpcServer::RpcServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &name,
+                     TcpServer::Option option)
+    : server_(loop, listenAddr, name, option)
+    , maxFrameSize_(RpcCodec::kDefaultMaxFrameSize) {
+  server_.setAutoCork(true);
+  // TcpConnection 总会调用 connectionCallback_，RpcServer 不需要处理连接事件
+  server_.setConnectionCallback([](const TcpConnectionPtr &) {});
+  server_.setMessageCallback(std::bind(&RpcServer::onMessage, this, std::placeholders::_1,
+                                       std::placeholders::_2, std::placeholders::_3));
+}
+
+void RpcServer::registerMethod(const std::string &name, const Method &method) {
+  if (name.size() > RpcCodec::kMaxMethodLen) {
+    LOG_ERROR("[%s:%s:%d]\nRpcServer method name too long: %s\n", __FILE__, __FUNCTION__, __LINE__,
+              name.c_str());
+    return;
+  }
+  auto it = std::lower_bound(methods_.begin(), methods_.end(), name,
+                             [](const std::pair<std::string, Method> &m, const std::string &n) {
+                               return m.first < n;
+                             });
+  if (it != methods_.end() && it->first == name) {
+    it->second = method;
+  } else {
+    methods_.insert(it, std::make_pair(name, method));
+  }
+}
+
+void RpcServer::start() { server_.start(); }
+
+void RpcServer::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+  RpcFrame frame;
+  while (conn->connected()) {
+    RpcCodec::Result result = RpcCodec::parse(buf->peek(), buf->readableBytes(), maxFrameSize_, &frame);
+    if (result == RpcCodec::kNeedMore) {
+      break;
+    }
+    if (result == RpcCodec::kBadFrame || frame.type != RpcFrame::kRequest) {
+      LOG_ERROR("[%s:%s:%d]\nRpcServer bad frame from %s, closing\n", __FILE__, __FUNCTION__, __LINE__,
+                conn->peerAddress().toIpPort().c_str());
+      buf->retrieveAll();
+      conn->forceClose();
+      break;
+    }
+    dispatch(conn, frame);
+    buf->retrieve(frame.frameSize);
+  }
+}
+
+void RpcServer::dispatch(const TcpConnectionPtr &conn, const RpcFrame &frame) {
+  RpcResponder responder(conn, frame.id);
+  const Method *method = findMethod(frame.method, frame.methodLen);
+  if (method == nullptr) {
+    responder.fail("unknown method " + std::string(frame.method, frame.methodLen));
+    return;
+  }
+  (*method)(frame.payload, frame.payloadLen, responder);
+}
+
+const RpcServer::Method *RpcServer::findMethod(const char *name, size_t len) const {
+  size_t lo = 0;
+  size_t hi = methods_.size();
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    int r = compareName(methods_[mid].first, name, len);
+    if (r == 0) {
+      return &methods_[mid].second;
+    }
+    if (r < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return nullptr;
+}
@@ -1,7 +1,9 @@
 #include "Socket.h"
 #include "InetAddress.h"
 #include "Logger.h"
+#include "SocketOptions.h"
 
+#include <errno.h>
 #include <netinet/tcp.h>
 #include <strings.h>
 #include <sys/socket.h>
@@ -11,15 +13,14 @@
 Socket::~Socket() { close(sockfd_); }
 
 void Socket::bindAddress(const InetAddress &localaddr) {
-  if (0 != ::bind(sockfd_, (sockaddr *)localaddr.getSockAddr(),
-                  sizeof(sockaddr_in))) {
-    LOG_FATAL("[%s:%s:%d]\nbind sockfd: %d fail!\n", __FILE__, __FUNCTION__,
-              __LINE__, sockfd_);
+  if (0 != ::bind(sockfd_, localaddr.getSockAddr(), localaddr.length())) {
+    LOG_FATAL("[%s:%s:%d]\nbind sockfd: %d to %s fail: %d!\n", __FILE__, __FUNCTION__,
+              __LINE__, sockfd_, localaddr.toIpPort().c_str(), errno);
   }
 }
 
-void Socket::listen() {
-  if (0 != ::listen(sockfd_, 1024)) {
+void Socket::listen(int backlog) {
+  if (0 != ::listen(sockfd_, backlog)) {
     LOG_FATAL("[%s:%s:%d]\nlisten sockfd: %d fail!\n", __FILE__, __FUNCTION__,
               __LINE__, sockfd_);
   }
@@ -27,13 +28,14 @@ void Socket::listen() {
 
 // 通过返回值返回通信时用的 fd，并通过输出参数返回客户端通信地址和端口号
 int Socket::accept(InetAddress *peeraddr) {
-  sockaddr_in addr;
+  // sockaddr_storage 能容纳任意地址族的地址
+  sockaddr_storage addr;
   socklen_t len = sizeof(addr);
   bzero(&addr, sizeof(addr));
   // 设置 connfd 为非阻塞，并且关闭父进程的文件描述符
   int connfd = ::accept4(sockfd_, (sockaddr *)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
   if (connfd >= 0) {
-    peeraddr->setSockAddr(addr);
+    peeraddr->setSockAddr((sockaddr *)&addr, len);
   }
   return connfd;
 }
@@ -64,9 +66,64 @@ void Socket::setKeepAlive(bool on) {
   ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval));
 }
 
+void Socket::setSendBufferSize(int bytes) {
+  ::setsockopt(sockfd_, SOL_SOCKET, SO_SNDBUF, &bytes, sizeof(bytes));
+}
+
+void Socket::setRecvBufferSize(int bytes) {
+  ::setsockopt(sockfd_, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes));
+}
+
+void Socket::setNotSentLowat(int bytes) {
+  ::setsockopt(sockfd_, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &bytes, sizeof(bytes));
+}
+
+void Socket::setQuickAck(bool on) {
+  int optval = on ? 1 : 0;
+  ::setsockopt(sockfd_, IPPROTO_TCP, TCP_QUICKACK, &optval, sizeof(optval));
+}
+
+void Socket::setDeferAccept(int seconds) {
+  ::setsockopt(sockfd_, IPPROTO_TCP, TCP_DEFER_ACCEPT, &seconds, sizeof(seconds));
+}
+
+void Socket::setFastOpen(int queueLength) {
+  ::setsockopt(sockfd_, IPPROTO_TCP, TCP_FASTOPEN, &queueLength, sizeof(queueLength));
+}
+
+void Socket::applyListenOptions(const SocketOptions &options) {
+  if (options.sendBufferSize > 0) {
+    setSendBufferSize(options.sendBufferSize);
+  }
+  if (options.recvBufferSize > 0) {
+    setRecvBufferSize(options.recvBufferSize);
+  }
+  if (options.deferAcceptSeconds > 0) {
+    setDeferAccept(options.deferAcceptSeconds);
+  }
+  if (options.fastOpenQueue > 0) {
+    setFastOpen(options.fastOpenQueue);
+  }
+}
+
+void Socket::applyConnectionOptions(const SocketOptions &options) {
+  if (options.tcpNoDelay) {
+    setTcpNoDelay(true);
+  }
+  if (options.keepAlive) {
+    setKeepAlive(true);
+  }
+  if (options.notSentLowat > 0) {
+    setNotSentLowat(options.notSentLowat);
+  }
+  if (options.quickAck) {
+    setQuickAck(true);
+  }
+}
+
 int Socket::getSocketError(int sockfd) {
   int optval;
-  socklen_t optlen = static_cast<socklen_t>(optval);
+  socklen_t optlen = static_cast<socklen_t>(sizeof(optval));
   if (::getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0) {
     return errno;
   } else {
@@ -0,0 +1,116 @@
+#include "TcpClient.h"
+#include "Logger.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+
+static EventLoop *CheckLoopNotNull(EventLoop *loop) {
+  if (loop == nullptr) {
+    LOG_FATAL("[%s:%s:%d]\nTcpClient loop is null!\n", __FILE__, __FUNCTION__, __LINE__);
+  }
+  return loop;
+}
+
+// TcpClient 析构后连接才关闭时，由它完成 TcpServer::removeConnection 的工作
+static void removeDetachedConnection(EventLoop *loop, const TcpConnectionPtr &conn) {
+  loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+}
+
+static InetAddress getAddr(int sockfd, bool peer) {
+  sockaddr_storage addr;
+  ::memset(&addr, 0, sizeof(addr));
+  socklen_t len = sizeof(addr);
+  int ret = peer ? ::getpeername(sockfd, (sockaddr *)&addr, &len)
+                 : ::getsockname(sockfd, (sockaddr *)&addr, &len);
+  if (ret < 0) {
+    LOG_ERROR("[%s:%s:%d]\nTcpClient get %s address error: %d\n", __FILE__, __FUNCTION__,
+              __LINE__, peer ? "peer" : "local", errno);
+  }
+  return InetAddress((sockaddr *)&addr, len);
+}
+
+TcpClient::TcpClient(EventLoop *loop, const InetAddress &serverAddr, const std::string &nameArg)
+    : loop_(CheckLoopNotNull(loop))
+    , connector_(new Connector(loop, serverAddr))
+    , name_(nameArg)
+    , retry_(false)
+    , connect_(true)
+    , nextConnId_(1) {
+  connector_->setNewConnectionCallback(
+      std::bind(&TcpClient::newConnection, this, std::placeholders::_1));
+  LOG_INFO("[%s:%s:%d]\nTcpClient::TcpClient [%s] - connector %p\n", __FILE__, __FUNCTION__,
+           __LINE__, name_.c_str(), connector_.get());
+}
+
+TcpClient::~TcpClient() {
+  LOG_INFO("[%s:%s:%d]\nTcpClient::~TcpClient [%s] - connector %p\n", __FILE__, __FUNCTION__,
+           __LINE__, name_.c_str(), connector_.get());
+  TcpConnectionPtr conn;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    conn = connection_;
+  }
+  if (conn) {
+    // 连接可能比 TcpClient 活得久，关闭时不能再回调已析构的 TcpClient::removeConnection
+    CloseCallback cb = std::bind(&removeDetachedConnection, loop_, std::placeholders::_1);
+    loop_->runInLoop(std::bind(&TcpConnection::setCloseCallback, conn, cb));
+    conn->shutdown();
+  } else {
+    connector_->stop();
+  }
+}
+
+void TcpClient::connect() {
+  LOG_INFO("[%s:%s:%d]\nTcpClient::connect [%s] - connecting to %s\n", __FILE__, __FUNCTION__,
+           __LINE__, name_.c_str(), connector_->serverAddress().toIpPort().c_str());
+  connect_ = true;
+  connector_->start();
+}
+
+void TcpClient::disconnect() {
+  connect_ = false;
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (connection_) {
+    connection_->shutdown();
+  }
+}
+
+void TcpClient::stop() {
+  connect_ = false;
+  connector_->stop();
+}
+
+void TcpClient::newConnection(int sockfd) {
+  InetAddress peerAddr(getAddr(sockfd, true));
+  InetAddress localAddr(getAddr(sockfd, false));
+  char buf[64];
+  snprintf(buf, sizeof(buf), ":%s#%d", peerAddr.toIpPort().c_str(), nextConnId_);
+  ++nextConnId_;
+  std::string connName = name_ + buf;
+
+  TcpConnectionPtr conn(new TcpConnection(loop_, connName, sockfd, localAddr, peerAddr));
+  conn->applySocketOptions(socketOptions_);
+  conn->setConnectionCallback(connectionCallback_);
+  conn->setMessageCallback(messageCallback_);
+  conn->setWriteCompleteCallback(writeCompleteCallback_);
+  conn->setCloseCallback(std::bind(&TcpClient::removeConnection, this, std::placeholders::_1));
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    connection_ = conn;
+  }
+  conn->connectEstablished();
+}
+
+void TcpClient::removeConnection(const TcpConnectionPtr &conn) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    connection_.reset();
+  }
+  loop_->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+  if (retry_ && connect_) {
+    LOG_INFO("[%s:%s:%d]\nTcpClient::removeConnection [%s] - reconnecting to %s\n", __FILE__,
+             __FUNCTION__, __LINE__, name_.c_str(), connector_->serverAddress().toIpPort().c_str());
+    connector_->restart();
+  }
+}
@@ -1,13 +1,22 @@
 #include "TcpConnection.h"
 #include "Channel.h"
 #include "EventLoop.h"
+#include "BinaryLogger.h"
 #include "Logger.h"
 #include "Socket.h"
+#include "TcpRelay.h"
+#include "Timer.h"
+#include "TokenBucket.h"
 
+#include <algorithm>
 #include <errno.h>
 #include <functional>
 #include <memory>
 #include <string>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
 
 static EventLoop *CheckLoopNotNull(EventLoop *loop) {
   if (loop == nullptr) {
@@ -17,37 +26,121 @@ static EventLoop *CheckLoopNotNull(EventLoop *loop) {
   return loop;
 }
 
+// 被限速的连接挂在所在 loop 的队列上，one loop per thread，所以 thread_local 的队列就是 per-loop 的
+// 队列非空时只有一个一次性定时器在运行，每 kThrottleTick 秒检查一次令牌，和连接数、send 次数无关
+struct ThrottleQueue {
+  ThrottleQueue() : scheduled(false) {}
+  std::vector<std::weak_ptr<TcpConnection>> parked;
+  std::vector<std::weak_ptr<TcpConnection>> running;
+  bool scheduled;
+};
+
+static thread_local ThrottleQueue t_throttleQueue;
+static const double kThrottleTick = 0.005;
+
+// 两个令牌桶中较少的可用令牌数，都为空表示不限速
+static size_t minQuota(const std::shared_ptr<TokenBucket> &own,
+                       const std::shared_ptr<TokenBucket> &shared) {
+  size_t quota = SIZE_MAX;
+  if (own) {
+    quota = std::min(quota, own->available());
+  }
+  if (shared) {
+    quota = std::min(quota, shared->available());
+  }
+  return quota;
+}
+
+static void consumeTokens(const std::shared_ptr<TokenBucket> &own,
+                          const std::shared_ptr<TokenBucket> &shared, size_t n) {
+  if (own) {
+    own->consume(n);
+  }
+  if (shared) {
+    shared->consume(n);
+  }
+}
+
 TcpConnection::TcpConnection(EventLoop *loop, const std::string &nameArg,
                              int sockfd, const InetAddress &localAddr,
                              const InetAddress &peerAddr)
+    : TcpConnection(loop, 0, std::shared_ptr<const std::string>(), 0, sockfd, localAddr, peerAddr) {
+  name_ = nameArg;
+}
+
+TcpConnection::TcpConnection(EventLoop *loop, uint64_t id,
+                             const std::shared_ptr<const std::string> &namePrefix, int64_t seq,
+                             int sockfd, const InetAddress &localAddr, const InetAddress &peerAddr)
     : loop_(CheckLoopNotNull(loop))
-    , name_(nameArg)
+    , id_(id)
+    , namePrefix_(namePrefix)
+    , nameSeq_(seq)
     , state_(kConnecting)
     , reading_(true)
     , socket_(new Socket(sockfd))
     , channel_(new Channel(loop, sockfd))
     , localAddr_(localAddr)
     , peerAddr_(peerAddr)
-    , highWaterMark_(64 * 1024 * 1024) { // 64M
+    , highWaterMark_(64 * 1024 * 1024) // 64M
+    , traffic_(0)
+    , autoCork_(false)
+    , flushPending_(false)
+    , backpressureHigh_(0)
+    , backpressureLow_(0)
+    , sourcePaused_(false)
+    , sendThrottled_(false)
+    , readThrottled_(false)
+    , throttleParked_(false)
+    , sendThrottledSince_(0)
+    , readThrottledSince_(0)
+    , sendThrottledUs_(0)
+    , readThrottledUs_(0)
+    , outputWritten_(0)
+    , queuedPayloadBytes_(0) {
   // 给 channel 设置相应的回调函数，poller 给 channel 通知感兴趣的事件发生时，channel 会回调相应的操作函数
   // 新连接 handleRead 中调用的 messageCallback_ 就是用户在构造函数中通过 setMessageCallback 设置的 onMessage
   channel_->setReadCallback(std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
   channel_->setWriteCallback(std::bind(&TcpConnection::handleWrite, this));
   channel_->setCloseCallback(std::bind(&TcpConnection::handleClose, this));
   channel_->setErrorCallback(std::bind(&TcpConnection::handleError, this));
-  LOG_INFO("TcpConnection::ctor[%s] at fd = %d\n", name_.c_str(), sockfd);
-  socket_->setKeepAlive(true); // TCP 心跳包，保活机制
+  LOG_BIN_INFO("TcpConnection::ctor[%lu] at fd = %d\n", id_, sockfd);
+  // TCP 心跳包等 socket 选项由创建者通过 applySocketOptions 设置，见 SocketOptions
 }
 
 TcpConnection::~TcpConnection() {
-  LOG_INFO("TcpConnection::dtor[%s] at fd = %d state = %d\n", name_.c_str(),
-           channel_->fd(), (int)state_);
+  LOG_BIN_INFO("TcpConnection::dtor[%lu] at fd = %d state = %d\n", id_, channel_->fd(),
+               (int)state_);
+  clearPendingSegments();
+}
+
+const std::string &TcpConnection::name() const {
+  if (namePrefix_) {
+    std::call_once(nameOnce_, [this]() { name_ = *namePrefix_ + std::to_string(nameSeq_); });
+  }
+  return name_;
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime) {
+  // 同一轮 poll 中已经被 relay 的另一端关闭
+  if (state_ == kDisconnected) {
+    return;
+  }
+  if (relay_) {
+    std::shared_ptr<TcpRelay> relay(relay_);
+    relay->handleRead(this);
+    return;
+  }
   int savedErrno = 0;
   ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
   if (n > 0) {
+    addTraffic(n);
+    // 读方向限速：令牌用完后暂停读取，数据留在内核缓冲区中
+    if (readBucket_ || sharedReadBucket_) {
+      consumeTokens(readBucket_, sharedReadBucket_, n);
+      if (readQuota() == 0) {
+        throttleRead();
+      }
+    }
     // 已建立连接的用户有可读事件发生了，调用用户传入的回调操作 onMessage
     // shared_from_this() 表示传递的是智能指针
     messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
@@ -61,19 +154,24 @@ void TcpConnection::handleRead(Timestamp receiveTime) {
 }
 
 void TcpConnection::handleWrite() {
+  // outputBuffer_ 和发送队列都已清空，EPOLLOUT 是 relay 等待 pipe 中的数据写出
+  if (relay_ && channel_->isWriting() && outputDrained()) {
+    std::shared_ptr<TcpRelay> relay(relay_);
+    relay->handleWrite(this);
+    return;
+  }
   if (channel_->isWriting()) {
     int savedErrno = 0;
-    ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
+    ssize_t n = writeOutput(&savedErrno);
     if (n > 0) {
-      outputBuffer_.retrieve(n);
-      // 可读数据为 0 说明数据已经全部发送出去了
-      if (0 == outputBuffer_.readableBytes()) {
+      updateBackpressure();
+      // 缓冲区和排队的文件都已写完，说明数据已经全部发送出去了
+      if (outputDrained()) {
         channel_->disableWriting();
         if (writeCompleteCallback_) {
           // 唤醒该 loop
-          // 对应的线程，执行回调（其实直接调用loop_->writeCompleteCallback_(shared_from_this()就可以)）
-          loop_->queueInLoop(
-              std::bind(writeCompleteCallback_, shared_from_this()));
+          // 对应的线程，执行回调（其实直接调用getLoop()->writeCompleteCallback_(shared_from_this()就可以)）
+          queueWriteComplete();
         }
         // 用户调用了
         // TcpConnection::shutdown，但此时发送缓冲区还在发送数据，还没真正
@@ -81,12 +179,23 @@ void TcpConnection::handleWrite() {
         if (state_ == kDisconnecting) {
           shutdownInLoop();
         }
+        // relay 开始前留在 outputBuffer_ 中的数据发完了，继续写 pipe 中的数据
+        if (relay_) {
+          std::shared_ptr<TcpRelay> relay(relay_);
+          relay->handleWrite(this);
+        }
       }
-    } else if (n <= 0) {
+    } else if (n < 0) {
       LOG_ERROR("[%s:%s:%d]\nTcpConnection::handleWrite\n", __FILE__,
                 __FUNCTION__, __LINE__);
     }
-  } else {
+    // 限速时令牌用完，暂停写，等待 loop 的 tick 补充令牌后恢复
+    if (!outputDrained() && !sendThrottled_ && sendQuota() == 0) {
+      throttleWrite();
+    }
+  } else if (state_ != kDisconnected && !relay_) {
+    // 同一轮 poll 中残留的 EPOLLOUT：连接已经关闭(比如 TcpRelay::close 关闭了两端)，
+    // 或者 relay 刚停止关注写事件，都是正常情况，不记录
     LOG_ERROR("[%s:%s:%d]\nTcpConnection fd = %d is down, no more writing\n",
               __FILE__, __FUNCTION__, __LINE__, channel_->fd());
   }
@@ -95,10 +204,27 @@ void TcpConnection::handleWrite() {
 // Poller 通知 channel 调用 Channel::closeCallback 方法 =>
 // TcpConnection::handleClose =>
 void TcpConnection::handleClose() {
-  LOG_INFO("[%s:%s:%d]\nfd = %d state = %d\n", __FILE__, __FUNCTION__, __LINE__,
-           channel_->fd(), (int)state_);
+  if (state_ == kDisconnected) {
+    return;
+  }
+  // relay 的一端关闭时两端一起关闭，TcpRelay::close 会先解除关联再回到这里
+  if (relay_) {
+    std::shared_ptr<TcpRelay> relay(relay_);
+    relay->close();
+    return;
+  }
+  LOG_BIN_INFO("fd = %d state = %d\n", channel_->fd(), (int)state_);
   setState(kDisconnected);
   channel_->disableAll();
+  clearPendingSegments();
+  // 自己已经关闭，不能让被限流的上游一直停读
+  if (sourcePaused_) {
+    TcpConnectionPtr source = backpressureSource_.lock();
+    if (source) {
+      source->startRead();
+    }
+    sourcePaused_ = false;
+  }
   // 获取当前对象的智能指针
   TcpConnectionPtr connPtr(shared_from_this());
   // 执行用户注册的连接关闭的回调函数
@@ -118,26 +244,109 @@ void TcpConnection::handleClose() {
 void TcpConnection::handleError() {
   int err = Socket::getSocketError(channel_->fd());
   LOG_ERROR("[%s:%s:%d]\nTcpConnection::handleError name: %s - SO_ERROR: %d\n",
-            __FILE__, __FUNCTION__, __LINE__, name_.c_str(), err);
+            __FILE__, __FUNCTION__, __LINE__, name().c_str(), err);
 }
 
+// 跨线程发送时，排队的回调必须自己持有数据：调用者的数据在回调执行前可能已经释放了
 void TcpConnection::send(const std::string &buf) {
   if (state_ == kConnected) {
-    if (loop_->isInLoopThread()) {
+    if (getLoop()->isInLoopThread()) {
+      sendInLoop(buf.c_str(), buf.size());
+    } else {
+      getLoop()->runInLoop(std::bind(&TcpConnection::sendString, shared_from_this(), buf));
+    }
+  }
+}
+
+void TcpConnection::send(std::string &&buf) {
+  if (state_ == kConnected) {
+    if (getLoop()->isInLoopThread()) {
       sendInLoop(buf.c_str(), buf.size());
     } else {
-      loop_->runInLoop(
-          std::bind(&TcpConnection::sendInLoop, this, buf.c_str(), buf.size()));
+      getLoop()->runInLoop(
+          std::bind(&TcpConnection::sendString, shared_from_this(), std::move(buf)));
+    }
+  }
+}
+
+void TcpConnection::send(const void *data, size_t len) {
+  if (state_ == kConnected) {
+    if (getLoop()->isInLoopThread()) {
+      sendInLoop(data, len);
+    } else {
+      getLoop()->runInLoop(std::bind(&TcpConnection::sendString, shared_from_this(),
+                                     std::string(static_cast<const char *>(data), len)));
+    }
+  }
+}
+
+void TcpConnection::send(Buffer *buf) {
+  if (state_ == kConnected) {
+    if (getLoop()->isInLoopThread()) {
+      sendInLoop(buf->peek(), buf->readableBytes());
+      buf->retrieveAll();
+    } else {
+      std::shared_ptr<Buffer> owned(new Buffer(0));
+      owned->swap(*buf);
+      getLoop()->runInLoop(std::bind(&TcpConnection::sendBuffer, shared_from_this(), owned));
     }
   }
 }
 
+void TcpConnection::send(const std::shared_ptr<const std::string> &buf) {
+  send(PayloadSlice(buf));
+}
+
+void TcpConnection::send(const PayloadSlice &payload) {
+  if (state_ == kConnected) {
+    if (getLoop()->isInLoopThread()) {
+      sendPayloadInLoop(payload);
+    } else {
+      getLoop()->runInLoop(
+          std::bind(&TcpConnection::sendPayloadInLoop, shared_from_this(), payload));
+    }
+  }
+}
+
+// 共享数据排在已有数据之后，由 writeOutput 和 outputBuffer_ 中的数据一起 writev 写出
+void TcpConnection::sendPayloadInLoop(const PayloadSlice &payload) {
+  if (!getLoop()->isInLoopThread()) {
+    getLoop()->runInLoop(
+        std::bind(&TcpConnection::sendPayloadInLoop, shared_from_this(), payload));
+    return;
+  }
+  if (state_ == kDisconnected) {
+    return;
+  }
+  if (payload.size() < kInlinePayloadSize) {
+    sendInLoop(payload.data(), payload.size());
+    return;
+  }
+  size_t oldLen = pendingBytes();
+  if (oldLen + payload.size() >= highWaterMark_ && oldLen < highWaterMark_ &&
+      highWaterMarkCallback_) {
+    queueHighWaterMark(oldLen + payload.size());
+  }
+  PendingSegment segment = {-1, 0, payload.size(),
+                            outputWritten_ + static_cast<int64_t>(outputBuffer_.readableBytes()),
+                            payload};
+  pendingSegments_.push_back(std::move(segment));
+  queuedPayloadBytes_ += payload.size();
+  flush();
+}
+
 // 发送数据
 // 应用写数据速度(快)与内核发送数据速度(慢)不匹配，应将待发送的数据写入缓冲区，并设置水位回调
 void TcpConnection::sendInLoop(const void *data, size_t len) {
   ssize_t nwrote = 0;     // 本次发送数据的长度
   size_t remaining = len; // 剩余数据的长度
   bool faultError = false;
+  // 排队期间连接被迁移到了其他 loop，转交给新的 loop 发送
+  if (!getLoop()->isInLoopThread()) {
+    getLoop()->runInLoop(std::bind(&TcpConnection::sendString, shared_from_this(),
+                                   std::string(static_cast<const char *>(data), len)));
+    return;
+  }
   // 之前调用过该 connect 的 shutdown，不能再进行发送了
   if (state_ == kDisconnected) {
     LOG_ERROR("[%s:%s:%d]\ndisconnected, give up writing!\n", __FILE__, __FUNCTION__, __LINE__);
@@ -145,15 +354,20 @@ void TcpConnection::sendInLoop(const void *data, size_t len) {
   }
   // 最初设置的新连接的 channel_ 只对读事件感兴趣
   // 条件列表表示该 channel_ 第一次开始写数据，而且缓冲区没有待发送数据
-  if (!channel_->isWriting() && 0 == outputBuffer_.readableBytes()) {
-    nwrote = ::write(channel_->fd(), data, len);
+  // auto-cork 模式下不直接写，数据都先进入 outputBuffer_
+  // 限速时最多直接写出可用令牌数的字节
+  if (!autoCork_ && !channel_->isWriting() && !sendThrottled_ && outputDrained()) {
+    size_t quota = std::min(len, sendQuota());
+    nwrote = quota > 0 ? ::write(channel_->fd(), data, quota) : 0;
     // 数据发送成功
     if (nwrote >= 0) {
+      addTraffic(nwrote);
+      consumeTokens(sendBucket_, sharedSendBucket_, nwrote);
       // 判断数据是否发送完
       remaining = len - nwrote;
       // 数据一次性全部发送完成了，所以无需给 channel 设置 epollout 事件
       if (0 == remaining && writeCompleteCallback_) {
-        loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+        queueWriteComplete();
       }
       // 数据发送出错
     } else {
@@ -173,19 +387,470 @@ void TcpConnection::sendInLoop(const void *data, size_t len) {
   // (TcpConnection::handleWrite->channel_)
   // 直到把发送缓冲区的数据全部发送完成为止
   if (!faultError && remaining > 0) {
-    size_t oldLen = outputBuffer_.readableBytes(); // 缓冲区剩余待发送数据长度
+    size_t oldLen = pendingBytes(); // 缓冲区和发送队列中剩余待发送数据长度
     if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ &&
         highWaterMarkCallback_) {
-      loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(),
-                                   oldLen + remaining));
+      queueHighWaterMark(oldLen + remaining);
     }
     outputBuffer_.append((char *)data + nwrote, remaining);
-    if (!channel_->isWriting()) {
+    updateBackpressure();
+    if (autoCork_) {
+      // 本轮循环结束时统一 flush 一次；已经在等待 EPOLLOUT 时由 handleWrite 发送
+      if (!channel_->isWriting() && !sendThrottled_ && !flushPending_) {
+        flushPending_ = true;
+        getLoop()->runAtIterationEnd(std::bind(&TcpConnection::flushCorked, shared_from_this()));
+      }
+    } else {
       // 这里一定要注册 channel 的写事件，否则即使有剩余数据，poller 也不会给channel_ 通知
       //  EPOLLOUT，继而无法驱动 channel_ 调用 writeCallback，即 TcpConnection::handleWrite
+      // 限速且令牌已用完时不注册，由 loop 的 tick 恢复
+      enableWritingOrThrottle();
+    }
+  }
+}
+
+void TcpConnection::startRead() {
+  getLoop()->runInLoop(std::bind(&TcpConnection::startReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::stopRead() {
+  getLoop()->runInLoop(std::bind(&TcpConnection::stopReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::startReadInLoop() {
+  if (!getLoop()->isInLoopThread()) {
+    startRead();
+    return;
+  }
+  if (state_ == kDisconnected) {
+    return;
+  }
+  reading_ = true;
+  // 因限速暂停读取时，由 loop 的 tick 恢复
+  if (!readThrottled_ && !channel_->isReading()) {
+    channel_->enableReading();
+  }
+}
+
+void TcpConnection::stopReadInLoop() {
+  if (!getLoop()->isInLoopThread()) {
+    stopRead();
+    return;
+  }
+  if (state_ == kDisconnected) {
+    return;
+  }
+  if (reading_ || channel_->isReading()) {
+    channel_->disableReading();
+    reading_ = false;
+  }
+}
+
+void TcpConnection::setBackpressure(const TcpConnectionPtr &source, size_t highWaterMark,
+                                    size_t lowWaterMark) {
+  getLoop()->runInLoop(std::bind(&TcpConnection::setBackpressureInLoop, shared_from_this(),
+                                 std::weak_ptr<TcpConnection>(source), highWaterMark, lowWaterMark));
+}
+
+void TcpConnection::setBackpressureInLoop(const std::weak_ptr<TcpConnection> &source,
+                                          size_t highWaterMark, size_t lowWaterMark) {
+  // 解除旧的关联前先恢复旧上游的读
+  if (sourcePaused_) {
+    TcpConnectionPtr old = backpressureSource_.lock();
+    if (old) {
+      old->startRead();
+    }
+    sourcePaused_ = false;
+  }
+  backpressureSource_ = source;
+  backpressureHigh_ = source.expired() ? 0 : highWaterMark;
+  backpressureLow_ = lowWaterMark;
+  updateBackpressure();
+}
+
+// outputBuffer_ 的长度变化后调用：超过高水位线让上游停读，降到低水位线以下再恢复
+void TcpConnection::updateBackpressure() {
+  if (backpressureHigh_ == 0) {
+    return;
+  }
+  size_t pending = pendingBytes();
+  if (!sourcePaused_ && pending >= backpressureHigh_) {
+    TcpConnectionPtr source = backpressureSource_.lock();
+    if (source) {
+      source->stopRead();
+      sourcePaused_ = true;
+    }
+  } else if (sourcePaused_ && pending <= backpressureLow_) {
+    TcpConnectionPtr source = backpressureSource_.lock();
+    if (source) {
+      source->startRead();
+    }
+    sourcePaused_ = false;
+  }
+}
+
+// auto-cork 模式下，在本轮循环末尾把本轮所有 send 合并后的 outputBuffer_ 一次写出
+void TcpConnection::flushCorked() {
+  // 本轮循环中连接被迁移走了，migrateInLoop 已经 flush 过
+  if (!getLoop()->isInLoopThread()) {
+    return;
+  }
+  flushPending_ = false;
+  flushOutput();
+}
+
+void TcpConnection::flush() {
+  if (state_ == kDisconnected) {
+    return;
+  }
+  updateBackpressure();
+  if (autoCork_) {
+    if (!channel_->isWriting() && !sendThrottled_ && !flushPending_) {
+      flushPending_ = true;
+      getLoop()->runAtIterationEnd(std::bind(&TcpConnection::flushCorked, shared_from_this()));
+    }
+  } else {
+    flushOutput();
+  }
+}
+
+// 没有在等待 EPOLLOUT 时立即写出 outputBuffer_ 和排队的文件，写不完再注册 EPOLLOUT
+void TcpConnection::flushOutput() {
+  if (state_ == kDisconnected || channel_->isWriting() || sendThrottled_ || outputDrained()) {
+    return;
+  }
+  int savedErrno = 0;
+  ssize_t n = writeOutput(&savedErrno);
+  if (n > 0) {
+    updateBackpressure();
+  } else if (n < 0 && savedErrno != EWOULDBLOCK) {
+    // 对端已关闭等错误，等 poller 上报关闭事件
+    LOG_ERROR("[%s:%s:%d]\nTcpConnection::flushOutput errno = %d\n", __FILE__, __FUNCTION__,
+              __LINE__, savedErrno);
+    return;
+  }
+  if (outputDrained()) {
+    if (writeCompleteCallback_) {
+      queueWriteComplete();
+    }
+    if (state_ == kDisconnecting) {
+      shutdownInLoop();
+    }
+  } else {
+    enableWritingOrThrottle();
+  }
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t count) {
+  if (state_ != kConnected) {
+    ::close(fd);
+    return;
+  }
+  if (getLoop()->isInLoopThread()) {
+    sendFileInLoop(fd, offset, count);
+  } else {
+    getLoop()->runInLoop(
+        std::bind(&TcpConnection::sendFileInLoop, shared_from_this(), fd, offset, count));
+  }
+}
+
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t count) {
+  if (!getLoop()->isInLoopThread()) {
+    sendFile(fd, offset, count);
+    return;
+  }
+  if (state_ == kDisconnected || count == 0) {
+    ::close(fd);
+    return;
+  }
+  PendingSegment file = {fd, offset, count,
+                         outputWritten_ + static_cast<int64_t>(outputBuffer_.readableBytes()),
+                         PayloadSlice()};
+  pendingSegments_.push_back(std::move(file));
+  flush();
+}
+
+void TcpConnection::clearPendingSegments() {
+  for (const PendingSegment &segment : pendingSegments_) {
+    if (segment.fd >= 0) {
+      ::close(segment.fd);
+    }
+  }
+  pendingSegments_.clear();
+  queuedPayloadBytes_ = 0;
+}
+
+void TcpConnection::applySocketOptions(const SocketOptions &options) {
+  socket_->applyConnectionOptions(options);
+}
+
+void TcpConnection::setTcpNoDelay(bool on) { socket_->setTcpNoDelay(on); }
+
+void TcpConnection::setKeepAlive(bool on) { socket_->setKeepAlive(on); }
+
+void TcpConnection::setQuickAck(bool on) { socket_->setQuickAck(on); }
+
+void TcpConnection::setNotSentLowat(int bytes) { socket_->setNotSentLowat(bytes); }
+
+void TcpConnection::setSendBufferSize(int bytes) { socket_->setSendBufferSize(bytes); }
+
+void TcpConnection::setRecvBufferSize(int bytes) { socket_->setRecvBufferSize(bytes); }
+
+void TcpConnection::setSendRate(double bytesPerSecond, double burst) {
+  getLoop()->runInLoop(
+      std::bind(&TcpConnection::setRateInLoop, shared_from_this(), true, bytesPerSecond, burst));
+}
+
+void TcpConnection::setReadRate(double bytesPerSecond, double burst) {
+  getLoop()->runInLoop(
+      std::bind(&TcpConnection::setRateInLoop, shared_from_this(), false, bytesPerSecond, burst));
+}
+
+void TcpConnection::setSharedSendBucket(const std::shared_ptr<TokenBucket> &bucket) {
+  getLoop()->runInLoop(
+      std::bind(&TcpConnection::setSharedBucketInLoop, shared_from_this(), true, bucket));
+}
+
+void TcpConnection::setSharedReadBucket(const std::shared_ptr<TokenBucket> &bucket) {
+  getLoop()->runInLoop(
+      std::bind(&TcpConnection::setSharedBucketInLoop, shared_from_this(), false, bucket));
+}
+
+void TcpConnection::setRateInLoop(bool send, double bytesPerSecond, double burst) {
+  if (!getLoop()->isInLoopThread()) {
+    getLoop()->runInLoop(std::bind(&TcpConnection::setRateInLoop, shared_from_this(), send,
+                                   bytesPerSecond, burst));
+    return;
+  }
+  std::shared_ptr<TokenBucket> &bucket = send ? sendBucket_ : readBucket_;
+  if (bytesPerSecond <= 0) {
+    bucket.reset();
+  } else if (bucket) {
+    bucket->setRate(bytesPerSecond, burst);
+  } else {
+    bucket.reset(new TokenBucket(bytesPerSecond, burst));
+  }
+  // 取消或放宽限制后立即恢复，不用等 tick
+  tryResumeThrottled();
+}
+
+void TcpConnection::setSharedBucketInLoop(bool send, const std::shared_ptr<TokenBucket> &bucket) {
+  if (!getLoop()->isInLoopThread()) {
+    getLoop()->runInLoop(
+        std::bind(&TcpConnection::setSharedBucketInLoop, shared_from_this(), send, bucket));
+    return;
+  }
+  (send ? sharedSendBucket_ : sharedReadBucket_) = bucket;
+  tryResumeThrottled();
+}
+
+size_t TcpConnection::sendQuota() { return minQuota(sendBucket_, sharedSendBucket_); }
+
+size_t TcpConnection::readQuota() { return minQuota(readBucket_, sharedReadBucket_); }
+
+// 按顺序写出 outputBuffer_ 中的数据和发送队列，直到写完或者 socket 写满，限速时最多写出可用令牌数的字节
+// 缓冲区数据和共享数据片段交错排列，一次 writev 最多写 kMaxIovecs 段；遇到文件时单独 sendfile
+// 写出的缓冲区数据在这里 retrieve，返回写出的总字节数，出错时返回 -1
+ssize_t TcpConnection::writeOutput(int *savedErrno) {
+  static const int kMaxIovecs = 64;
+  const bool limited = sendBucket_ || sharedSendBucket_;
+  size_t quota = limited ? sendQuota() : SIZE_MAX;
+  ssize_t total = 0;
+  while (quota > 0) {
+    // 发送队列中第一项之前还有多少缓冲区数据
+    size_t buffered = outputBuffer_.readableBytes();
+    if (!pendingSegments_.empty()) {
+      buffered = static_cast<size_t>(pendingSegments_.front().position - outputWritten_);
+    }
+    ssize_t n;
+    size_t want = 0;
+    if (buffered == 0 && !pendingSegments_.empty() && pendingSegments_.front().fd >= 0) {
+      PendingSegment &file = pendingSegments_.front();
+      want = std::min(file.remaining, quota);
+      n = ::sendfile(channel_->fd(), file.fd, &file.offset, want);
+      if (n == 0) {
+        // 文件比预期的短，响应已经无法按约定的长度发完，只能关闭连接
+        LOG_ERROR("[%s:%s:%d]\nTcpConnection::sendFile fd = %d truncated, %zu bytes missing\n",
+                  __FILE__, __FUNCTION__, __LINE__, file.fd, file.remaining);
+        clearPendingSegments();
+        getLoop()->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+        break;
+      }
+      if (n > 0) {
+        file.remaining -= n;
+        if (file.remaining == 0) {
+          ::close(file.fd);
+          pendingSegments_.pop_front();
+        }
+      }
+    } else if (buffered > 0 || !pendingSegments_.empty()) {
+      // 收集缓冲区数据和其后的共享数据片段，直到遇到文件
+      struct iovec vec[kMaxIovecs];
+      int count = 0;
+      size_t bufferOffset = 0;
+      for (size_t i = 0; count < kMaxIovecs && want < quota; ++i) {
+        size_t end = i < pendingSegments_.size()
+                         ? static_cast<size_t>(pendingSegments_[i].position - outputWritten_)
+                         : outputBuffer_.readableBytes();
+        size_t len = std::min(end - bufferOffset, quota - want);
+        if (len > 0) {
+          vec[count].iov_base = const_cast<char *>(outputBuffer_.peek() + bufferOffset);
+          vec[count].iov_len = len;
+          ++count;
+          bufferOffset += len;
+          want += len;
+        }
+        if (i == pendingSegments_.size() || pendingSegments_[i].fd >= 0 || count == kMaxIovecs ||
+            want == quota) {
+          break;
+        }
+        const PendingSegment &segment = pendingSegments_[i];
+        len = std::min(segment.remaining, quota - want);
+        vec[count].iov_base = const_cast<char *>(segment.payload.data() + segment.offset);
+        vec[count].iov_len = len;
+        ++count;
+        want += len;
+      }
+      n = count == 1 ? ::write(channel_->fd(), vec[0].iov_base, vec[0].iov_len)
+                     : ::writev(channel_->fd(), vec, count);
+      if (n > 0) {
+        consumeOutput(n);
+      }
+    } else {
+      break;
+    }
+    if (n < 0) {
+      *savedErrno = errno;
+      return total > 0 ? total : -1;
+    }
+    total += n;
+    addTraffic(n);
+    if (limited) {
+      consumeTokens(sendBucket_, sharedSendBucket_, n);
+      quota -= n;
+    }
+    // 没有全部写出说明 socket 发送缓冲区已满
+    if (static_cast<size_t>(n) < want) {
+      break;
+    }
+  }
+  return total;
+}
+
+// 按输出流的顺序消耗已经写出的 n 字节：先是发送队列第一项之前的缓冲区数据，再是共享数据片段
+void TcpConnection::consumeOutput(size_t n) {
+  while (n > 0) {
+    size_t buffered = outputBuffer_.readableBytes();
+    if (!pendingSegments_.empty()) {
+      buffered = static_cast<size_t>(pendingSegments_.front().position - outputWritten_);
+    }
+    if (buffered > 0) {
+      size_t len = std::min(n, buffered);
+      outputBuffer_.retrieve(len);
+      outputWritten_ += len;
+      n -= len;
+    } else {
+      PendingSegment &segment = pendingSegments_.front();
+      size_t len = std::min(n, segment.remaining);
+      segment.offset += len;
+      segment.remaining -= len;
+      queuedPayloadBytes_ -= len;
+      n -= len;
+      if (segment.remaining == 0) {
+        pendingSegments_.pop_front();
+      }
+    }
+  }
+}
+
+// outputBuffer_ 中还有数据等待发送时调用：有令牌就等待 EPOLLOUT，令牌用完就暂停写
+void TcpConnection::enableWritingOrThrottle() {
+  if (sendThrottled_) {
+    return;
+  }
+  if (sendQuota() == 0) {
+    throttleWrite();
+  } else if (!channel_->isWriting()) {
+    channel_->enableWriting();
+  }
+}
+
+void TcpConnection::throttleWrite() {
+  sendThrottled_ = true;
+  sendThrottledSince_ = Timer::now();
+  if (channel_->isWriting()) {
+    channel_->disableWriting();
+  }
+  parkThrottled();
+}
+
+void TcpConnection::throttleRead() {
+  readThrottled_ = true;
+  readThrottledSince_ = Timer::now();
+  if (channel_->isReading()) {
+    channel_->disableReading();
+  }
+  parkThrottled();
+}
+
+void TcpConnection::parkThrottled() {
+  if (throttleParked_) {
+    return;
+  }
+  throttleParked_ = true;
+  ThrottleQueue &queue = t_throttleQueue;
+  queue.parked.push_back(shared_from_this());
+  if (!queue.scheduled) {
+    queue.scheduled = true;
+    getLoop()->runAfter(kThrottleTick, &TcpConnection::throttleTick);
+  }
+}
+
+// 在 loop 线程中由定时器调用，逐个检查挂起的连接，令牌仍不足的连接重新挂到队列上等待下一次 tick
+void TcpConnection::throttleTick() {
+  ThrottleQueue &queue = t_throttleQueue;
+  queue.scheduled = false;
+  queue.running.swap(queue.parked);
+  for (const std::weak_ptr<TcpConnection> &weak : queue.running) {
+    TcpConnectionPtr conn = weak.lock();
+    if (conn) {
+      conn->onThrottleTick();
+    }
+  }
+  queue.running.clear();
+}
+
+void TcpConnection::onThrottleTick() {
+  // 挂起期间连接被迁移到了其他 loop，由新 loop 检查并挂到新 loop 的队列上
+  if (!getLoop()->isInLoopThread()) {
+    getLoop()->runInLoop(std::bind(&TcpConnection::onThrottleTick, shared_from_this()));
+    return;
+  }
+  throttleParked_ = false;
+  tryResumeThrottled();
+}
+
+void TcpConnection::tryResumeThrottled() {
+  if (state_ == kDisconnected) {
+    return;
+  }
+  if (sendThrottled_ && sendQuota() > 0) {
+    sendThrottled_ = false;
+    sendThrottledUs_.fetch_add(Timer::now() - sendThrottledSince_, std::memory_order_relaxed);
+    if (!outputDrained() && !channel_->isWriting()) {
       channel_->enableWriting();
     }
   }
+  if (readThrottled_ && readQuota() > 0) {
+    readThrottled_ = false;
+    readThrottledUs_.fetch_add(Timer::now() - readThrottledSince_, std::memory_order_relaxed);
+    if (reading_ && !channel_->isReading()) {
+      channel_->enableReading();
+    }
+  }
+  if (sendThrottled_ || readThrottled_) {
+    parkThrottled();
+  }
 }
 
 // 连接建立，创建连接时调用
@@ -197,11 +862,20 @@ void TcpConnection::connectEstablished() {
   channel_->tie(shared_from_this());  // 返回一个当前类的std::share_ptr
   channel_->enableReading(); // 向对应的 poller 注册 channel 的 EPOLLIN 读事件
   // 新连接建立，执行回调
-  connectionCallback_(shared_from_this());
+  // 回调中可能会重新设置本连接的回调(比如 CoConnection 接管连接)，先把回调移出来再调用，避免执行中的函数对象被析构
+  ConnectionCallback cb(std::move(connectionCallback_));
+  cb(shared_from_this());
+  if (!connectionCallback_) {
+    connectionCallback_ = std::move(cb);
+  }
 }
 
 // 连接销毁，连接关闭时调用
 void TcpConnection::connectDestroyed() {
+  if (!getLoop()->isInLoopThread()) {
+    getLoop()->runInLoop(std::bind(&TcpConnection::connectDestroyed, shared_from_this()));
+    return;
+  }
   if (state_ == kConnected) {
     setState(kDisconnected);
     channel_->disableAll(); // 把 channel_ 所有感兴趣的事件 delete
@@ -214,17 +888,110 @@ void TcpConnection::connectDestroyed() {
 void TcpConnection::shutdown() {
   if (state_ == kConnected) {
     setState(kDisconnecting);
-    loop_->runInLoop(std::bind(&TcpConnection::shutdownInLoop, this));
+    getLoop()->runInLoop(std::bind(&TcpConnection::shutdownInLoop, shared_from_this()));
   }
 }
 
 void TcpConnection::shutdownInLoop() {
+  if (!getLoop()->isInLoopThread()) {
+    getLoop()->runInLoop(std::bind(&TcpConnection::shutdownInLoop, shared_from_this()));
+    return;
+  }
   // channel_ 已经将发送缓冲区 outputBuffer 中的数据发送完了
-  if (!channel_->isWriting()) {
+  // auto-cork 模式下还没 flush 的数据不在 EPOLLOUT 上等待，由 flushCorked 发送完后再调用 shutdownInLoop
+  if (!channel_->isWriting() && outputDrained()) {
     // 关闭 sockfd 的 write 端，poller 给 channel 通知 EPOLLHUB 事件，
     // 触发 channel::handleEventWithGuard 中的 closeCallback_ 回调函数
     // closeCallback_ 即 TcpConnection 在构造函数中注册的
     // TcpConnection::handleClose 方法
     socket_->shutdownWrite();
   }
-}
\ No newline at end of file
+}
+
+void TcpConnection::forceClose() {
+  if (state_ == kConnected || state_ == kDisconnecting) {
+    setState(kDisconnecting);
+    getLoop()->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+  }
+}
+
+void TcpConnection::forceCloseInLoop() {
+  if (!getLoop()->isInLoopThread()) {
+    getLoop()->runInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+    return;
+  }
+  // 与对端关闭走同样的流程，outputBuffer_ 中未发送的数据被丢弃
+  if (state_ == kConnected || state_ == kDisconnecting) {
+    handleClose();
+  }
+}
+
+// 迁移分两步：先在原 loop 中把 channel 从 poller 上摘下，再在新 loop 中重新注册
+// 两步都通过 queueInLoop 执行，此时本轮 activeChannels_ 已处理完，原 loop 不会再回调该 channel
+void TcpConnection::migrateTo(EventLoop *newLoop) {
+  getLoop()->queueInLoop(std::bind(&TcpConnection::migrateInLoop, shared_from_this(), newLoop));
+}
+
+void TcpConnection::migrateInLoop(EventLoop *newLoop) {
+  EventLoop *oldLoop = getLoop();
+  // 连接已经在关闭，或者被其他迁移请求抢先移走了
+  // splice 转发的两个连接必须在同一个 loop 中，不能单独迁移
+  if (state_ != kConnected || newLoop == oldLoop || !oldLoop->isInLoopThread() || relay_) {
+    return;
+  }
+  // 本轮还没 flush 的合并写先在原 loop 中发出去，之后原 loop 中排队的 flushCorked 会因为 loop 已改变而直接返回
+  if (flushPending_) {
+    flushCorked();
+  }
+  bool reading = channel_->isReading();
+  bool writing = channel_->isWriting();
+  channel_->disableAll();
+  channel_->remove();
+  channel_->setOwnerLoop(newLoop);
+  loop_.store(newLoop, std::memory_order_release);
+  LOG_INFO("[%s:%s:%d]\nTcpConnection[%s] fd = %d migrate from loop %p to loop %p\n",
+           __FILE__, __FUNCTION__, __LINE__, name().c_str(), channel_->fd(), oldLoop, newLoop);
+  newLoop->queueInLoop(std::bind(&TcpConnection::attachInLoop, shared_from_this(), reading, writing));
+}
+
+// 回调在排队时绑定，执行时如果连接已经迁移到其他 loop，就转交给新 loop，保证回调总在连接所属的 loop 中执行
+void TcpConnection::queueWriteComplete() {
+  getLoop()->queueInLoop(
+      std::bind(&TcpConnection::writeCompleteInLoop, shared_from_this(), writeCompleteCallback_));
+}
+
+void TcpConnection::writeCompleteInLoop(const WriteCompleteCallback &cb) {
+  EventLoop *loop = getLoop();
+  if (!loop->isInLoopThread()) {
+    loop->queueInLoop(std::bind(&TcpConnection::writeCompleteInLoop, shared_from_this(), cb));
+    return;
+  }
+  cb(shared_from_this());
+}
+
+void TcpConnection::queueHighWaterMark(size_t len) {
+  getLoop()->queueInLoop(
+      std::bind(&TcpConnection::highWaterMarkInLoop, shared_from_this(), highWaterMarkCallback_, len));
+}
+
+void TcpConnection::highWaterMarkInLoop(const HighWaterMarkCallback &cb, size_t len) {
+  EventLoop *loop = getLoop();
+  if (!loop->isInLoopThread()) {
+    loop->queueInLoop(std::bind(&TcpConnection::highWaterMarkInLoop, shared_from_this(), cb, len));
+    return;
+  }
+  cb(shared_from_this(), len);
+}
+
+void TcpConnection::attachInLoop(bool reading, bool writing) {
+  if (state_ == kDisconnected) {
+    return;
+  }
+  // 迁移期间新 loop 中的 send 可能已经注册了写事件
+  if (reading && !channel_->isReading()) {
+    channel_->enableReading();
+  }
+  if (writing && !channel_->isWriting()) {
+    channel_->enableWriting();
+  }
+}
@@ -0,0 +1,192 @@
+#include "TcpRelay.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "Socket.h"
+#include "TcpConnection.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+std::shared_ptr<TcpRelay> TcpRelay::start(const TcpConnectionPtr &a, const TcpConnectionPtr &b,
+                                          size_t pipeSize) {
+  if (a->getLoop() != b->getLoop() || !a->getLoop()->isInLoopThread() || !a->connected() ||
+      !b->connected() || a->relay_ || b->relay_) {
+    LOG_ERROR("[%s:%s:%d]\nTcpRelay::start - connections must be connected, unrelayed and in "
+              "the current loop\n", __FILE__, __FUNCTION__, __LINE__);
+    return std::shared_ptr<TcpRelay>();
+  }
+  std::shared_ptr<TcpRelay> relay(new TcpRelay(a, b));
+  if (!relay->openPipe(&relay->forward_, pipeSize) || !relay->openPipe(&relay->backward_, pipeSize)) {
+    return std::shared_ptr<TcpRelay>();
+  }
+  a->relay_ = relay;
+  b->relay_ = relay;
+  // 已经读到用户态的数据先按顺序交给对方的 outputBuffer_，pump 会等对方的输出(缓冲区和发送队列)清空后再从 pipe 写
+  if (a->inputBuffer_.readableBytes() > 0) {
+    b->sendInLoop(a->inputBuffer_.peek(), a->inputBuffer_.readableBytes());
+    a->inputBuffer_.retrieveAll();
+  }
+  if (b->inputBuffer_.readableBytes() > 0) {
+    a->sendInLoop(b->inputBuffer_.peek(), b->inputBuffer_.readableBytes());
+    b->inputBuffer_.retrieveAll();
+  }
+  if (!relay->pump(&relay->forward_, a.get(), b.get()) ||
+      !relay->pump(&relay->backward_, b.get(), a.get())) {
+    relay->close();
+    return std::shared_ptr<TcpRelay>();
+  }
+  relay->updateInterest(a.get(), b.get());
+  return relay;
+}
+
+TcpRelay::TcpRelay(const TcpConnectionPtr &a, const TcpConnectionPtr &b)
+    : a_(a), b_(b), closed_(false) {}
+
+TcpRelay::~TcpRelay() {
+  for (Direction *dir : {&forward_, &backward_}) {
+    if (dir->pipeRead >= 0) {
+      ::close(dir->pipeRead);
+      ::close(dir->pipeWrite);
+    }
+  }
+}
+
+bool TcpRelay::openPipe(Direction *dir, size_t pipeSize) {
+  int fds[2];
+  if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0) {
+    LOG_ERROR("[%s:%s:%d]\nTcpRelay pipe2 error: %d\n", __FILE__, __FUNCTION__, __LINE__, errno);
+    return false;
+  }
+  dir->pipeRead = fds[0];
+  dir->pipeWrite = fds[1];
+  // 内核会把容量向上取整到页大小的 2 的幂，以实际容量为准
+  ::fcntl(dir->pipeWrite, F_SETPIPE_SZ, static_cast<int>(pipeSize));
+  int capacity = ::fcntl(dir->pipeWrite, F_GETPIPE_SZ);
+  dir->capacity = capacity > 0 ? static_cast<size_t>(capacity) : pipeSize;
+  return true;
+}
+
+void TcpRelay::handleRead(TcpConnection *conn) {
+  std::shared_ptr<TcpRelay> guard(shared_from_this());
+  TcpConnectionPtr a = a_.lock();
+  TcpConnectionPtr b = b_.lock();
+  if (!a || !b) {
+    close();
+    return;
+  }
+  bool ok = conn == a.get() ? pump(&forward_, a.get(), b.get()) : pump(&backward_, b.get(), a.get());
+  if (!ok) {
+    close();
+  } else if (!closed_) {
+    updateInterest(a.get(), b.get());
+  }
+}
+
+// 输出(outputBuffer_ 和发送队列)已经清空后由 TcpConnection::handleWrite 调用，conn 是可写的一方，即某个方向的 dst
+void TcpRelay::handleWrite(TcpConnection *conn) {
+  std::shared_ptr<TcpRelay> guard(shared_from_this());
+  TcpConnectionPtr a = a_.lock();
+  TcpConnectionPtr b = b_.lock();
+  if (!a || !b) {
+    close();
+    return;
+  }
+  bool ok = conn == a.get() ? pump(&backward_, b.get(), a.get()) : pump(&forward_, a.get(), b.get());
+  if (!ok) {
+    close();
+  } else if (!closed_) {
+    updateInterest(a.get(), b.get());
+  }
+}
+
+bool TcpRelay::pump(Direction *dir, TcpConnection *src, TcpConnection *dst) {
+  bool progress = true;
+  while (progress) {
+    progress = false;
+    // 先把 pipe 中的数据写给 dst；dst 的 outputBuffer_ 或发送队列(文件、PayloadSlice)中还有数据时
+    // 要等它们先发完，保证字节顺序
+    if (dir->inPipe > 0 && dst->outputDrained()) {
+      ssize_t n = ::splice(dir->pipeRead, nullptr, dst->channel_->fd(), nullptr, dir->inPipe,
+                           SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+      if (n > 0) {
+        dir->inPipe -= n;
+        dir->bytes += n;
+        dst->addTraffic(n);
+        progress = true;
+      } else if (n < 0 && errno != EAGAIN) {
+        LOG_ERROR("[%s:%s:%d]\nTcpRelay splice to fd %d error: %d\n", __FILE__, __FUNCTION__,
+                  __LINE__, dst->channel_->fd(), errno);
+        return false;
+      }
+    }
+    // 再从 src 读入 pipe，pipe 满时停止
+    if (!dir->srcEof && dir->inPipe < dir->capacity) {
+      ssize_t n = ::splice(src->channel_->fd(), nullptr, dir->pipeWrite, nullptr,
+                           dir->capacity - dir->inPipe, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+      if (n > 0) {
+        dir->inPipe += n;
+        src->addTraffic(n);
+        progress = true;
+      } else if (n == 0) {
+        dir->srcEof = true;
+      } else if (errno != EAGAIN) {
+        LOG_ERROR("[%s:%s:%d]\nTcpRelay splice from fd %d error: %d\n", __FILE__, __FUNCTION__,
+                  __LINE__, src->channel_->fd(), errno);
+        return false;
+      }
+    }
+  }
+  // src 已结束且数据全部交给了 dst，把 EOF 传给 dst 的对端
+  if (dir->srcEof && dir->inPipe == 0 && dst->outputDrained() && !dir->dstShutdown) {
+    dir->dstShutdown = true;
+    dst->socket_->shutdownWrite();
+  }
+  return true;
+}
+
+// 根据两个方向的状态设置两个连接的读写事件，只在状态变化时调用 epoll_ctl
+void TcpRelay::updateInterest(TcpConnection *a, TcpConnection *b) {
+  if (forward_.dstShutdown && backward_.dstShutdown) {
+    close();
+    return;
+  }
+  struct Side {
+    TcpConnection *conn;
+    const Direction *out; // conn 作为 src 的方向
+    const Direction *in;  // conn 作为 dst 的方向
+  };
+  Side sides[] = {{a, &forward_, &backward_}, {b, &backward_, &forward_}};
+  for (const Side &side : sides) {
+    Channel *channel = side.conn->channel_.get();
+    bool reading = !side.out->srcEof && side.out->inPipe < side.out->capacity;
+    bool writing = side.in->inPipe > 0 || !side.conn->outputDrained();
+    if (reading != channel->isReading()) {
+      reading ? channel->enableReading() : channel->disableReading();
+    }
+    if (writing != channel->isWriting()) {
+      writing ? channel->enableWriting() : channel->disableWriting();
+    }
+  }
+}
+
+void TcpRelay::close() {
+  if (closed_) {
+    return;
+  }
+  closed_ = true;
+  std::shared_ptr<TcpRelay> guard(shared_from_this());
+  TcpConnectionPtr a = a_.lock();
+  TcpConnectionPtr b = b_.lock();
+  for (const TcpConnectionPtr &conn : {a, b}) {
+    if (conn) {
+      conn->relay_.reset();
+    }
+  }
+  for (const TcpConnectionPtr &conn : {a, b}) {
+    if (conn && !conn->disconnected()) {
+      conn->handleClose();
+    }
+  }
+}
@@ -1,8 +1,11 @@
 #include "TcpServer.h"
+#include "EventLoopThread.h"
 #include "Logger.h"
 #include "TcpConnection.h"
 
 #include <strings.h>
+#include <unistd.h>
+#include <vector>
 
 static EventLoop *CheckLoopNotNull(EventLoop *loop) {
   if (loop == nullptr) {
@@ -21,8 +24,22 @@ TcpServer::TcpServer(EventLoop *loop, const InetAddress &listenAddr,
     , threadPool_(new EventLoopThreadPool(loop, name_))               // 事件循环线程池，这里只是创建，未开启事件循环
     , connectionCallback_()
     , messageCallback_()
+    , autoCork_(false)
+    , namePrefix_(std::make_shared<const std::string>(nameArg + "-" + ipPort_ + "#"))
     , nextConnId_(1)
-    , started_(0) { // 原子整形 started_ 用来保证 server 只启动一次
+    , started_(0) // 原子整形 started_ 用来保证 server 只启动一次
+    , rebalanceInterval_(0)
+    , rebalanceThreshold_(0)
+    , minLoops_(0)
+    , maxLoops_(0)
+    , autoScaleInterval_(0)
+    , scaleUpRatio_(0)
+    , scaleDownRatio_(0)
+    , connSendRate_(0)
+    , connSendBurst_(0)
+    , connReadRate_(0)
+    , connReadBurst_(0)
+    , stopping_(false) {
   // 1. 在 TcpServer 的构造函数中，将 acceptor_ 的 newConnectionCallback_ 绑定为 TcpServer::newConnection
   // 2. 在 Acceptor 的构造函数中，将 acceptorChannel 的 readCallback_ 绑定为 Acceptor::handleRead
   // 4. 在 Acceptor::handleRead 中，会调用 newConnectionCallback_，即 TcpServer::newConnection
@@ -47,39 +64,369 @@ void TcpServer::start() {
   }
 }
 
+void TcpServer::stop(double drainTimeout, const StopCallback &cb) {
+  loop_->runInLoop(std::bind(&TcpServer::stopInLoop, this, drainTimeout, cb));
+}
+
+// 按所在 loop 分组，每个 loop 只排队一次，各 loop 并行处理自己的连接
+template <typename Func>
+static void forEachLoop(const ConnectionRegistry &connections, Func func) {
+  std::unordered_map<EventLoop *, std::vector<TcpConnectionPtr>> byLoop;
+  connections.forEach([&byLoop](const TcpConnectionPtr &conn) { byLoop[conn->getLoop()].push_back(conn); });
+  for (auto &item : byLoop) {
+    std::vector<TcpConnectionPtr> conns(std::move(item.second));
+    item.first->queueInLoop([conns, func]() {
+      for (const TcpConnectionPtr &conn : conns) {
+        func(conn);
+      }
+    });
+  }
+}
+
+void TcpServer::stopInLoop(double drainTimeout, const StopCallback &cb) {
+  if (stopping_) {
+    return;
+  }
+  stopping_ = true;
+  stopCallback_ = cb;
+  LOG_INFO("[%s:%s:%d]\nTcpServer::stop [%s] - draining %zu connections, timeout %.1fs\n",
+           __FILE__, __FUNCTION__, __LINE__, name_.c_str(), connections_.size(), drainTimeout);
+  // 停止期间不再迁移连接和伸缩线程池
+  if (rebalanceTimer_.valid()) {
+    loop_->cancel(rebalanceTimer_);
+    rebalanceTimer_ = TimerId();
+  }
+  if (autoScaleTimer_.valid()) {
+    loop_->cancel(autoScaleTimer_);
+    autoScaleTimer_ = TimerId();
+  }
+  acceptor_->stop();
+  if (drainTimeout > 0) {
+    forEachLoop(connections_, [](const TcpConnectionPtr &conn) { conn->shutdown(); });
+    drainTimer_ = loop_->runAfter(drainTimeout, std::bind(&TcpServer::forceCloseAll, this));
+  } else {
+    forceCloseAll();
+  }
+  checkStopped();
+}
+
+void TcpServer::forceCloseAll() {
+  drainTimer_ = TimerId();
+  if (!connections_.empty()) {
+    LOG_INFO("[%s:%s:%d]\nTcpServer::stop [%s] - force closing %zu connections\n", __FILE__,
+             __FUNCTION__, __LINE__, name_.c_str(), connections_.size());
+  }
+  forEachLoop(connections_, [](const TcpConnectionPtr &conn) { conn->forceClose(); });
+}
+
+// 停止过程中最后一个连接关闭后调用 stopCallback_
+void TcpServer::checkStopped() {
+  if (!stopping_ || !connections_.empty()) {
+    return;
+  }
+  if (drainTimer_.valid()) {
+    loop_->cancel(drainTimer_);
+    drainTimer_ = TimerId();
+  }
+  if (stopCallback_) {
+    StopCallback cb(std::move(stopCallback_));
+    stopCallback_ = StopCallback();
+    cb();
+  }
+}
+
+void TcpServer::setSocketOptions(const SocketOptions &options) {
+  socketOptions_ = options;
+  acceptor_->setSocketOptions(options);
+}
+
+void TcpServer::enableRebalance(double interval, double threshold) {
+  rebalanceInterval_ = interval;
+  rebalanceThreshold_ = threshold;
+  rebalanceTimer_ = loop_->runEvery(interval, std::bind(&TcpServer::rebalance, this));
+}
+
+// 根据两次采样之间累计繁忙时间的差值计算各 loop 的繁忙比例
+// samples 中只保留本次出现的 loop，已退役的 loop 自动清除；第一次出现的 loop 不计入结果
+static std::vector<std::pair<EventLoop *, double>>
+sampleBusyRatios(const std::vector<EventLoop *> &loops,
+                 std::unordered_map<EventLoop *, int64_t> *samples, double interval) {
+  std::vector<std::pair<EventLoop *, double>> ratios;
+  std::unordered_map<EventLoop *, int64_t> current;
+  for (EventLoop *loop : loops) {
+    int64_t busy = loop->busyTimeUs();
+    auto it = samples->find(loop);
+    if (it != samples->end()) {
+      ratios.emplace_back(loop, (busy - it->second) / (interval * 1000 * 1000));
+    }
+    current[loop] = busy;
+  }
+  samples->swap(current);
+  return ratios;
+}
+
+void TcpServer::rebalance() {
+  std::vector<EventLoop *> loops = threadPool_->getAllLoops();
+  if (loops.size() < 2) {
+    return;
+  }
+  std::vector<std::pair<EventLoop *, double>> ratios =
+      sampleBusyRatios(loops, &loopBusySamples_, rebalanceInterval_);
+  // 所有 loop 都有上一次的采样值，本轮的比例才有意义
+  bool sampled = ratios.size() == loops.size();
+  EventLoop *hottest = nullptr;
+  EventLoop *coldest = nullptr;
+  double maxRatio = 0;
+  double minRatio = 0;
+  for (auto &item : ratios) {
+    if (hottest == nullptr || item.second > maxRatio) {
+      hottest = item.first;
+      maxRatio = item.second;
+    }
+    if (coldest == nullptr || item.second < minRatio) {
+      coldest = item.first;
+      minRatio = item.second;
+    }
+  }
+
+  // 每轮都取走所有连接的流量样本，保证下一轮比较的是同一段时间内的流量
+  std::vector<std::pair<int64_t, TcpConnectionPtr>> hotConns;
+  int64_t hotTraffic = 0;
+  connections_.forEach([&](const TcpConnectionPtr &conn) {
+    int64_t traffic = conn->takeTrafficSample();
+    if (conn->getLoop() == hottest && conn->connected()) {
+      hotTraffic += traffic;
+      hotConns.emplace_back(traffic, conn);
+    }
+  });
+
+  const double gap = maxRatio - minRatio;
+  if (!sampled || gap < rebalanceThreshold_ || hotTraffic == 0 || hotConns.size() < 2) {
+    return;
+  }
+
+  // 按流量占比估算每个连接占用的繁忙比例 share，迁移后两个 loop 分别变为 max - share 和 min + share
+  // share 越接近 gap / 2 越均衡，share >= gap 时迁移只会把热点搬到另一个 loop 上
+  TcpConnectionPtr best;
+  double bestDistance = gap / 2;
+  for (auto &item : hotConns) {
+    double share = maxRatio * item.first / hotTraffic;
+    double distance = share > gap / 2 ? share - gap / 2 : gap / 2 - share;
+    if (share > 0 && share < gap && distance < bestDistance) {
+      best = item.second;
+      bestDistance = distance;
+    }
+  }
+  if (best) {
+    LOG_INFO("[%s:%s:%d]\nTcpServer::rebalance [%s] - move %s from loop %p(%.2f) to loop %p(%.2f)\n",
+             __FILE__, __FUNCTION__, __LINE__, name_.c_str(), best->name().c_str(),
+             hottest, maxRatio, coldest, minRatio);
+    best->migrateTo(coldest);
+  }
+}
+
+EventLoop *TcpServer::addSubLoop() {
+  EventLoop *loop = threadPool_->addLoop();
+  LOG_INFO("[%s:%s:%d]\nTcpServer::addSubLoop [%s] - loop %p, %d loops now\n", __FILE__,
+           __FUNCTION__, __LINE__, name_.c_str(), loop, threadPool_->numLoops());
+  return loop;
+}
+
+void TcpServer::retireSubLoop(EventLoop *loop) {
+  loop_->runInLoop(std::bind(&TcpServer::retireSubLoopInLoop, this, loop));
+}
+
+void TcpServer::retireSubLoopInLoop(EventLoop *loop) {
+  if (loop == nullptr) {
+    if (threadPool_->numLoops() == 0) {
+      return;
+    }
+    loop = threadPool_->getAllLoops().back();
+  }
+  // 摘下之后 getNextLoop 不会再把新连接分给它
+  std::unique_ptr<EventLoopThread> thread = threadPool_->detachLoop(loop);
+  if (!thread) {
+    LOG_ERROR("[%s:%s:%d]\nTcpServer::retireSubLoop [%s] - loop %p is not in pool\n", __FILE__,
+              __FUNCTION__, __LINE__, name_.c_str(), loop);
+    return;
+  }
+  LOG_INFO("[%s:%s:%d]\nTcpServer::retireSubLoop [%s] - draining loop %p\n", __FILE__,
+           __FUNCTION__, __LINE__, name_.c_str(), loop);
+  retiringLoops_[loop].thread = std::move(thread);
+  checkRetiring(loop);
+}
+
+// 把还在 loop 上的已连接连接迁走，正在关闭的连接等它自己关闭，直到 loop 上没有连接为止
+void TcpServer::checkRetiring(EventLoop *loop) {
+  bool remaining = false;
+  connections_.forEach([&](const TcpConnectionPtr &conn) {
+    if (conn->getLoop() == loop) {
+      remaining = true;
+      if (conn->connected()) {
+        conn->migrateTo(threadPool_->getNextLoop());
+      }
+    }
+  });
+  RetiringLoop &retiring = retiringLoops_[loop];
+  if (remaining) {
+    retiring.timer = loop_->runAfter(kRetireCheckInterval, std::bind(&TcpServer::checkRetiring, this, loop));
+  } else {
+    retiring.timer = TimerId();
+    // 绕 loop 一圈再回到 baseLoop 析构线程，保证之前排队给该 loop 的回调(迁移、connectDestroyed)都已执行
+    loop->queueInLoop([this, loop]() {
+      loop_->queueInLoop(std::bind(&TcpServer::finishRetire, this, loop));
+    });
+  }
+}
+
+void TcpServer::finishRetire(EventLoop *loop) {
+  LOG_INFO("[%s:%s:%d]\nTcpServer::retireSubLoop [%s] - loop %p retired, %d loops now\n", __FILE__,
+           __FUNCTION__, __LINE__, name_.c_str(), loop, threadPool_->numLoops());
+  // EventLoopThread 析构时 quit 并 join 线程
+  retiringLoops_.erase(loop);
+}
+
+void TcpServer::enableAutoScale(int minLoops, int maxLoops, double interval,
+                                double scaleUpRatio, double scaleDownRatio) {
+  minLoops_ = minLoops;
+  maxLoops_ = maxLoops;
+  autoScaleInterval_ = interval;
+  scaleUpRatio_ = scaleUpRatio;
+  scaleDownRatio_ = scaleDownRatio;
+  autoScaleTimer_ = loop_->runEvery(interval, std::bind(&TcpServer::autoScale, this));
+}
+
+void TcpServer::autoScale() {
+  std::vector<EventLoop *> loops = threadPool_->getAllLoops();
+  std::vector<std::pair<EventLoop *, double>> ratios =
+      sampleBusyRatios(loops, &autoScaleSamples_, autoScaleInterval_);
+  // 有 loop 正在退役或刚加入时先不做决定，每轮最多增减一个 loop
+  if (ratios.size() != loops.size() || !retiringLoops_.empty()) {
+    return;
+  }
+  double total = 0;
+  EventLoop *coldest = nullptr;
+  double minRatio = 0;
+  for (auto &item : ratios) {
+    total += item.second;
+    if (coldest == nullptr || item.second < minRatio) {
+      coldest = item.first;
+      minRatio = item.second;
+    }
+  }
+  double average = total / ratios.size();
+  int numLoops = threadPool_->numLoops();
+  if (average > scaleUpRatio_ && numLoops < maxLoops_) {
+    LOG_INFO("[%s:%s:%d]\nTcpServer::autoScale [%s] - busy ratio %.2f, scale up\n", __FILE__,
+             __FUNCTION__, __LINE__, name_.c_str(), average);
+    addSubLoop();
+  } else if (average < scaleDownRatio_ && numLoops > minLoops_ && numLoops > 0) {
+    LOG_INFO("[%s:%s:%d]\nTcpServer::autoScale [%s] - busy ratio %.2f, scale down\n", __FILE__,
+             __FUNCTION__, __LINE__, name_.c_str(), average);
+    retireSubLoopInLoop(coldest);
+  }
+}
+
+void TcpServer::setConnectionSendRate(double bytesPerSecond, double burst) {
+  loop_->runInLoop(std::bind(&TcpServer::setConnectionRateInLoop, this, true, bytesPerSecond, burst));
+}
+
+void TcpServer::setConnectionReadRate(double bytesPerSecond, double burst) {
+  loop_->runInLoop(std::bind(&TcpServer::setConnectionRateInLoop, this, false, bytesPerSecond, burst));
+}
+
+void TcpServer::setTotalSendRate(double bytesPerSecond, double burst) {
+  loop_->runInLoop(std::bind(&TcpServer::setTotalRateInLoop, this, true, bytesPerSecond, burst));
+}
+
+void TcpServer::setTotalReadRate(double bytesPerSecond, double burst) {
+  loop_->runInLoop(std::bind(&TcpServer::setTotalRateInLoop, this, false, bytesPerSecond, burst));
+}
+
+void TcpServer::setConnectionRateInLoop(bool send, double bytesPerSecond, double burst) {
+  (send ? connSendRate_ : connReadRate_) = bytesPerSecond > 0 ? bytesPerSecond : 0;
+  (send ? connSendBurst_ : connReadBurst_) = burst;
+  connections_.forEach([&](const TcpConnectionPtr &conn) {
+    if (send) {
+      conn->setSendRate(bytesPerSecond, burst);
+    } else {
+      conn->setReadRate(bytesPerSecond, burst);
+    }
+  });
+}
+
+// 已有共享令牌桶时直接调整速率(TokenBucket 自带锁)，新建或取消时需要通知每个连接
+void TcpServer::setTotalRateInLoop(bool send, double bytesPerSecond, double burst) {
+  std::shared_ptr<TokenBucket> &bucket = send ? totalSendBucket_ : totalReadBucket_;
+  if (bytesPerSecond > 0 && bucket) {
+    bucket->setRate(bytesPerSecond, burst);
+    return;
+  }
+  if (bytesPerSecond > 0) {
+    bucket.reset(new TokenBucket(bytesPerSecond, burst));
+  } else if (bucket) {
+    bucket.reset();
+  } else {
+    return;
+  }
+  connections_.forEach([&](const TcpConnectionPtr &conn) {
+    if (send) {
+      conn->setSharedSendBucket(bucket);
+    } else {
+      conn->setSharedReadBucket(bucket);
+    }
+  });
+}
+
 // 有一个新客户端连接时，会通过 acceptorChannel 执行这个回调函数
 void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr) {
+  if (stopping_) {
+    ::close(sockfd);
+    return;
+  }
   // 轮询算法选择一个 subLoop 来管理 channel
   EventLoop *ioLoop = threadPool_->getNextLoop();
-  char buf[64] = {0};
-  // 设置新连接名称
-  snprintf(buf, sizeof(buf), "-%s#%d", ipPort_.c_str(), nextConnId_);
-  ++nextConnId_;
-  std::string connName = name_ + buf;
+  // 在连接表中预留槽位得到连接 ID，连接名称等到需要时再由 namePrefix_ 和序号格式化
+  uint64_t connId = connections_.allocate();
+  int64_t seq = nextConnId_++;
 
-  LOG_INFO("[%s:%s:%d]\nTcpServer::newConnection [%s] - new connection [%s] "
+  LOG_INFO("[%s:%s:%d]\nTcpServer::newConnection [%s] - new connection [%s%ld] id = %lu "
            "from %s\n",
-           __FILE__, __FUNCTION__, __LINE__, name_.c_str(), connName.c_str(),
+           __FILE__, __FUNCTION__, __LINE__, name_.c_str(), namePrefix_->c_str(), seq, connId,
            peerAddr.toIpPort().c_str());
 
   // 通过 sockfd 获取其绑定的本机的IP地址和端口号信息
-  sockaddr_in local;
+  sockaddr_storage local;
   ::bzero(&local, sizeof(local));
   socklen_t addrLen = sizeof(local);
   if (::getsockname(sockfd, (sockaddr *)&local, &addrLen) < 0) {
     LOG_ERROR("[%s:%s:%d]\nsockets::getLocalAddr\n", __FILE__, __FUNCTION__,
               __LINE__);
   }
-  InetAddress localAddr(local);
+  InetAddress localAddr((sockaddr *)&local, addrLen);
 
   // 根据连接成功的 sockfd，创建一个 TcpConnection 连接对象
-  TcpConnectionPtr conn(new TcpConnection(ioLoop, connName, sockfd, localAddr, peerAddr));
-  connections_[connName] = conn;
+  TcpConnectionPtr conn(new TcpConnection(ioLoop, connId, namePrefix_, seq, sockfd, localAddr, peerAddr));
+  connections_.assign(connId, conn);
   // 设置相应的回调
   // 下面的回调都由用户设置给 TcpServer => TcpConnection => Channel=> Poller => notify channel 调用回调
   conn->setConnectionCallback(connectionCallback_);
   conn->setMessageCallback(messageCallback_);
   conn->setWriteCompleteCallback(writeCompleteCallback_);
+  conn->applySocketOptions(socketOptions_);
+  conn->setAutoCork(autoCork_);
+  if (connSendRate_ > 0) {
+    conn->setSendRate(connSendRate_, connSendBurst_);
+  }
+  if (connReadRate_ > 0) {
+    conn->setReadRate(connReadRate_, connReadBurst_);
+  }
+  if (totalSendBucket_) {
+    conn->setSharedSendBucket(totalSendBucket_);
+  }
+  if (totalReadBucket_) {
+    conn->setSharedReadBucket(totalReadBucket_);
+  }
   // 设置如何关闭连接的回调
   // 用户会调用 conn->shutdown() => shutdownInLoop => Socket::shutdownWrite
   // => poller 给 channel 上报 EPOLLHUB => Channel::handleWithGuard 调用 closeCallback_
@@ -96,25 +443,42 @@ void TcpServer::removeConnection(const TcpConnectionPtr &conn) {
 }
 
 void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn) {
-  LOG_INFO("[%s:%s:%d]\nTcpServer::removeConnectionInLoop [%s] - connection %s\n",
-      __FILE__, __FUNCTION__, __LINE__, name_.c_str(), conn->name().c_str());
-  connections_.erase(conn->name());
+  // 记录连接 ID 而不是名字，避免每次关闭连接都格式化延迟生成的名字
+  LOG_INFO("[%s:%s:%d]\nTcpServer::removeConnectionInLoop [%s] - connection %llu\n",
+      __FILE__, __FUNCTION__, __LINE__, name_.c_str(), static_cast<unsigned long long>(conn->id()));
+  connections_.remove(conn->id());
   EventLoop *ioLoop = conn->getLoop();
   // 将 channel 从 poller 中删除
   ioLoop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+  checkStopped();
 }
 
 TcpServer::~TcpServer() {
   LOG_INFO("[%s:%s:%d]\nTcpServer::~TcpServer [%s] destructing!\n", __FILE__,
            __FUNCTION__, __LINE__, name_.c_str());
-  for (auto &item : connections_) {
+  if (rebalanceTimer_.valid()) {
+    loop_->cancel(rebalanceTimer_);
+  }
+  if (autoScaleTimer_.valid()) {
+    loop_->cancel(autoScaleTimer_);
+  }
+  if (drainTimer_.valid()) {
+    loop_->cancel(drainTimer_);
+  }
+  for (auto &item : retiringLoops_) {
+    if (item.second.timer.valid()) {
+      loop_->cancel(item.second.timer);
+    }
+  }
+  connections_.forEach([](TcpConnectionPtr &item) {
     // 获取一个 TcpConnection 的局部智能指针对象，出作用域自动释放 new 出来的
     // TcpConnection 对象资源
-    TcpConnectionPtr conn(item.second);
+    TcpConnectionPtr conn(item);
     // 释放后就无法再访问原来指向的 TcpConnection 对象了，所以才定义了上面的
     // conn
-    item.second.reset();
+    item.reset();
     // 然后通过 conn 调用 TcpConnection::connectDestroyed，销毁连接
     conn->getLoop()->runInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
-  }
+  });
+  connections_.clear();
 }
\ No newline at end of file
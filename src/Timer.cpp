@@ -0,0 +1,11 @@
+#include "Timer.h"
+
+#include <time.h>
+
+std::atomic<int64_t> Timer::numCreated_(0);
+
+int64_t Timer::now() {
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000 * 1000 + ts.tv_nsec / 1000;
+}
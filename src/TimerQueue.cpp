@@ -0,0 +1,154 @@
+#include "TimerQueue.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <iterator>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+static int createTimerfd() {
+  int timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timerfd < 0) {
+    LOG_FATAL("[%s:%s:%d]\ntimerfd_create error: %d\n", __FILE__, __FUNCTION__,
+              __LINE__, errno);
+  }
+  return timerfd;
+}
+
+// 读走 timerfd 上的到期次数，否则 LT 模式下会一直触发可读事件
+static void readTimerfd(int timerfd) {
+  uint64_t howmany = 0;
+  ssize_t n = ::read(timerfd, &howmany, sizeof(howmany));
+  if (n != sizeof(howmany)) {
+    LOG_ERROR("[%s:%s:%d]\nTimerQueue::handleRead() reads %ld bytes instead of 8\n",
+              __FILE__, __FUNCTION__, __LINE__, n);
+  }
+}
+
+TimerQueue::TimerQueue(EventLoop *loop)
+    : loop_(loop)
+    , timerfd_(createTimerfd())
+    , timerfdChannel_(loop, timerfd_)
+    , callingExpiredTimers_(false) {
+  timerfdChannel_.setReadCallback(std::bind(&TimerQueue::handleRead, this));
+  timerfdChannel_.enableReading();
+}
+
+TimerQueue::~TimerQueue() {
+  timerfdChannel_.disableAll();
+  timerfdChannel_.remove();
+  ::close(timerfd_);
+  for (const Entry &timer : timers_) {
+    delete timer.second;
+  }
+}
+
+TimerId TimerQueue::addTimer(Timer::TimerCallback cb, int64_t when,
+                             int64_t intervalUs) {
+  Timer *timer = new Timer(std::move(cb), when, intervalUs);
+  loop_->runInLoop(std::bind(&TimerQueue::addTimerInLoop, this, timer));
+  return TimerId(timer, timer->sequence());
+}
+
+void TimerQueue::cancel(TimerId timerId) {
+  loop_->runInLoop(std::bind(&TimerQueue::cancelInLoop, this, timerId));
+}
+
+void TimerQueue::addTimerInLoop(Timer *timer) {
+  bool earliestChanged = insert(timer);
+  if (earliestChanged) {
+    resetTimerfd(timer->expiration());
+  }
+}
+
+void TimerQueue::cancelInLoop(TimerId timerId) {
+  ActiveTimer timer(timerId.timer_, timerId.sequence_);
+  ActiveTimerSet::iterator it = activeTimers_.find(timer);
+  if (it != activeTimers_.end()) {
+    timers_.erase(Entry(it->first->expiration(), it->first));
+    delete it->first;
+    activeTimers_.erase(it);
+  } else if (callingExpiredTimers_) {
+    // 定时器正在执行回调(比如在自己的回调中取消自己)，此时它已不在 timers_ 中
+    cancelingTimers_.insert(timer);
+  }
+}
+
+void TimerQueue::handleRead() {
+  int64_t now = Timer::now();
+  readTimerfd(timerfd_);
+
+  std::vector<Entry> expired = getExpired(now);
+
+  callingExpiredTimers_ = true;
+  cancelingTimers_.clear();
+  for (const Entry &it : expired) {
+    it.second->run();
+  }
+  callingExpiredTimers_ = false;
+
+  reset(expired, now);
+}
+
+std::vector<TimerQueue::Entry> TimerQueue::getExpired(int64_t now) {
+  std::vector<Entry> expired;
+  // 第一个到期时间大于 now 的定时器，之前的都已到期
+  Entry sentry(now, reinterpret_cast<Timer *>(UINTPTR_MAX));
+  TimerList::iterator end = timers_.lower_bound(sentry);
+  std::copy(timers_.begin(), end, std::back_inserter(expired));
+  timers_.erase(timers_.begin(), end);
+
+  for (const Entry &it : expired) {
+    activeTimers_.erase(ActiveTimer(it.second, it.second->sequence()));
+  }
+  return expired;
+}
+
+void TimerQueue::reset(const std::vector<Entry> &expired, int64_t now) {
+  for (const Entry &it : expired) {
+    ActiveTimer timer(it.second, it.second->sequence());
+    if (it.second->repeat() &&
+        cancelingTimers_.find(timer) == cancelingTimers_.end()) {
+      it.second->restart(now);
+      insert(it.second);
+    } else {
+      delete it.second;
+    }
+  }
+
+  if (!timers_.empty()) {
+    resetTimerfd(timers_.begin()->second->expiration());
+  }
+}
+
+bool TimerQueue::insert(Timer *timer) {
+  bool earliestChanged = false;
+  int64_t when = timer->expiration();
+  TimerList::iterator it = timers_.begin();
+  if (it == timers_.end() || when < it->first) {
+    earliestChanged = true;
+  }
+  timers_.insert(Entry(when, timer));
+  activeTimers_.insert(ActiveTimer(timer, timer->sequence()));
+  return earliestChanged;
+}
+
+// 设置 timerfd 的超时时间为 expiration
+void TimerQueue::resetTimerfd(int64_t expiration) {
+  int64_t microseconds = expiration - Timer::now();
+  // 已经过期的定时器也要让 timerfd 尽快触发
+  if (microseconds < 100) {
+    microseconds = 100;
+  }
+  struct itimerspec newValue;
+  ::memset(&newValue, 0, sizeof(newValue));
+  newValue.it_value.tv_sec = static_cast<time_t>(microseconds / (1000 * 1000));
+  newValue.it_value.tv_nsec = static_cast<long>((microseconds % (1000 * 1000)) * 1000);
+  if (::timerfd_settime(timerfd_, 0, &newValue, nullptr) < 0) {
+    LOG_ERROR("[%s:%s:%d]\ntimerfd_settime error: %d\n", __FILE__, __FUNCTION__,
+              __LINE__, errno);
+  }
+}
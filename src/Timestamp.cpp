@@ -1,26 +1,75 @@
 #include "Timestamp.h"
+#include <string.h>
 #include <time.h>
 
+namespace {
+
+// 每个线程缓存上一次格式化的秒和对应的 "年/月/日 时:分:秒"
+// 放在一个结构体中，formatTo 只做一次 TLS 寻址
+struct TimeCache {
+  time_t second;
+  size_t length;
+  char text[32];
+};
+__thread TimeCache t_timeCache = {-1, 0, {0}};
+
+} // namespace
+
 Timestamp::Timestamp() : microSecondsSinceEpoch_(0) {}
 Timestamp::Timestamp(int64_t microSecondsSinceEpoch)
     : microSecondsSinceEpoch_(microSecondsSinceEpoch) {}
 
 Timestamp Timestamp::now() {
-  // time_t ti = time(NULL);
-  return Timestamp(time(NULL));
+  struct timespec ts;
+  ::clock_gettime(CLOCK_REALTIME, &ts);
+  return Timestamp(static_cast<int64_t>(ts.tv_sec) * kMicroSecondsPerSecond + ts.tv_nsec / 1000);
+}
+
+int64_t Timestamp::nowNanos() {
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000 * 1000 * 1000 + ts.tv_nsec;
+}
+
+size_t Timestamp::formatTo(char *buf, size_t len, bool showMicroseconds) const {
+  time_t seconds = secondsSinceEpoch();
+  TimeCache &cache = t_timeCache;
+  if (seconds != cache.second) {
+    cache.second = seconds;
+    struct tm tm_time;
+    ::localtime_r(&seconds, &tm_time);
+    int n = snprintf(cache.text, sizeof(cache.text), "%4d/%02d/%02d %02d:%02d:%02d",
+                     tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday, tm_time.tm_hour,
+                     tm_time.tm_min, tm_time.tm_sec);
+    cache.length = n > 0 ? static_cast<size_t>(n) : 0;
+  }
+  if (len <= cache.length) {
+    return 0;
+  }
+  ::memcpy(buf, cache.text, cache.length);
+  size_t n = cache.length;
+  if (showMicroseconds && len - n > 7) {
+    // 手工填写 6 位微秒，避免每条日志一次 snprintf
+    int micros = static_cast<int>(microSecondsSinceEpoch_ % kMicroSecondsPerSecond);
+    buf[n] = '.';
+    for (int i = 6; i > 0; --i) {
+      buf[n + i] = static_cast<char>('0' + micros % 10);
+      micros /= 10;
+    }
+    n += 7;
+  }
+  buf[n] = '\0';
+  return n;
 }
 
 std::string Timestamp::toString() const {
-  char buf[128] = {0};
-  tm *tm_time = localtime(&microSecondsSinceEpoch_);
-  snprintf(buf, sizeof(buf), "%4d/%02d/%02d %02d:%02d:%02d",
-      tm_time->tm_year + 1900,
-      tm_time->tm_mon + 1,
-      tm_time->tm_mday,
-      tm_time->tm_hour,
-      tm_time->tm_min,
-      tm_time->tm_sec);
-  return buf;
+  return toFormattedString(false);
+}
+
+std::string Timestamp::toFormattedString(bool showMicroseconds) const {
+  char buf[64];
+  size_t n = formatTo(buf, sizeof(buf), showMicroseconds);
+  return std::string(buf, n);
 }
 
 
@@ -32,4 +81,4 @@ int main() {
   std::cout << tm.now().toString() << '\n';
   return 0;
 }
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,51 @@
+#include "TokenBucket.h"
+#include "Timer.h"
+
+#include <algorithm>
+#include <stdint.h>
+
+static double defaultBurst(double rate, double burst) {
+  return burst > 0 ? burst : std::max(rate / 10, 1.0);
+}
+
+TokenBucket::TokenBucket(double rate, double burst)
+    : rate_(rate)
+    , burst_(defaultBurst(rate, burst))
+    , tokens_(burst_)
+    , lastRefill_(Timer::now()) {}
+
+void TokenBucket::setRate(double rate, double burst) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  refill(Timer::now());
+  rate_ = rate;
+  burst_ = defaultBurst(rate, burst);
+  tokens_ = std::min(tokens_, burst_);
+}
+
+double TokenBucket::rate() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return rate_;
+}
+
+size_t TokenBucket::available() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (rate_ <= 0) {
+    return SIZE_MAX;
+  }
+  refill(Timer::now());
+  return tokens_ >= 1 ? static_cast<size_t>(tokens_) : 0;
+}
+
+void TokenBucket::consume(size_t n) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (rate_ > 0) {
+    tokens_ -= static_cast<double>(n);
+  }
+}
+
+void TokenBucket::refill(int64_t now) {
+  if (now > lastRefill_) {
+    tokens_ = std::min(burst_, tokens_ + rate_ * (now - lastRefill_) / (1000 * 1000));
+    lastRefill_ = now;
+  }
+}
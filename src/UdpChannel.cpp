@@ -0,0 +1,425 @@
+#include "UdpChannel.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <functional>
+#include <netinet/udp.h>
+#include <string.h>
+
+namespace {
+
+const int kMaxReadRounds = 8;              // 一次可读事件中最多收取 kMaxReadRounds 批，避免饿死同一 loop 上的其他 channel
+const size_t kGroSlotSize = 65536;         // 开启 GRO 后一个接收槽可能收到合并后的 64KB 数据
+const size_t kMaxUdpPayload = 65507;       // IPv4 UDP 数据报的最大负载
+const size_t kMaxGsoSegments = 64;         // 一次 UDP_SEGMENT 发送的最大报文数(UDP_MAX_SEGMENTS)
+const size_t kControlWords = 4;            // 每个槽位的控制消息缓冲区(32 字节，足够放一个 int/uint16_t 的 cmsg)
+
+int createUdpSocket(sa_family_t family) {
+  int sockfd = ::socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (sockfd < 0) {
+    LOG_FATAL("[%s:%s:%d]\nudp socket create error: %d!\n", __FILE__, __FUNCTION__, __LINE__, errno);
+  }
+  return sockfd;
+}
+
+} // namespace
+
+UdpChannel::UdpChannel(EventLoop *loop, const InetAddress &bindAddr, const UdpOptions &options)
+    : loop_(loop)
+    , socket_(createUdpSocket(bindAddr.family()))
+    , localAddr_(bindAddr)
+    , channel_(new Channel(loop, socket_.fd()))
+    , options_(options)
+    , groEnabled_(false)
+    , gsoEnabled_(false)
+    , started_(false)
+    , closed_(false)
+    , flushPending_(false)
+    , slotSize_(std::max<size_t>(options.maxDatagramSize, 1))
+    , sendHead_(0)
+    , sendCount_(0)
+    , packetsReceived_(0)
+    , packetsSent_(0)
+    , dropped_(0)
+    , truncated_(0) {
+  socket_.setReuseAddr(true);
+  if (options_.reusePort) {
+    socket_.setReusePort(true);
+  }
+  if (options_.sendBufferSize > 0) {
+    socket_.setSendBufferSize(options_.sendBufferSize);
+  }
+  if (options_.recvBufferSize > 0) {
+    socket_.setRecvBufferSize(options_.recvBufferSize);
+  }
+  socket_.bindAddress(bindAddr);
+  sockaddr_in6 local;
+  socklen_t addrlen = sizeof(local);
+  if (::getsockname(socket_.fd(), (sockaddr *)&local, &addrlen) == 0) {
+    localAddr_.setSockAddr((sockaddr *)&local, addrlen);
+  }
+
+  // UDP_SEGMENT 设为 0 表示不切分，只用来探测内核是否支持 GSO，真正的分段大小随每次 sendmsg 的 cmsg 传递
+  int zero = 0;
+  gsoEnabled_ = ::setsockopt(socket_.fd(), SOL_UDP, UDP_SEGMENT, &zero, sizeof(zero)) == 0;
+  if (options_.gro) {
+    int on = 1;
+    groEnabled_ = ::setsockopt(socket_.fd(), SOL_UDP, UDP_GRO, &on, sizeof(on)) == 0;
+    if (groEnabled_) {
+      slotSize_ = std::max(slotSize_, kGroSlotSize);
+    } else {
+      LOG_ERROR("[%s:%s:%d]\nUDP_GRO not supported: %d\n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+  }
+
+  size_t batch = static_cast<size_t>(std::max(options_.batchSize, 1));
+  recvBuffer_.resize(batch * slotSize_);
+  recvMsgs_.resize(batch);
+  recvIovs_.resize(batch);
+  recvAddrs_.resize(batch);
+  recvControl_.resize(batch * kControlWords);
+  for (size_t i = 0; i < batch; ++i) {
+    recvIovs_[i].iov_base = &recvBuffer_[i * slotSize_];
+    recvIovs_[i].iov_len = slotSize_;
+    msghdr &hdr = recvMsgs_[i].msg_hdr;
+    ::memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_name = &recvAddrs_[i];
+    hdr.msg_iov = &recvIovs_[i];
+    hdr.msg_iovlen = 1;
+  }
+  sendMsgs_.resize(batch);
+  sendIovs_.resize(batch);
+  sendControl_.resize(batch * kControlWords);
+
+  channel_->setReadCallback(std::bind(&UdpChannel::handleRead, this, std::placeholders::_1));
+  channel_->setWriteCallback(std::bind(&UdpChannel::handleWrite, this));
+}
+
+UdpChannel::~UdpChannel() {
+  if (!closed_) {
+    channel_->disableAll();
+    channel_->remove();
+  }
+}
+
+void UdpChannel::start() {
+  if (started_ || closed_) {
+    return;
+  }
+  started_ = true;
+  channel_->tie(shared_from_this());
+  channel_->enableReading();
+}
+
+void UdpChannel::close() {
+  if (closed_) {
+    return;
+  }
+  closed_ = true;
+  channel_->disableAll();
+  channel_->remove();
+  sendHead_ = 0;
+  sendCount_ = 0;
+}
+
+void UdpChannel::handleRead(Timestamp receiveTime) {
+  if (recvMsgs_.size() > 1) {
+    readBatched(receiveTime);
+  } else {
+    readSingle(receiveTime);
+  }
+}
+
+void UdpChannel::readBatched(Timestamp receiveTime) {
+  const unsigned batch = static_cast<unsigned>(recvMsgs_.size());
+  const size_t controlBytes = kControlWords * sizeof(uint64_t);
+  for (int round = 0; round < kMaxReadRounds && !closed_; ++round) {
+    // recvmmsg 会改写地址长度、控制消息长度和标志位，每一批之前复位
+    for (unsigned i = 0; i < batch; ++i) {
+      msghdr &hdr = recvMsgs_[i].msg_hdr;
+      hdr.msg_namelen = sizeof(sockaddr_in6);
+      hdr.msg_control = groEnabled_ ? &recvControl_[i * kControlWords] : nullptr;
+      hdr.msg_controllen = groEnabled_ ? controlBytes : 0;
+      hdr.msg_flags = 0;
+    }
+    int n = ::recvmmsg(socket_.fd(), &recvMsgs_[0], batch, MSG_DONTWAIT, nullptr);
+    if (n <= 0) {
+      if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        LOG_ERROR("[%s:%s:%d]\nrecvmmsg error: %d\n", __FILE__, __FUNCTION__, __LINE__, errno);
+      }
+      return;
+    }
+    for (int i = 0; i < n && !closed_; ++i) {
+      msghdr &hdr = recvMsgs_[i].msg_hdr;
+      if (hdr.msg_flags & MSG_TRUNC) {
+        add(&truncated_, 1);
+        continue;
+      }
+      size_t segmentSize = 0;
+      if (groEnabled_) {
+        for (cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+          if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+            int gso = 0;
+            ::memcpy(&gso, CMSG_DATA(cmsg), sizeof(gso));
+            segmentSize = static_cast<size_t>(gso);
+          }
+        }
+      }
+      deliver(&recvBuffer_[i * slotSize_], recvMsgs_[i].msg_len, segmentSize,
+              (sockaddr *)&recvAddrs_[i], hdr.msg_namelen, receiveTime);
+    }
+    if (static_cast<unsigned>(n) < batch) {
+      return;
+    }
+  }
+}
+
+// batchSize 为 1 时逐个收取：没有 GRO 时就是一次 recvfrom 一个数据报
+void UdpChannel::readSingle(Timestamp receiveTime) {
+  msghdr &hdr = recvMsgs_[0].msg_hdr;
+  for (int i = 0; i < kMaxReadRounds && !closed_; ++i) {
+    ssize_t n;
+    size_t segmentSize = 0;
+    socklen_t addrlen = sizeof(sockaddr_in6);
+    if (groEnabled_) {
+      hdr.msg_namelen = addrlen;
+      hdr.msg_control = &recvControl_[0];
+      hdr.msg_controllen = kControlWords * sizeof(uint64_t);
+      hdr.msg_flags = 0;
+      n = ::recvmsg(socket_.fd(), &hdr, MSG_DONTWAIT);
+      addrlen = hdr.msg_namelen;
+      if (n >= 0) {
+        for (cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+          if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+            int gso = 0;
+            ::memcpy(&gso, CMSG_DATA(cmsg), sizeof(gso));
+            segmentSize = static_cast<size_t>(gso);
+          }
+        }
+      }
+    } else {
+      n = ::recvfrom(socket_.fd(), &recvBuffer_[0], slotSize_, MSG_DONTWAIT | MSG_TRUNC,
+                     (sockaddr *)&recvAddrs_[0], &addrlen);
+    }
+    if (n < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        LOG_ERROR("[%s:%s:%d]\nrecvfrom error: %d\n", __FILE__, __FUNCTION__, __LINE__, errno);
+      }
+      return;
+    }
+    if (static_cast<size_t>(n) > slotSize_ || (hdr.msg_flags & MSG_TRUNC)) {
+      add(&truncated_, 1);
+      continue;
+    }
+    deliver(&recvBuffer_[0], n, segmentSize, (sockaddr *)&recvAddrs_[0], addrlen, receiveTime);
+  }
+}
+
+// GRO 合并的数据按 segmentSize 拆回原始的数据报，最后一个可能较短
+void UdpChannel::deliver(const char *data, size_t len, size_t segmentSize, const sockaddr *addr,
+                         socklen_t addrLen, Timestamp receiveTime) {
+  InetAddress peer(addr, addrLen);
+  if (segmentSize == 0 || segmentSize >= len) {
+    add(&packetsReceived_, 1);
+    if (messageCallback_) {
+      messageCallback_(this, data, len, peer, receiveTime);
+    }
+    return;
+  }
+  for (size_t offset = 0; offset < len && !closed_; offset += segmentSize) {
+    add(&packetsReceived_, 1);
+    if (messageCallback_) {
+      messageCallback_(this, data + offset, std::min(segmentSize, len - offset), peer, receiveTime);
+    }
+  }
+}
+
+void UdpChannel::send(const void *data, size_t len, const InetAddress &peer) {
+  sendSegments(data, len, 0, peer);
+}
+
+void UdpChannel::sendSegments(const void *data, size_t len, size_t segmentSize,
+                              const InetAddress &peer) {
+  if (loop_->isInLoopThread()) {
+    sendInLoop(static_cast<const char *>(data), len, segmentSize, peer);
+  } else {
+    loop_->runInLoop(std::bind(&UdpChannel::sendString, shared_from_this(),
+                               std::string(static_cast<const char *>(data), len), segmentSize,
+                               peer));
+  }
+}
+
+void UdpChannel::sendString(const std::string &data, size_t segmentSize, const InetAddress &addr) {
+  sendInLoop(data.data(), data.size(), segmentSize, addr);
+}
+
+void UdpChannel::sendInLoop(const char *data, size_t len, size_t segmentSize,
+                            const InetAddress &addr) {
+  if (closed_) {
+    return;
+  }
+  // 一组 GSO 报文最多 kMaxGsoSegments 个、总长不超过一个 UDP 数据报，超出的部分拆成多组
+  size_t perSend = gsoEnabled_ && segmentSize > 0
+                       ? std::min(kMaxGsoSegments, kMaxUdpPayload / segmentSize) * segmentSize
+                       : segmentSize;
+  if (segmentSize == 0 || segmentSize >= len) {
+    enqueue(data, len, 0, addr);
+  } else {
+    for (size_t offset = 0; offset < len; offset += std::max(perSend, segmentSize)) {
+      size_t chunk = std::min(std::max(perSend, segmentSize), len - offset);
+      enqueue(data + offset, chunk, chunk > segmentSize ? segmentSize : 0, addr);
+    }
+  }
+  // 本轮循环结束时统一 flush；已经在等待 EPOLLOUT 时由 handleWrite 发送
+  if (!flushPending_ && !channel_->isWriting()) {
+    flushPending_ = true;
+    loop_->runAtIterationEnd(std::bind(&UdpChannel::flush, shared_from_this()));
+  }
+}
+
+void UdpChannel::enqueue(const char *data, size_t len, size_t segmentSize, const InetAddress &addr) {
+  if (sendCount_ - sendHead_ >= options_.maxPendingSends) {
+    add(&dropped_, segmentSize > 0 ? (len + segmentSize - 1) / segmentSize : 1);
+    return;
+  }
+  if (sendCount_ == sendQueue_.size()) {
+    if (sendHead_ > 0) {
+      // 队首已发出的项挪到队尾复用
+      std::rotate(sendQueue_.begin(), sendQueue_.begin() + sendHead_, sendQueue_.begin() + sendCount_);
+      sendCount_ -= sendHead_;
+      sendHead_ = 0;
+    } else {
+      sendQueue_.emplace_back();
+    }
+  }
+  PendingSend &item = sendQueue_[sendCount_++];
+  item.data.assign(data, len);
+  item.addr = addr;
+  item.segmentSize = segmentSize;
+}
+
+void UdpChannel::handleWrite() { flush(); }
+
+void UdpChannel::flush() {
+  flushPending_ = false;
+  if (closed_) {
+    return;
+  }
+  while (sendHead_ < sendCount_) {
+    size_t sent = sendMsgs_.size() > 1 ? flushBatched() : flushSingle();
+    if (sent == 0) {
+      break;
+    }
+  }
+  if (sendHead_ == sendCount_) {
+    sendHead_ = 0;
+    sendCount_ = 0;
+    if (channel_->isWriting()) {
+      channel_->disableWriting();
+    }
+  } else if (!channel_->isWriting()) {
+    // 内核发送缓冲区满，等待 EPOLLOUT
+    channel_->enableWriting();
+  }
+}
+
+void UdpChannel::prepareSend(size_t i, PendingSend *item) {
+  sendIovs_[i].iov_base = &item->data[0];
+  sendIovs_[i].iov_len = item->data.size();
+  msghdr &hdr = sendMsgs_[i].msg_hdr;
+  ::memset(&hdr, 0, sizeof(hdr));
+  hdr.msg_name = const_cast<sockaddr *>(item->addr.getSockAddr());
+  hdr.msg_namelen = item->addr.length();
+  hdr.msg_iov = &sendIovs_[i];
+  hdr.msg_iovlen = 1;
+  if (item->segmentSize > 0) {
+    hdr.msg_control = &sendControl_[i * kControlWords];
+    hdr.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    uint16_t segment = static_cast<uint16_t>(item->segmentSize);
+    ::memcpy(CMSG_DATA(cmsg), &segment, sizeof(segment));
+  }
+}
+
+size_t UdpChannel::flushBatched() {
+  size_t batch = std::min(sendCount_ - sendHead_, sendMsgs_.size());
+  for (size_t i = 0; i < batch; ++i) {
+    prepareSend(i, &sendQueue_[sendHead_ + i]);
+  }
+  int n = ::sendmmsg(socket_.fd(), &sendMsgs_[0], static_cast<unsigned>(batch), 0);
+  if (n > 0) {
+    for (int i = 0; i < n; ++i) {
+      countSent(sendQueue_[sendHead_ + i]);
+    }
+    sendHead_ += n;
+    return n;
+  }
+  if (errno == EAGAIN || errno == EWOULDBLOCK) {
+    return 0;
+  }
+  // 队首的报文发送失败(报文过大、目的不可达等)，丢弃后继续发送后面的报文
+  PendingSend &item = sendQueue_[sendHead_];
+  if (item.segmentSize > 0 && (errno == EIO || errno == EINVAL)) {
+    // 网卡不支持校验和卸载等原因导致 GSO 不可用，以后都逐个发送
+    LOG_ERROR("[%s:%s:%d]\nUDP_SEGMENT send failed: %d, disable GSO\n", __FILE__, __FUNCTION__,
+              __LINE__, errno);
+    gsoEnabled_ = false;
+    sendSegmentsSingly(item);
+  } else {
+    LOG_ERROR("[%s:%s:%d]\nsendmmsg error: %d\n", __FILE__, __FUNCTION__, __LINE__, errno);
+    add(&dropped_, 1);
+  }
+  ++sendHead_;
+  return 1;
+}
+
+// batchSize 为 1 时逐个发送：没有 GSO 时就是一次 sendto 一个数据报
+size_t UdpChannel::flushSingle() {
+  PendingSend &item = sendQueue_[sendHead_];
+  ssize_t n;
+  if (item.segmentSize > 0) {
+    prepareSend(0, &item);
+    n = ::sendmsg(socket_.fd(), &sendMsgs_[0].msg_hdr, 0);
+  } else {
+    n = ::sendto(socket_.fd(), item.data.data(), item.data.size(), 0, item.addr.getSockAddr(),
+                 item.addr.length());
+  }
+  if (n >= 0) {
+    countSent(item);
+  } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+    return 0;
+  } else if (item.segmentSize > 0 && (errno == EIO || errno == EINVAL)) {
+    gsoEnabled_ = false;
+    sendSegmentsSingly(item);
+  } else {
+    LOG_ERROR("[%s:%s:%d]\nsendto error: %d\n", __FILE__, __FUNCTION__, __LINE__, errno);
+    add(&dropped_, 1);
+  }
+  ++sendHead_;
+  return 1;
+}
+
+// GSO 发送失败后把一组报文逐个发出，发送缓冲区满时丢弃剩余部分
+void UdpChannel::sendSegmentsSingly(const PendingSend &item) {
+  const size_t len = item.data.size();
+  for (size_t offset = 0; offset < len; offset += item.segmentSize) {
+    size_t chunk = std::min(item.segmentSize, len - offset);
+    if (::sendto(socket_.fd(), item.data.data() + offset, chunk, 0, item.addr.getSockAddr(),
+                 item.addr.length()) < 0) {
+      add(&dropped_, (len - offset + item.segmentSize - 1) / item.segmentSize);
+      return;
+    }
+    add(&packetsSent_, 1);
+  }
+}
+
+void UdpChannel::countSent(const PendingSend &item) {
+  size_t len = item.data.size();
+  add(&packetsSent_, item.segmentSize > 0 ? (len + item.segmentSize - 1) / item.segmentSize : 1);
+}
@@ -0,0 +1,86 @@
+#include "UdpServer.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "Logger.h"
+
+UdpServer::UdpServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &nameArg,
+                     const UdpOptions &options)
+    : loop_(loop)
+    , listenAddr_(listenAddr)
+    , name_(nameArg)
+    , options_(options)
+    , threadPool_(new EventLoopThreadPool(loop, nameArg))
+    , started_(0) {
+  if (loop_ == nullptr) {
+    LOG_FATAL("[%s:%s:%d]\nmainLoop is null!\n", __FILE__, __FUNCTION__, __LINE__);
+  }
+}
+
+UdpServer::~UdpServer() {
+  LOG_INFO("[%s:%s:%d]\nUdpServer::~UdpServer [%s] destructing!\n", __FILE__, __FUNCTION__,
+           __LINE__, name_.c_str());
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (const std::shared_ptr<UdpChannel> &channel : channels_) {
+    // 在 channel 所属的 loop 中从 poller 移除，回调持有的智能指针保证 channel 在此之前不会析构
+    channel->getLoop()->runInLoop(std::bind(&UdpChannel::close, channel));
+  }
+  channels_.clear();
+}
+
+void UdpServer::setThreadNum(int numThreads) { threadPool_->setThreadNum(numThreads); }
+
+void UdpServer::start() {
+  if (started_++ == 0) {
+    threadPool_->start(threadInitCallback_);
+    std::vector<EventLoop *> loops = threadPool_->getAllLoops();
+    if (loops.size() > 1) {
+      // 多个 socket 绑定同一端口
+      options_.reusePort = true;
+    }
+    for (EventLoop *loop : loops) {
+      loop->runInLoop(std::bind(&UdpServer::startInLoop, this, loop));
+    }
+  }
+}
+
+void UdpServer::startInLoop(EventLoop *loop) {
+  std::shared_ptr<UdpChannel> channel(new UdpChannel(loop, listenAddr_, options_));
+  channel->setMessageCallback(messageCallback_);
+  channel->start();
+  LOG_INFO("[%s:%s:%d]\nUdpServer [%s] fd = %d listening on %s\n", __FILE__, __FUNCTION__,
+           __LINE__, name_.c_str(), channel->fd(), channel->localAddress().toIpPort().c_str());
+  std::unique_lock<std::mutex> lock(mutex_);
+  channels_.push_back(channel);
+}
+
+std::vector<std::shared_ptr<UdpChannel>> UdpServer::channels() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return channels_;
+}
+
+int64_t UdpServer::packetsReceived() const {
+  int64_t total = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (const std::shared_ptr<UdpChannel> &channel : channels_) {
+    total += channel->packetsReceived();
+  }
+  return total;
+}
+
+int64_t UdpServer::packetsSent() const {
+  int64_t total = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (const std::shared_ptr<UdpChannel> &channel : channels_) {
+    total += channel->packetsSent();
+  }
+  return total;
+}
+
+int64_t UdpServer::dropped() const {
+  int64_t total = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (const std::shared_ptr<UdpChannel> &channel : channels_) {
+    total += channel->dropped();
+  }
+  return total;
+}
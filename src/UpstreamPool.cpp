@@ -0,0 +1,143 @@
+#include "UpstreamPool.h"
+#include "EventLoop.h"
+#include "Logger.h"
+#include "TcpClient.h"
+#include "TcpConnection.h"
+
+#include <algorithm>
+
+static const size_t kDefaultMaxIdle = 16;
+
+// 空闲连接上收到的数据(对端不应该发送)直接丢弃
+static void discardMessage(const TcpConnectionPtr &, Buffer *buf, Timestamp) { buf->retrieveAll(); }
+
+UpstreamPool *UpstreamPool::forLoop(EventLoop *loop, const InetAddress &backend) {
+  // one loop per thread，按后端地址查找当前线程(即当前 loop)的池子；loop 析构后 weak_ptr 失效，新 loop 会重新创建
+  static thread_local std::unordered_map<std::string, std::weak_ptr<UpstreamPool>> pools;
+  std::weak_ptr<UpstreamPool> &weak = pools[backend.toIpPort()];
+  std::shared_ptr<UpstreamPool> pool = weak.lock();
+  if (!pool || pool->loop_ != loop) {
+    pool = std::make_shared<UpstreamPool>(loop, backend);
+    loop->attach(pool);
+    weak = pool;
+  }
+  return pool.get();
+}
+
+UpstreamPool::UpstreamPool(EventLoop *loop, const InetAddress &backend)
+    : loop_(loop)
+    , backend_(backend)
+    , name_("upstream-" + backend.toIpPort())
+    , maxIdle_(kDefaultMaxIdle) {}
+
+UpstreamPool::~UpstreamPool() {
+  // 连接可能比池子活得久，去掉指向池子的回调；TcpClient 析构时会关闭连接或停止正在进行的连接
+  for (auto &item : upstreams_) {
+    if (item.second.conn) {
+      item.second.conn->setConnectionCallback([](const TcpConnectionPtr &) {});
+      item.second.conn->setMessageCallback(discardMessage);
+    }
+  }
+}
+
+void UpstreamPool::acquire(const AcquireCallback &cb) {
+  while (!idle_.empty()) {
+    TcpConnectionPtr conn = idle_.back();
+    idle_.pop_back();
+    if (conn->connected()) {
+      cb(conn);
+      return;
+    }
+  }
+  TcpClient *client = new TcpClient(loop_, backend_, name_);
+  Upstream &upstream = upstreams_[client];
+  upstream.client.reset(client);
+  upstream.waiter = cb;
+  client->setSocketOptions(socketOptions_);
+  client->setConnectionCallback(
+      std::bind(&UpstreamPool::onConnection, this, client, std::placeholders::_1));
+  client->setMessageCallback(discardMessage);
+  client->setConnectFailedCallback(
+      std::bind(&UpstreamPool::onConnectFailed, this, client, std::placeholders::_1));
+  client->connect();
+}
+
+void UpstreamPool::release(const TcpConnectionPtr &conn) {
+  auto it = owners_.find(conn.get());
+  if (it == owners_.end()) {
+    return;
+  }
+  if (!conn->connected() || idle_.size() >= maxIdle_) {
+    conn->shutdown();
+    return;
+  }
+  conn->setMessageCallback(discardMessage);
+  conn->setWriteCompleteCallback(WriteCompleteCallback());
+  conn->inputBuffer()->retrieveAll();
+  idle_.push_back(conn);
+}
+
+void UpstreamPool::onConnection(TcpClient *client, const TcpConnectionPtr &conn) {
+  auto it = upstreams_.find(client);
+  if (it == upstreams_.end()) {
+    return;
+  }
+  Upstream &upstream = it->second;
+  if (conn->connected()) {
+    upstream.conn = conn;
+    owners_[conn.get()] = client;
+    AcquireCallback waiter;
+    waiter.swap(upstream.waiter);
+    if (waiter) {
+      waiter(conn);
+    } else {
+      idle_.push_back(conn);
+    }
+    return;
+  }
+  // 连接关闭：空闲连接直接移出池子，已交给调用者的连接通知调用者
+  owners_.erase(conn.get());
+  upstream.conn.reset();
+  if (!removeIdle(conn) && closeCallback_) {
+    closeCallback_(conn);
+  }
+  // 当前还在 TcpClient 的回调中，稍后再析构它
+  std::weak_ptr<UpstreamPool> weak(shared_from_this());
+  loop_->queueInLoop([weak, client]() {
+    std::shared_ptr<UpstreamPool> pool = weak.lock();
+    if (pool) {
+      pool->removeUpstream(client);
+    }
+  });
+}
+
+void UpstreamPool::onConnectFailed(TcpClient *client, int err) {
+  auto it = upstreams_.find(client);
+  if (it == upstreams_.end() || !it->second.waiter) {
+    return;
+  }
+  LOG_ERROR("[%s:%s:%d]\nUpstreamPool [%s] - connect failed: %d\n", __FILE__, __FUNCTION__,
+            __LINE__, name_.c_str(), err);
+  client->stop();
+  AcquireCallback waiter;
+  waiter.swap(it->second.waiter);
+  std::weak_ptr<UpstreamPool> weak(shared_from_this());
+  loop_->queueInLoop([weak, client]() {
+    std::shared_ptr<UpstreamPool> pool = weak.lock();
+    if (pool) {
+      pool->removeUpstream(client);
+    }
+  });
+  waiter(TcpConnectionPtr());
+}
+
+void UpstreamPool::removeUpstream(TcpClient *client) { upstreams_.erase(client); }
+
+bool UpstreamPool::removeIdle(const TcpConnectionPtr &conn) {
+  auto it = std::find(idle_.begin(), idle_.end(), conn);
+  if (it == idle_.end()) {
+    return false;
+  }
+  idle_.erase(it);
+  return true;
+}
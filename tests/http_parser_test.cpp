@@ -0,0 +1,126 @@
+/*
+ * HttpParser 输入上限的测试：每个用例逐块喂入数据，检查解析器在缓冲区增长到上限之前报错
+ * 失败时打印用例名并返回非 0，由 ctest 运行
+ */
+
+#include "Buffer.h"
+#include "HttpParser.h"
+#include "HttpRequest.h"
+
+#include <stdio.h>
+#include <string>
+
+static int g_failures = 0;
+
+#define CHECK(cond)                                                        \
+  do {                                                                     \
+    if (!(cond)) {                                                         \
+      fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+      ++g_failures;                                                        \
+    }                                                                      \
+  } while (0)
+
+static const char kChunkedHead[] =
+    "POST /upload HTTP/1.1\r\nHost: x\r\nTransfer-Encoding: chunked\r\n\r\n";
+
+// 每次追加 piece，直到解析器不再返回 kNeedMore 或缓冲区超过 limit，返回最后一次的结果
+static HttpParser::Result feedUntil(HttpParser *parser, Buffer *buf, HttpRequest *request,
+                                    const std::string &piece, size_t limit) {
+  HttpParser::Result result = parser->parse(buf, request);
+  while (result == HttpParser::kNeedMore && buf->readableBytes() <= limit) {
+    buf->append(piece.data(), piece.size());
+    result = parser->parse(buf, request);
+  }
+  return result;
+}
+
+static void testChunkedRequest() {
+  HttpParser parser;
+  HttpRequest request;
+  Buffer buf;
+  std::string data = std::string(kChunkedHead) + "5;ext=1\r\nhello\r\n0\r\nX-Checksum: 1\r\n\r\n";
+  buf.append(data.data(), data.size());
+  CHECK(parser.parse(&buf, &request) == HttpParser::kComplete);
+  CHECK(parser.consumed() == data.size());
+  CHECK(request.body() == std::string("hello"));
+}
+
+// chunk 大小行一直没有换行
+static void testChunkSizeLineWithoutLf() {
+  HttpParser parser;
+  HttpRequest request;
+  Buffer buf;
+  buf.append(kChunkedHead, sizeof(kChunkedHead) - 1);
+  buf.append("1;", 2);
+  HttpParser::Result result = feedUntil(&parser, &buf, &request, std::string(256, 'a'), 1024 * 1024);
+  CHECK(result == HttpParser::kError);
+  CHECK(parser.errorStatus() == 400);
+  CHECK(buf.readableBytes() < 4096);
+}
+
+// chunk 大小行有换行但超过上限
+static void testChunkSizeLineTooLong() {
+  HttpParser parser;
+  HttpRequest request;
+  Buffer buf;
+  std::string data = std::string(kChunkedHead) + "1;" + std::string(2048, 'a') + "\r\n";
+  buf.append(data.data(), data.size());
+  CHECK(parser.parse(&buf, &request) == HttpParser::kError);
+  CHECK(parser.errorStatus() == 400);
+}
+
+// chunk 数据后面不是 CRLF，而是不断到来的数据
+static void testChunkDataEndWithoutLf() {
+  HttpParser parser;
+  HttpRequest request;
+  Buffer buf;
+  std::string data = std::string(kChunkedHead) + "2\r\nab";
+  buf.append(data.data(), data.size());
+  HttpParser::Result result = feedUntil(&parser, &buf, &request, "cd", 1024 * 1024);
+  CHECK(result == HttpParser::kError);
+  CHECK(parser.errorStatus() == 400);
+}
+
+// 最后一个 chunk 之后不断发送 trailer 行，永远不发送结束的空行
+static void testEndlessTrailers() {
+  const size_t maxHeaderBytes = 4096;
+  HttpParser parser(maxHeaderBytes);
+  HttpRequest request;
+  Buffer buf;
+  std::string data = std::string(kChunkedHead) + "0\r\n";
+  buf.append(data.data(), data.size());
+  HttpParser::Result result =
+      feedUntil(&parser, &buf, &request, "X-Trailer: 0123456789\r\n", 1024 * 1024);
+  CHECK(result == HttpParser::kError);
+  CHECK(parser.errorStatus() == 431);
+  CHECK(buf.readableBytes() < 2 * maxHeaderBytes);
+}
+
+// 一个没有换行的超长 trailer 行
+static void testTrailerLineWithoutLf() {
+  const size_t maxHeaderBytes = 4096;
+  HttpParser parser(maxHeaderBytes);
+  HttpRequest request;
+  Buffer buf;
+  std::string data = std::string(kChunkedHead) + "0\r\nX-Trailer: ";
+  buf.append(data.data(), data.size());
+  HttpParser::Result result = feedUntil(&parser, &buf, &request, std::string(256, 'a'), 1024 * 1024);
+  CHECK(result == HttpParser::kError);
+  CHECK(parser.errorStatus() == 431);
+  CHECK(buf.readableBytes() < 2 * maxHeaderBytes);
+}
+
+int main() {
+  testChunkedRequest();
+  testChunkSizeLineWithoutLf();
+  testChunkSizeLineTooLong();
+  testChunkDataEndWithoutLf();
+  testEndlessTrailers();
+  testTrailerLineWithoutLf();
+  if (g_failures != 0) {
+    fprintf(stderr, "%d check(s) failed\n", g_failures);
+    return 1;
+  }
+  printf("all passed\n");
+  return 0;
+}